@@ -0,0 +1,346 @@
+#include "Acceptance.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+namespace {
+
+const uint32_t kStandardMask = 0x7FF;
+const uint32_t kExtendedMask = 0x1FFFFFFF;
+
+// The most rules held at once. Further rules are merged into the existing
+// ones as they are added so that planning time and memory stay bounded.
+const size_t kMaxRules = 64;
+
+uint32_t widthMask(uint8_t ext) {
+    return ext ? kExtendedMask : kStandardMask;
+}
+
+// Return the number of IDs accepted by a mask.
+uint64_t cost(uint32_t mask, uint8_t ext) {
+    uint8_t width = ext ? 29 : 11;
+    return (uint64_t)1 << (width - __builtin_popcountl(mask & widthMask(ext)));
+}
+
+// Return the mask that covers both rules.
+uint32_t mergeMask(const AcceptanceFilter& a, const AcceptanceFilter& b) {
+    return a.mask & b.mask & ~(a.id ^ b.id);
+}
+
+// Return true if merging two rules accepts no IDs that neither rule accepts.
+bool exactMerge(const AcceptanceFilter& a, const AcceptanceFilter& b) {
+    const uint64_t merged = cost(mergeMask(a, b), a.ext);
+    const uint64_t cost_a = cost(a.mask, a.ext);
+    const uint64_t cost_b = cost(b.mask, b.ext);
+    if (merged == cost_a || merged == cost_b) {
+        // One rule contains the other.
+        return true;
+    }
+    const bool disjoint = ((a.id ^ b.id) & a.mask & b.mask) != 0;
+    return disjoint && merged == cost_a + cost_b;
+}
+
+}  // namespace
+
+AcceptancePlanner::~AcceptancePlanner() {
+    if (rules_ != nullptr) {
+        delete[] rules_;
+    }
+}
+
+void AcceptancePlanner::accept(uint32_t id, uint32_t mask, uint8_t ext) {
+    if (all_) {
+        return;
+    }
+    ext = ext ? 1 : 0;
+    mask &= widthMask(ext);
+    id &= mask;
+    for (size_t i = 0; i < len_; ++i) {
+        if (rules_[i].ext == ext && rules_[i].mask == mask && rules_[i].id == id) {
+            return;
+        }
+    }
+
+    if (len_ + 1 > size_) {
+        size_t new_size = size_ == 0 ? 8 : size_ * 2;
+        if (new_size > kMaxRules + 1) {
+            new_size = kMaxRules + 1;
+        }
+        AcceptanceFilter* new_rules = new AcceptanceFilter[new_size];
+        if (new_rules == nullptr) {
+            // Without room for the rule no cover is possible.
+            acceptAll();
+            return;
+        }
+        if (rules_ != nullptr) {
+            memcpy(new_rules, rules_, len_ * sizeof(AcceptanceFilter));
+            delete[] rules_;
+        }
+        rules_ = new_rules;
+        size_ = new_size;
+    }
+    rules_[len_].id = id;
+    rules_[len_].mask = mask;
+    rules_[len_].ext = ext;
+    ++len_;
+    reduce(kMaxRules);
+}
+
+void AcceptancePlanner::accept(const FrameIDFilter& filter) {
+    if (filter.mode_ == FilterMode::ALLOW) {
+        acceptAll();
+        return;
+    }
+    if (filter.bitmap_ != nullptr) {
+        // Add each run of consecutive IDs as a range.
+        uint32_t id = 0;
+        while (id <= kStandardMask) {
+            if ((filter.bitmap_[id >> 3] & (1 << (id & 0x07))) == 0) {
+                ++id;
+                continue;
+            }
+            uint32_t low = id;
+            while (id < kStandardMask &&
+                    (filter.bitmap_[(id + 1) >> 3] & (1 << ((id + 1) & 0x07)))) {
+                ++id;
+            }
+            acceptRange(low, id, 0);
+            ++id;
+        }
+    }
+    for (size_t i = 0; i < filter.len_; ++i) {
+        accept(filter.items_[i], kExtendedMask, 1);
+    }
+    for (size_t i = 0; i < filter.masks_len_; ++i) {
+        const uint32_t value = filter.masks_[i].value;
+        const uint32_t mask = filter.masks_[i].mask;
+        accept(value, mask, (value | mask) > kStandardMask);
+    }
+    for (size_t i = 0; i < filter.ranges_len_; ++i) {
+        uint32_t low = filter.ranges_[i].low;
+        uint32_t high = filter.ranges_[i].high;
+        if (low <= kStandardMask) {
+            acceptRange(low, high > kStandardMask ? kStandardMask : high, 0);
+        }
+        if (high > kStandardMask) {
+            acceptRange(low > kStandardMask ? low : kStandardMask + 1,
+                    high > kExtendedMask ? kExtendedMask : high, 1);
+        }
+    }
+}
+
+void AcceptancePlanner::acceptRange(uint32_t low, uint32_t high, uint8_t ext) {
+    // Split the range into the largest aligned power of two blocks.
+    while (low <= high) {
+        uint32_t size = 1;
+        while ((low & ((size << 1) - 1)) == 0 && low + (size << 1) - 1 <= high &&
+                (size << 1) - 1 <= widthMask(ext)) {
+            size <<= 1;
+        }
+        accept(low, ~(size - 1), ext);
+        if (low + size - 1 >= high) {
+            break;
+        }
+        low += size;
+    }
+}
+
+void AcceptancePlanner::clear() {
+    len_ = 0;
+    all_ = false;
+    exact_ = true;
+}
+
+bool AcceptancePlanner::reduce(size_t n) {
+    while (len_ > n) {
+        size_t best_i = 0;
+        size_t best_j = 0;
+        int64_t best_delta = INT64_MAX;
+        for (size_t i = 0; i < len_; ++i) {
+            for (size_t j = i + 1; j < len_; ++j) {
+                if (rules_[i].ext != rules_[j].ext) {
+                    continue;
+                }
+                uint8_t ext = rules_[i].ext;
+                int64_t delta = cost(mergeMask(rules_[i], rules_[j]), ext) -
+                    cost(rules_[i].mask, ext) - cost(rules_[j].mask, ext);
+                if (delta < best_delta) {
+                    best_delta = delta;
+                    best_i = i;
+                    best_j = j;
+                }
+            }
+        }
+        if (best_delta == INT64_MAX) {
+            return false;
+        }
+        if (!exactMerge(rules_[best_i], rules_[best_j])) {
+            exact_ = false;
+        }
+        rules_[best_i].mask = mergeMask(rules_[best_i], rules_[best_j]);
+        rules_[best_i].id &= rules_[best_i].mask;
+        rules_[best_j] = rules_[--len_];
+    }
+    return true;
+}
+
+bool AcceptancePlanner::plan(AcceptanceFilter* filters, size_t size, size_t* len) {
+    *len = 0;
+    if (all_ || len_ == 0 || !reduce(size)) {
+        return false;
+    }
+    memcpy(filters, rules_, len_ * sizeof(AcceptanceFilter));
+    *len = len_;
+    return true;
+}
+
+bool AcceptancePlanner::plan(const uint8_t* groups, size_t count, AcceptanceFilter* masks,
+        AcceptanceFilter* filters) {
+    size_t total = 0;
+    for (size_t g = 0; g < count; ++g) {
+        total += groups[g];
+    }
+    if (all_ || len_ == 0 || count == 0 || !reduce(total)) {
+        return false;
+    }
+
+    // Try every assignment of rules to groups and keep the one that accepts
+    // the fewest IDs. There are at most count^total assignments which is
+    // small for the controllers this is used with. If no assignment fits then
+    // merge another pair of rules and try again.
+    uint32_t best = 0;
+    uint64_t best_cost = UINT64_MAX;
+    while (best_cost == UINT64_MAX) {
+        uint32_t assignments = 1;
+        for (size_t i = 0; i < len_; ++i) {
+            assignments *= count;
+        }
+        for (uint32_t a = 0; a < assignments; ++a) {
+            uint64_t a_cost = 0;
+            bool valid = true;
+            for (size_t g = 0; g < count && valid; ++g) {
+                AcceptanceFilter shared;
+                size_t distinct;
+                valid = group(a, count, g, &shared, &distinct) && distinct <= groups[g];
+                if (distinct > 0) {
+                    a_cost += distinct * cost(shared.mask, shared.ext);
+                }
+            }
+            if (valid && a_cost < best_cost) {
+                best_cost = a_cost;
+                best = a;
+            }
+        }
+        if (best_cost == UINT64_MAX && (len_ <= 1 || !reduce(len_ - 1))) {
+            return false;
+        }
+    }
+
+    // Write the masks and filters for the chosen assignment. Unused filter
+    // slots duplicate the first filter in the group.
+    size_t first = count;
+    size_t first_offset = 0;
+    size_t offset = 0;
+    for (size_t g = 0; g < count; ++g) {
+        AcceptanceFilter shared;
+        size_t distinct;
+        group(best, count, g, &shared, &distinct);
+        masks[g] = shared;
+        masks[g].id = 0;
+
+        size_t n = 0;
+        uint32_t digits = best;
+        for (size_t i = 0; i < len_; ++i, digits /= count) {
+            if (digits % count != g) {
+                continue;
+            }
+            if (rules_[i].mask != shared.mask) {
+                // The shared mask widens this rule.
+                exact_ = false;
+            }
+            uint32_t id = rules_[i].id & shared.mask;
+            bool seen = false;
+            for (size_t j = 0; j < n; ++j) {
+                if (filters[offset + j].id == id) {
+                    seen = true;
+                    break;
+                }
+            }
+            if (!seen) {
+                filters[offset + n].id = id;
+                filters[offset + n].mask = shared.mask;
+                filters[offset + n].ext = shared.ext;
+                ++n;
+            }
+        }
+        for (size_t i = n; i < groups[g] && n > 0; ++i) {
+            filters[offset + i] = filters[offset];
+        }
+        if (n > 0 && first == count) {
+            first = g;
+            first_offset = offset;
+        }
+        offset += groups[g];
+    }
+
+    // Empty groups copy the first populated group so they accept nothing
+    // new.
+    offset = 0;
+    for (size_t g = 0; g < count; ++g) {
+        AcceptanceFilter shared;
+        size_t distinct;
+        group(best, count, g, &shared, &distinct);
+        if (distinct == 0) {
+            masks[g] = masks[first];
+            for (size_t i = 0; i < groups[g]; ++i) {
+                filters[offset + i] = filters[first_offset];
+            }
+        }
+        offset += groups[g];
+    }
+    return true;
+}
+
+bool AcceptancePlanner::group(uint32_t assignment, size_t count, size_t g,
+        AcceptanceFilter* shared, size_t* distinct) const {
+    // The shared mask is the intersection of the member masks.
+    *distinct = 0;
+    size_t members = 0;
+    uint32_t digits = assignment;
+    for (size_t i = 0; i < len_; ++i, digits /= count) {
+        if (digits % count != g) {
+            continue;
+        }
+        if (members == 0) {
+            *shared = rules_[i];
+        } else if (shared->ext != rules_[i].ext) {
+            return false;
+        } else {
+            shared->mask &= rules_[i].mask;
+        }
+        ++members;
+    }
+
+    // Count the distinct filter values under the shared mask.
+    digits = assignment;
+    for (size_t i = 0; i < len_; ++i, digits /= count) {
+        if (digits % count != g) {
+            continue;
+        }
+        bool seen = false;
+        uint32_t other = assignment;
+        for (size_t j = 0; j < i; ++j, other /= count) {
+            if (other % count == g &&
+                    (rules_[j].id & shared->mask) == (rules_[i].id & shared->mask)) {
+                seen = true;
+                break;
+            }
+        }
+        if (!seen) {
+            ++*distinct;
+        }
+    }
+    return true;
+}
+
+}  // namespace Canny
@@ -0,0 +1,102 @@
+#ifndef _CANNY_ACCEPTANCE_H_
+#define _CANNY_ACCEPTANCE_H_
+
+#include <Arduino.h>
+#include "Filter.h"
+
+namespace Canny {
+
+// A hardware acceptance filter. A frame is accepted when its ext flag matches
+// and (frame_id & mask) == id.
+struct AcceptanceFilter {
+    uint32_t id;
+    uint32_t mask;
+    uint8_t ext;
+};
+
+// Plans the hardware acceptance filters of a CAN controller. Rules describing
+// the frames an application wants to receive are added to the planner which
+// then computes the tightest set of ID/mask pairs that covers all of them
+// within the controller's limits. Rules are merged greedily, always choosing
+// the merge that lets the fewest extra IDs through.
+//
+// The hardware cover may accept frames that the rules do not. Those frames
+// must still be removed by a software filter after they are read. exact()
+// reports whether the last plan needs one.
+//
+// Standard and extended rules are never merged with each other. When rules are
+// added from a FrameIDFilter, IDs up to 0x7FF are treated as standard IDs and
+// larger IDs as extended. Consecutive IDs are added as ranges.
+//
+// At most 64 rules are held at once. Rules added beyond that are merged into
+// the existing rules as they arrive. If memory for the rules can't be
+// allocated the planner accepts all frames.
+class AcceptancePlanner {
+    public:
+        AcceptancePlanner() : rules_(nullptr), size_(0), len_(0), all_(false), exact_(true) {}
+        ~AcceptancePlanner();
+
+        // Accept frames whose ID matches id under mask.
+        void accept(uint32_t id, uint32_t mask, uint8_t ext);
+
+        // Accept every frame allowed by a filter. A filter in ALLOW mode may
+        // allow any frame and causes the planner to accept all frames.
+        void accept(const FrameIDFilter& filter);
+
+        // Accept all frames. Hardware filtering should be disabled.
+        void acceptAll() { all_ = true; }
+
+        // Return true if the planner accepts all frames.
+        bool all() const { return all_; }
+
+        // Return true if the last plan accepts exactly the frames the rules
+        // describe. When false the hardware admits extra frames which must be
+        // dropped in software.
+        bool exact() const { return exact_ && !all_; }
+
+        // Clear all rules.
+        void clear();
+
+        // Plan for a controller with independent filters, each with its own
+        // mask. At most size filters are written to filters and the number
+        // written is stored in len. Rules are reduced in place.
+        //
+        // Return false if no hardware cover is possible in which case the
+        // hardware filters should be disabled.
+        bool plan(AcceptanceFilter* filters, size_t size, size_t* len);
+
+        // Plan for a controller whose filters share masks. The controller has
+        // count masks and groups[i] filters are assigned to mask i. Masks are
+        // written to masks and filters are written to filters in group order.
+        // Every filter slot is written. Rules are reduced in place.
+        //
+        // Return false if no hardware cover is possible in which case the
+        // hardware filters should be disabled.
+        bool plan(const uint8_t* groups, size_t count, AcceptanceFilter* masks,
+                AcceptanceFilter* filters);
+
+    private:
+        // Add a range of IDs as aligned mask rules.
+        void acceptRange(uint32_t low, uint32_t high, uint8_t ext);
+
+        // Merge rules until no more than n remain. Return false if rules
+        // cannot be merged further.
+        bool reduce(size_t n);
+
+        // Compute the shared mask and the number of distinct filter values of
+        // group g when rules are assigned to groups by the digits of
+        // assignment in base count. Return false if the group mixes standard
+        // and extended rules.
+        bool group(uint32_t assignment, size_t count, size_t g,
+                AcceptanceFilter* shared, size_t* distinct) const;
+
+        AcceptanceFilter* rules_;
+        size_t size_;
+        size_t len_;
+        bool all_;
+        bool exact_;
+};
+
+}  // namespace Canny
+
+#endif  // _CANNY_ACCEPTANCE_H_
@@ -2,19 +2,41 @@
 #define _CANNY_BUFFER_H_
 
 #include <Arduino.h>
-#include <Foundation.h>
+#include "CoalescingFrameQueue.h"
 #include "Connection.h"
+#include "Filter.h"
+#include "CompactFrameQueue.h"
 #include "Frame.h"
+#include "FrameQueue.h"
+#include "PriorityFrameQueue.h"
+#include "Stats.h"
 
 namespace Canny {
 
 // A CAN connection that buffers reads and writes. Supports pre-filtering of
 // reads and writes to avoid filling buffers with frames that should be ignored.
-template <typename FrameType>
+//
+// Frames are buffered in a FrameQueue by default. A CompactFrameQueue may be
+// used instead to store more small frames in the same memory, e.g.
+// BufferedConnection<CANFDFrame, CompactFrameQueue<CANFDFrame>>.
+//
+// The write buffer uses the same queue type as the read buffer unless
+// WriteQueueType is given. Use a PriorityFrameQueue to send buffered frames in
+// bus arbitration order rather than FIFO order so that high priority frames
+// are not delayed behind a backlog of low priority ones, e.g.
+// BufferedConnection<CAN20Frame, FrameQueue<CAN20Frame>, PriorityFrameQueue<CAN20Frame>>.
+// When a priority write buffer is full a higher priority frame replaces the
+// lowest priority buffered frame, which is discarded via onWriteError.
+// Use a CoalescingFrameQueue to keep only the latest pending frame for each ID
+// when writing periodic frames to a slow link. Its size is the number of
+// distinct IDs rather than frames.
+template <typename FrameType, typename QueueType = FrameQueue<FrameType>,
+         typename WriteQueueType = QueueType>
 class BufferedConnection : public Connection<FrameType> {
     public:
         // Construct a buffered connection that reads/writes to the child
-        // connection. Buffers of the given sizes are created.
+        // connection. Buffers of the given sizes are created. Sizes are in
+        // frames for a FrameQueue and in bytes for a CompactFrameQueue.
         BufferedConnection(
                 Connection<FrameType>* child,
                 size_t read_buffer_size,
@@ -37,19 +59,83 @@ class BufferedConnection : public Connection<FrameType> {
         // if the write fails with ERR_FIFO and the internal buffer is full.
         Error write(const FrameType& frame) override;
 
+        // Read up to max frames. Buffered frames are returned first followed
+        // by frames read directly from the child in a single burst. Filtered
+        // frames are not returned.
+        //
+        // Return ERR_OK if at least one frame was read or ERR_FIFO otherwise.
+        Error readMany(FrameType* frames, size_t max, size_t* n) override;
+
+        // Write frames to the child in bursts. Frames that the child cannot
+        // accept are buffered. The number of frames written, buffered, or
+        // filtered is stored in n.
+        //
+        // Return ERR_OK when all frames were handled. Return ERR_FIFO if the
+        // internal buffer is full. The discarded frame is frames[*n].
+        Error writeMany(const FrameType* frames, size_t count, size_t* n) override;
+
         // Flush buffered writes. This should happen in loop() to avoid delays
         // when write() isn't being called frequently.
         void flush();
 
+        // Borrow the next frame in the read buffer without copying it. The
+        // buffer is filled from the child if it is empty. The frame remains
+        // valid until release() is called and must be released before the
+        // next call to read(), readMany(), or borrow().
+        //
+        // Return ERR_OK if a frame was borrowed or ERR_FIFO if there are no
+        // frames to read.
+        Error borrow(FrameType** frame);
+
+        // Release the frame returned by borrow().
+        void release();
+
+        // Return an empty slot in the write buffer for the caller to fill in
+        // place. Buffered writes are flushed to make room if necessary.
+        // Return nullptr if the write buffer is full. The slot must be
+        // committed before the next write.
+        FrameType* reserve();
+
+        // Queue the frame in the slot returned by reserve() and flush
+        // buffered writes. The frame is discarded if it fails the write
+        // filter.
+        //
+        // Return ERR_OK if the frame was queued or filtered. Return ERR_FIFO
+        // if no slot was reserved.
+        Error commit();
+
+        // Set a filter to apply to frames read from the child connection. The
+        // filter is used by the default readFilter() implementation. Set to
+        // nullptr to read all frames. The filter is not owned by the
+        // connection.
+        void setReadFilter(FrameIDFilter* filter) { read_filter_ = filter; }
+
+        // Set a filter to apply to frames written to the child connection.
+        // The filter is used by the default writeFilter() implementation. Set
+        // to nullptr to write all frames. The filter is not owned by the
+        // connection.
+        void setWriteFilter(FrameIDFilter* filter) { write_filter_ = filter; }
+
         // Filter frames read from the child connection. Filtered frames are
         // not buffered. Return true if a frame should be read or false to
-        // filter a frame.
-        virtual bool readFilter(const FrameType&) const { return true; }
+        // filter a frame. Applies the read filter by default.
+        virtual bool readFilter(const FrameType& frame) const {
+            return read_filter_ == nullptr || read_filter_->match(frame);
+        }
 
         // Filter frames written to the child connection. Filtered frames are
         // not buffered. true if a frame should be written or false false to
-        // filter a frame.
-        virtual bool writeFilter(const FrameType&) const { return true; }
+        // filter a frame. Applies the write filter by default.
+        virtual bool writeFilter(const FrameType& frame) const {
+            return write_filter_ == nullptr || write_filter_->match(frame);
+        }
+
+        // Copy the statistics recorded for this connection. Statistics are
+        // only recorded when CANNY_STATS is defined.
+        void stats(ConnectionStats* stats) const { stats_.snapshot(stats); }
+
+        // Reset the recorded statistics.
+        void clearStats() { stats_.clear(); }
 
         // Called by read() when a read error occurs. Only non-FIFO errors are
         // handled by this method.
@@ -57,16 +143,28 @@ class BufferedConnection : public Connection<FrameType> {
 
         // Called by write() when a frame is discarded due to a write error.
         // Error is ERR_FIFO when the write buffer is full and the frame must
-        // be discarded.
+        // be discarded. For a priority write buffer the discarded frame may be
+        // a lower priority frame evicted to make room for the written one.
         virtual void onWriteError(Error, const FrameType&) const {}
 
     private:
         void fillReadBuffer();
         Error drainWriteBuffer();
 
+        // Add a frame to the write buffer. A full priority buffer evicts its
+        // lowest priority frame if the new frame outranks it. Return false if
+        // the frame was not added.
+        bool queueWrite(const FrameType& frame);
+
+        // Write a frame to the child.
+        Error writeChild(const FrameType& frame);
+
         Connection<FrameType>* child_;
-        Queue<FrameType> read_queue_;
-        Queue<FrameType> write_queue_;
+        QueueType read_queue_;
+        WriteQueueType write_queue_;
+        FrameIDFilter* read_filter_;
+        FrameIDFilter* write_filter_;
+        StatsRecorder stats_;
 };
 
 }  // namespace Canny
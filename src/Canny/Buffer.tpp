@@ -1,41 +1,106 @@
 namespace Canny {
+namespace internal {
 
+// Make room in a full write buffer by evicting a frame that frame outranks.
+// Only priority queues order frames so other queues never evict.
+template <typename QueueType, typename FrameType>
+bool displaceFrame(QueueType*, const FrameType&, FrameType*) {
+    return false;
+}
+
+template <typename FrameType>
+bool displaceFrame(PriorityFrameQueue<FrameType>* queue, const FrameType& frame,
+        FrameType* evicted) {
+    return queue->displace(frame, evicted);
+}
+
+// True for queues that send frames in the order they were added. Residency is
+// charged in that order so it is only timed for these queues.
+template <typename QueueType>
+struct FifoQueue {
+    static const bool value = true;
+};
+
+// Priority queues reorder frames.
 template <typename FrameType>
-BufferedConnection<FrameType>::BufferedConnection(
+struct FifoQueue<PriorityFrameQueue<FrameType>> {
+    static const bool value = false;
+};
+
+// Coalescing queues overwrite the frames that were timed.
+template <typename FrameType>
+struct FifoQueue<CoalescingFrameQueue<FrameType>> {
+    static const bool value = false;
+};
+
+}  // namespace internal
+
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+BufferedConnection<FrameType, QueueType, WriteQueueType>::BufferedConnection(
         Connection<FrameType>* child,
         size_t read_buffer_size,
         size_t write_buffer_size) :
     child_(child),
     read_queue_(read_buffer_size),
-    write_queue_(write_buffer_size) {}
+    write_queue_(write_buffer_size),
+    read_filter_(nullptr),
+    write_filter_(nullptr) {
+    // The size is in bytes for some queues so it only bounds the number of
+    // frames. Residency is not timed for queues that reorder frames.
+    size_t timed = internal::FifoQueue<WriteQueueType>::value ? write_buffer_size : 0;
+    stats_.reserve(timed < StatsResidencyFrames ? timed : StatsResidencyFrames);
+}
 
-template <typename FrameType>
-Error BufferedConnection<FrameType>::read(FrameType* frame) {
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+Error BufferedConnection<FrameType, QueueType, WriteQueueType>::read(FrameType* frame) {
+    uint32_t start = stats_.start();
     if (!read_queue_.empty()) {
-        *frame = *read_queue_.dequeue();
+        *frame = *read_queue_.front();
+        read_queue_.pop();
     } else {
         Error err;
-        do {
+        while (true) {
             err = child_->read(frame);
             if (err != ERR_OK) {
+                stats_.read(err, 0, start);
                 if (err != ERR_FIFO) {
                     onReadError(err);
                 }
                 return ERR_FIFO;
             }
-        } while(!readFilter(*frame));
+            if (readFilter(*frame)) {
+                break;
+            }
+            stats_.filteredIn();
+        }
     }
     fillReadBuffer();
+    stats_.read(ERR_OK, frame->size(), start);
     return ERR_OK;
 }
 
-template <typename FrameType>
-Error BufferedConnection<FrameType>::write(const FrameType& frame) {
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+Error BufferedConnection<FrameType, QueueType, WriteQueueType>::write(const FrameType& frame) {
+    // queue behind a backlog so that a priority queue can reorder the frame
+    if (!write_queue_.empty() && !write_queue_.full()) {
+        if (!writeFilter(frame)) {
+            stats_.filteredOut();
+        } else if (!queueWrite(frame)) {
+            // no room in buffer, discard frame
+            onWriteError(ERR_FIFO, frame);
+            return ERR_FIFO;
+        }
+        drainWriteBuffer();
+        return ERR_OK;
+    }
+
     // write buffered frames
     Error err = drainWriteBuffer();
     if (err != ERR_OK) {
         // drain failed, queue this frame for later if it passes the filter
-        if (writeFilter(frame) && !write_queue_.enqueue(frame)) {
+        if (!writeFilter(frame)) {
+            stats_.filteredOut();
+        } else if (!queueWrite(frame)) {
             // no room in buffer, discard frame
             onWriteError(ERR_FIFO, frame);
             return ERR_FIFO;
@@ -45,14 +110,15 @@ Error BufferedConnection<FrameType>::write(const FrameType& frame) {
 
     // filter written frames
     if (!writeFilter(frame)) {
+        stats_.filteredOut();
         return ERR_OK;
     }
 
     // write this frame
-    err = child_->write(frame);
+    err = writeChild(frame);
     if (err == ERR_FIFO) {
         // write failed, queue this frame for later
-        if (!write_queue_.enqueue(frame)) {
+        if (!queueWrite(frame)) {
             // no room in buffer, discard frame
             onWriteError(ERR_FIFO, frame);
             return ERR_FIFO;
@@ -65,35 +131,190 @@ Error BufferedConnection<FrameType>::write(const FrameType& frame) {
     return ERR_OK;
 }
 
-template <typename FrameType>
-void BufferedConnection<FrameType>::flush() {
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+Error BufferedConnection<FrameType, QueueType, WriteQueueType>::readMany(FrameType* frames, size_t max, size_t* n) {
+    uint32_t start = stats_.start();
+    *n = 0;
+    while (*n < max && !read_queue_.empty()) {
+        frames[(*n)++] = *read_queue_.front();
+        read_queue_.pop();
+    }
+
+    // The buffer is empty so frames read from the child are in order.
+    while (*n < max) {
+        size_t len;
+        Error err = child_->readMany(frames + *n, max - *n, &len);
+        if (err != ERR_OK || len == 0) {
+            if (err != ERR_OK && err != ERR_FIFO) {
+                stats_.read(err, 0);
+                onReadError(err);
+            }
+            break;
+        }
+        // remove filtered frames in place
+        size_t kept = 0;
+        for (size_t i = 0; i < len; ++i) {
+            if (readFilter(frames[*n + i])) {
+                if (kept != i) {
+                    frames[*n + kept] = frames[*n + i];
+                }
+                ++kept;
+            } else {
+                stats_.filteredIn();
+            }
+        }
+        *n += kept;
+    }
+
+    fillReadBuffer();
+    if (*n == 0) {
+        stats_.read(ERR_FIFO, 0, start);
+        return ERR_FIFO;
+    }
+    for (size_t i = 1; i < *n; ++i) {
+        stats_.read(ERR_OK, frames[i].size());
+    }
+    stats_.read(ERR_OK, frames[0].size(), start);
+    return ERR_OK;
+}
+
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+Error BufferedConnection<FrameType, QueueType, WriteQueueType>::writeMany(const FrameType* frames, size_t count, size_t* n) {
+    *n = 0;
+    if (drainWriteBuffer() == ERR_OK) {
+        // write runs of unfiltered frames directly to the child
+        while (*n < count) {
+            size_t run = 0;
+            while (*n + run < count && writeFilter(frames[*n + run])) {
+                ++run;
+            }
+            if (run == 0) {
+                // skip the filtered frame
+                stats_.filteredOut();
+                ++*n;
+                continue;
+            }
+
+            size_t written;
+            Error err = child_->writeMany(frames + *n, run, &written);
+            for (size_t i = 0; i < written; ++i) {
+                stats_.write(ERR_OK, frames[*n + i].size());
+            }
+            *n += written;
+            if (err == ERR_OK) {
+                continue;
+            } else if (*n >= count) {
+                // the child reported an error after writing every frame
+                break;
+            }
+            stats_.write(err, frames[*n].size());
+            if (err == ERR_FIFO) {
+                break;
+            }
+            // treat all non-FIFO the errors the same; log and ignore
+            onWriteError(err, frames[*n]);
+            ++*n;
+        }
+    }
+
+    // buffer the frames the child could not accept
+    for (; *n < count; ++*n) {
+        if (!writeFilter(frames[*n])) {
+            stats_.filteredOut();
+        } else if (!queueWrite(frames[*n])) {
+            // no room in buffer, discard frame
+            onWriteError(ERR_FIFO, frames[*n]);
+            return ERR_FIFO;
+        }
+    }
+    return ERR_OK;
+}
+
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+void BufferedConnection<FrameType, QueueType, WriteQueueType>::flush() {
     drainWriteBuffer();
 } 
 
-template <typename FrameType>
-void BufferedConnection<FrameType>::fillReadBuffer() {
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+Error BufferedConnection<FrameType, QueueType, WriteQueueType>::borrow(FrameType** frame) {
+    if (read_queue_.empty()) {
+        fillReadBuffer();
+    }
+    *frame = read_queue_.front();
+    if (*frame == nullptr) {
+        stats_.read(ERR_FIFO, 0);
+        return ERR_FIFO;
+    }
+    return ERR_OK;
+}
+
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+void BufferedConnection<FrameType, QueueType, WriteQueueType>::release() {
+    FrameType* frame = read_queue_.front();
+    if (frame == nullptr) {
+        return;
+    }
+    stats_.read(ERR_OK, frame->size());
+    read_queue_.pop();
+    fillReadBuffer();
+}
+
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+FrameType* BufferedConnection<FrameType, QueueType, WriteQueueType>::reserve() {
+    if (write_queue_.full()) {
+        drainWriteBuffer();
+    }
+    return write_queue_.back();
+}
+
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+Error BufferedConnection<FrameType, QueueType, WriteQueueType>::commit() {
+    FrameType* frame = write_queue_.back();
+    if (frame == nullptr) {
+        return ERR_FIFO;
+    }
+    if (!writeFilter(*frame)) {
+        stats_.filteredOut();
+        return ERR_OK;
+    }
+    size_t size = write_queue_.size();
+    write_queue_.push();
+    if (write_queue_.size() > size) {
+        stats_.enqueued();
+    }
+    stats_.writeDepth(write_queue_.size());
+    drainWriteBuffer();
+    return ERR_OK;
+}
+
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+void BufferedConnection<FrameType, QueueType, WriteQueueType>::fillReadBuffer() {
     FrameType* frame;
     Error err;
-    while ((frame = read_queue_.alloc()) != nullptr) {
+    while ((frame = read_queue_.back()) != nullptr) {
         err = child_->read(frame);
         if (err == ERR_FIFO) {
             break;
         } else if (err != ERR_OK) {
+            stats_.read(err, 0);
             onReadError(err);
             break;
         }
         if (readFilter(*frame)) {
-            read_queue_.enqueue(*frame);
+            read_queue_.push();
+        } else {
+            stats_.filteredIn();
         }
     }
+    stats_.readDepth(read_queue_.size());
 }
 
-template <typename FrameType>
-Error BufferedConnection<FrameType>::drainWriteBuffer() {
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+Error BufferedConnection<FrameType, QueueType, WriteQueueType>::drainWriteBuffer() {
     FrameType* frame;
     Error err;
-    while ((frame = write_queue_.peek()) != nullptr) {
-        err = child_->write(*frame);
+    while ((frame = write_queue_.front()) != nullptr) {
+        err = writeChild(*frame);
         if (err == ERR_FIFO) {
             // try again later
             return ERR_FIFO;
@@ -101,9 +322,38 @@ Error BufferedConnection<FrameType>::drainWriteBuffer() {
             // unrecoverable error, discard write
             onWriteError(err, *frame);
         }
-        write_queue_.dequeue();
+        write_queue_.pop();
+        stats_.dequeued();
     }
     return ERR_OK;
 }
 
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+bool BufferedConnection<FrameType, QueueType, WriteQueueType>::queueWrite(const FrameType& frame) {
+    size_t size = write_queue_.size();
+    if (!write_queue_.push(frame)) {
+        stats_.overflow();
+        FrameType evicted;
+        if (!internal::displaceFrame(&write_queue_, frame, &evicted)) {
+            return false;
+        }
+        // the evicted frame is discarded in place of this one
+        onWriteError(ERR_FIFO, evicted);
+        return true;
+    }
+    // coalescing queues may replace a pending frame instead of adding one
+    if (write_queue_.size() > size) {
+        stats_.enqueued();
+    }
+    stats_.writeDepth(write_queue_.size());
+    return true;
+}
+
+template <typename FrameType, typename QueueType, typename WriteQueueType>
+Error BufferedConnection<FrameType, QueueType, WriteQueueType>::writeChild(const FrameType& frame) {
+    Error err = child_->write(frame);
+    stats_.write(err, frame.size());
+    return err;
+}
+
 }  // namespace Canny
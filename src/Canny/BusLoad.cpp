@@ -0,0 +1,379 @@
+#include "BusLoad.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+namespace {
+
+// Longest supported window in milliseconds. Slots accumulate nanoseconds and
+// must not overflow when the bus is saturated.
+const uint16_t kMaxWindow = 30000;
+
+// Bits in the classic frame header from SOF through DLC.
+const uint8_t kClassicStandardHeader = 19;
+const uint8_t kClassicExtendedHeader = 39;
+
+// Bits in the FD frame header from SOF through BRS. These are sent at the
+// arbitration rate. ESI and DLC follow at the data rate.
+const uint8_t kFDStandardHeader = 17;
+const uint8_t kFDExtendedHeader = 36;
+const uint8_t kFDControl = 5;
+
+// Bits after the CRC which are never stuffed: CRC delimiter, ACK slot, ACK
+// delimiter, end of frame and the interframe space.
+const uint8_t kTrailer = 13;
+
+// The classic CRC is 15 bits. FD frames send a 4 bit stuff count followed by a
+// 17 or 21 bit CRC with a fixed stuff bit before every fourth bit.
+const uint8_t kClassicCRC = 15;
+const uint8_t kFDShortCRC = 4 + 17 + 6;
+const uint8_t kFDLongCRC = 4 + 21 + 7;
+
+// Bit stuffing state transitions for each run length and 4-bit nibble. The
+// index is (run - 1) * 16 + nibble where run is the number of identical bits
+// already sent (1 to 4) and the last bit sent is 0. Invert the nibble when the
+// last bit was 1. Each entry holds the new run length in bits 0-2, whether the
+// last bit changed in bit 3 and the number of stuff bits inserted in bit 4.
+const uint8_t kStuffTable[64] = {
+    0x19, 0x09, 0x01, 0x0A, 0x02, 0x09, 0x01, 0x0B, 0x03, 0x09, 0x01, 0x0A, 0x02, 0x09, 0x01, 0x0C,
+    0x11, 0x1A, 0x01, 0x0A, 0x02, 0x09, 0x01, 0x0B, 0x03, 0x09, 0x01, 0x0A, 0x02, 0x09, 0x01, 0x0C,
+    0x12, 0x19, 0x11, 0x1B, 0x02, 0x09, 0x01, 0x0B, 0x03, 0x09, 0x01, 0x0A, 0x02, 0x09, 0x01, 0x0C,
+    0x13, 0x19, 0x11, 0x1A, 0x12, 0x19, 0x11, 0x1C, 0x03, 0x09, 0x01, 0x0A, 0x02, 0x09, 0x01, 0x0C,
+};
+
+// CRC-15 (polynomial 0x4599) remainders for each 4-bit value.
+const uint16_t kCRCTable[16] = {
+    0x0000, 0x4599, 0x4EAB, 0x0B32, 0x58CF, 0x1D56, 0x1664, 0x53FD,
+    0x7407, 0x319E, 0x3AAC, 0x7F35, 0x2CC8, 0x6951, 0x6263, 0x27FA,
+};
+
+// Counts the stuff bits and computes the CRC-15 of a bit stream. Bits are
+// processed a nibble at a time.
+class BitStream {
+    public:
+        // The stream starts on an idle (recessive) bus.
+        BitStream() : acc_(0), bits_(0), last_(1), run_(1), stuff_(0), crc_(0) {}
+
+        // Append the low bits of value, most significant bit first. No more
+        // than 28 bits may be pushed at once.
+        void push(uint32_t value, uint8_t bits, bool crc = true) {
+            acc_ = (acc_ << bits) | (value & ((1UL << bits) - 1));
+            bits_ += bits;
+            while (bits_ >= 4) {
+                bits_ -= 4;
+                nibble((acc_ >> bits_) & 0x0F, crc);
+            }
+        }
+
+        // Process any bits not yet consumed by push().
+        void flush(bool crc = true) {
+            while (bits_ > 0) {
+                --bits_;
+                bit((acc_ >> bits_) & 0x01, crc);
+            }
+        }
+
+        // Return the number of stuff bits inserted.
+        uint16_t stuff() const { return stuff_; }
+
+        // Return the CRC of the bits pushed.
+        uint16_t crc() const { return crc_; }
+
+    private:
+        void nibble(uint8_t value, bool crc) {
+            if (crc) {
+                crc_ = ((crc_ << 4) & 0x7FFF) ^ kCRCTable[((crc_ >> 11) ^ value) & 0x0F];
+            }
+            uint8_t entry = kStuffTable[(run_ - 1) * 16 + (last_ ? value ^ 0x0F : value)];
+            run_ = entry & 0x07;
+            last_ ^= (entry >> 3) & 0x01;
+            stuff_ += entry >> 4;
+        }
+
+        void bit(uint8_t value, bool crc) {
+            if (crc) {
+                bool next = value ^ ((crc_ >> 14) & 0x01);
+                crc_ = (crc_ << 1) & 0x7FFF;
+                if (next) {
+                    crc_ ^= 0x4599;
+                }
+            }
+            if (value != last_) {
+                last_ = value;
+                run_ = 1;
+            } else if (++run_ == 5) {
+                ++stuff_;
+                last_ ^= 1;
+                run_ = 1;
+            }
+        }
+
+        uint32_t acc_;
+        uint8_t bits_;
+        uint8_t last_;
+        uint8_t run_;
+        uint16_t stuff_;
+        uint16_t crc_;
+};
+
+// Return the bit times of a bitrate in nanoseconds.
+void bitTimes(Bitrate bitrate, uint16_t* arbitration, uint16_t* data) {
+    switch (bitrate) {
+        case CAN20_125K:
+        case CANFD_125K:
+            *arbitration = 8000;
+            *data = 8000;
+            break;
+        case CAN20_250K:
+        case CANFD_250K:
+            *arbitration = 4000;
+            *data = 4000;
+            break;
+        case CAN20_500K:
+        case CANFD_500K:
+            *arbitration = 2000;
+            *data = 2000;
+            break;
+        case CAN20_1000K:
+        case CANFD_1000K:
+            *arbitration = 1000;
+            *data = 1000;
+            break;
+        case CANFD_125K_500K:
+            *arbitration = 8000;
+            *data = 2000;
+            break;
+        case CANFD_250K_500K:
+            *arbitration = 4000;
+            *data = 2000;
+            break;
+        case CANFD_250K_750K:
+            *arbitration = 4000;
+            *data = 1333;
+            break;
+        case CANFD_250K_1M:
+            *arbitration = 4000;
+            *data = 1000;
+            break;
+        case CANFD_250K_1M5:
+            *arbitration = 4000;
+            *data = 667;
+            break;
+        case CANFD_250K_2M:
+            *arbitration = 4000;
+            *data = 500;
+            break;
+        case CANFD_250K_3M:
+            *arbitration = 4000;
+            *data = 333;
+            break;
+        case CANFD_250K_4M:
+            *arbitration = 4000;
+            *data = 250;
+            break;
+        case CANFD_500K_1M:
+            *arbitration = 2000;
+            *data = 1000;
+            break;
+        case CANFD_500K_2M:
+            *arbitration = 2000;
+            *data = 500;
+            break;
+        case CANFD_500K_3M:
+            *arbitration = 2000;
+            *data = 333;
+            break;
+        case CANFD_500K_4M:
+            *arbitration = 2000;
+            *data = 250;
+            break;
+        case CANFD_500K_5M:
+            *arbitration = 2000;
+            *data = 200;
+            break;
+        case CANFD_500K_6M5:
+            *arbitration = 2000;
+            *data = 154;
+            break;
+        case CANFD_500K_8M:
+            *arbitration = 2000;
+            *data = 125;
+            break;
+        case CANFD_500K_10M:
+            *arbitration = 2000;
+            *data = 100;
+            break;
+        case CANFD_1000K_4M:
+            *arbitration = 1000;
+            *data = 250;
+            break;
+        case CANFD_1000K_8M:
+            *arbitration = 1000;
+            *data = 125;
+            break;
+    }
+}
+
+// Return the DLC of a payload size. FD sizes are rounded up to the next valid
+// length.
+uint8_t dlc(uint8_t size) {
+    if (size <= 8) {
+        return size;
+    } else if (size <= 24) {
+        return 9 + (size - 9) / 4;
+    } else if (size <= 32) {
+        return 13;
+    } else if (size <= 48) {
+        return 14;
+    }
+    return 15;
+}
+
+// Return the payload length of a DLC.
+uint8_t dlcLength(uint8_t dlc) {
+    static const uint8_t lengths[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+    return lengths[dlc & 0x0F];
+}
+
+// Push the payload of a frame. Bytes past the end of data are sent as zero.
+void pushData(BitStream* stream, const uint8_t* data, uint8_t size, uint8_t length) {
+    for (uint8_t i = 0; i < length; ++i) {
+        stream->push(i < size ? data[i] : 0, 8);
+    }
+}
+
+}  // namespace
+
+BusLoad::BusLoad(Bitrate bitrate, Mode mode, Stuffing stuffing, uint16_t window) :
+    mode_(mode), stuffing_(stuffing), arbitration_bit_(0), data_bit_(0),
+    slot_(0), slot_start_(0), head_(0), filled_(1) {
+    bitTimes(bitrate, &arbitration_bit_, &data_bit_);
+    if (mode_ == CAN20 || mode_ == CANFD_CONST_RATE) {
+        data_bit_ = arbitration_bit_;
+    }
+    if (window > kMaxWindow) {
+        window = kMaxWindow;
+    }
+    slot_ = window < kSlots ? 1 : window / kSlots;
+    slot_start_ = millis();
+    memset(slots_, 0, sizeof(slots_));
+}
+
+uint32_t BusLoad::frameTime(uint32_t id, uint8_t ext, const uint8_t* data, uint8_t size) const {
+    uint32_t arbitration_bits;
+    uint32_t data_bits;
+    uint16_t arbitration_stuff;
+    uint16_t data_stuff;
+
+    if (mode_ == CAN20) {
+        uint8_t length = size > 8 ? 8 : size;
+        uint8_t header = ext ? kClassicExtendedHeader : kClassicStandardHeader;
+        arbitration_bits = header + length * 8 + kClassicCRC + kTrailer;
+        data_bits = 0;
+        data_stuff = 0;
+        if (stuffing_ == Stuffing::EXACT) {
+            BitStream stream;
+            stream.push(0, 1);
+            if (ext) {
+                stream.push((id >> 18) & 0x7FF, 11);
+                stream.push(0x03, 2);
+                stream.push(id & 0x3FFFF, 18);
+                stream.push(0, 3);
+            } else {
+                stream.push(id & 0x7FF, 11);
+                stream.push(0, 3);
+            }
+            stream.push(length, 4);
+            pushData(&stream, data, size, length);
+            stream.flush();
+            stream.push(stream.crc(), kClassicCRC, false);
+            stream.flush(false);
+            arbitration_stuff = stream.stuff();
+        } else {
+            arbitration_stuff = (header + length * 8 + kClassicCRC - 1) / 4;
+        }
+    } else {
+        uint8_t code = dlc(size);
+        uint8_t length = dlcLength(code);
+        uint8_t header = ext ? kFDExtendedHeader : kFDStandardHeader;
+        uint8_t brs = mode_ == CANFD_DUAL_RATE ? 1 : 0;
+        arbitration_bits = header + kTrailer;
+        data_bits = kFDControl + length * 8 + (length > 16 ? kFDLongCRC : kFDShortCRC);
+        if (stuffing_ == Stuffing::EXACT) {
+            BitStream stream;
+            stream.push(0, 1);
+            if (ext) {
+                stream.push((id >> 18) & 0x7FF, 11);
+                stream.push(0x03, 2);
+                stream.push(id & 0x3FFFF, 18);
+                stream.push(0x04 | brs, 4);
+            } else {
+                stream.push(id & 0x7FF, 11);
+                stream.push(0x04 | brs, 5);
+            }
+            stream.flush();
+            arbitration_stuff = stream.stuff();
+            stream.push(code, kFDControl);
+            pushData(&stream, data, size, length);
+            stream.flush();
+            data_stuff = stream.stuff() - arbitration_stuff;
+        } else {
+            arbitration_stuff = (header - 1) / 4;
+            data_stuff = (header + kFDControl + length * 8 - 1) / 4 - arbitration_stuff;
+        }
+    }
+
+    return (arbitration_bits + arbitration_stuff) * arbitration_bit_ +
+        (data_bits + data_stuff) * data_bit_;
+}
+
+void BusLoad::recordTime(uint32_t time) {
+    advance(millis());
+    slots_[head_] += time;
+}
+
+uint8_t BusLoad::load() {
+    return loadPermille() / 10;
+}
+
+uint16_t BusLoad::loadPermille() {
+    uint32_t now = millis();
+    advance(now);
+
+    uint64_t busy = 0;
+    for (uint8_t i = 0; i < kSlots; ++i) {
+        busy += slots_[i];
+    }
+    uint32_t span = (uint32_t)(filled_ - 1) * slot_ + (now - slot_start_);
+    if (span == 0) {
+        return busy > 0 ? 1000 : 0;
+    }
+    uint64_t permille = busy / ((uint64_t)span * 1000);
+    return permille > 1000 ? 1000 : permille;
+}
+
+void BusLoad::clear() {
+    memset(slots_, 0, sizeof(slots_));
+    head_ = 0;
+    filled_ = 1;
+    slot_start_ = millis();
+}
+
+void BusLoad::advance(uint32_t now) {
+    uint32_t elapsed = now - slot_start_;
+    if (elapsed < slot_) {
+        return;
+    }
+    uint32_t steps = elapsed / slot_;
+    if (steps > kSlots) {
+        steps = kSlots;
+    }
+    for (uint32_t i = 0; i < steps; ++i) {
+        head_ = (head_ + 1) % kSlots;
+        slots_[head_] = 0;
+    }
+    filled_ = filled_ + steps > kSlots ? kSlots : filled_ + steps;
+    slot_start_ = now - elapsed % slot_;
+}
+
+}  // namespace Canny
@@ -0,0 +1,126 @@
+#ifndef _CANNY_BUS_LOAD_H_
+#define _CANNY_BUS_LOAD_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Controller.h"
+#include "Error.h"
+
+namespace Canny {
+
+// How bit stuffing is counted when computing the wire time of a frame.
+enum class Stuffing : uint8_t {
+    WORST_CASE, // Assume the maximum number of stuff bits for the frame size.
+    EXACT,      // Count the stuff bits of the actual ID and data.
+};
+
+// Estimates the load on a CAN bus. The wire time of each frame is computed
+// from the bus bitrate and mode and accumulated into a sliding window. The
+// window is split into eight slots which expire in turn so the load reflects
+// the most recent window of traffic.
+//
+// Frames are assumed to be data frames sent by an error active node. In CAN
+// 2.0 mode frames use the classic format. In CAN FD modes frames use the FD
+// format and, in CANFD_DUAL_RATE mode, switch to the data bitrate. Bit times
+// are rounded to the nearest nanosecond.
+class BusLoad {
+    public:
+        // Construct an estimator for a bus running at the given bitrate and
+        // mode. Load is averaged over window milliseconds. Windows longer than
+        // 30 seconds are shortened to 30 seconds.
+        BusLoad(Bitrate bitrate, Mode mode, Stuffing stuffing = Stuffing::WORST_CASE,
+                uint16_t window = 1000);
+
+        // Return the time in nanoseconds to transmit a frame, including the
+        // interframe space.
+        uint32_t frameTime(uint32_t id, uint8_t ext, const uint8_t* data, uint8_t size) const;
+
+        // Return the time in nanoseconds to transmit a frame, including the
+        // interframe space.
+        template <typename FrameType>
+        uint32_t frameTime(const FrameType& frame) const {
+            return frameTime(frame.id(), frame.ext(), frame.data(), frame.size());
+        }
+
+        // Record time nanoseconds of bus activity.
+        void recordTime(uint32_t time);
+
+        // Record a frame seen on the bus.
+        template <typename FrameType>
+        void record(const FrameType& frame) { recordTime(frameTime(frame)); }
+
+        // Return the bus load over the window as a percentage from 0 to 100.
+        uint8_t load();
+
+        // Return the bus load over the window in tenths of a percent from 0 to
+        // 1000.
+        uint16_t loadPermille();
+
+        // Return the length of the window in milliseconds.
+        uint16_t window() const { return slot_ * kSlots; }
+
+        // Clear recorded activity.
+        void clear();
+
+    private:
+        static const uint8_t kSlots = 8;
+
+        // Expire slots that have fallen out of the window.
+        void advance(uint32_t now);
+
+        Mode mode_;
+        Stuffing stuffing_;
+        uint16_t arbitration_bit_;
+        uint16_t data_bit_;
+        uint16_t slot_;
+        uint32_t slot_start_;
+        uint32_t slots_[kSlots];
+        uint8_t head_;
+        uint8_t filled_;
+};
+
+// A connection that estimates the load on the bus from the frames read from
+// and written to its child. Only frames which pass through the connection are
+// counted so hardware filters and other nodes' unaccepted frames reduce the
+// estimate.
+template <typename FrameType>
+class BusLoadConnection : public Connection<FrameType> {
+    public:
+        // Construct a connection that estimates the load on the bus that child
+        // is attached to.
+        BusLoadConnection(Connection<FrameType>* child, Bitrate bitrate, Mode mode,
+                Stuffing stuffing = Stuffing::WORST_CASE, uint16_t window = 1000) :
+            child_(child), load_(bitrate, mode, stuffing, window) {}
+
+        // Read a frame from the child and record it.
+        Error read(FrameType* frame) override {
+            Error err = child_->read(frame);
+            if (err == ERR_OK) {
+                load_.record(*frame);
+            }
+            return err;
+        }
+
+        // Write a frame to the child and record it.
+        Error write(const FrameType& frame) override {
+            Error err = child_->write(frame);
+            if (err == ERR_OK) {
+                load_.record(frame);
+            }
+            return err;
+        }
+
+        // Return the bus load over the window as a percentage.
+        uint8_t load() { return load_.load(); }
+
+        // Return the bus load estimator.
+        BusLoad* estimator() { return &load_; }
+
+    private:
+        Connection<FrameType>* child_;
+        BusLoad load_;
+};
+
+}  // namespace Canny
+
+#endif  // _CANNY_BUS_LOAD_H_
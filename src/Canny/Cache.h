@@ -0,0 +1,117 @@
+#ifndef _CANNY_CACHE_H_
+#define _CANNY_CACHE_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Error.h"
+#include "FrameIndex.h"
+
+namespace Canny {
+
+// The latest frame received for an ID.
+template <typename FrameType>
+struct FrameCacheEntry {
+    // The most recent frame received with this ID.
+    FrameType frame;
+    // The value of micros() when the frame was received.
+    uint32_t timestamp;
+    // The number of frames received with this ID. Wraps on overflow.
+    uint32_t updates;
+    // True if the entry is in the changed list.
+    bool changed;
+};
+
+// Caches the most recent frame for each ID read from a child connection.
+// Frames are read through the cache, or drained into it with poll(), and may
+// then be looked up by ID in constant time. Consumers can sample the latest
+// values at their own rate rather than processing every frame.
+//
+// Entries track when they were last updated and are stale once they are older
+// than the cache timeout. Entries updated since they were last returned by
+// nextChanged() can be iterated without scanning the whole cache.
+//
+// The cache holds a fixed number of IDs. Frames with new IDs are not cached
+// once it is full but are still returned by read().
+template <typename FrameType>
+class FrameCache : public Connection<FrameType> {
+    public:
+        typedef FrameCacheEntry<FrameType> Entry;
+
+        // Construct a cache of up to capacity IDs that reads from child.
+        // Entries older than timeout microseconds are stale. A timeout of 0
+        // disables staleness.
+        FrameCache(Connection<FrameType>* child, size_t capacity, uint32_t timeout = 0);
+        ~FrameCache();
+
+        // Read a frame from the child and cache it. Return the result of the
+        // child read.
+        Error read(FrameType* frame) override;
+
+        // Write a frame to the child.
+        Error write(const FrameType& frame) override;
+
+        // Read all available frames from the child into the cache. Return the
+        // number of frames read.
+        size_t poll();
+
+        // Return the entry for an ID or nullptr if no frame with that ID has
+        // been received.
+        const Entry* find(uint32_t id, uint8_t ext) const;
+
+        // Return the latest frame received with an ID or nullptr if no frame
+        // has been received.
+        const FrameType* latest(uint32_t id, uint8_t ext) const;
+
+        // Return the number of microseconds since an entry was updated.
+        uint32_t age(const Entry& entry) const { return micros() - entry.timestamp; }
+
+        // Return true if an entry is older than the timeout.
+        bool stale(const Entry& entry) const { return timeout_ > 0 && age(entry) > timeout_; }
+
+        // Return true if no frame has been received with an ID within the
+        // timeout.
+        bool stale(uint32_t id, uint8_t ext) const;
+
+        // Return the next entry updated since it was last returned by this
+        // method or nullptr if no more entries have changed. Entries are
+        // returned in the order they first changed.
+        const Entry* nextChanged();
+
+        // Set the staleness timeout in microseconds. 0 disables staleness.
+        void timeout(uint32_t timeout) { timeout_ = timeout; }
+
+        // Return the staleness timeout in microseconds.
+        uint32_t timeout() const { return timeout_; }
+
+        // Return the number of IDs in the cache.
+        size_t size() const { return len_; }
+
+        // Return the maximum number of IDs the cache can hold.
+        size_t capacity() const { return capacity_; }
+
+        // Remove all entries from the cache.
+        void clear();
+
+    private:
+        // Store a frame in the cache.
+        void update(const FrameType& frame);
+
+        Connection<FrameType>* child_;
+        uint32_t timeout_;
+
+        Entry* entries_;
+        size_t capacity_;
+        size_t len_;
+
+        FrameIndex index_;  // Map of IDs to entries.
+
+        size_t* changed_;   // Ring of changed entries.
+        size_t changed_head_;
+        size_t changed_len_;
+};
+
+}  // namespace Canny
+
+#include "Cache.tpp"
+
+#endif  // _CANNY_CACHE_H_
@@ -0,0 +1,115 @@
+namespace Canny {
+
+template <typename FrameType>
+FrameCache<FrameType>::FrameCache(Connection<FrameType>* child, size_t capacity, uint32_t timeout) :
+        child_(child), timeout_(timeout), entries_(nullptr), capacity_(capacity), len_(0),
+        index_(capacity), changed_(nullptr), changed_head_(0), changed_len_(0) {
+    if (capacity_ > 0) {
+        entries_ = new Entry[capacity_];
+        changed_ = new size_t[capacity_];
+    }
+    clear();
+}
+
+template <typename FrameType>
+FrameCache<FrameType>::~FrameCache() {
+    if (entries_ != nullptr) {
+        delete[] entries_;
+    }
+    if (changed_ != nullptr) {
+        delete[] changed_;
+    }
+}
+
+template <typename FrameType>
+Error FrameCache<FrameType>::read(FrameType* frame) {
+    Error err = child_->read(frame);
+    if (err == ERR_OK) {
+        update(*frame);
+    }
+    return err;
+}
+
+template <typename FrameType>
+Error FrameCache<FrameType>::write(const FrameType& frame) {
+    return child_->write(frame);
+}
+
+template <typename FrameType>
+size_t FrameCache<FrameType>::poll() {
+    FrameType frame;
+    size_t count = 0;
+    while (read(&frame) == ERR_OK) {
+        ++count;
+    }
+    return count;
+}
+
+template <typename FrameType>
+const FrameCacheEntry<FrameType>* FrameCache<FrameType>::find(uint32_t id, uint8_t ext) const {
+    size_t slot = index_.get(frameKey(id, ext));
+    return slot == FrameIndex::Empty ? nullptr : entries_ + slot;
+}
+
+template <typename FrameType>
+const FrameType* FrameCache<FrameType>::latest(uint32_t id, uint8_t ext) const {
+    const Entry* entry = find(id, ext);
+    return entry == nullptr ? nullptr : &entry->frame;
+}
+
+template <typename FrameType>
+bool FrameCache<FrameType>::stale(uint32_t id, uint8_t ext) const {
+    const Entry* entry = find(id, ext);
+    return entry == nullptr || stale(*entry);
+}
+
+template <typename FrameType>
+const FrameCacheEntry<FrameType>* FrameCache<FrameType>::nextChanged() {
+    if (changed_len_ == 0) {
+        return nullptr;
+    }
+    Entry* entry = entries_ + changed_[changed_head_];
+    if (++changed_head_ >= capacity_) {
+        changed_head_ = 0;
+    }
+    --changed_len_;
+    entry->changed = false;
+    return entry;
+}
+
+template <typename FrameType>
+void FrameCache<FrameType>::clear() {
+    index_.clear();
+    len_ = 0;
+    changed_head_ = 0;
+    changed_len_ = 0;
+}
+
+template <typename FrameType>
+void FrameCache<FrameType>::update(const FrameType& frame) {
+    uint32_t key = frameKey(frame.id(), frame.ext());
+    size_t slot = index_.get(key);
+    Entry* entry;
+    if (slot != FrameIndex::Empty) {
+        entry = entries_ + slot;
+    } else if (len_ < capacity_) {
+        index_.put(key, len_);
+        entry = entries_ + len_++;
+        entry->updates = 0;
+        entry->changed = false;
+    } else {
+        return;
+    }
+
+    entry->frame = frame;
+    entry->timestamp = micros();
+    ++entry->updates;
+    if (!entry->changed) {
+        entry->changed = true;
+        size_t tail = changed_head_ + changed_len_;
+        changed_[tail >= capacity_ ? tail - capacity_ : tail] = entry - entries_;
+        ++changed_len_;
+    }
+}
+
+}  // namespace Canny
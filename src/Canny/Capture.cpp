@@ -0,0 +1,190 @@
+#include "Capture.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+namespace {
+
+const uint8_t kMagic[4] = {'C', 'N', 'Y', 0x01};
+
+const char kHex[] = "0123456789ABCDEF";
+
+// Write a varint to buffer. Return the number of bytes written.
+size_t putVarint(uint8_t* buffer, uint32_t value) {
+    size_t n = 0;
+    while (value >= 0x80) {
+        buffer[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buffer[n++] = value;
+    return n;
+}
+
+// Write value as digits hex digits to buffer.
+void putHex(char* buffer, uint32_t value, uint8_t digits) {
+    for (uint8_t i = digits; i > 0; --i) {
+        buffer[i - 1] = kHex[value & 0x0F];
+        value >>= 4;
+    }
+}
+
+// Write value in decimal to buffer, padded with zeros to at least width
+// digits. Return the number of characters written.
+size_t putDecimal(char* buffer, uint64_t value, uint8_t width) {
+    char digits[20];
+    uint8_t n = 0;
+    do {
+        digits[n++] = '0' + value % 10;
+        value /= 10;
+    } while (value > 0);
+    while (n < width) {
+        digits[n++] = '0';
+    }
+    for (uint8_t i = 0; i < n; ++i) {
+        buffer[i] = digits[n - 1 - i];
+    }
+    return n;
+}
+
+}  // namespace
+
+size_t captureHeader(uint8_t* buffer) {
+    memcpy(buffer, kMagic, sizeof(kMagic));
+    return sizeof(kMagic);
+}
+
+size_t captureEncode(uint8_t* buffer, uint32_t delta, uint32_t id, uint8_t ext,
+        uint8_t direction, const uint8_t* data, uint8_t size) {
+    if (size > CaptureMaxData) {
+        size = CaptureMaxData;
+    }
+    size_t n = putVarint(buffer, delta);
+    n += putVarint(buffer + n, ((id & 0x1FFFFFFF) << 2) | ((ext == 1) << 1) | (direction & 0x01));
+    buffer[n++] = size;
+    memcpy(buffer + n, data, size);
+    return n + size;
+}
+
+CaptureDecoder::CaptureDecoder() : state_(HEADER), pos_(0), shift_(0), value_(0), error_(false) {
+    memset(&record_, 0, sizeof(record_));
+}
+
+bool CaptureDecoder::varint(uint8_t b) {
+    if (shift_ > 28) {
+        error_ = true;
+        return false;
+    }
+    value_ |= (uint32_t)(b & 0x7F) << shift_;
+    shift_ += 7;
+    return (b & 0x80) == 0;
+}
+
+const CaptureRecord* CaptureDecoder::next(Stream* stream) {
+    while (!error_ && stream->available() > 0) {
+        int c = stream->read();
+        if (c < 0) {
+            break;
+        }
+        uint8_t b = c;
+
+        switch (state_) {
+            case HEADER:
+                if (b != kMagic[pos_]) {
+                    error_ = true;
+                } else if (++pos_ == sizeof(kMagic)) {
+                    state_ = TIME;
+                }
+                break;
+            case TIME:
+                if (varint(b)) {
+                    record_.time += value_;
+                    value_ = 0;
+                    shift_ = 0;
+                    state_ = KEY;
+                }
+                break;
+            case KEY:
+                if (varint(b)) {
+                    record_.id = value_ >> 2;
+                    record_.ext = (value_ >> 1) & 0x01;
+                    record_.direction = value_ & 0x01;
+                    value_ = 0;
+                    shift_ = 0;
+                    state_ = SIZE;
+                }
+                break;
+            case SIZE:
+                if (b > CaptureMaxData) {
+                    error_ = true;
+                    break;
+                }
+                record_.size = b;
+                pos_ = 0;
+                if (b == 0) {
+                    state_ = TIME;
+                    return &record_;
+                }
+                state_ = DATA;
+                break;
+            case DATA:
+                record_.data[pos_++] = b;
+                if (pos_ == record_.size) {
+                    state_ = TIME;
+                    return &record_;
+                }
+                break;
+        }
+    }
+    return nullptr;
+}
+
+size_t printCandump(Print* out, const CaptureRecord& record, const char* interface) {
+    // The longest line is a 64 byte FD frame: 22 characters of time, the
+    // interface, a 12 character ID and flags, 128 characters of data and a
+    // newline.
+    char line[24 + 16 + 12 + 2 * CaptureMaxData + 1];
+    size_t n = 0;
+
+    line[n++] = '(';
+    n += putDecimal(line + n, record.time / 1000000, 1);
+    line[n++] = '.';
+    n += putDecimal(line + n, record.time % 1000000, 6);
+    line[n++] = ')';
+    line[n++] = ' ';
+    for (size_t i = 0; interface[i] != 0 && i < 15; ++i) {
+        line[n++] = interface[i];
+    }
+    line[n++] = ' ';
+
+    if (record.ext) {
+        putHex(line + n, record.id, 8);
+        n += 8;
+    } else {
+        putHex(line + n, record.id, 3);
+        n += 3;
+    }
+    line[n++] = '#';
+    if (record.size > 8) {
+        line[n++] = '#';
+        line[n++] = '0';
+    }
+    for (uint8_t i = 0; i < record.size; ++i) {
+        putHex(line + n, record.data[i], 2);
+        n += 2;
+    }
+    line[n++] = '\n';
+    return out->write((const uint8_t*)line, n);
+}
+
+size_t captureToCandump(Stream* in, Print* out, const char* interface) {
+    CaptureDecoder decoder;
+    const CaptureRecord* record;
+    size_t n = 0;
+    while ((record = decoder.next(in)) != nullptr) {
+        printCandump(out, *record, interface);
+        ++n;
+    }
+    return n;
+}
+
+}  // namespace Canny
@@ -0,0 +1,176 @@
+#ifndef _CANNY_CAPTURE_H_
+#define _CANNY_CAPTURE_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Error.h"
+#include "Frame.h"
+
+// A compact binary format for recording CAN traffic. A capture starts with
+// the four byte header "CNY" 0x01 followed by one record per frame:
+//
+//   varint  microseconds since the previous record (0 for the first)
+//   varint  (id << 2) | (ext << 1) | direction
+//   uint8   payload size
+//   bytes   payload
+//
+// Varints are unsigned LEB128: seven bits per byte, least significant group
+// first, with the high bit set on every byte but the last. A standard frame
+// with 8 bytes of data recorded a few milliseconds after the last takes 13
+// bytes.
+
+namespace Canny {
+
+// Directions of a recorded frame.
+const uint8_t CaptureRead = 0;     // The frame was read from the connection.
+const uint8_t CaptureWrite = 1;    // The frame was written to the connection.
+
+// The largest payload that may be recorded.
+const uint8_t CaptureMaxData = 64;
+
+// The largest encoded size of a record in bytes.
+const uint8_t CaptureMaxRecord = 5 + 5 + 1 + CaptureMaxData;
+
+// A decoded capture record.
+struct CaptureRecord {
+    uint64_t time;      // Microseconds since the first record.
+    uint32_t id;
+    uint8_t ext;
+    uint8_t direction;
+    uint8_t size;
+    uint8_t data[CaptureMaxData];
+};
+
+// Write the capture header to buffer. Return the number of bytes written.
+size_t captureHeader(uint8_t* buffer);
+
+// Encode a record into buffer which must hold at least CaptureMaxRecord
+// bytes. The payload is truncated to CaptureMaxData bytes. Return the number
+// of bytes written.
+size_t captureEncode(uint8_t* buffer, uint32_t delta, uint32_t id, uint8_t ext,
+        uint8_t direction, const uint8_t* data, uint8_t size);
+
+// Decodes a capture from a stream. Records may arrive a byte at a time; bytes
+// are consumed as they become available and a record is returned once it is
+// complete.
+class CaptureDecoder {
+    public:
+        CaptureDecoder();
+
+        // Read available bytes from the stream. Return the next complete
+        // record or nullptr if more bytes are needed. The record is valid
+        // until the next call.
+        const CaptureRecord* next(Stream* stream);
+
+        // Return true if the stream is not a valid capture. No more records
+        // are returned once this is true.
+        bool error() const { return error_; }
+
+    private:
+        enum State : uint8_t {
+            HEADER,
+            TIME,
+            KEY,
+            SIZE,
+            DATA,
+        };
+
+        // Accumulate a varint byte. Return true when the varint is complete.
+        bool varint(uint8_t b);
+
+        CaptureRecord record_;
+        State state_;
+        uint8_t pos_;
+        uint8_t shift_;
+        uint32_t value_;
+        bool error_;
+};
+
+// Write a record as a line of candump log text:
+//
+//   (seconds.micros) interface ID#DATA
+//
+// Payloads longer than 8 bytes use the CAN FD form ID##0DATA. Return the
+// number of bytes written.
+size_t printCandump(Print* out, const CaptureRecord& record, const char* interface = "can0");
+
+// Convert the available bytes of a binary capture to candump log text. Return
+// the number of records converted.
+size_t captureToCandump(Stream* in, Print* out, const char* interface = "can0");
+
+// A connection that records every frame read from or written to its child.
+// Records are written to the output in the capture format with a single
+// write() per frame. Timestamped frames are recorded with their own
+// timestamp. Other frames are recorded with micros() at the time of the read
+// or write.
+template <typename FrameType>
+class CaptureWriter : public Connection<FrameType> {
+    public:
+        // Construct a writer that records the frames passing through child to
+        // out. The capture header is written with the first record.
+        CaptureWriter(Connection<FrameType>* child, Print* out);
+
+        // Read a frame from the child and record it.
+        Error read(FrameType* frame) override;
+
+        // Write a frame to the child and record it if the write succeeds.
+        Error write(const FrameType& frame) override;
+
+        // Return the number of frames recorded.
+        uint32_t frames() const { return frames_; }
+
+        // Return the number of records that could not be written in full.
+        // The capture is corrupt from the first short write.
+        uint32_t overflows() const { return overflows_; }
+
+    private:
+        void record(const FrameType& frame, uint8_t direction);
+
+        Connection<FrameType>* child_;
+        Print* out_;
+        bool started_;
+        uint32_t last_;
+        uint32_t frames_;
+        uint32_t overflows_;
+};
+
+// A connection that replays a capture. Frames are returned by read() at the
+// same relative times they were recorded, or as fast as they are read if
+// realtime is false. Timestamped frames receive their recorded time. Frames
+// written to the replayer are discarded.
+template <typename FrameType>
+class Replayer : public Connection<FrameType> {
+    public:
+        // Construct a replayer that reads a capture from in.
+        Replayer(Stream* in, bool realtime = true);
+
+        // Read the next frame in the capture.
+        //
+        // Return ERR_OK if a frame was read, ERR_FIFO if the next frame is
+        // not yet due or not fully available, or ERR_INVALID if the capture
+        // is corrupt.
+        Error read(FrameType* frame) override;
+
+        // Discard a frame. Always returns ERR_OK.
+        Error write(const FrameType&) override { return ERR_OK; }
+
+        // Return the direction in which the last frame read was recorded.
+        uint8_t direction() const { return direction_; }
+
+    private:
+        Stream* in_;
+        CaptureDecoder decoder_;
+        const CaptureRecord* pending_;
+        bool realtime_;
+        bool started_;
+        uint64_t base_;
+        uint64_t elapsed_;
+        uint32_t last_;
+        uint8_t direction_;
+};
+
+}  // namespace Canny
+
+#include "Capture.tpp"
+
+#endif  // _CANNY_CAPTURE_H_
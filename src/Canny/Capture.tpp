@@ -0,0 +1,84 @@
+namespace Canny {
+
+template <typename FrameType>
+CaptureWriter<FrameType>::CaptureWriter(Connection<FrameType>* child, Print* out) :
+    child_(child), out_(out), started_(false), last_(0), frames_(0), overflows_(0) {}
+
+template <typename FrameType>
+Error CaptureWriter<FrameType>::read(FrameType* frame) {
+    Error err = child_->read(frame);
+    if (err == ERR_OK) {
+        record(*frame, CaptureRead);
+    }
+    return err;
+}
+
+template <typename FrameType>
+Error CaptureWriter<FrameType>::write(const FrameType& frame) {
+    Error err = child_->write(frame);
+    if (err == ERR_OK) {
+        record(frame, CaptureWrite);
+    }
+    return err;
+}
+
+template <typename FrameType>
+void CaptureWriter<FrameType>::record(const FrameType& frame, uint8_t direction) {
+    uint32_t now = FrameTraits<FrameType>::timestamped ? frameTimestamp(frame) : micros();
+    uint8_t buffer[4 + CaptureMaxRecord];
+    size_t len = 0;
+    if (!started_) {
+        len = captureHeader(buffer);
+        last_ = now;
+        started_ = true;
+    }
+    len += captureEncode(buffer + len, now - last_, frame.id(), frame.ext(), direction,
+            frame.data(), frame.size());
+    last_ = now;
+
+    if (out_->write(buffer, len) != len) {
+        ++overflows_;
+    }
+    ++frames_;
+}
+
+template <typename FrameType>
+Replayer<FrameType>::Replayer(Stream* in, bool realtime) :
+    in_(in), pending_(nullptr), realtime_(realtime), started_(false), base_(0),
+    elapsed_(0), last_(0), direction_(CaptureRead) {}
+
+template <typename FrameType>
+Error Replayer<FrameType>::read(FrameType* frame) {
+    if (pending_ == nullptr) {
+        pending_ = decoder_.next(in_);
+        if (pending_ == nullptr) {
+            return decoder_.error() ? ERR_INVALID : ERR_FIFO;
+        }
+    }
+
+    if (realtime_) {
+        if (!started_) {
+            base_ = pending_->time;
+            last_ = micros();
+            started_ = true;
+        } else {
+            // Accumulate elapsed time in 64 bits so replay continues past
+            // the 32-bit rollover of micros().
+            uint32_t now = micros();
+            elapsed_ += now - last_;
+            last_ = now;
+            if (elapsed_ < pending_->time - base_) {
+                return ERR_FIFO;
+            }
+        }
+    }
+
+    frame->id(pending_->id, pending_->ext);
+    frame->data(pending_->data, pending_->size);
+    stampFrame(frame, pending_->time);
+    direction_ = pending_->direction;
+    pending_ = nullptr;
+    return ERR_OK;
+}
+
+}  // namespace Canny
@@ -0,0 +1,15 @@
+#ifndef _CANNY_CHECKSUM_H_
+#define _CANNY_CHECKSUM_H_
+
+#include <Arduino.h>
+
+namespace Canny {
+
+// Update a CRC-32 (IEEE 802.3, as used by zlib and RealDash) with len bytes of
+// data and return the result. Pass 0 as crc to start a new checksum. Data may
+// be split across calls by passing the previous result as crc.
+uint32_t crc32(uint32_t crc, const uint8_t* data, size_t len);
+
+}  // namespace Canny
+
+#endif  // _CANNY_CHECKSUM_H_
@@ -0,0 +1,72 @@
+#ifndef _CANNY_COALESCING_FRAME_QUEUE_H_
+#define _CANNY_COALESCING_FRAME_QUEUE_H_
+
+#include <Arduino.h>
+#include "FrameIndex.h"
+
+namespace Canny {
+
+// A queue that holds at most one pending frame per ID. Pushing a frame whose
+// ID and ext flag match a pending frame overwrites that frame in place rather
+// than adding another. Pending IDs are drained round-robin in the order they
+// first became pending so an ID that is written often cannot starve the
+// others.
+//
+// This suits periodic status frames written to a link slower than the rate
+// they are produced: memory is bounded by the number of distinct IDs and
+// stale data is never sent ahead of fresh data. It has the same slot
+// interface as FrameQueue so it can be used as the write buffer of a
+// BufferedConnection.
+template <typename FrameType>
+class CoalescingFrameQueue {
+    public:
+        // Construct a queue that holds up to capacity distinct IDs.
+        CoalescingFrameQueue(size_t capacity);
+        ~CoalescingFrameQueue();
+
+        // Return true if the queue has no frames.
+        bool empty() const { return len_ == 0; }
+
+        // Return true if no new IDs may be added. Frames whose IDs are
+        // pending can still be pushed.
+        bool full() const { return len_ >= capacity_; }
+
+        // Return the number of pending frames.
+        size_t size() const { return len_; }
+
+        // Return the maximum number of distinct IDs the queue can hold.
+        size_t capacity() const { return capacity_; }
+
+        // Return a free slot or nullptr if the queue is full.
+        FrameType* back();
+
+        // Add the slot returned by back() to the queue. If its ID is pending
+        // then the pending frame is replaced instead.
+        void push();
+
+        // Copy a frame into the queue, replacing the pending frame with the
+        // same ID. Return false if the ID is not pending and the queue is
+        // full.
+        bool push(const FrameType& frame);
+
+        // Return the next frame to send or nullptr if the queue is empty.
+        FrameType* front();
+
+        // Remove the frame returned by front().
+        void pop();
+
+    private:
+        FrameType* frames_;
+        size_t* order_;     // Ring of pending slots in send order.
+        size_t* free_;      // Stack of free slots.
+        FrameIndex index_;  // Map of pending IDs to slots.
+        size_t capacity_;
+        size_t head_;
+        size_t len_;
+};
+
+}  // namespace Canny
+
+#include "CoalescingFrameQueue.tpp"
+
+#endif  // _CANNY_COALESCING_FRAME_QUEUE_H_
@@ -0,0 +1,94 @@
+namespace Canny {
+
+template <typename FrameType>
+CoalescingFrameQueue<FrameType>::CoalescingFrameQueue(size_t capacity) :
+        frames_(nullptr), order_(nullptr), free_(nullptr), index_(capacity),
+        capacity_(capacity), head_(0), len_(0) {
+    if (capacity_ > 0) {
+        frames_ = new FrameType[capacity_];
+        order_ = new size_t[capacity_];
+        free_ = new size_t[capacity_];
+        for (size_t i = 0; i < capacity_; ++i) {
+            free_[i] = capacity_ - i - 1;
+        }
+    }
+}
+
+template <typename FrameType>
+CoalescingFrameQueue<FrameType>::~CoalescingFrameQueue() {
+    if (frames_ != nullptr) {
+        delete[] frames_;
+    }
+    if (order_ != nullptr) {
+        delete[] order_;
+    }
+    if (free_ != nullptr) {
+        delete[] free_;
+    }
+}
+
+template <typename FrameType>
+FrameType* CoalescingFrameQueue<FrameType>::back() {
+    if (full()) {
+        return nullptr;
+    }
+    return frames_ + free_[capacity_ - len_ - 1];
+}
+
+template <typename FrameType>
+void CoalescingFrameQueue<FrameType>::push() {
+    if (full()) {
+        return;
+    }
+    size_t slot = free_[capacity_ - len_ - 1];
+    uint32_t key = frameKey(frames_[slot].id(), frames_[slot].ext());
+    size_t pending = index_.get(key);
+    if (pending != FrameIndex::Empty) {
+        frames_[pending] = frames_[slot];
+        return;
+    }
+    index_.put(key, slot);
+    size_t tail = head_ + len_;
+    order_[tail >= capacity_ ? tail - capacity_ : tail] = slot;
+    ++len_;
+}
+
+template <typename FrameType>
+bool CoalescingFrameQueue<FrameType>::push(const FrameType& frame) {
+    size_t pending = index_.get(frameKey(frame.id(), frame.ext()));
+    if (pending != FrameIndex::Empty) {
+        frames_[pending] = frame;
+        return true;
+    }
+    FrameType* slot = back();
+    if (slot == nullptr) {
+        return false;
+    }
+    *slot = frame;
+    push();
+    return true;
+}
+
+template <typename FrameType>
+FrameType* CoalescingFrameQueue<FrameType>::front() {
+    if (empty()) {
+        return nullptr;
+    }
+    return frames_ + order_[head_];
+}
+
+template <typename FrameType>
+void CoalescingFrameQueue<FrameType>::pop() {
+    if (empty()) {
+        return;
+    }
+    size_t slot = order_[head_];
+    index_.remove(frameKey(frames_[slot].id(), frames_[slot].ext()));
+    if (++head_ >= capacity_) {
+        head_ = 0;
+    }
+    --len_;
+    free_[capacity_ - len_ - 1] = slot;
+}
+
+}  // namespace Canny
@@ -0,0 +1,86 @@
+#ifndef _CANNY_COMPACT_FRAME_QUEUE_H_
+#define _CANNY_COMPACT_FRAME_QUEUE_H_
+
+#include <Arduino.h>
+#include "Frame.h"
+
+namespace Canny {
+
+// A FIFO queue of frames packed into a fixed size ring of bytes. Each frame is
+// stored as a 5 byte header holding its ID, ext flag, and size followed by
+// only size() bytes of data. Timestamped frames add their 4 byte timestamp to
+// the header. This holds many more small CAN FD frames than a
+// FrameQueue of the same memory.
+//
+// The queue has the same slot interface as FrameQueue so that it can back a
+// BufferedConnection. The slot returned by back() is a staging frame that is
+// packed into the ring by push(). The slot returned by front() is unpacked
+// from the ring on first access. Unlike FrameQueue this costs a copy of the
+// frame's data in each direction.
+//
+// Capacity is measured in bytes rather than frames.
+template <typename FrameType>
+class CompactFrameQueue {
+    public:
+        // The number of bytes of overhead for each frame in the queue.
+        static const size_t HeaderSize = FrameTraits<FrameType>::timestamped ? 9 : 5;
+
+        // Construct a queue backed by the given number of bytes.
+        CompactFrameQueue(size_t capacity);
+        ~CompactFrameQueue();
+
+        // Return true if the queue has no frames.
+        bool empty() const { return len_ == 0; }
+
+        // Return true if a frame of the maximum size may not fit in the queue.
+        bool full() const { return capacity_ - used_ < HeaderSize + back_.capacity(); }
+
+        // Return the number of frames in the queue.
+        size_t size() const { return len_; }
+
+        // Return the size of the queue in bytes.
+        size_t capacity() const { return capacity_; }
+
+        // Return the number of bytes used by frames in the queue.
+        size_t used() const { return used_; }
+
+        // Return a staging frame to fill or nullptr if the queue is full.
+        FrameType* back();
+
+        // Pack the frame returned by back() into the queue.
+        void push();
+
+        // Pack a frame into the queue. Return false if there is not enough
+        // room for the frame.
+        bool push(const FrameType& frame);
+
+        // Return the frame at the front of the queue or nullptr if the queue
+        // is empty.
+        FrameType* front();
+
+        // Remove the frame at the front of the queue.
+        void pop();
+
+    private:
+        // Copy bytes into the ring at the given offset from the head.
+        void write(size_t offset, const uint8_t* data, size_t len);
+
+        // Copy bytes out of the ring at the given offset from the head.
+        void read(size_t offset, uint8_t* data, size_t len) const;
+
+        uint8_t* buffer_;
+        size_t capacity_;
+        size_t head_;
+        size_t used_;
+        size_t len_;
+
+        FrameType back_;
+        FrameType front_;
+        bool front_valid_;
+};
+
+}  // namespace Canny
+
+#include "CompactFrameQueue.tpp"
+
+#endif  // _CANNY_COMPACT_FRAME_QUEUE_H_
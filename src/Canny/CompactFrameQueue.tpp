@@ -0,0 +1,129 @@
+namespace Canny {
+
+template <typename FrameType>
+CompactFrameQueue<FrameType>::CompactFrameQueue(size_t capacity) :
+        buffer_(nullptr), capacity_(capacity), head_(0), used_(0), len_(0),
+        front_valid_(false) {
+    if (capacity_ > 0) {
+        buffer_ = new uint8_t[capacity_];
+    }
+}
+
+template <typename FrameType>
+CompactFrameQueue<FrameType>::~CompactFrameQueue() {
+    if (buffer_ != nullptr) {
+        delete[] buffer_;
+    }
+}
+
+template <typename FrameType>
+FrameType* CompactFrameQueue<FrameType>::back() {
+    if (full()) {
+        return nullptr;
+    }
+    return &back_;
+}
+
+template <typename FrameType>
+void CompactFrameQueue<FrameType>::push() {
+    push(back_);
+}
+
+template <typename FrameType>
+bool CompactFrameQueue<FrameType>::push(const FrameType& frame) {
+    uint8_t size = frame.size() > frame.capacity() ? frame.capacity() : frame.size();
+    if (capacity_ - used_ < HeaderSize + size) {
+        return false;
+    }
+
+    // The ext flag is stored in the unused top bit of the ID.
+    uint32_t id = (frame.id() & 0x7FFFFFFF) | ((uint32_t)(frame.ext() == 1) << 31);
+    uint8_t header[5] = {
+        (uint8_t)id,
+        (uint8_t)(id >> 8),
+        (uint8_t)(id >> 16),
+        (uint8_t)(id >> 24),
+        size,
+    };
+    write(used_, header, 5);
+    if (FrameTraits<FrameType>::timestamped) {
+        uint32_t timestamp = frameTimestamp(frame);
+        uint8_t stamp[4] = {
+            (uint8_t)timestamp,
+            (uint8_t)(timestamp >> 8),
+            (uint8_t)(timestamp >> 16),
+            (uint8_t)(timestamp >> 24),
+        };
+        write(used_ + 5, stamp, 4);
+    }
+    write(used_ + HeaderSize, frame.data(), size);
+    used_ += HeaderSize + size;
+    ++len_;
+    return true;
+}
+
+template <typename FrameType>
+FrameType* CompactFrameQueue<FrameType>::front() {
+    if (empty()) {
+        return nullptr;
+    }
+    if (!front_valid_) {
+        uint8_t header[5];
+        read(0, header, 5);
+        uint32_t id = header[0] | ((uint32_t)header[1] << 8) |
+            ((uint32_t)header[2] << 16) | ((uint32_t)header[3] << 24);
+        front_.id(id & 0x7FFFFFFF);
+        front_.ext(id >> 31);
+        if (FrameTraits<FrameType>::timestamped) {
+            uint8_t stamp[4];
+            read(5, stamp, 4);
+            stampFrame(&front_, stamp[0] | ((uint32_t)stamp[1] << 8) |
+                    ((uint32_t)stamp[2] << 16) | ((uint32_t)stamp[3] << 24));
+        }
+        front_.resize(header[4]);
+        read(HeaderSize, front_.data(), header[4]);
+        front_valid_ = true;
+    }
+    return &front_;
+}
+
+template <typename FrameType>
+void CompactFrameQueue<FrameType>::pop() {
+    if (empty()) {
+        return;
+    }
+    uint8_t size;
+    read(4, &size, 1);
+    size_t len = HeaderSize + size;
+    head_ += len;
+    if (head_ >= capacity_) {
+        head_ -= capacity_;
+    }
+    used_ -= len;
+    --len_;
+    front_valid_ = false;
+}
+
+template <typename FrameType>
+void CompactFrameQueue<FrameType>::write(size_t offset, const uint8_t* data, size_t len) {
+    size_t pos = head_ + offset;
+    if (pos >= capacity_) {
+        pos -= capacity_;
+    }
+    size_t first = capacity_ - pos < len ? capacity_ - pos : len;
+    memcpy(buffer_ + pos, data, first);
+    memcpy(buffer_, data + first, len - first);
+}
+
+template <typename FrameType>
+void CompactFrameQueue<FrameType>::read(size_t offset, uint8_t* data, size_t len) const {
+    size_t pos = head_ + offset;
+    if (pos >= capacity_) {
+        pos -= capacity_;
+    }
+    size_t first = capacity_ - pos < len ? capacity_ - pos : len;
+    memcpy(data, buffer_ + pos, first);
+    memcpy(data + first, buffer_, len - first);
+}
+
+}  // namespace Canny
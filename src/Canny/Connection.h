@@ -40,8 +40,45 @@ class Connection {
         // controllers are limited to 64 bytes. See the Error definition for
         // the meaning of other error codes.
         virtual Error write(const FrameType& frame) = 0;
+
+        // Read up to max frames into frames without blocking. The number of
+        // frames read is stored in n. The default implementation calls read()
+        // until it fails or max frames have been read. Connections that can
+        // move frames in bursts override this to avoid per-frame overhead.
+        //
+        // Return ERR_OK if at least one frame was read. Otherwise return the
+        // error of the first read.
+        virtual Error readMany(FrameType* frames, size_t max, size_t* n);
+
+        // Write count frames in order without blocking. The number of frames
+        // written is stored in n. Writing stops at the first frame that
+        // fails. The default implementation calls write() for each frame.
+        //
+        // Return ERR_OK if all frames were written. Otherwise return the error
+        // of the failed write. The failed frame is frames[*n].
+        virtual Error writeMany(const FrameType* frames, size_t count, size_t* n);
 };
 
+template <typename FrameType>
+Error Connection<FrameType>::readMany(FrameType* frames, size_t max, size_t* n) {
+    Error err = ERR_FIFO;
+    *n = 0;
+    while (*n < max && (err = read(frames + *n)) == ERR_OK) {
+        ++*n;
+    }
+    return *n > 0 ? ERR_OK : err;
+}
+
+template <typename FrameType>
+Error Connection<FrameType>::writeMany(const FrameType* frames, size_t count, size_t* n) {
+    Error err = ERR_OK;
+    *n = 0;
+    while (*n < count && (err = write(frames[*n])) == ERR_OK) {
+        ++*n;
+    }
+    return err;
+}
+
 }  // namespace Canny
 
 #endif  // _CANNY_CONNECTION_H_
@@ -3,11 +3,44 @@
 #include <Arduino.h>
 
 namespace Canny {
+namespace {
+
+// IDs below this value are stored in the bitmap.
+const uint32_t kBitmapIDs = 0x800;
+
+// Convert a J1939 PGN, source address, and priority into a mask rule.
+void j1939Rule(uint32_t pgn, uint8_t sa, uint8_t priority, uint32_t* value, uint32_t* mask) {
+    bool pdu1 = ((pgn >> 8) & 0xFF) < 240;
+    *mask = pdu1 ? 0x03FF0000 : 0x03FFFF00;
+    *value = (pgn << 8) & *mask;
+    if (sa != AnySourceAddress) {
+        *mask |= 0xFF;
+        *value |= sa;
+    }
+    if (priority != AnyPriority) {
+        *mask |= 0x1C000000;
+        *value |= (uint32_t)(priority & 0x07) << 26;
+    }
+}
+
+}  // namespace
 
 FrameIDFilter::~FrameIDFilter() {
+    if (bitmap_ != nullptr) {
+        delete[] bitmap_;
+    }
     if (items_ != nullptr) {
         delete[] items_;
     }
+    if (masks_ != nullptr) {
+        delete[] masks_;
+    }
+    if (ranges_ != nullptr) {
+        delete[] ranges_;
+    }
+    if (merged_ != nullptr) {
+        delete[] merged_;
+    }
 }
 
 void FrameIDFilter::mode(FilterMode mode) {
@@ -31,46 +64,281 @@ void FrameIDFilter::drop(uint32_t frame_id) {
     }
 }
 
+void FrameIDFilter::allowMask(uint32_t value, uint32_t mask) {
+    if (mode_ == FilterMode::ALLOW) {
+        removeMask(value, mask);
+    } else {
+        addMask(value, mask);
+    }
+}
+
+void FrameIDFilter::dropMask(uint32_t value, uint32_t mask) {
+    if (mode_ == FilterMode::ALLOW) {
+        addMask(value, mask);
+    } else {
+        removeMask(value, mask);
+    }
+}
+
+void FrameIDFilter::allowRange(uint32_t low, uint32_t high) {
+    if (mode_ == FilterMode::ALLOW) {
+        removeRange(low, high);
+    } else {
+        addRange(low, high);
+    }
+}
+
+void FrameIDFilter::dropRange(uint32_t low, uint32_t high) {
+    if (mode_ == FilterMode::ALLOW) {
+        addRange(low, high);
+    } else {
+        removeRange(low, high);
+    }
+}
+
+void FrameIDFilter::allowJ1939(uint32_t pgn, uint8_t sa, uint8_t priority) {
+    uint32_t value, mask;
+    j1939Rule(pgn, sa, priority, &value, &mask);
+    allowMask(value, mask);
+}
+
+void FrameIDFilter::dropJ1939(uint32_t pgn, uint8_t sa, uint8_t priority) {
+    uint32_t value, mask;
+    j1939Rule(pgn, sa, priority, &value, &mask);
+    dropMask(value, mask);
+}
+
 void FrameIDFilter::add(uint32_t frame_id) {
-    reserve();
-    items_[len_++] = frame_id;
+    if (frame_id < kBitmapIDs) {
+        if (bitmap_ == nullptr) {
+            bitmap_ = new uint8_t[kBitmapIDs / 8];
+            memset(bitmap_, 0, kBitmapIDs / 8);
+        }
+        bitmap_[frame_id >> 3] |= (1 << (frame_id & 0x07));
+        return;
+    }
+
+    size_t i = search(frame_id);
+    if (i < len_ && items_[i] == frame_id) {
+        return;
+    }
+    reserve(&items_, &size_, len_);
+    memmove(items_ + i + 1, items_ + i, (len_ - i) * sizeof(uint32_t));
+    items_[i] = frame_id;
+    ++len_;
 }
 
 void FrameIDFilter::remove(uint32_t frame_id) {
-    for (size_t i = 0; i < len_; i++) {
-        while (items_[i] == frame_id) {
-            memcpy(items_ + i, items_ + i + 1, (len_ - i - 1) * sizeof(uint32_t));
-            --len_;
+    if (frame_id < kBitmapIDs) {
+        if (bitmap_ != nullptr) {
+            bitmap_[frame_id >> 3] &= ~(1 << (frame_id & 0x07));
+        }
+        return;
+    }
+
+    size_t i = search(frame_id);
+    if (i < len_ && items_[i] == frame_id) {
+        memmove(items_ + i, items_ + i + 1, (len_ - i - 1) * sizeof(uint32_t));
+        --len_;
+    }
+}
+
+void FrameIDFilter::addMask(uint32_t value, uint32_t mask) {
+    value &= mask;
+    for (size_t i = 0; i < masks_len_; ++i) {
+        if (masks_[i].value == value && masks_[i].mask == mask) {
+            return;
+        }
+    }
+    reserve(&masks_, &masks_size_, masks_len_);
+    masks_[masks_len_].value = value;
+    masks_[masks_len_].mask = mask;
+    ++masks_len_;
+    compiled_ = false;
+}
+
+void FrameIDFilter::removeMask(uint32_t value, uint32_t mask) {
+    value &= mask;
+    for (size_t i = 0; i < masks_len_; ++i) {
+        if (masks_[i].value == value && masks_[i].mask == mask) {
+            masks_[i] = masks_[--masks_len_];
+            compiled_ = false;
+            return;
+        }
+    }
+}
+
+void FrameIDFilter::addRange(uint32_t low, uint32_t high) {
+    if (low > high) {
+        return;
+    }
+    for (size_t i = 0; i < ranges_len_; ++i) {
+        if (ranges_[i].low == low && ranges_[i].high == high) {
+            return;
+        }
+    }
+    reserve(&ranges_, &ranges_size_, ranges_len_);
+    ranges_[ranges_len_].low = low;
+    ranges_[ranges_len_].high = high;
+    ++ranges_len_;
+    compiled_ = false;
+}
+
+void FrameIDFilter::removeRange(uint32_t low, uint32_t high) {
+    for (size_t i = 0; i < ranges_len_; ++i) {
+        if (ranges_[i].low == low && ranges_[i].high == high) {
+            ranges_[i] = ranges_[--ranges_len_];
+            compiled_ = false;
+            return;
         }
     }
 }
 
 void FrameIDFilter::clear() {
+    if (bitmap_ != nullptr) {
+        memset(bitmap_, 0, kBitmapIDs / 8);
+    }
     len_ = 0;
+    masks_len_ = 0;
+    ranges_len_ = 0;
+    compiled_ = false;
+}
+
+void FrameIDFilter::compile() {
+    // Merge ranges into a sorted list of disjoint ranges.
+    if (merged_size_ < ranges_len_) {
+        if (merged_ != nullptr) {
+            delete[] merged_;
+        }
+        merged_ = new RangeRule[ranges_len_];
+        merged_size_ = ranges_len_;
+    }
+    merged_len_ = 0;
+    for (size_t i = 0; i < ranges_len_; ++i) {
+        // insertion sort by low
+        size_t j = merged_len_++;
+        while (j > 0 && merged_[j-1].low > ranges_[i].low) {
+            merged_[j] = merged_[j-1];
+            --j;
+        }
+        merged_[j] = ranges_[i];
+    }
+    if (merged_len_ > 0) {
+        size_t n = 0;
+        for (size_t i = 1; i < merged_len_; ++i) {
+            if (merged_[n].high == 0xFFFFFFFF || merged_[i].low <= merged_[n].high + 1) {
+                if (merged_[i].high > merged_[n].high) {
+                    merged_[n].high = merged_[i].high;
+                }
+            } else {
+                merged_[++n] = merged_[i];
+            }
+        }
+        merged_len_ = n + 1;
+    }
+
+    // Find the bits that all mask rules test for the same value. An ID that
+    // differs in any of those bits cannot match a mask rule.
+    common_mask_ = 0;
+    common_value_ = 0;
+    if (masks_len_ > 0) {
+        common_mask_ = masks_[0].mask;
+        common_value_ = masks_[0].value;
+        for (size_t i = 1; i < masks_len_; ++i) {
+            common_mask_ &= masks_[i].mask & ~(masks_[i].value ^ common_value_);
+        }
+        common_value_ &= common_mask_;
+
+        // Test the most specific masks first.
+        for (size_t i = 1; i < masks_len_; ++i) {
+            MaskRule rule = masks_[i];
+            uint8_t bits = __builtin_popcountl(rule.mask);
+            size_t j = i;
+            while (j > 0 && __builtin_popcountl(masks_[j-1].mask) < bits) {
+                masks_[j] = masks_[j-1];
+                --j;
+            }
+            masks_[j] = rule;
+        }
+    }
+    compiled_ = true;
 }
 
 bool FrameIDFilter::match(uint32_t frame_id) {
-    for (size_t i = 0; i < len_; i++) {
-        if (items_[i] == frame_id) {
-            return mode_ != FilterMode::ALLOW;
+    bool found;
+    if (frame_id < kBitmapIDs) {
+        found = bitmap_ != nullptr && (bitmap_[frame_id >> 3] & (1 << (frame_id & 0x07)));
+    } else {
+        size_t i = search(frame_id);
+        found = i < len_ && items_[i] == frame_id;
+    }
+    if (!found && (masks_len_ > 0 || ranges_len_ > 0)) {
+        found = matchRules(frame_id);
+    }
+    return found != (mode_ == FilterMode::ALLOW);
+}
+
+bool FrameIDFilter::matchRules(uint32_t frame_id) {
+    if (!compiled_) {
+        compile();
+    }
+
+    if (merged_len_ > 0 && frame_id >= merged_[0].low &&
+            frame_id <= merged_[merged_len_-1].high) {
+        // find the last range with low <= frame_id
+        size_t low = 0;
+        size_t high = merged_len_;
+        while (high - low > 1) {
+            size_t mid = low + (high - low) / 2;
+            if (merged_[mid].low <= frame_id) {
+                low = mid;
+            } else {
+                high = mid;
+            }
+        }
+        if (frame_id <= merged_[low].high) {
+            return true;
+        }
+    }
+
+    if (masks_len_ > 0 && (frame_id & common_mask_) == common_value_) {
+        for (size_t i = 0; i < masks_len_; ++i) {
+            if ((frame_id & masks_[i].mask) == masks_[i].value) {
+                return true;
+            }
         }
     }
-    return mode_ == FilterMode::ALLOW;
+    return false;
 }
 
-void FrameIDFilter::reserve() {
-    if (len_ + 1 <= size_) {
+size_t FrameIDFilter::search(uint32_t frame_id) const {
+    size_t low = 0;
+    size_t high = len_;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (items_[mid] < frame_id) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+template <typename T>
+void FrameIDFilter::reserve(T** items, size_t* size, size_t len) {
+    if (len + 1 <= *size) {
         return;
     }
 
-    size_t new_size = size_ == 0 ? 1 : size_ * 2;
-    uint32_t* new_items = new uint32_t[new_size];
-    if (items_ != nullptr) {
-        memcpy(new_items, items_, len_ * sizeof(uint32_t));
-        delete[] items_;
+    size_t new_size = *size == 0 ? 1 : *size * 2;
+    T* new_items = new T[new_size];
+    if (*items != nullptr) {
+        memcpy(new_items, *items, len * sizeof(T));
+        delete[] *items;
     }
-    items_ = new_items;
-    size_ = new_size;
+    *items = new_items;
+    *size = new_size;
 }
 
 }  // namespace Canny
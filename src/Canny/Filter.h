@@ -11,11 +11,36 @@ enum class FilterMode : uint8_t {
     DROP,   // All frames are dropped by default.
 };
 
-// A configurable filter that filters frames by ID.
+// Passed to the J1939 filter rules to match any source address.
+const uint8_t AnySourceAddress = 0xFF;
+
+// Passed to the J1939 filter rules to match any priority.
+const uint8_t AnyPriority = 0xFF;
+
+// A configurable filter that filters frames by ID. Standard 11-bit IDs are
+// stored in a 2048-bit bitmap which is allocated when the first standard ID is
+// added. All other IDs are stored in a sorted array. Matching is O(1) for
+// standard IDs and O(log n) for extended IDs.
+//
+// Rules that cover many IDs may be added alongside exact IDs. Mask rules match
+// IDs where (id & mask) == (value & mask). Range rules match IDs between low
+// and high inclusive. J1939 rules match the PGN, source address, and priority
+// fields of a J1939 ID and are stored as mask rules. Like exact IDs, rules
+// are exceptions to the filter mode: allowing in DROP mode adds a rule and
+// allowing in ALLOW mode removes an identical rule.
+//
+// Rules are compiled into an evaluation order on the first match() after they
+// change. Ranges are merged and searched with a binary search. Mask rules are
+// guarded by the bits common to all of them so that most IDs are rejected
+// with a single comparison.
 class FrameIDFilter {
     public:
         FrameIDFilter(FilterMode mode = FilterMode::ALLOW) :
-            mode_(mode), items_(nullptr), size_(0), len_(0) {}
+            mode_(mode), bitmap_(nullptr), items_(nullptr), size_(0), len_(0),
+            masks_(nullptr), masks_size_(0), masks_len_(0),
+            ranges_(nullptr), ranges_size_(0), ranges_len_(0),
+            merged_(nullptr), merged_size_(0), merged_len_(0),
+            common_mask_(0), common_value_(0), compiled_(true) {}
         ~FrameIDFilter();
 
         // Clear the filter and Set the filter mode.
@@ -33,9 +58,35 @@ class FrameIDFilter {
         template <typename FrameType>
         void drop(const FrameType& frame) { drop(frame.id()); }
 
+        // Allow frames whose ID matches value under mask.
+        void allowMask(uint32_t value, uint32_t mask);
+
+        // Drop frames whose ID matches value under mask.
+        void dropMask(uint32_t value, uint32_t mask);
+
+        // Allow frames with IDs between low and high inclusive.
+        void allowRange(uint32_t low, uint32_t high);
+
+        // Drop frames with IDs between low and high inclusive.
+        void dropRange(uint32_t low, uint32_t high);
+
+        // Allow J1939 messages with the given PGN. The destination address of
+        // PDU1 PGNs is ignored. The source address and priority are matched
+        // unless set to AnySourceAddress and AnyPriority.
+        void allowJ1939(uint32_t pgn, uint8_t sa = AnySourceAddress, uint8_t priority = AnyPriority);
+
+        // Drop J1939 messages with the given PGN, source address, and
+        // priority.
+        void dropJ1939(uint32_t pgn, uint8_t sa = AnySourceAddress, uint8_t priority = AnyPriority);
+
         // Clear the filter.
         void clear();
 
+        // Compile rules into their evaluation order. This is called by
+        // match() when rules have changed and may be called ahead of time to
+        // avoid the cost on the first match.
+        void compile();
+
         // Return true if a frame is allowed through the filter.
         bool match(uint32_t frame_id);
         bool match(const int frame_id) { return match((uint32_t)frame_id); };
@@ -43,19 +94,64 @@ class FrameIDFilter {
         bool match(const FrameType& frame) { return match(frame.id()); }
 
     private:
+        friend class AcceptancePlanner;
+
+        struct MaskRule {
+            uint32_t value;
+            uint32_t mask;
+        };
+
+        struct RangeRule {
+            uint32_t low;
+            uint32_t high;
+        };
+
         // Add a frame ID to filter items.
         void add(uint32_t frame_id);
 
         // Remove a frame ID from filter items.
         void remove(uint32_t frame_id);
 
-        // Reserve capacity for n+1 items. Doubles the capacity when necessary.
-        void reserve();
+        // Add or remove a mask rule.
+        void addMask(uint32_t value, uint32_t mask);
+        void removeMask(uint32_t value, uint32_t mask);
+
+        // Add or remove a range rule.
+        void addRange(uint32_t low, uint32_t high);
+        void removeRange(uint32_t low, uint32_t high);
+
+        // Return true if a frame ID matches any rule.
+        bool matchRules(uint32_t frame_id);
+
+        // Reserve capacity for len+1 items. Doubles the capacity when
+        // necessary.
+        template <typename T>
+        static void reserve(T** items, size_t* size, size_t len);
+
+        // Return the index of the first item not less than frame_id.
+        size_t search(uint32_t frame_id) const;
 
         FilterMode mode_;
+        uint8_t* bitmap_;
         uint32_t* items_;
         size_t size_;
         size_t len_;
+
+        MaskRule* masks_;
+        size_t masks_size_;
+        size_t masks_len_;
+
+        RangeRule* ranges_;
+        size_t ranges_size_;
+        size_t ranges_len_;
+
+        // Compiled rule state.
+        RangeRule* merged_;
+        size_t merged_size_;
+        size_t merged_len_;
+        uint32_t common_mask_;
+        uint32_t common_value_;
+        bool compiled_;
 };
 
 }  // namespace Canny
@@ -157,6 +157,82 @@ class CANFDFrame : public Frame<64, 0x00> {
         CANFDFrame(uint32_t id, uint8_t ext, const uint8_t (&data)[N]);
 };
 
+// A frame with a receive timestamp. Controllers set the timestamp to the time
+// in microseconds at which the frame was received, as early in the read as
+// they are able. The timestamp is copied with the frame but is ignored when
+// frames are compared. Frame types without a timestamp are unchanged and pay
+// nothing for it.
+template <typename FrameType>
+class TimestampedFrame : public FrameType {
+    public:
+        // Construct an empty frame with a timestamp of 0.
+        TimestampedFrame() : FrameType(), timestamp_(0) {}
+
+        // Construct a frame with the provided values and size.
+        TimestampedFrame(uint32_t id, uint8_t ext, uint8_t size) :
+            FrameType(id, ext, size), timestamp_(0) {}
+
+        // Construct a frame with the provided values and data.
+        template <size_t N>
+        TimestampedFrame(uint32_t id, uint8_t ext, const uint8_t (&data)[N]) :
+            FrameType(id, ext, data), timestamp_(0) {}
+
+        // Construct a frame from an untimestamped frame.
+        TimestampedFrame(const FrameType& frame, uint32_t timestamp = 0) :
+            FrameType(frame), timestamp_(timestamp) {}
+
+        // Return the time in microseconds at which the frame was received.
+        uint32_t timestamp() const { return timestamp_; }
+
+        // Set the time at which the frame was received.
+        void timestamp(uint32_t timestamp) { timestamp_ = timestamp; }
+
+    private:
+        uint32_t timestamp_;
+};
+
+// Describes the optional features of a frame type.
+template <typename FrameType>
+struct FrameTraits {
+    // True if the frame type carries a timestamp.
+    static const bool timestamped = false;
+};
+
+template <typename FrameType>
+struct FrameTraits<TimestampedFrame<FrameType>> {
+    static const bool timestamped = true;
+};
+
+// Set the timestamp of a frame to the current time. Does nothing if the frame
+// type does not carry a timestamp.
+template <typename FrameType>
+inline void stampFrame(FrameType*) {}
+
+template <typename FrameType>
+inline void stampFrame(TimestampedFrame<FrameType>* frame) {
+    frame->timestamp(micros());
+}
+
+// Set the timestamp of a frame. Does nothing if the frame type does not carry
+// a timestamp.
+template <typename FrameType>
+inline void stampFrame(FrameType*, uint32_t) {}
+
+template <typename FrameType>
+inline void stampFrame(TimestampedFrame<FrameType>* frame, uint32_t timestamp) {
+    frame->timestamp(timestamp);
+}
+
+// Return the timestamp of a frame or 0 if the frame type does not carry a
+// timestamp.
+template <typename FrameType>
+inline uint32_t frameTimestamp(const FrameType&) { return 0; }
+
+template <typename FrameType>
+inline uint32_t frameTimestamp(const TimestampedFrame<FrameType>& frame) {
+    return frame.timestamp();
+}
+
 // Return true if the values of two frames are equal. The id, ext, size, and
 // data are compared directly. Only data[:size] is compared. The capacities of
 // the two frames are ignored.
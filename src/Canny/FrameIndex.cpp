@@ -0,0 +1,73 @@
+#include "FrameIndex.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+
+FrameIndex::FrameIndex(size_t capacity) : items_(nullptr), size_(2), bits_(1) {
+    while (size_ < capacity * 2) {
+        size_ <<= 1;
+        ++bits_;
+    }
+    items_ = new Item[size_];
+    clear();
+}
+
+FrameIndex::~FrameIndex() {
+    if (items_ != nullptr) {
+        delete[] items_;
+    }
+}
+
+size_t FrameIndex::get(uint32_t key) const {
+    return items_[find(key)].slot;
+}
+
+void FrameIndex::put(uint32_t key, size_t slot) {
+    size_t pos = find(key);
+    items_[pos].key = key;
+    items_[pos].slot = slot;
+}
+
+void FrameIndex::remove(uint32_t key) {
+    size_t pos = find(key);
+    if (items_[pos].slot == Empty) {
+        return;
+    }
+
+    // Shift later items of the probe sequence back so that lookups do not
+    // stop at the hole.
+    size_t mask = size_ - 1;
+    size_t next = (pos + 1) & mask;
+    while (items_[next].slot != Empty) {
+        size_t h = home(items_[next].key);
+        bool movable = pos <= next ? (h <= pos || h > next) : (h <= pos && h > next);
+        if (movable) {
+            items_[pos] = items_[next];
+            pos = next;
+        }
+        next = (next + 1) & mask;
+    }
+    items_[pos].slot = Empty;
+}
+
+void FrameIndex::clear() {
+    for (size_t i = 0; i < size_; ++i) {
+        items_[i].slot = Empty;
+    }
+}
+
+size_t FrameIndex::home(uint32_t key) const {
+    return (uint32_t)(key * 2654435761UL) >> (32 - bits_);
+}
+
+size_t FrameIndex::find(uint32_t key) const {
+    size_t mask = size_ - 1;
+    size_t pos = home(key);
+    while (items_[pos].slot != Empty && items_[pos].key != key) {
+        pos = (pos + 1) & mask;
+    }
+    return pos;
+}
+
+}  // namespace Canny
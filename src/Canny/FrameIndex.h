@@ -0,0 +1,60 @@
+#ifndef _CANNY_FRAME_INDEX_H_
+#define _CANNY_FRAME_INDEX_H_
+
+#include <Arduino.h>
+
+namespace Canny {
+
+// Return the index key of a frame ID. Standard and extended frames with the
+// same ID have different keys.
+inline uint32_t frameKey(uint32_t id, uint8_t ext) {
+    return (id & 0x7FFFFFFF) | ((uint32_t)(ext == 1) << 31);
+}
+
+// An open addressed map of frame keys to slot numbers. Containers that store
+// one item per frame ID use this to find the slot holding an ID in constant
+// time. The table is sized to stay at most half full so that probes stay
+// short.
+class FrameIndex {
+    public:
+        // Returned by get() when a key is not in the index.
+        static const size_t Empty = (size_t)-1;
+
+        // Construct an index with room for capacity keys.
+        FrameIndex(size_t capacity);
+        ~FrameIndex();
+
+        // Return the slot mapped to key or Empty if the key is not in the
+        // index.
+        size_t get(uint32_t key) const;
+
+        // Map key to slot. The index must have room for the key.
+        void put(uint32_t key, size_t slot);
+
+        // Remove key from the index.
+        void remove(uint32_t key);
+
+        // Remove all keys from the index.
+        void clear();
+
+    private:
+        struct Item {
+            uint32_t key;
+            size_t slot;
+        };
+
+        // Return the home position of a key.
+        size_t home(uint32_t key) const;
+
+        // Return the position of key or the empty position where it would be
+        // inserted.
+        size_t find(uint32_t key) const;
+
+        Item* items_;
+        size_t size_;
+        uint8_t bits_;
+};
+
+}  // namespace Canny
+
+#endif  // _CANNY_FRAME_INDEX_H_
@@ -0,0 +1,62 @@
+#ifndef _CANNY_FRAME_QUEUE_H_
+#define _CANNY_FRAME_QUEUE_H_
+
+#include <Arduino.h>
+
+namespace Canny {
+
+// A fixed size FIFO queue of frames that is filled and drained in place.
+// Frames are written into the slot returned by back() and published with
+// push(). They are read from the slot returned by front() and released with
+// pop(). Frames are never copied by the queue unless push(frame) is used.
+//
+// Unlike FrameRing this is not safe to use from an interrupt handler.
+template <typename FrameType>
+class FrameQueue {
+    public:
+        // Construct a queue that holds up to capacity frames.
+        FrameQueue(size_t capacity);
+        ~FrameQueue();
+
+        // Return true if the queue has no frames.
+        bool empty() const { return len_ == 0; }
+
+        // Return true if the queue has no free slots.
+        bool full() const { return len_ >= capacity_; }
+
+        // Return the number of frames in the queue.
+        size_t size() const { return len_; }
+
+        // Return the maximum number of frames the queue can hold.
+        size_t capacity() const { return capacity_; }
+
+        // Return the free slot at the end of the queue or nullptr if the
+        // queue is full.
+        FrameType* back();
+
+        // Publish the slot returned by back().
+        void push();
+
+        // Copy a frame to the end of the queue. Return false if the queue is
+        // full.
+        bool push(const FrameType& frame);
+
+        // Return the frame at the front of the queue or nullptr if the queue
+        // is empty.
+        FrameType* front();
+
+        // Release the frame returned by front().
+        void pop();
+
+    private:
+        FrameType* frames_;
+        size_t capacity_;
+        size_t head_;
+        size_t len_;
+};
+
+}  // namespace Canny
+
+#include "FrameQueue.tpp"
+
+#endif  // _CANNY_FRAME_QUEUE_H_
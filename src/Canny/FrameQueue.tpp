@@ -0,0 +1,64 @@
+namespace Canny {
+
+template <typename FrameType>
+FrameQueue<FrameType>::FrameQueue(size_t capacity) :
+        frames_(nullptr), capacity_(capacity), head_(0), len_(0) {
+    if (capacity_ > 0) {
+        frames_ = new FrameType[capacity_];
+    }
+}
+
+template <typename FrameType>
+FrameQueue<FrameType>::~FrameQueue() {
+    if (frames_ != nullptr) {
+        delete[] frames_;
+    }
+}
+
+template <typename FrameType>
+FrameType* FrameQueue<FrameType>::back() {
+    if (full()) {
+        return nullptr;
+    }
+    size_t tail = head_ + len_;
+    return frames_ + (tail >= capacity_ ? tail - capacity_ : tail);
+}
+
+template <typename FrameType>
+void FrameQueue<FrameType>::push() {
+    if (!full()) {
+        ++len_;
+    }
+}
+
+template <typename FrameType>
+bool FrameQueue<FrameType>::push(const FrameType& frame) {
+    FrameType* slot = back();
+    if (slot == nullptr) {
+        return false;
+    }
+    *slot = frame;
+    ++len_;
+    return true;
+}
+
+template <typename FrameType>
+FrameType* FrameQueue<FrameType>::front() {
+    if (empty()) {
+        return nullptr;
+    }
+    return frames_ + head_;
+}
+
+template <typename FrameType>
+void FrameQueue<FrameType>::pop() {
+    if (empty()) {
+        return;
+    }
+    if (++head_ >= capacity_) {
+        head_ = 0;
+    }
+    --len_;
+}
+
+}  // namespace Canny
@@ -0,0 +1,389 @@
+#include "GVRET.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+namespace {
+
+// Message start and binary mode bytes.
+const uint8_t kStart = 0xF1;
+const uint8_t kBinary = 0xE7;
+
+// Commands.
+const uint8_t kBuildFrame = 0x00;
+const uint8_t kTimeSync = 0x01;
+const uint8_t kDigitalInputs = 0x02;
+const uint8_t kSetDigitalOutputs = 0x04;
+const uint8_t kSetupBus = 0x05;
+const uint8_t kGetBusParams = 0x06;
+const uint8_t kDeviceInfo = 0x07;
+const uint8_t kSetSingleWire = 0x08;
+const uint8_t kKeepAlive = 0x09;
+const uint8_t kSetSystemType = 0x0A;
+const uint8_t kEchoFrame = 0x0B;
+const uint8_t kNumBuses = 0x0C;
+const uint8_t kGetExtBuses = 0x0D;
+const uint8_t kSetExtBuses = 0x0E;
+const uint8_t kBuildFDFrame = 0x14;
+
+// Size of a frame message from the host before the payload.
+const uint8_t kFrameHeader = 6;
+
+void putUint32(uint8_t* buffer, uint32_t value) {
+    buffer[0] = value;
+    buffer[1] = value >> 8;
+    buffer[2] = value >> 16;
+    buffer[3] = value >> 24;
+}
+
+uint32_t getUint32(const uint8_t* buffer) {
+    return (uint32_t)buffer[0] | ((uint32_t)buffer[1] << 8) |
+        ((uint32_t)buffer[2] << 16) | ((uint32_t)buffer[3] << 24);
+}
+
+// Return the arbitration rate of a bitrate in bits per second.
+uint32_t arbitrationRate(Bitrate bitrate) {
+    switch (bitrate) {
+        case CAN20_125K:
+        case CANFD_125K:
+        case CANFD_125K_500K:
+            return 125000;
+        case CAN20_250K:
+        case CANFD_250K:
+        case CANFD_250K_500K:
+        case CANFD_250K_750K:
+        case CANFD_250K_1M:
+        case CANFD_250K_1M5:
+        case CANFD_250K_2M:
+        case CANFD_250K_3M:
+        case CANFD_250K_4M:
+            return 250000;
+        case CAN20_1000K:
+        case CANFD_1000K:
+        case CANFD_1000K_4M:
+        case CANFD_1000K_8M:
+            return 1000000;
+        default:
+            return 500000;
+    }
+}
+
+// Return the CAN 2.0 bitrate closest to a rate in bits per second.
+Bitrate closestBitrate(uint32_t rate) {
+    if (rate <= 187500) {
+        return CAN20_125K;
+    } else if (rate <= 375000) {
+        return CAN20_250K;
+    } else if (rate <= 750000) {
+        return CAN20_500K;
+    }
+    return CAN20_1000K;
+}
+
+}  // namespace
+
+GVRET::GVRET(Stream* stream, uint8_t buses) :
+        stream_(stream), buses_(buses > GVRETMaxBuses ? GVRETMaxBuses : buses),
+        binary_(false), dropped_(0), state_(IDLE), cmd_(0), need_(0),
+        pos_(0), in_pos_(0), in_len_(0), out_len_(0) {
+    for (uint8_t i = 0; i < GVRETMaxBuses; ++i) {
+        bus_[i].bitrate = CAN20_500K;
+        bus_[i].enabled = true;
+        bus_[i].listen = false;
+        bus_[i].changed = false;
+        bus_[i].pending = false;
+    }
+}
+
+void GVRET::configure(uint8_t bus, Bitrate bitrate) {
+    if (bus < buses_) {
+        bus_[bus].bitrate = bitrate;
+    }
+}
+
+bool GVRET::changed(uint8_t bus) {
+    if (bus >= buses_ || !bus_[bus].changed) {
+        return false;
+    }
+    bus_[bus].changed = false;
+    return true;
+}
+
+const GVRETFrame* GVRET::pending(uint8_t bus) const {
+    if (bus >= buses_ || !bus_[bus].pending) {
+        return nullptr;
+    }
+    return &bus_[bus].frame;
+}
+
+void GVRET::release(uint8_t bus) {
+    if (bus < buses_) {
+        bus_[bus].pending = false;
+    }
+}
+
+void GVRET::poll() {
+    flush();
+    for (uint8_t i = 0; i < buses_; ++i) {
+        if (bus_[i].pending) {
+            return;
+        }
+    }
+
+    while (true) {
+        if (in_pos_ >= in_len_) {
+            int available = stream_->available();
+            if (available <= 0) {
+                return;
+            }
+            in_len_ = stream_->readBytes(in_, (size_t)available < in_size_ ? available : in_size_);
+            in_pos_ = 0;
+            if (in_len_ == 0) {
+                return;
+            }
+        }
+        while (in_pos_ < in_len_) {
+            if (parse(in_[in_pos_++])) {
+                // Replies to the commands before the frame go out now.
+                flush();
+                return;
+            }
+        }
+        flush();
+    }
+}
+
+void GVRET::flush() {
+    if (out_len_ > 0) {
+        stream_->write(out_, out_len_);
+        out_len_ = 0;
+    }
+}
+
+uint8_t* GVRET::reserve(size_t len) {
+    if (out_len_ + len > out_size_) {
+        flush();
+    }
+    uint8_t* p = out_ + out_len_;
+    out_len_ += len;
+    return p;
+}
+
+Error GVRET::send(uint8_t bus, uint32_t timestamp, uint32_t id, uint8_t ext,
+        const uint8_t* data, uint8_t size) {
+    if (!binary_ || !enabled(bus)) {
+        return ERR_READY;
+    }
+    if (size > 64) {
+        return ERR_INVALID;
+    }
+
+    const bool fd = size > 8;
+    uint8_t* p = reserve((fd ? 13 : 12) + size);
+    *p++ = kStart;
+    *p++ = fd ? kBuildFDFrame : kBuildFrame;
+    putUint32(p, timestamp);
+    putUint32(p + 4, ext ? id | 0x80000000 : id);
+    p += 8;
+    if (fd) {
+        *p++ = size;
+        *p++ = bus;
+    } else {
+        *p++ = (bus << 4) | size;
+    }
+    memcpy(p, data, size);
+    p[size] = 0;
+    return ERR_OK;
+}
+
+bool GVRET::parse(uint8_t b) {
+    switch (state_) {
+        case IDLE:
+            if (b == kStart) {
+                state_ = COMMAND;
+            } else if (b == kBinary) {
+                binary_ = true;
+            }
+            return false;
+        case COMMAND:
+            cmd_ = b;
+            pos_ = 0;
+            state_ = PAYLOAD;
+            switch (cmd_) {
+                case kBuildFrame:
+                case kEchoFrame:
+                case kBuildFDFrame:
+                    need_ = kFrameHeader;
+                    break;
+                case kSetupBus:
+                    need_ = 8;
+                    break;
+                case kSetExtBuses:
+                    need_ = 12;
+                    break;
+                case kSetDigitalOutputs:
+                case kSetSingleWire:
+                case kSetSystemType:
+                    need_ = 1;
+                    break;
+                default:
+                    state_ = IDLE;
+                    command(cmd_);
+                    break;
+            }
+            return false;
+        case PAYLOAD:
+            message_[pos_++] = b;
+            if (pos_ < need_) {
+                return false;
+            }
+            if (pos_ == kFrameHeader && (cmd_ == kBuildFrame ||
+                        cmd_ == kEchoFrame || cmd_ == kBuildFDFrame)) {
+                // The header gives the payload size. A checksum byte follows
+                // the payload.
+                uint8_t size = cmd_ == kBuildFDFrame ? message_[5] : message_[5] & 0x0F;
+                if (size > (cmd_ == kBuildFDFrame ? 64 : 8)) {
+                    state_ = IDLE;
+                    return false;
+                }
+                message_[5] = size;
+                need_ = kFrameHeader + size + 1;
+                return false;
+            }
+            state_ = IDLE;
+            return complete();
+    }
+    return false;
+}
+
+void GVRET::command(uint8_t cmd) {
+    uint8_t* p;
+    switch (cmd) {
+        case kTimeSync:
+            p = reserve(6);
+            p[0] = kStart;
+            p[1] = kTimeSync;
+            putUint32(p + 2, micros());
+            break;
+        case kDigitalInputs:
+            p = reserve(4);
+            p[0] = kStart;
+            p[1] = kDigitalInputs;
+            p[2] = 0;
+            p[3] = 0;
+            break;
+        case kGetBusParams:
+            p = reserve(12);
+            p[0] = kStart;
+            p[1] = kGetBusParams;
+            for (uint8_t i = 0; i < 2; ++i) {
+                uint8_t* bus = p + 2 + 5 * i;
+                if (i < buses_) {
+                    bus[0] = (bus_[i].enabled ? 0x01 : 0x00) | (bus_[i].listen ? 0x10 : 0x00);
+                    putUint32(bus + 1, arbitrationRate(bus_[i].bitrate));
+                } else {
+                    memset(bus, 0, 5);
+                }
+            }
+            break;
+        case kDeviceInfo:
+            p = reserve(8);
+            p[0] = kStart;
+            p[1] = kDeviceInfo;
+            p[2] = 0x6A;    // build number, low byte
+            p[3] = 0x01;    // build number, high byte
+            p[4] = 0x20;    // EEPROM version
+            p[5] = 0;       // file output type
+            p[6] = 0;       // auto start logging
+            p[7] = 0;       // single wire mode
+            break;
+        case kKeepAlive:
+            p = reserve(4);
+            p[0] = kStart;
+            p[1] = kKeepAlive;
+            p[2] = 0xDE;
+            p[3] = 0xAD;
+            break;
+        case kNumBuses:
+            p = reserve(3);
+            p[0] = kStart;
+            p[1] = kNumBuses;
+            p[2] = buses_;
+            break;
+        case kGetExtBuses:
+            // There are no extended buses.
+            p = reserve(17);
+            p[0] = kStart;
+            p[1] = kGetExtBuses;
+            memset(p + 2, 0, 15);
+            break;
+    }
+}
+
+bool GVRET::complete() {
+    switch (cmd_) {
+        case kSetupBus:
+            setup(0, getUint32(message_));
+            setup(1, getUint32(message_ + 4));
+            return false;
+        case kEchoFrame: {
+            uint32_t id = getUint32(message_);
+            send(message_[4], micros(), id & 0x1FFFFFFF, id >> 31, message_ + kFrameHeader,
+                    message_[5]);
+            return false;
+        }
+        case kBuildFrame:
+        case kBuildFDFrame: {
+            const uint8_t bus = message_[4];
+            if (!enabled(bus) || bus_[bus].listen) {
+                return false;
+            }
+            Bus* state = bus_ + bus;
+            if (state->pending) {
+                ++dropped_;
+                return false;
+            }
+            uint32_t id = getUint32(message_);
+            state->frame.id = id & 0x1FFFFFFF;
+            state->frame.ext = id >> 31;
+            state->frame.size = message_[5];
+            memcpy(state->frame.data, message_ + kFrameHeader, message_[5]);
+            state->pending = true;
+            return true;
+        }
+    }
+    return false;
+}
+
+void GVRET::setup(uint8_t bus, uint32_t value) {
+    if (bus >= buses_) {
+        return;
+    }
+    Bus* state = bus_ + bus;
+    bool enabled;
+    bool listen = false;
+    uint32_t rate;
+    if (value & 0x80000000) {
+        // The enabled and listen only flags are given.
+        enabled = value & 0x40000000;
+        listen = value & 0x20000000;
+        rate = value & 0xFFFFF;
+    } else {
+        rate = value;
+        enabled = rate > 0;
+    }
+
+    // Keep the data rate of a CAN FD bus whose arbitration rate is unchanged.
+    Bitrate bitrate = state->bitrate;
+    if (enabled && rate > 0 && rate != arbitrationRate(bitrate)) {
+        bitrate = closestBitrate(rate);
+    }
+    if (state->enabled != enabled || state->listen != listen || state->bitrate != bitrate) {
+        state->changed = true;
+    }
+    state->enabled = enabled;
+    state->listen = listen;
+    state->bitrate = bitrate;
+}
+
+}  // namespace Canny
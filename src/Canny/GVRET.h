@@ -0,0 +1,203 @@
+#ifndef _CANNY_GVRET_H_
+#define _CANNY_GVRET_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Controller.h"
+#include "Error.h"
+#include "Frame.h"
+
+// The GVRET binary protocol as spoken by SavvyCAN. The host switches the
+// device into binary mode by sending 0xE7 0xE7. Every message then starts with
+// 0xF1 and a command byte. Multi-byte values are little endian. Frames sent to
+// the host are:
+//
+//   F1 00 time[4] id[4] (bus << 4 | size) data[size] 00
+//   F1 14 time[4] id[4] size bus data[size] 00
+//
+// The first form carries CAN 2.0 payloads and the second, used for payloads
+// over 8 bytes, carries CAN FD payloads. Time is in microseconds. Bit 31 of
+// the ID is set for extended frames. Frames sent by the host to be
+// transmitted are:
+//
+//   F1 00 id[4] bus size data[size] 00
+//   F1 14 id[4] bus size data[size] 00
+//
+// Command 0x0B has the same form and echoes the frame back to the host
+// instead of transmitting it.
+
+namespace Canny {
+
+// The number of buses a GVRET instance can expose.
+const uint8_t GVRETMaxBuses = 2;
+
+// A frame received from the host.
+struct GVRETFrame {
+    uint32_t id;
+    uint8_t ext;
+    uint8_t size;
+    uint8_t data[64];
+};
+
+// Exchanges frames for one or two buses with SavvyCAN over a serial stream.
+// Each bus is exposed to the sketch as a GVRETBus connection. Frames written
+// to the host are packed into an output buffer which is sent with a single
+// stream write when it fills or when poll() is next called, so that all frames
+// written in one loop() share as few USB packets as possible.
+//
+// The host may configure the bus rates and modes. The configuration is
+// applied by a GVRETBus to its controller.
+class GVRET {
+    public:
+        // Construct a GVRET instance that communicates over the given stream
+        // and exposes the given number of buses, up to GVRETMaxBuses. Buses
+        // start enabled at CAN20_500K.
+        GVRET(Stream* stream, uint8_t buses = 1);
+
+        // Set the bitrate reported to the host for a bus. This does not mark
+        // the bus as changed.
+        void configure(uint8_t bus, Bitrate bitrate);
+
+        // Flush buffered output and process messages from the host without
+        // blocking. Processing stops once a frame from the host is waiting to
+        // be read from a bus. GVRETBus calls this from read().
+        void poll();
+
+        // Write buffered output to the stream.
+        void flush();
+
+        // Return true once the host has switched to binary mode. Frames are
+        // only sent to the host in binary mode.
+        bool binary() const { return binary_; }
+
+        // Return the number of buses.
+        uint8_t buses() const { return buses_; }
+
+        // Return true if the host has enabled a bus.
+        bool enabled(uint8_t bus) const { return bus < buses_ && bus_[bus].enabled; }
+
+        // Return true if the host has placed a bus in listen only mode.
+        // Frames from the host are not transmitted on the bus.
+        bool listenOnly(uint8_t bus) const { return bus < buses_ && bus_[bus].listen; }
+
+        // Return the bitrate of a bus.
+        Bitrate bitrate(uint8_t bus) const { return bus_[bus].bitrate; }
+
+        // Return true once if the host has changed the configuration of a bus
+        // since the last call.
+        bool changed(uint8_t bus);
+
+        // Return the frame from the host waiting to be transmitted on a bus or
+        // nullptr if there is none.
+        const GVRETFrame* pending(uint8_t bus) const;
+
+        // Release the pending frame of a bus.
+        void release(uint8_t bus);
+
+        // Queue a frame received on a bus for the host. Return ERR_READY if
+        // the host is not in binary mode or the bus is disabled or
+        // ERR_INVALID if size is larger than 64.
+        Error send(uint8_t bus, uint32_t timestamp, uint32_t id, uint8_t ext,
+                const uint8_t* data, uint8_t size);
+
+        // Return the number of frames from the host that were dropped because
+        // the frame before it on the same bus had not been read yet.
+        uint32_t dropped() const { return dropped_; }
+
+    private:
+        enum State : uint8_t {
+            IDLE,
+            COMMAND,
+            PAYLOAD,
+        };
+
+        struct Bus {
+            Bitrate bitrate;
+            bool enabled;
+            bool listen;
+            bool changed;
+            bool pending;
+            GVRETFrame frame;
+        };
+
+        // Size of the output buffer.
+        static const size_t out_size_ = 256;
+
+        // Size of the input buffer.
+        static const size_t in_size_ = 64;
+
+        // Size of the longest message from the host after the command byte.
+        static const size_t message_size_ = 71;
+
+        // Handle a byte from the host. Return true if a frame was queued on a
+        // bus.
+        bool parse(uint8_t b);
+
+        // Handle a command with no payload.
+        void command(uint8_t cmd);
+
+        // Handle a complete message. Return true if a frame was queued on a
+        // bus.
+        bool complete();
+
+        // Apply a SETUP_CANBUS value to a bus.
+        void setup(uint8_t bus, uint32_t value);
+
+        // Reserve len bytes of output. Return a pointer to the reserved bytes.
+        uint8_t* reserve(size_t len);
+
+        Stream* stream_;
+        uint8_t buses_;
+        bool binary_;
+        Bus bus_[GVRETMaxBuses];
+        uint32_t dropped_;
+
+        // Parser attributes.
+        State state_;
+        uint8_t cmd_;
+        uint8_t need_;
+        uint8_t pos_;
+        uint8_t message_[message_size_];
+
+        uint8_t in_[in_size_];
+        uint8_t in_pos_;
+        uint8_t in_len_;
+
+        uint8_t out_[out_size_];
+        size_t out_len_;
+};
+
+// A connection to one bus of a GVRET instance. Frames read are those the host
+// asked to be transmitted on the bus. Frames written are sent to the host as
+// received on the bus. If a controller is given it is restarted with begin()
+// whenever the host changes the bus rate.
+template <typename FrameType>
+class GVRETBus : public Connection<FrameType> {
+    public:
+        // Construct a connection to the given bus of gvret.
+        GVRETBus(GVRET* gvret, uint8_t bus, Controller<FrameType>* controller = nullptr);
+
+        // Poll the GVRET instance and read the next frame the host sent for
+        // this bus. Return ERR_OK if a frame was read or ERR_FIFO if there is
+        // none. Frames larger than the frame capacity are dropped.
+        Error read(FrameType* frame) override;
+
+        // Send a frame to the host. Timestamped frames are sent with their
+        // timestamp. Other frames are stamped with micros().
+        //
+        // Return ERR_OK on success, ERR_READY if the host is not in binary
+        // mode or has disabled the bus, or ERR_INVALID if the frame is larger
+        // than 64 bytes.
+        Error write(const FrameType& frame) override;
+
+    private:
+        GVRET* gvret_;
+        uint8_t bus_;
+        Controller<FrameType>* controller_;
+};
+
+}  // namespace Canny
+
+#include "GVRET.tpp"
+
+#endif  // _CANNY_GVRET_H_
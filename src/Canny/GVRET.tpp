@@ -0,0 +1,38 @@
+namespace Canny {
+
+template <typename FrameType>
+GVRETBus<FrameType>::GVRETBus(GVRET* gvret, uint8_t bus, Controller<FrameType>* controller) :
+    gvret_(gvret), bus_(bus), controller_(controller) {}
+
+template <typename FrameType>
+Error GVRETBus<FrameType>::read(FrameType* frame) {
+    gvret_->poll();
+    if (gvret_->changed(bus_) && controller_ && gvret_->enabled(bus_)) {
+        controller_->begin(gvret_->bitrate(bus_));
+    }
+
+    while (true) {
+        const GVRETFrame* pending = gvret_->pending(bus_);
+        if (pending == nullptr) {
+            return ERR_FIFO;
+        }
+        if (pending->size > frame->capacity()) {
+            gvret_->release(bus_);
+            gvret_->poll();
+            continue;
+        }
+        frame->id(pending->id, pending->ext);
+        frame->data(pending->data, pending->size);
+        stampFrame(frame);
+        gvret_->release(bus_);
+        return ERR_OK;
+    }
+}
+
+template <typename FrameType>
+Error GVRETBus<FrameType>::write(const FrameType& frame) {
+    uint32_t timestamp = FrameTraits<FrameType>::timestamped ? frameTimestamp(frame) : micros();
+    return gvret_->send(bus_, timestamp, frame.id(), frame.ext(), frame.data(), frame.size());
+}
+
+}  // namespace Canny
@@ -0,0 +1,206 @@
+#ifndef _CANNY_ISOTP_H_
+#define _CANNY_ISOTP_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Error.h"
+#include "Frame.h"
+
+namespace Canny {
+
+// The largest message size that fits the 12-bit length of a first frame.
+// Larger messages use the 32-bit escape sequence.
+const uint32_t ISOTPShortMaxSize = 4095;
+
+// Reasons a segmented transfer is aborted.
+enum ISOTPAbortReason : uint8_t {
+    ISOTP_ABORT_TIMEOUT = 1,    // The peer or child did not respond in time.
+    ISOTP_ABORT_OVERFLOW = 2,   // The peer can't receive a message this large.
+    ISOTP_ABORT_SEQUENCE = 3,   // A consecutive frame was received out of order.
+};
+
+// A message sent or received with ISO-TP. The payload is stored in a buffer
+// owned by the transport's session pool.
+class ISOTPMessage {
+    public:
+        // Return the channel the message was sent or received on.
+        uint8_t channel() const { return channel_; }
+
+        // Return the size of the payload in bytes.
+        uint32_t size() const { return size_; }
+
+        // Return a pointer to the payload. The data is exactly size() bytes
+        // long.
+        uint8_t* data() const { return data_; }
+
+    protected:
+        ISOTPMessage() : channel_(0), size_(0), data_(nullptr) {}
+
+        uint8_t channel_;
+        uint32_t size_;
+        uint8_t* data_;
+};
+
+// Implements the ISO 15765-2 transport protocol (ISO-TP) with normal
+// addressing over a CAN 2.0 or CAN FD connection. Messages that don't fit a
+// single frame are segmented into a first frame and consecutive frames, with
+// flow control from the receiver. CAN FD frames carry up to 64 bytes and
+// messages larger than 4095 bytes use the escape sequence in the first frame.
+//
+// A channel is a pair of CAN IDs: frames are sent with the transmit ID and
+// received on the receive ID. Each channel may send one message and receive
+// one message at a time. Sessions are allocated from a fixed pool of
+// preallocated buffers. A received message is handed to the caller in place
+// and its session is returned to the pool on release().
+//
+// Consecutive frames are sent as soon as the receiver's STmin allows,
+// measured with micros(). Timeouts are measured with millis(). The transport
+// must be serviced from loop() by calling read() until it returns ERR_FIFO.
+template <typename FrameType>
+class ISOTP : public Connection<FrameType> {
+    public:
+        // Construct a transport over the child connection with room for the
+        // given number of channels. The pool is allocated with room for the
+        // given number of concurrent transfers, each of which may hold up to
+        // max_size bytes.
+        ISOTP(Connection<FrameType>* child, size_t channels = 4, size_t sessions = 4,
+                uint32_t max_size = ISOTPShortMaxSize);
+        ~ISOTP();
+
+        // Add a channel which sends frames with tx_id and receives frames
+        // with rx_id. Set ext to 1 to use extended IDs. Channels are numbered
+        // in the order they are added starting at 0. Return false if there is
+        // no room for the channel.
+        bool addChannel(uint32_t tx_id, uint32_t rx_id, uint8_t ext = 0);
+
+        // Set the block size and STmin sent to peers in flow control frames.
+        // A block size of 0 lets the peer send all consecutive frames without
+        // waiting. STmin is encoded as in ISO 15765-2: 0-127 ms or 0xF1-0xF9
+        // for 100-900 us. Defaults to 0 and 0.
+        void flowControl(uint8_t block_size, uint8_t st_min);
+
+        // Set the size of the frames sent. This is 8 for CAN 2.0 and up to 64
+        // for CAN FD. Sizes are rounded down to a valid CAN FD length and
+        // limited by the frame capacity. Defaults to the frame capacity.
+        void frameSize(uint8_t size);
+
+        // Read a frame from the child connection. Frames received on a
+        // channel are consumed and processed until a frame that is not part
+        // of a channel is read. Outgoing sessions and session timeouts are
+        // serviced on each call.
+        //
+        // Return ERR_OK if a frame was read or ERR_FIFO if the child has no
+        // more frames to read. Completed messages are retrieved with
+        // receive().
+        Error read(FrameType* frame) override;
+
+        // Write a frame to the child connection.
+        Error write(const FrameType& frame) override;
+
+        // Retrieve a completed message. Messages are returned in the order
+        // they completed. The message remains owned by the transport and
+        // must be passed to release() once the caller is done with it.
+        //
+        // Return ERR_OK if a message is available or ERR_FIFO if none are.
+        Error receive(ISOTPMessage** message);
+
+        // Return a received message's session to the pool.
+        void release(ISOTPMessage* message);
+
+        // Send a message on a channel. Messages that fit in a single frame
+        // are written directly. Larger messages are copied into a session
+        // buffer and sent as read() and flush() are called.
+        //
+        // Return ERR_OK if the message was written or a session was started.
+        // Return ERR_FIFO if the channel is already sending or no session is
+        // available, or the child's error if a single frame write fails.
+        // Return ERR_INVALID if the channel does not exist or the message is
+        // empty or too large.
+        Error send(uint8_t channel, const uint8_t* data, uint32_t size);
+
+        // Service outgoing sessions and session timeouts without reading
+        // from the child.
+        void flush();
+
+        // Return true if an outgoing session is in progress.
+        bool sending() const;
+
+        // Called when a session is aborted or times out. The message is
+        // incomplete and is released after this returns.
+        virtual void onAbort(const ISOTPMessage&, ISOTPAbortReason) const {}
+
+    private:
+        enum State : uint8_t {
+            IDLE,
+            RX_DATA,        // Receiving consecutive frames.
+            RX_COMPLETE,    // Received message waiting for the caller.
+            RX_DELIVERED,   // Received message handed to the caller.
+            TX_FIRST,       // Sending the first frame.
+            TX_FC,          // Waiting for a flow control frame.
+            TX_DATA,        // Sending consecutive frames.
+        };
+
+        struct Channel {
+            uint32_t tx_id;
+            uint32_t rx_id;
+            uint8_t ext;
+        };
+
+        class Session : public ISOTPMessage {
+            public:
+                State state;
+                uint32_t offset;    // Bytes sent or received.
+                uint8_t sn;         // Next sequence number.
+                uint8_t block;      // Frames left in the block or 0 if unlimited.
+                uint8_t block_size; // Block size from the last flow control.
+                bool pending;       // A flow control frame is waiting to be sent.
+                uint32_t st_min;    // Separation time in microseconds.
+                uint32_t sent;      // Time of the last consecutive frame in microseconds.
+                uint32_t timer;     // Time of the last session event in milliseconds.
+                uint32_t completed; // Completion order of a received message.
+
+                friend class ISOTP;
+        };
+
+        // Process a frame received on a channel.
+        void handleSingle(uint8_t channel, const FrameType& frame);
+        void handleFirst(uint8_t channel, const FrameType& frame);
+        void handleConsecutive(uint8_t channel, const FrameType& frame);
+        void handleFlowControl(uint8_t channel, const FrameType& frame);
+
+        // Service a single session.
+        void service(Session* session, uint32_t now);
+        bool sendFirst(Session* session);
+        bool sendConsecutive(Session* session);
+        bool sendFlowControl(uint8_t channel, uint8_t status);
+
+        // Write a frame on a channel. The first len bytes of the frame have
+        // been filled in. The rest of the frame is padded.
+        Error writeFrame(uint8_t channel, FrameType* frame, uint8_t len);
+
+        // Find an active session by channel and direction.
+        Session* find(uint8_t channel, bool rx);
+        Session* alloc();
+        void abort(Session* session, ISOTPAbortReason reason);
+        void complete(Session* session);
+        void reset(Session* session);
+
+        Connection<FrameType>* child_;
+        Channel* channels_;
+        size_t channels_size_;
+        size_t channels_len_;
+        Session* sessions_;
+        uint8_t* buffer_;
+        size_t count_;
+        uint32_t max_size_;
+        uint8_t frame_size_;
+        uint8_t block_size_;
+        uint8_t st_min_;
+        uint32_t completed_;
+};
+
+}  // namespace Canny
+
+#include "ISOTP.tpp"
+
+#endif  // _CANNY_ISOTP_H_
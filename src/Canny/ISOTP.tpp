@@ -0,0 +1,542 @@
+namespace Canny {
+
+// Protocol control information types in the high nibble of the first byte.
+static const uint8_t kISOTPSingle = 0x00;
+static const uint8_t kISOTPFirst = 0x10;
+static const uint8_t kISOTPConsecutive = 0x20;
+static const uint8_t kISOTPFlowControl = 0x30;
+
+// Flow control status values.
+static const uint8_t kISOTPContinue = 0;
+static const uint8_t kISOTPWait = 1;
+static const uint8_t kISOTPOverflow = 2;
+
+// Timeouts from ISO 15765-2 in milliseconds.
+static const uint16_t kISOTPTimeoutAs = 1000;  // Sender waiting for the child to accept a frame.
+static const uint16_t kISOTPTimeoutBs = 1000;  // Sender waiting for flow control.
+static const uint16_t kISOTPTimeoutCr = 1000;  // Receiver waiting for a consecutive frame.
+
+// Byte used to pad frames to a valid length.
+static const uint8_t kISOTPPadding = 0xCC;
+
+// Valid frame lengths of 8 bytes or more.
+static const uint8_t kISOTPLengths[] = {8, 12, 16, 20, 24, 32, 48, 64};
+
+// Return the shortest valid frame length that holds len bytes.
+inline uint8_t isotpPadded(uint8_t len) {
+    for (uint8_t i = 0; i < sizeof(kISOTPLengths); ++i) {
+        if (kISOTPLengths[i] >= len) {
+            return kISOTPLengths[i];
+        }
+    }
+    return 64;
+}
+
+// Return an encoded STmin value in microseconds. Reserved values are treated
+// as the maximum of 127 ms.
+inline uint32_t isotpSTmin(uint8_t value) {
+    if (value <= 0x7F) {
+        return value * 1000UL;
+    }
+    if (value >= 0xF1 && value <= 0xF9) {
+        return (value - 0xF0) * 100UL;
+    }
+    return 127000UL;
+}
+
+template <typename FrameType>
+ISOTP<FrameType>::ISOTP(Connection<FrameType>* child, size_t channels, size_t sessions,
+        uint32_t max_size) :
+        child_(child), channels_(nullptr), channels_size_(channels), channels_len_(0),
+        sessions_(nullptr), buffer_(nullptr), count_(sessions), max_size_(max_size),
+        frame_size_(8), block_size_(0), st_min_(0), completed_(0) {
+    if (channels_size_ > 0) {
+        channels_ = new Channel[channels_size_];
+    }
+    if (count_ > 0) {
+        sessions_ = new Session[count_];
+        buffer_ = new uint8_t[count_ * max_size_];
+    }
+    for (size_t i = 0; i < count_; ++i) {
+        sessions_[i].data_ = buffer_ + i * max_size_;
+        reset(sessions_ + i);
+    }
+    frameSize(64);
+}
+
+template <typename FrameType>
+ISOTP<FrameType>::~ISOTP() {
+    if (channels_ != nullptr) {
+        delete[] channels_;
+    }
+    if (sessions_ != nullptr) {
+        delete[] sessions_;
+    }
+    if (buffer_ != nullptr) {
+        delete[] buffer_;
+    }
+}
+
+template <typename FrameType>
+bool ISOTP<FrameType>::addChannel(uint32_t tx_id, uint32_t rx_id, uint8_t ext) {
+    if (channels_len_ >= channels_size_) {
+        return false;
+    }
+    Channel* channel = channels_ + channels_len_++;
+    channel->tx_id = tx_id;
+    channel->rx_id = rx_id;
+    channel->ext = ext == 1 ? 1 : 0;
+    return true;
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::flowControl(uint8_t block_size, uint8_t st_min) {
+    block_size_ = block_size;
+    st_min_ = st_min;
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::frameSize(uint8_t size) {
+    FrameType frame;
+    if (size > frame.capacity()) {
+        size = frame.capacity();
+    }
+    frame_size_ = 8;
+    for (uint8_t i = 0; i < sizeof(kISOTPLengths); ++i) {
+        if (kISOTPLengths[i] <= size) {
+            frame_size_ = kISOTPLengths[i];
+        }
+    }
+}
+
+template <typename FrameType>
+Error ISOTP<FrameType>::read(FrameType* frame) {
+    flush();
+
+    Error err;
+    while ((err = child_->read(frame)) == ERR_OK) {
+        size_t channel = 0;
+        while (channel < channels_len_ && (channels_[channel].rx_id != frame->id() ||
+                    channels_[channel].ext != frame->ext())) {
+            ++channel;
+        }
+        if (channel >= channels_len_) {
+            return ERR_OK;
+        }
+        if (frame->size() == 0) {
+            continue;
+        }
+        switch (frame->data()[0] & 0xF0) {
+            case kISOTPSingle:
+                handleSingle(channel, *frame);
+                break;
+            case kISOTPFirst:
+                handleFirst(channel, *frame);
+                break;
+            case kISOTPConsecutive:
+                handleConsecutive(channel, *frame);
+                break;
+            case kISOTPFlowControl:
+                handleFlowControl(channel, *frame);
+                break;
+            default:
+                break;
+        }
+    }
+    return err;
+}
+
+template <typename FrameType>
+Error ISOTP<FrameType>::write(const FrameType& frame) {
+    return child_->write(frame);
+}
+
+template <typename FrameType>
+Error ISOTP<FrameType>::receive(ISOTPMessage** message) {
+    Session* oldest = nullptr;
+    for (size_t i = 0; i < count_; ++i) {
+        Session* session = sessions_ + i;
+        if (session->state == RX_COMPLETE && (oldest == nullptr ||
+                (int32_t)(session->completed - oldest->completed) < 0)) {
+            oldest = session;
+        }
+    }
+    if (oldest == nullptr) {
+        return ERR_FIFO;
+    }
+    oldest->state = RX_DELIVERED;
+    *message = oldest;
+    return ERR_OK;
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::release(ISOTPMessage* message) {
+    for (size_t i = 0; i < count_; ++i) {
+        if (message == sessions_ + i) {
+            reset(sessions_ + i);
+            return;
+        }
+    }
+}
+
+template <typename FrameType>
+Error ISOTP<FrameType>::send(uint8_t channel, const uint8_t* data, uint32_t size) {
+    if (channel >= channels_len_ || size == 0) {
+        return ERR_INVALID;
+    }
+    if (find(channel, false) != nullptr) {
+        // only one outgoing message is allowed per channel
+        return ERR_FIFO;
+    }
+
+    // CAN FD single frames longer than 7 bytes put the length in a second
+    // byte.
+    const uint8_t single = frame_size_ > 8 ? frame_size_ - 2 : 7;
+    if (size <= single) {
+        FrameType frame;
+        uint8_t* out = frame.data();
+        uint8_t header = 1;
+        if (size <= 7) {
+            out[0] = kISOTPSingle | size;
+        } else {
+            out[0] = kISOTPSingle;
+            out[1] = size;
+            header = 2;
+        }
+        memcpy(out + header, data, size);
+        return writeFrame(channel, &frame, header + size);
+    }
+
+    if (size > max_size_) {
+        return ERR_INVALID;
+    }
+    Session* session = alloc();
+    if (session == nullptr) {
+        return ERR_FIFO;
+    }
+    session->channel_ = channel;
+    session->size_ = size;
+    memcpy(session->data_, data, size);
+    session->state = TX_FIRST;
+    session->timer = millis();
+    service(session, session->timer);
+    return ERR_OK;
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::flush() {
+    uint32_t now = millis();
+    for (size_t i = 0; i < count_; ++i) {
+        if (sessions_[i].state != IDLE) {
+            service(sessions_ + i, now);
+        }
+    }
+}
+
+template <typename FrameType>
+bool ISOTP<FrameType>::sending() const {
+    for (size_t i = 0; i < count_; ++i) {
+        if (sessions_[i].state >= TX_FIRST) {
+            return true;
+        }
+    }
+    return false;
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::handleSingle(uint8_t channel, const FrameType& frame) {
+    const uint8_t* data = frame.data();
+    uint32_t size = data[0] & 0x0F;
+    uint8_t header = 1;
+    if (size == 0 && frame.size() > 8) {
+        size = data[1];
+        header = 2;
+    }
+    if (size == 0 || size + header > frame.size() || size > max_size_) {
+        return;
+    }
+
+    // A new message replaces one that is in progress.
+    Session* session = find(channel, true);
+    if (session != nullptr) {
+        abort(session, ISOTP_ABORT_SEQUENCE);
+    }
+    session = alloc();
+    if (session == nullptr) {
+        return;
+    }
+    session->channel_ = channel;
+    session->size_ = size;
+    memcpy(session->data_, data + header, size);
+    complete(session);
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::handleFirst(uint8_t channel, const FrameType& frame) {
+    if (frame.size() < 8) {
+        return;
+    }
+    const uint8_t* data = frame.data();
+    uint32_t size = ((uint32_t)(data[0] & 0x0F) << 8) | data[1];
+    uint8_t header = 2;
+    if (size == 0) {
+        size = ((uint32_t)data[2] << 24) | ((uint32_t)data[3] << 16) |
+            ((uint32_t)data[4] << 8) | data[5];
+        header = 6;
+    }
+    if (size < (uint32_t)(frame.size() - header)) {
+        return;
+    }
+
+    Session* session = find(channel, true);
+    if (session != nullptr) {
+        abort(session, ISOTP_ABORT_SEQUENCE);
+    }
+    if (size > max_size_ || (session = alloc()) == nullptr) {
+        sendFlowControl(channel, kISOTPOverflow);
+        return;
+    }
+    session->channel_ = channel;
+    session->size_ = size;
+    session->offset = frame.size() - header;
+    memcpy(session->data_, data + header, session->offset);
+    session->sn = 1;
+    session->block = block_size_;
+    session->state = RX_DATA;
+    session->pending = true;
+    session->timer = millis();
+    service(session, session->timer);
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::handleConsecutive(uint8_t channel, const FrameType& frame) {
+    Session* session = find(channel, true);
+    if (session == nullptr || session->pending) {
+        return;
+    }
+    if ((frame.data()[0] & 0x0F) != session->sn) {
+        abort(session, ISOTP_ABORT_SEQUENCE);
+        return;
+    }
+
+    uint32_t len = session->size_ - session->offset;
+    if (len > (uint32_t)frame.size() - 1) {
+        len = frame.size() - 1;
+    }
+    memcpy(session->data_ + session->offset, frame.data() + 1, len);
+    session->offset += len;
+    session->sn = (session->sn + 1) & 0x0F;
+    session->timer = millis();
+
+    if (session->offset >= session->size_) {
+        complete(session);
+    } else if (block_size_ > 0 && --session->block == 0) {
+        // block received, request more frames
+        session->block = block_size_;
+        session->pending = true;
+        service(session, session->timer);
+    }
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::handleFlowControl(uint8_t channel, const FrameType& frame) {
+    Session* session = find(channel, false);
+    if (session == nullptr || session->state != TX_FC || frame.size() < 3) {
+        return;
+    }
+
+    const uint8_t* data = frame.data();
+    session->timer = millis();
+    switch (data[0] & 0x0F) {
+        case kISOTPContinue:
+            session->block_size = data[1];
+            session->block = data[1];
+            session->st_min = isotpSTmin(data[2]);
+            // The first frame of a block is not delayed.
+            session->sent = micros() - session->st_min;
+            session->state = TX_DATA;
+            service(session, session->timer);
+            break;
+        case kISOTPWait:
+            break;
+        case kISOTPOverflow:
+            abort(session, ISOTP_ABORT_OVERFLOW);
+            break;
+        default:
+            break;
+    }
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::service(Session* session, uint32_t now) {
+    switch (session->state) {
+        case RX_DATA:
+            if (session->pending) {
+                if (sendFlowControl(session->channel_, kISOTPContinue)) {
+                    session->pending = false;
+                    session->timer = now;
+                }
+            } else if (now - session->timer >= kISOTPTimeoutCr) {
+                abort(session, ISOTP_ABORT_TIMEOUT);
+            }
+            break;
+        case TX_FIRST:
+            if (sendFirst(session)) {
+                session->state = TX_FC;
+                session->timer = now;
+            } else if (now - session->timer >= kISOTPTimeoutAs) {
+                abort(session, ISOTP_ABORT_TIMEOUT);
+            }
+            break;
+        case TX_FC:
+            if (now - session->timer >= kISOTPTimeoutBs) {
+                abort(session, ISOTP_ABORT_TIMEOUT);
+            }
+            break;
+        case TX_DATA:
+            while (true) {
+                if (session->block_size > 0 && session->block == 0) {
+                    // wait for the next flow control
+                    session->state = TX_FC;
+                    session->timer = now;
+                    break;
+                }
+                if (session->st_min > 0 && micros() - session->sent < session->st_min) {
+                    break;
+                }
+                if (!sendConsecutive(session)) {
+                    if (now - session->timer >= kISOTPTimeoutAs) {
+                        abort(session, ISOTP_ABORT_TIMEOUT);
+                    }
+                    break;
+                }
+                session->timer = now;
+                if (session->offset >= session->size_) {
+                    reset(session);
+                    break;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+template <typename FrameType>
+bool ISOTP<FrameType>::sendFirst(Session* session) {
+    FrameType frame;
+    uint8_t* data = frame.data();
+    uint8_t header = 2;
+    if (session->size_ <= ISOTPShortMaxSize) {
+        data[0] = kISOTPFirst | (session->size_ >> 8);
+        data[1] = session->size_ & 0xFF;
+    } else {
+        data[0] = kISOTPFirst;
+        data[1] = 0;
+        data[2] = session->size_ >> 24;
+        data[3] = session->size_ >> 16;
+        data[4] = session->size_ >> 8;
+        data[5] = session->size_;
+        header = 6;
+    }
+    const uint8_t len = frame_size_ - header;
+    memcpy(data + header, session->data_, len);
+    if (writeFrame(session->channel_, &frame, frame_size_) != ERR_OK) {
+        return false;
+    }
+    session->offset = len;
+    session->sn = 1;
+    return true;
+}
+
+template <typename FrameType>
+bool ISOTP<FrameType>::sendConsecutive(Session* session) {
+    FrameType frame;
+    uint32_t len = session->size_ - session->offset;
+    if (len > (uint32_t)frame_size_ - 1) {
+        len = frame_size_ - 1;
+    }
+    frame.data()[0] = kISOTPConsecutive | session->sn;
+    memcpy(frame.data() + 1, session->data_ + session->offset, len);
+    if (writeFrame(session->channel_, &frame, len + 1) != ERR_OK) {
+        return false;
+    }
+    session->offset += len;
+    session->sn = (session->sn + 1) & 0x0F;
+    session->sent = micros();
+    if (session->block_size > 0) {
+        --session->block;
+    }
+    return true;
+}
+
+template <typename FrameType>
+bool ISOTP<FrameType>::sendFlowControl(uint8_t channel, uint8_t status) {
+    FrameType frame;
+    uint8_t* data = frame.data();
+    data[0] = kISOTPFlowControl | status;
+    data[1] = block_size_;
+    data[2] = st_min_;
+    return writeFrame(channel, &frame, 3) == ERR_OK;
+}
+
+template <typename FrameType>
+Error ISOTP<FrameType>::writeFrame(uint8_t channel, FrameType* frame, uint8_t len) {
+    const uint8_t padded = isotpPadded(len);
+    frame->id(channels_[channel].tx_id, channels_[channel].ext);
+    frame->resize(padded);
+    memset(frame->data() + len, kISOTPPadding, padded - len);
+    return child_->write(*frame);
+}
+
+template <typename FrameType>
+typename ISOTP<FrameType>::Session* ISOTP<FrameType>::find(uint8_t channel, bool rx) {
+    for (size_t i = 0; i < count_; ++i) {
+        Session* session = sessions_ + i;
+        bool active = rx ? session->state == RX_DATA : session->state >= TX_FIRST;
+        if (active && session->channel_ == channel) {
+            return session;
+        }
+    }
+    return nullptr;
+}
+
+template <typename FrameType>
+typename ISOTP<FrameType>::Session* ISOTP<FrameType>::alloc() {
+    for (size_t i = 0; i < count_; ++i) {
+        if (sessions_[i].state == IDLE) {
+            return sessions_ + i;
+        }
+    }
+    return nullptr;
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::abort(Session* session, ISOTPAbortReason reason) {
+    onAbort(*session, reason);
+    reset(session);
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::complete(Session* session) {
+    session->state = RX_COMPLETE;
+    session->completed = completed_++;
+}
+
+template <typename FrameType>
+void ISOTP<FrameType>::reset(Session* session) {
+    session->state = IDLE;
+    session->channel_ = 0;
+    session->size_ = 0;
+    session->offset = 0;
+    session->sn = 0;
+    session->block = 0;
+    session->block_size = 0;
+    session->pending = false;
+    session->st_min = 0;
+    session->sent = 0;
+    session->timer = 0;
+    session->completed = 0;
+}
+
+}  // namespace Canny
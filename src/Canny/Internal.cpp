@@ -2,6 +2,33 @@
 
 namespace Canny {
 namespace internal {
+namespace {
+
+const uint8_t kMaxInterruptHandlers = 4;
+
+// Arduino interrupt handlers take no arguments so each slot has its own
+// trampoline that forwards to the attached handler.
+struct InterruptHandler {
+    uint8_t pin;
+    void (*handler)(void*);
+    void* arg;
+};
+
+InterruptHandler handlers[kMaxInterruptHandlers];
+
+template <uint8_t N>
+void trampoline() {
+    handlers[N].handler(handlers[N].arg);
+}
+
+void (*const trampolines[kMaxInterruptHandlers])() = {
+    trampoline<0>,
+    trampoline<1>,
+    trampoline<2>,
+    trampoline<3>,
+};
+
+}  // namespace
 
 Mode getMode(Bitrate bitrate) {
     if (bitrate < CANFD_125K) {
@@ -13,5 +40,32 @@ Mode getMode(Bitrate bitrate) {
     return CANFD_DUAL_RATE;
 }
 
+bool attachInterruptHandler(uint8_t pin, int mode, void (*handler)(void*), void* arg) {
+    int irq = digitalPinToInterrupt(pin);
+    if (irq == NOT_AN_INTERRUPT) {
+        return false;
+    }
+    for (uint8_t i = 0; i < kMaxInterruptHandlers; ++i) {
+        if (handlers[i].handler == nullptr) {
+            handlers[i].pin = pin;
+            handlers[i].arg = arg;
+            handlers[i].handler = handler;
+            attachInterrupt(irq, trampolines[i], mode);
+            return true;
+        }
+    }
+    return false;
+}
+
+void detachInterruptHandler(uint8_t pin) {
+    for (uint8_t i = 0; i < kMaxInterruptHandlers; ++i) {
+        if (handlers[i].handler != nullptr && handlers[i].pin == pin) {
+            detachInterrupt(digitalPinToInterrupt(pin));
+            handlers[i].handler = nullptr;
+            return;
+        }
+    }
+}
+
 }  // namespace internal
 }  // namespace Canny
@@ -9,6 +9,15 @@ namespace internal {
 // Get the mode from the provided bitrate.
 Mode getMode(Bitrate bitrate);
 
+// Attach a handler to the external interrupt on pin. The handler is called
+// with arg when the interrupt fires. Up to four handlers may be attached.
+//
+// Return false if pin does not support interrupts or all handlers are in use.
+bool attachInterruptHandler(uint8_t pin, int mode, void (*handler)(void*), void* arg);
+
+// Detach the handler attached to pin.
+void detachInterruptHandler(uint8_t pin);
+
 }  // namespace internal
 }  // namespace Canny
 
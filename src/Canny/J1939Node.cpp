@@ -0,0 +1,194 @@
+#include "J1939Node.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+namespace {
+
+// PGNs used for address claim.
+const uint32_t kAddressClaimedPGN = 0xEE00;
+const uint32_t kRequestPGN = 0xEA00;
+
+// Time to wait for contention after claiming an address in milliseconds.
+const uint16_t kClaimTimeout = 250;
+
+// Range of addresses available to self-configurable devices.
+const uint8_t kArbitraryAddressMin = 128;
+const uint8_t kArbitraryAddressMax = 247;
+
+}  // namespace
+
+J1939Node::J1939Node(Connection<J1939Message>* child, uint64_t name,
+        uint8_t preferred_address, size_t devices) :
+    child_(child), name_(name), preferred_(preferred_address),
+    address_(NullAddress), state_(IDLE), pending_(false), timer_(0),
+    devices_(nullptr), devices_size_(devices), devices_len_(0) {
+    if (devices_size_ > 0) {
+        devices_ = new Device[devices_size_];
+    }
+}
+
+J1939Node::~J1939Node() {
+    if (devices_ != nullptr) {
+        delete[] devices_;
+    }
+}
+
+void J1939Node::begin() {
+    address_ = preferred_;
+    state_ = CLAIMING;
+    pending_ = true;
+    flush();
+}
+
+Error J1939Node::read(J1939Message* message) {
+    flush();
+
+    Error err = child_->read(message);
+    if (err != ERR_OK) {
+        return err;
+    }
+    switch (message->pgn()) {
+        case kAddressClaimedPGN:
+            handleClaim(*message);
+            break;
+        case kRequestPGN:
+            handleRequest(*message);
+            break;
+        default:
+            break;
+    }
+    return ERR_OK;
+}
+
+Error J1939Node::write(const J1939Message& message) {
+    if (state_ != CLAIMED) {
+        return ERR_READY;
+    }
+    if (message.source_address() == address_) {
+        return child_->write(message);
+    }
+    J1939Message copy = message;
+    copy.source_address(address_);
+    return child_->write(copy);
+}
+
+void J1939Node::flush() {
+    if (pending_ && sendClaim()) {
+        pending_ = false;
+        if (state_ == CLAIMING) {
+            timer_ = millis();
+        }
+    }
+    if (state_ == CLAIMING && !pending_ && millis() - timer_ >= kClaimTimeout) {
+        state_ = CLAIMED;
+    }
+}
+
+uint8_t J1939Node::device_address(uint64_t name) const {
+    for (size_t i = 0; i < devices_len_; ++i) {
+        if (devices_[i].name == name) {
+            return devices_[i].address;
+        }
+    }
+    return NullAddress;
+}
+
+uint64_t J1939Node::device_name(uint8_t address) const {
+    for (size_t i = 0; i < devices_len_; ++i) {
+        if (devices_[i].address == address) {
+            return devices_[i].name;
+        }
+    }
+    return 0;
+}
+
+void J1939Node::handleClaim(const J1939Message& message) {
+    uint64_t name = message.name();
+    uint8_t sa = message.source_address();
+    if (message.size() < 8 || name == name_) {
+        return;
+    }
+    if (sa != address_ || (state_ != CLAIMING && state_ != CLAIMED)) {
+        record(name, sa);
+        return;
+    }
+    if (name_ < name) {
+        // we have priority, defend the address; the other device does not
+        // hold it
+        pending_ = true;
+        flush();
+    } else {
+        record(name, sa);
+        lose();
+    }
+}
+
+void J1939Node::handleRequest(const J1939Message& message) {
+    uint8_t da = message.dest_address();
+    if (message.size() < 3 || (da != BroadcastAddress && da != address_)) {
+        return;
+    }
+    const uint8_t* data = message.data();
+    uint32_t pgn = data[0] | ((uint32_t)data[1] << 8) | ((uint32_t)data[2] << 16);
+    if (pgn == kAddressClaimedPGN && state_ != IDLE) {
+        pending_ = true;
+        flush();
+    }
+}
+
+void J1939Node::lose() {
+    if (!j1939_name_arbitrary_address(name_)) {
+        address_ = NullAddress;
+        state_ = LOST;
+        pending_ = true;
+        flush();
+        return;
+    }
+
+    // Search the self-configurable range for an address that has not been
+    // claimed, starting after the address that was lost.
+    uint8_t range = kArbitraryAddressMax - kArbitraryAddressMin + 1;
+    uint8_t start = address_ < kArbitraryAddressMin || address_ > kArbitraryAddressMax ?
+        0 : address_ - kArbitraryAddressMin + 1;
+    for (uint8_t i = 0; i < range; ++i) {
+        uint8_t candidate = kArbitraryAddressMin + (start + i) % range;
+        if (device_name(candidate) == 0) {
+            address_ = candidate;
+            state_ = CLAIMING;
+            pending_ = true;
+            flush();
+            return;
+        }
+    }
+
+    address_ = NullAddress;
+    state_ = LOST;
+    pending_ = true;
+    flush();
+}
+
+bool J1939Node::sendClaim() {
+    J1939Message message(kAddressClaimedPGN, address_, BroadcastAddress, 6);
+    message.name(name_);
+    return child_->write(message) == ERR_OK;
+}
+
+void J1939Node::record(uint64_t name, uint8_t address) {
+    size_t i = 0;
+    while (i < devices_len_) {
+        if (devices_[i].name == name || devices_[i].address == address) {
+            devices_[i] = devices_[--devices_len_];
+        } else {
+            ++i;
+        }
+    }
+    if (address == NullAddress || devices_len_ >= devices_size_) {
+        return;
+    }
+    devices_[devices_len_].name = name;
+    devices_[devices_len_].address = address;
+    ++devices_len_;
+}
+
+}  // namespace Canny
@@ -0,0 +1,119 @@
+#ifndef _CANNY_J1939_NODE_H_
+#define _CANNY_J1939_NODE_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Error.h"
+#include "J1939.h"
+
+namespace Canny {
+
+// A J1939 node that claims an address on the bus. The node owns a 64-bit NAME
+// and runs the J1939-81 address claim procedure: it claims its preferred
+// address, answers requests for the Address Claimed PGN, and defends its
+// address against lower priority NAMEs. If the NAME has the arbitrary address
+// bit set then a new address is selected when the claim is lost. Otherwise the
+// node sends a Cannot Claim message and stays offline.
+//
+// The node also records every NAME/address pair claimed on the bus.
+//
+// Address claim is driven entirely from read() and flush() and never blocks.
+// Frames continue to flow through read() while the claim is in progress.
+class J1939Node : public Connection<J1939Message> {
+    public:
+        // Construct a node that communicates over the child connection. The
+        // node will attempt to claim the preferred address when begin() is
+        // called. The device table records up to devices NAME/address pairs.
+        J1939Node(Connection<J1939Message>* child, uint64_t name,
+                uint8_t preferred_address, size_t devices = 32);
+        ~J1939Node();
+
+        // Start claiming an address. Claiming progresses as read() and flush()
+        // are called.
+        void begin();
+
+        // Return the NAME of this node.
+        uint64_t name() const { return name_; }
+
+        // Return the address of this node. This is NullAddress if the node has
+        // not started claiming or could not claim an address.
+        uint8_t address() const { return address_; }
+
+        // Return true once the address has been held for 250ms without
+        // contention. The node may only send messages while this is true.
+        bool claimed() const { return state_ == CLAIMED; }
+
+        // Read a message from the child connection. Address claims and
+        // requests for the Address Claimed PGN are processed before being
+        // returned to the caller. Pending claims are serviced on each call.
+        //
+        // Return ERR_OK if a message was read or ERR_FIFO if the child has no
+        // more messages to read.
+        Error read(J1939Message* message) override;
+
+        // Write a message to the child connection. The source address of the
+        // message is set to the node's address.
+        //
+        // Return ERR_READY if the node has not claimed an address. Otherwise
+        // return the result of the child write.
+        Error write(const J1939Message& message) override;
+
+        // Service pending claims without reading from the child.
+        void flush();
+
+        // Return the address claimed by the device with the given NAME.
+        // Return NullAddress if the device is not known.
+        uint8_t device_address(uint64_t name) const;
+
+        // Return the NAME of the device that claimed the given address. Return
+        // 0 if no device has claimed the address.
+        uint64_t device_name(uint8_t address) const;
+
+        // Return the number of devices in the device table.
+        size_t devices() const { return devices_len_; }
+
+    private:
+        enum State : uint8_t {
+            IDLE,       // Not started.
+            CLAIMING,   // Claim sent, waiting for contention.
+            CLAIMED,    // Address claimed.
+            LOST,       // Unable to claim an address.
+        };
+
+        struct Device {
+            uint64_t name;
+            uint8_t address;
+        };
+
+        // Process an address claim from another device.
+        void handleClaim(const J1939Message& message);
+
+        // Process a request PGN.
+        void handleRequest(const J1939Message& message);
+
+        // Give up the current address to a higher priority device.
+        void lose();
+
+        // Send the Address Claimed message for this node's address.
+        bool sendClaim();
+
+        // Record a device in the device table. Remove the device if address is
+        // NullAddress.
+        void record(uint64_t name, uint8_t address);
+
+        Connection<J1939Message>* child_;
+        uint64_t name_;
+        uint8_t preferred_;
+        uint8_t address_;
+        State state_;
+        bool pending_;
+        uint32_t timer_;
+
+        Device* devices_;
+        size_t devices_size_;
+        size_t devices_len_;
+};
+
+}  // namespace Canny
+
+#endif  // _CANNY_J1939_NODE_H_
@@ -0,0 +1,538 @@
+#include "J1939Transport.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+namespace {
+
+// Transport protocol PGNs.
+const uint32_t kConnectionManagementPGN = 0xEC00;
+const uint32_t kDataTransferPGN = 0xEB00;
+
+// Connection management control bytes.
+const uint8_t kControlRTS = 16;
+const uint8_t kControlCTS = 17;
+const uint8_t kControlEOMA = 19;
+const uint8_t kControlBAM = 32;
+const uint8_t kControlAbort = 255;
+
+// Session timers from J1939-21 in milliseconds.
+const uint16_t kTimeoutT1 = 750;    // Receiver waiting for the next packet.
+const uint16_t kTimeoutT2 = 1250;   // Receiver waiting for data after a CTS.
+const uint16_t kTimeoutT3 = 1250;   // Sender waiting for a CTS or EOMA.
+const uint16_t kTimeoutT4 = 1050;   // Sender waiting after a hold CTS.
+const uint16_t kBAMInterval = 50;   // Delay between BAM data packets.
+
+// Number of data bytes carried by each TP.DT packet.
+const uint8_t kPacketSize = 7;
+
+uint32_t decodePGN(const uint8_t* data) {
+    return data[5] | ((uint32_t)data[6] << 8) | ((uint32_t)data[7] << 16);
+}
+
+void encodePGN(uint8_t* data, uint32_t pgn) {
+    data[5] = pgn & 0xFF;
+    data[6] = (pgn >> 8) & 0xFF;
+    data[7] = (pgn >> 16) & 0xFF;
+}
+
+uint16_t packetCount(uint16_t size) {
+    return (size + kPacketSize - 1) / kPacketSize;
+}
+
+}  // namespace
+
+J1939Transport::J1939Transport(Connection<J1939Message>* child, size_t sessions, uint16_t max_size) :
+        child_(child), sessions_(nullptr), buffer_(nullptr), count_(sessions),
+        max_size_(max_size > J1939TransportMaxSize ? J1939TransportMaxSize : max_size),
+        address_(NullAddress) {
+    if (count_ > 0) {
+        sessions_ = new Session[count_];
+        buffer_ = new uint8_t[count_ * max_size_];
+    }
+    for (size_t i = 0; i < count_; ++i) {
+        sessions_[i].data_ = buffer_ + i * max_size_;
+        reset(sessions_ + i);
+    }
+}
+
+J1939Transport::~J1939Transport() {
+    if (sessions_ != nullptr) {
+        delete[] sessions_;
+    }
+    if (buffer_ != nullptr) {
+        delete[] buffer_;
+    }
+}
+
+Error J1939Transport::read(J1939Message* message) {
+    flush();
+
+    Error err;
+    while ((err = child_->read(message)) == ERR_OK) {
+        switch (message->pgn()) {
+            case kConnectionManagementPGN:
+                handleCM(*message);
+                break;
+            case kDataTransferPGN:
+                handleDT(*message);
+                break;
+            default:
+                return ERR_OK;
+        }
+    }
+    return err;
+}
+
+Error J1939Transport::write(const J1939Message& message) {
+    return child_->write(message);
+}
+
+Error J1939Transport::receive(J1939TransportMessage** message) {
+    for (size_t i = 0; i < count_; ++i) {
+        if (sessions_[i].state == RX_COMPLETE) {
+            sessions_[i].state = RX_DELIVERED;
+            *message = sessions_ + i;
+            return ERR_OK;
+        }
+    }
+    return ERR_FIFO;
+}
+
+void J1939Transport::release(J1939TransportMessage* message) {
+    for (size_t i = 0; i < count_; ++i) {
+        if (message == sessions_ + i) {
+            reset(sessions_ + i);
+            return;
+        }
+    }
+}
+
+Error J1939Transport::send(uint32_t pgn, uint8_t da, const uint8_t* data, uint16_t size, uint8_t priority) {
+    if (size <= 8) {
+        J1939Message message(pgn, address_, da, priority);
+        message.data(data, size);
+        return child_->write(message);
+    }
+    if (size > max_size_ || (da != BroadcastAddress && address_ == NullAddress)) {
+        return ERR_INVALID;
+    }
+    if (find(false, address_, da) != nullptr) {
+        // only one session is allowed per destination
+        return ERR_FIFO;
+    }
+
+    Session* session = alloc();
+    if (session == nullptr) {
+        return ERR_FIFO;
+    }
+    session->pgn_ = pgn;
+    session->priority_ = priority & 0x07;
+    session->sa_ = address_;
+    session->da_ = da;
+    session->size_ = size;
+    memcpy(session->data_, data, size);
+    session->packets = packetCount(size);
+    session->next = 1;
+    session->end = session->packets;
+    session->state = (da == BroadcastAddress) ? TX_BAM : TX_CTS;
+    session->pending = true;
+    session->timer = millis();
+    session->timeout = kTimeoutT3;
+    service(session, session->timer);
+    return ERR_OK;
+}
+
+void J1939Transport::flush() {
+    uint32_t now = millis();
+    for (size_t i = 0; i < count_; ++i) {
+        if (sessions_[i].state != IDLE) {
+            service(sessions_ + i, now);
+        }
+    }
+}
+
+bool J1939Transport::sending() const {
+    for (size_t i = 0; i < count_; ++i) {
+        if (sessions_[i].state >= TX_BAM) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void J1939Transport::handleCM(const J1939Message& message) {
+    if (message.size() < 8) {
+        return;
+    }
+    switch (message.data()[0]) {
+        case kControlRTS:
+            handleRTS(message);
+            break;
+        case kControlCTS:
+            handleCTS(message);
+            break;
+        case kControlEOMA:
+            handleEOMA(message);
+            break;
+        case kControlBAM:
+            handleBAM(message);
+            break;
+        case kControlAbort:
+            handleAbort(message);
+            break;
+        default:
+            break;
+    }
+}
+
+void J1939Transport::handleDT(const J1939Message& message) {
+    uint8_t da = message.dest_address();
+    if (message.size() < 2 || (da != address_ && da != BroadcastAddress)) {
+        return;
+    }
+    Session* session = find(true, message.source_address(), da);
+    if (session == nullptr) {
+        return;
+    }
+
+    uint8_t seq = message.data()[0];
+    if (seq < session->next) {
+        // duplicate packet
+        return;
+    }
+    if (seq != session->next || seq > session->end) {
+        abort(session, J1939_ABORT_SEQUENCE, true);
+        return;
+    }
+
+    uint16_t offset = (seq - 1) * kPacketSize;
+    uint16_t len = session->size_ - offset;
+    if (len > kPacketSize) {
+        len = kPacketSize;
+    }
+    if (len > message.size() - 1) {
+        len = message.size() - 1;
+    }
+    memcpy(session->data_ + offset, message.data() + 1, len);
+
+    session->next++;
+    session->timer = millis();
+    session->timeout = kTimeoutT1;
+    if (session->next > session->packets) {
+        complete(session);
+    } else if (session->next > session->end) {
+        // window received, request more packets
+        session->pending = true;
+        service(session, session->timer);
+    }
+}
+
+void J1939Transport::handleBAM(const J1939Message& message) {
+    if (message.dest_address() != BroadcastAddress) {
+        return;
+    }
+    const uint8_t* data = message.data();
+    uint16_t size = data[1] | (data[2] << 8);
+    if (size <= 8 || size > max_size_ || data[3] != packetCount(size)) {
+        return;
+    }
+
+    Session* session = find(true, message.source_address(), BroadcastAddress);
+    if (session == nullptr) {
+        session = alloc();
+        if (session == nullptr) {
+            return;
+        }
+    }
+    session->pgn_ = decodePGN(data);
+    session->priority_ = message.priority();
+    session->sa_ = message.source_address();
+    session->da_ = BroadcastAddress;
+    session->size_ = size;
+    session->packets = data[3];
+    session->next = 1;
+    session->end = session->packets;
+    session->state = RX_BAM;
+    session->pending = false;
+    session->timer = millis();
+    session->timeout = kTimeoutT1;
+}
+
+void J1939Transport::handleRTS(const J1939Message& message) {
+    if (address_ == NullAddress || message.dest_address() != address_) {
+        return;
+    }
+    const uint8_t* data = message.data();
+    uint32_t pgn = decodePGN(data);
+    uint8_t sa = message.source_address();
+    uint16_t size = data[1] | (data[2] << 8);
+    if (size <= 8 || size > max_size_ || data[3] != packetCount(size)) {
+        sendAbort(pgn, sa, J1939_ABORT_RESOURCES);
+        return;
+    }
+
+    Session* session = find(true, sa, address_);
+    if (session == nullptr) {
+        session = alloc();
+        if (session == nullptr) {
+            sendAbort(pgn, sa, J1939_ABORT_BUSY);
+            return;
+        }
+    }
+    session->pgn_ = pgn;
+    session->priority_ = message.priority();
+    session->sa_ = sa;
+    session->da_ = address_;
+    session->size_ = size;
+    session->packets = data[3];
+    session->window = data[4] == 0 ? 0xFF : data[4];
+    session->next = 1;
+    session->end = 0;
+    session->state = RX_DATA;
+    session->pending = true;
+    session->timer = millis();
+    session->timeout = kTimeoutT2;
+    service(session, session->timer);
+}
+
+void J1939Transport::handleCTS(const J1939Message& message) {
+    if (message.dest_address() != address_) {
+        return;
+    }
+    const uint8_t* data = message.data();
+    Session* session = find(false, address_, message.source_address());
+    if (session == nullptr || session->pgn_ != decodePGN(data) || session->pending) {
+        return;
+    }
+    if (session->state == TX_DATA) {
+        abort(session, J1939_ABORT_CTS, true);
+        return;
+    }
+
+    session->timer = millis();
+    uint8_t count = data[1];
+    uint8_t next = data[2];
+    if (count == 0) {
+        // hold the connection open
+        session->state = TX_CTS;
+        session->timeout = kTimeoutT4;
+        return;
+    }
+    if (next == 0 || next > session->packets) {
+        abort(session, J1939_ABORT_SEQUENCE, true);
+        return;
+    }
+    session->next = next;
+    session->end = next + count - 1;
+    if (session->end > session->packets) {
+        session->end = session->packets;
+    }
+    session->state = TX_DATA;
+    service(session, session->timer);
+}
+
+void J1939Transport::handleEOMA(const J1939Message& message) {
+    if (message.dest_address() != address_) {
+        return;
+    }
+    Session* session = find(false, address_, message.source_address());
+    if (session != nullptr && session->pgn_ == decodePGN(message.data()) &&
+            (session->state == TX_EOMA || session->state == TX_CTS)) {
+        reset(session);
+    }
+}
+
+void J1939Transport::handleAbort(const J1939Message& message) {
+    if (message.dest_address() != address_) {
+        return;
+    }
+    uint32_t pgn = decodePGN(message.data());
+    uint8_t sa = message.source_address();
+    Session* session = find(false, address_, sa);
+    if (session == nullptr || session->pgn_ != pgn) {
+        session = find(true, sa, address_);
+    }
+    if (session != nullptr && session->pgn_ == pgn) {
+        abort(session, message.data()[1], false);
+    }
+}
+
+void J1939Transport::service(Session* session, uint32_t now) {
+    switch (session->state) {
+        case RX_BAM:
+            if (now - session->timer >= session->timeout) {
+                abort(session, J1939_ABORT_TIMEOUT, false);
+            }
+            break;
+        case RX_DATA:
+            if (session->pending) {
+                if (sendCTS(session)) {
+                    session->pending = false;
+                    session->timer = now;
+                    session->timeout = kTimeoutT2;
+                }
+            } else if (now - session->timer >= session->timeout) {
+                abort(session, J1939_ABORT_TIMEOUT, true);
+            }
+            break;
+        case RX_COMPLETE:
+        case RX_DELIVERED:
+            if (session->pending && sendCM(session, kControlEOMA)) {
+                session->pending = false;
+            }
+            break;
+        case TX_BAM:
+            if (session->pending) {
+                if (sendCM(session, kControlBAM)) {
+                    session->pending = false;
+                    session->timer = now;
+                }
+            } else if (now - session->timer >= kBAMInterval && sendDT(session)) {
+                session->timer = now;
+                if (session->next > session->packets) {
+                    reset(session);
+                }
+            }
+            break;
+        case TX_CTS:
+            if (session->pending) {
+                if (sendCM(session, kControlRTS)) {
+                    session->pending = false;
+                    session->timer = now;
+                    session->timeout = kTimeoutT3;
+                }
+            } else if (now - session->timer >= session->timeout) {
+                abort(session, J1939_ABORT_TIMEOUT, true);
+            }
+            break;
+        case TX_DATA:
+            while (session->next <= session->end && sendDT(session)) {}
+            if (session->next > session->end) {
+                session->state = session->end >= session->packets ? TX_EOMA : TX_CTS;
+                session->timer = now;
+                session->timeout = kTimeoutT3;
+            }
+            break;
+        case TX_EOMA:
+            if (now - session->timer >= session->timeout) {
+                abort(session, J1939_ABORT_TIMEOUT, true);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+bool J1939Transport::sendDT(Session* session) {
+    J1939Message message(kDataTransferPGN, address_, session->da_, session->priority_);
+    message.resize(8);
+
+    uint16_t offset = (session->next - 1) * kPacketSize;
+    uint16_t len = session->size_ - offset;
+    if (len > kPacketSize) {
+        len = kPacketSize;
+    }
+    message.data()[0] = session->next;
+    memcpy(message.data() + 1, session->data_ + offset, len);
+    if (child_->write(message) != ERR_OK) {
+        return false;
+    }
+    session->next++;
+    return true;
+}
+
+bool J1939Transport::sendCTS(Session* session) {
+    uint16_t count = session->packets - session->next + 1;
+    if (count > session->window) {
+        count = session->window;
+    }
+    J1939Message message(kConnectionManagementPGN, address_, session->sa_, session->priority_);
+    message.resize(8);
+    uint8_t* data = message.data();
+    data[0] = kControlCTS;
+    data[1] = count;
+    data[2] = session->next;
+    encodePGN(data, session->pgn_);
+    if (child_->write(message) != ERR_OK) {
+        return false;
+    }
+    session->end = session->next + count - 1;
+    return true;
+}
+
+bool J1939Transport::sendCM(Session* session, uint8_t control) {
+    J1939Message message(kConnectionManagementPGN, address_, peer(session), session->priority_);
+    message.resize(8);
+    uint8_t* data = message.data();
+    data[0] = control;
+    data[1] = session->size_ & 0xFF;
+    data[2] = session->size_ >> 8;
+    data[3] = session->packets;
+    encodePGN(data, session->pgn_);
+    return child_->write(message) == ERR_OK;
+}
+
+bool J1939Transport::sendAbort(uint32_t pgn, uint8_t da, uint8_t reason) {
+    J1939Message message(kConnectionManagementPGN, address_, da);
+    message.resize(8);
+    uint8_t* data = message.data();
+    data[0] = kControlAbort;
+    data[1] = reason;
+    encodePGN(data, pgn);
+    return child_->write(message) == ERR_OK;
+}
+
+void J1939Transport::complete(Session* session) {
+    session->state = RX_COMPLETE;
+    session->pending = !session->broadcast();
+    service(session, session->timer);
+}
+
+J1939Transport::Session* J1939Transport::find(bool rx, uint8_t sa, uint8_t da) {
+    for (size_t i = 0; i < count_; ++i) {
+        Session* session = sessions_ + i;
+        bool active = rx ?
+            (session->state == RX_BAM || session->state == RX_DATA) :
+            (session->state >= TX_BAM);
+        if (active && session->sa_ == sa && session->da_ == da) {
+            return session;
+        }
+    }
+    return nullptr;
+}
+
+uint8_t J1939Transport::peer(const Session* session) const {
+    return session->state >= TX_BAM ? session->da_ : session->sa_;
+}
+
+J1939Transport::Session* J1939Transport::alloc() {
+    for (size_t i = 0; i < count_; ++i) {
+        if (sessions_[i].state == IDLE) {
+            return sessions_ + i;
+        }
+    }
+    return nullptr;
+}
+
+void J1939Transport::abort(Session* session, uint8_t reason, bool send) {
+    if (send && !session->broadcast()) {
+        sendAbort(session->pgn_, peer(session), reason);
+    }
+    onAbort(*session, reason);
+    reset(session);
+}
+
+void J1939Transport::reset(Session* session) {
+    session->state = IDLE;
+    session->pending = false;
+    session->packets = 0;
+    session->window = 0xFF;
+    session->next = 0;
+    session->end = 0;
+    session->timeout = 0;
+    session->timer = 0;
+    session->size_ = 0;
+}
+
+}  // namespace Canny
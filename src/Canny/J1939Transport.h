@@ -0,0 +1,201 @@
+#ifndef _CANNY_J1939_TRANSPORT_H_
+#define _CANNY_J1939_TRANSPORT_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Error.h"
+#include "J1939.h"
+
+namespace Canny {
+
+// The maximum payload size of a message sent with the J1939 transport
+// protocol. This is 255 packets of 7 bytes each.
+const uint16_t J1939TransportMaxSize = 1785;
+
+// Abort reasons sent in a TP.CM_Abort message.
+enum J1939AbortReason : uint8_t {
+    J1939_ABORT_BUSY = 1,       // Already in a session with the peer.
+    J1939_ABORT_RESOURCES = 2,  // Out of session buffers or message too large.
+    J1939_ABORT_TIMEOUT = 3,    // The peer did not respond in time.
+    J1939_ABORT_CTS = 4,        // CTS received while transferring data.
+    J1939_ABORT_SEQUENCE = 7,   // Bad sequence number received.
+};
+
+// A J1939 message whose payload is sent over the transport protocol. The
+// payload is stored in a buffer owned by the transport's session pool.
+class J1939TransportMessage {
+    public:
+        // Return the PGN of the message.
+        uint32_t pgn() const { return pgn_; }
+
+        // Return the Priority of the message.
+        uint8_t priority() const { return priority_; }
+
+        // Return the address of the node that sent the message.
+        uint8_t source_address() const { return sa_; }
+
+        // Return the address of the node the message was sent to. This is
+        // BroadcastAddress for messages sent with BAM.
+        uint8_t dest_address() const { return da_; }
+
+        // Return true if the message was broadcast with BAM.
+        bool broadcast() const { return da_ == BroadcastAddress; }
+
+        // Return the size of the payload in bytes.
+        uint16_t size() const { return size_; }
+
+        // Return a pointer to the payload. The data is exactly size() bytes
+        // long.
+        uint8_t* data() const { return data_; }
+
+    protected:
+        J1939TransportMessage() : pgn_(0), priority_(7), sa_(NullAddress),
+            da_(NullAddress), size_(0), data_(nullptr) {}
+
+        uint32_t pgn_;
+        uint8_t priority_;
+        uint8_t sa_;
+        uint8_t da_;
+        uint16_t size_;
+        uint8_t* data_;
+};
+
+// Implements the J1939 transport protocol (TP.CM and TP.DT) over a J1939
+// connection. Messages larger than 8 bytes are sent and received using BAM
+// for broadcast messages and RTS/CTS for destination specific messages.
+//
+// Sessions are allocated from a fixed pool of preallocated buffers so that
+// concurrent transfers from different nodes never allocate at runtime. A
+// received message is handed to the caller in place and its session is
+// returned to the pool on release().
+//
+// Timers follow J1939-21 and are measured with millis(). The transport must
+// be serviced from loop() by calling read() until it returns ERR_FIFO.
+class J1939Transport : public Connection<J1939Message> {
+    public:
+        // Construct a transport over the child connection. The pool is
+        // allocated with room for the given number of concurrent sessions,
+        // each of which may hold up to max_size bytes.
+        J1939Transport(Connection<J1939Message>* child, size_t sessions = 4,
+                uint16_t max_size = J1939TransportMaxSize);
+        ~J1939Transport();
+
+        // Return the address of this node.
+        uint8_t address() const { return address_; }
+
+        // Set the address of this node. Connection mode transfers are only
+        // accepted for this address and are sent from it. Only BAM messages
+        // are received while the address is NullAddress.
+        void address(uint8_t address) { address_ = address; }
+
+        // Read a single frame message from the child connection. Transport
+        // protocol frames are consumed and processed until a frame that is
+        // not part of the transport protocol is read. Outgoing sessions and
+        // session timeouts are serviced on each call.
+        //
+        // Return ERR_OK if a message was read or ERR_FIFO if the child has no
+        // more frames to read. Completed transport messages are retrieved
+        // with receive().
+        Error read(J1939Message* message) override;
+
+        // Write a single frame message to the child connection.
+        Error write(const J1939Message& message) override;
+
+        // Retrieve a completed transport message. The message remains owned
+        // by the transport and must be passed to release() once the caller
+        // is done with it.
+        //
+        // Return ERR_OK if a message is available or ERR_FIFO if none are.
+        Error receive(J1939TransportMessage** message);
+
+        // Return a received message's session to the pool.
+        void release(J1939TransportMessage* message);
+
+        // Send a message to the given destination. Messages of 8 bytes or
+        // fewer are written directly. Larger messages are copied into a
+        // session buffer and sent with BAM if the destination is the
+        // BroadcastAddress or with RTS/CTS otherwise. Transmission proceeds
+        // as read() and flush() are called.
+        //
+        // Return ERR_OK if the message was written or a session was started.
+        // Return ERR_FIFO if no session is available. Return ERR_INVALID if
+        // the message is too large or if a connection mode transfer is
+        // requested while the address is NullAddress.
+        Error send(uint32_t pgn, uint8_t da, const uint8_t* data, uint16_t size,
+                uint8_t priority = 0x07);
+
+        // Service outgoing sessions and session timeouts without reading
+        // from the child.
+        void flush();
+
+        // Return true if an outgoing session is in progress.
+        bool sending() const;
+
+        // Called when a session is aborted or times out. The message is
+        // incomplete and is released after this returns.
+        virtual void onAbort(const J1939TransportMessage&, uint8_t) const {}
+
+    private:
+        enum State : uint8_t {
+            IDLE,
+            RX_BAM,         // Receiving BAM data packets.
+            RX_DATA,        // Receiving RTS/CTS data packets.
+            RX_COMPLETE,    // Received message waiting for the caller.
+            RX_DELIVERED,   // Received message handed to the caller.
+            TX_BAM,         // Sending BAM data packets.
+            TX_CTS,         // Waiting for a CTS.
+            TX_DATA,        // Sending data packets allowed by a CTS.
+            TX_EOMA,        // Waiting for the end of message ack.
+        };
+
+        class Session : public J1939TransportMessage {
+            public:
+                State state;
+                uint8_t packets;    // Total packets in the message.
+                uint8_t window;     // Max packets per CTS.
+                uint16_t next;      // Next sequence number to send or receive.
+                uint16_t end;       // Last sequence number in the CTS window.
+                bool pending;       // A control message is waiting to be sent.
+                uint16_t timeout;   // Time allowed since the last event.
+                uint32_t timer;     // Time of the last session event.
+
+                friend class J1939Transport;
+        };
+
+        // Process a transport protocol frame.
+        void handleCM(const J1939Message& message);
+        void handleDT(const J1939Message& message);
+        void handleBAM(const J1939Message& message);
+        void handleRTS(const J1939Message& message);
+        void handleCTS(const J1939Message& message);
+        void handleEOMA(const J1939Message& message);
+        void handleAbort(const J1939Message& message);
+
+        // Service a single session.
+        void service(Session* session, uint32_t now);
+        bool sendDT(Session* session);
+        bool sendCTS(Session* session);
+        bool sendCM(Session* session, uint8_t control);
+        bool sendAbort(uint32_t pgn, uint8_t da, uint8_t reason);
+        void complete(Session* session);
+
+        // Find a session by state direction and address pair.
+        Session* find(bool rx, uint8_t sa, uint8_t da);
+        Session* alloc();
+
+        // Return the address of the remote node in a session.
+        uint8_t peer(const Session* session) const;
+        void abort(Session* session, uint8_t reason, bool send);
+        void reset(Session* session);
+
+        Connection<J1939Message>* child_;
+        Session* sessions_;
+        uint8_t* buffer_;
+        size_t count_;
+        uint16_t max_size_;
+        uint8_t address_;
+};
+
+}  // namespace Canny
+
+#endif  // _CANNY_J1939_TRANSPORT_H_
@@ -5,23 +5,32 @@
 // https://github.com/bluedragonx/ArduinoMCP2515
 
 #include <mcp_can.h>
+#include "Acceptance.h"
 #include "Controller.h"
+#include "Filter.h"
+#include "Ring.h"
 
 namespace Canny {
 
 // CAN implementation for MCP2515 controller.
+//
+// TimestampedFrame frames are stamped with micros() before they are read from
+// the controller. In interrupt mode this is the time of the interrupt.
 template <typename FrameType>
 class MCP2515 : public Controller<FrameType> {
     public:
         // Construct a new MCP2515 CAN object that uses the given CS pin.
-        MCP2515(uint8_t cs_pin) : mcp_(cs_pin), ready_(false) {}
-        ~MCP2515() override = default;
+        MCP2515(uint8_t cs_pin) : mcp_(cs_pin), ready_(false), rx_(nullptr), int_pin_(0),
+                filter_(nullptr) {}
+        ~MCP2515() override;
 
         bool begin(Bitrate bitrate) override;
         Mode mode() const override;
         Bitrate bitrate() const override;
         Error read(FrameType* frame) override;
         Error write(const FrameType& frame) override;
+        Error readMany(FrameType* frames, size_t max, size_t* n) override;
+        Error writeMany(const FrameType* frames, size_t count, size_t* n) override;
 
         // Set a mask on the controller. The MCP2515 has two masks. Mask 0
         // applies to filters 0-1. Mask 1 applies to filters 2-5. Filtering is
@@ -34,10 +43,51 @@ class MCP2515 : public Controller<FrameType> {
 
         // Clear masks and filters so that all frames are read.
         void disableFilters();
+
+        // Program the masks and filters to accept the frames allowed by
+        // filter. When the masks and filters accept frames that filter does
+        // not, the controller keeps the filter and drops those frames as they
+        // are read. The filter is not owned by the controller and must outlive
+        // it or be replaced. Set to nullptr to read all frames.
+        //
+        // Return true if hardware filtering was enabled. Filtering is disabled
+        // if filter may allow any frame.
+        bool setFilters(FrameIDFilter* filter);
+
+        // Receive frames in an interrupt handler. The controller's INT pin
+        // must be connected to int_pin. When the interrupt fires the
+        // controller's receive buffers are drained into a ring of capacity
+        // frames and read() returns frames from the ring. This prevents the
+        // receive buffers from overflowing when loop() is slow. Call after
+        // begin().
+        //
+        // Return false if int_pin does not support interrupts.
+        bool enableInterrupt(uint8_t int_pin, uint8_t capacity = 32);
+
+        // Stop receiving frames in an interrupt handler. Frames remaining in
+        // the ring are discarded.
+        void disableInterrupt();
+
+        // Move frames from the controller into the receive ring. This is
+        // called by the interrupt handler.
+        void drain();
+
+        // Return the number of frames discarded because the receive ring was
+        // full.
+        uint32_t dropped() const { return rx_ == nullptr ? 0 : rx_->dropped(); }
     private:
+        // Read a frame directly from the controller. Frames rejected by the
+        // software filter are skipped.
+        Error receive(FrameType* frame);
+
+        static void handleInterrupt(void* arg);
+
         MCP_CAN mcp_;
         bool ready_;
         Bitrate bitrate_;
+        FrameRing<FrameType>* rx_;
+        uint8_t int_pin_;
+        FrameIDFilter* filter_;
 };
 
 }  // namespace Canny
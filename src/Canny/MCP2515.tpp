@@ -2,6 +2,9 @@
 // it's used. This is done for efficiency as a board will only have one or two
 // different CAN controllers.
 
+#include <SPI.h>
+#include "Internal.h"
+
 namespace Canny {
 namespace {
 
@@ -57,6 +60,11 @@ uint8_t GetMCP2515Bitrate(Bitrate bitrate) {
 
 }  // namespace
 
+template <typename FrameType>
+MCP2515<FrameType>::~MCP2515() {
+    disableInterrupt();
+}
+
 template <typename FrameType>
 bool MCP2515<FrameType>::begin(Bitrate bitrate) {
     bitrate_ = FixMCP2515Bitrate(bitrate);
@@ -76,22 +84,67 @@ Bitrate MCP2515<FrameType>::bitrate() const {
 
 template <typename FrameType>
 Error MCP2515<FrameType>::read(FrameType* frame) {
+    if (rx_ == nullptr) {
+        return receive(frame);
+    }
     if (!ready_) {
         return ERR_READY;
     }
-
-    switch (mcp_.readMsgBufID(frame->mutable_id(), frame->mutable_size(), frame->data())) {
-        case CAN_OK:
-            break;
-        case CAN_NOMSG:
-            return ERR_FIFO;
-        default:
-            return ERR_INTERNAL;
+    FrameType* next = rx_->front();
+    if (next == nullptr) {
+        return ERR_FIFO;
     }
-    frame->ext(mcp_.isExtendedFrame());
+    *frame = *next;
+    rx_->pop();
     return ERR_OK;
 }
 
+template <typename FrameType>
+Error MCP2515<FrameType>::readMany(FrameType* frames, size_t max, size_t* n) {
+    *n = 0;
+    if (!ready_) {
+        return ERR_READY;
+    }
+
+    Error err = ERR_FIFO;
+    if (rx_ == nullptr) {
+        // Drain the controller's receive buffers directly.
+        while (*n < max && (err = receive(frames + *n)) == ERR_OK) {
+            ++*n;
+        }
+    } else {
+        FrameType* next;
+        while (*n < max && (next = rx_->front()) != nullptr) {
+            frames[(*n)++] = *next;
+            rx_->pop();
+        }
+    }
+    return *n > 0 ? ERR_OK : err;
+}
+
+template <typename FrameType>
+Error MCP2515<FrameType>::receive(FrameType* frame) {
+    if (!ready_) {
+        return ERR_READY;
+    }
+
+    while (true) {
+        stampFrame(frame);
+        switch (mcp_.readMsgBufID(frame->mutable_id(), frame->mutable_size(), frame->data())) {
+            case CAN_OK:
+                break;
+            case CAN_NOMSG:
+                return ERR_FIFO;
+            default:
+                return ERR_INTERNAL;
+        }
+        frame->ext(mcp_.isExtendedFrame());
+        if (filter_ == nullptr || filter_->match(*frame)) {
+            return ERR_OK;
+        }
+    }
+}
+
 template <typename FrameType>
 Error MCP2515<FrameType>::write(const FrameType& frame) {
     if (!ready_) {
@@ -112,6 +165,32 @@ Error MCP2515<FrameType>::write(const FrameType& frame) {
     }
 }
 
+template <typename FrameType>
+Error MCP2515<FrameType>::writeMany(const FrameType* frames, size_t count, size_t* n) {
+    *n = 0;
+    if (!ready_) {
+        return ERR_READY;
+    }
+
+    // Fill the transmit buffers until the controller runs out of space.
+    for (; *n < count; ++*n) {
+        const FrameType& frame = frames[*n];
+        if (frame.data() == nullptr || frame.size() > 8) {
+            return ERR_INVALID;
+        }
+        switch(mcp_.sendMsgBuf(frame.id(), frame.ext(), frame.size(), frame.data())) {
+            case CAN_OK:
+                break;
+            case CAN_GETTXBFTIMEOUT:
+            case CAN_SENDMSGTIMEOUT:
+                return ERR_FIFO;
+            default:
+                return ERR_INTERNAL;
+        }
+    }
+    return ERR_OK;
+}
+
 template <typename FrameType>
 void MCP2515<FrameType>::setMask(uint8_t num, uint8_t ext, uint32_t mask) {
     mcp_.init_Mask(num, ext, mask);
@@ -122,6 +201,96 @@ void MCP2515<FrameType>::setFilter(uint8_t num, uint8_t ext, uint32_t filter) {
     mcp_.init_Filt(num, ext, filter);
 }
 
+template <typename FrameType>
+bool MCP2515<FrameType>::setFilters(FrameIDFilter* filter) {
+    static const uint8_t groups[] = {2, 4};
+    AcceptanceFilter masks[2];
+    AcceptanceFilter filters[6];
+
+    AcceptancePlanner planner;
+    bool enabled = false;
+    if (filter != nullptr) {
+        planner.accept(*filter);
+        filter->compile();
+        enabled = planner.plan(groups, 2, masks, filters);
+    }
+    if (enabled) {
+        for (uint8_t i = 0; i < 2; ++i) {
+            setMask(i, masks[i].ext, masks[i].mask);
+        }
+        for (uint8_t i = 0; i < 6; ++i) {
+            setFilter(i, filters[i].ext, filters[i].id);
+        }
+    } else {
+        disableFilters();
+    }
+
+    // Keep the filter to drop frames the hardware accepts but the filter does
+    // not.
+    noInterrupts();
+    filter_ = enabled && planner.exact() ? nullptr : filter;
+    interrupts();
+    return enabled;
+}
+
+template <typename FrameType>
+bool MCP2515<FrameType>::enableInterrupt(uint8_t int_pin, uint8_t capacity) {
+    disableInterrupt();
+    rx_ = new FrameRing<FrameType>(capacity);
+    int_pin_ = int_pin;
+    pinMode(int_pin_, INPUT_PULLUP);
+    if (!internal::attachInterruptHandler(int_pin_, FALLING, handleInterrupt, this)) {
+        delete rx_;
+        rx_ = nullptr;
+        return false;
+    }
+    // Keep SPI transactions in loop() from being interrupted by the handler.
+    SPI.usingInterrupt(digitalPinToInterrupt(int_pin_));
+
+    // Frames received before the interrupt was attached hold INT low and
+    // would prevent the falling edge.
+    noInterrupts();
+    drain();
+    interrupts();
+    return true;
+}
+
+template <typename FrameType>
+void MCP2515<FrameType>::disableInterrupt() {
+    if (rx_ == nullptr) {
+        return;
+    }
+    internal::detachInterruptHandler(int_pin_);
+    delete rx_;
+    rx_ = nullptr;
+}
+
+template <typename FrameType>
+void MCP2515<FrameType>::drain() {
+    if (rx_ == nullptr || !ready_) {
+        return;
+    }
+    // Read until the controller is empty so that INT is released. Frames that
+    // do not fit in the ring are discarded.
+    FrameType overflow;
+    while (true) {
+        FrameType* slot = rx_->back();
+        if (receive(slot == nullptr ? &overflow : slot) != ERR_OK) {
+            return;
+        }
+        if (slot == nullptr) {
+            rx_->drop();
+        } else {
+            rx_->push();
+        }
+    }
+}
+
+template <typename FrameType>
+void MCP2515<FrameType>::handleInterrupt(void* arg) {
+    ((MCP2515<FrameType>*)arg)->drain();
+}
+
 template <typename FrameType>
 void MCP2515<FrameType>::disableFilters() {
     for (uint8_t i = 0; i < 2; ++i) {
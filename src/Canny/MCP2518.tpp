@@ -2,6 +2,7 @@
 // it's used. This is done for efficiency as a board will only have one or two
 // different CAN controllers.
 
+#include <SPI.h>
 #include "Internal.h"
 
 namespace Canny {
@@ -67,6 +68,11 @@ uint32_t GetMCP2518Bitrate(Bitrate bitrate) {
 
 }  // namespace
 
+template <typename FrameType>
+MCP2518<FrameType>::~MCP2518() {
+    disableInterrupt();
+}
+
 template <typename FrameType>
 bool MCP2518<FrameType>::begin(Bitrate bitrate) {
     bitrate_ = bitrate;
@@ -91,21 +97,66 @@ Bitrate MCP2518<FrameType>::bitrate() const {
 
 template <typename FrameType>
 Error MCP2518<FrameType>::read(FrameType* frame) {
+    if (rx_ == nullptr) {
+        return receive(frame);
+    }
     if (!ready_) {
         return ERR_READY;
     }
-
-    if (mcp_.checkReceive() != CAN_MSGAVAIL) {
+    FrameType* next = rx_->front();
+    if (next == nullptr) {
         return ERR_FIFO;
     }
-    if (mcp_.readMsgBuf(frame->mutable_size(), frame->data(), frame->capacity()) != CAN_OK) {
-        return ERR_INTERNAL;
-    }
-    frame->id(mcp_.getCanId());
-    frame->ext(mcp_.isExtendedFrame());
+    *frame = *next;
+    rx_->pop();
     return ERR_OK;
 }
 
+template <typename FrameType>
+Error MCP2518<FrameType>::readMany(FrameType* frames, size_t max, size_t* n) {
+    *n = 0;
+    if (!ready_) {
+        return ERR_READY;
+    }
+
+    Error err = ERR_FIFO;
+    if (rx_ == nullptr) {
+        // Drain the controller's receive buffers directly.
+        while (*n < max && (err = receive(frames + *n)) == ERR_OK) {
+            ++*n;
+        }
+    } else {
+        FrameType* next;
+        while (*n < max && (next = rx_->front()) != nullptr) {
+            frames[(*n)++] = *next;
+            rx_->pop();
+        }
+    }
+    return *n > 0 ? ERR_OK : err;
+}
+
+template <typename FrameType>
+Error MCP2518<FrameType>::receive(FrameType* frame) {
+    if (!ready_) {
+        return ERR_READY;
+    }
+
+    while (true) {
+        if (mcp_.checkReceive() != CAN_MSGAVAIL) {
+            return ERR_FIFO;
+        }
+        stampFrame(frame);
+        if (mcp_.readMsgBuf(frame->mutable_size(), frame->data(), frame->capacity()) != CAN_OK) {
+            return ERR_INTERNAL;
+        }
+        frame->id(mcp_.getCanId());
+        frame->ext(mcp_.isExtendedFrame());
+        if (filter_ == nullptr || filter_->match(*frame)) {
+            return ERR_OK;
+        }
+    }
+}
+
 template <typename FrameType>
 Error MCP2518<FrameType>::write(const FrameType& frame) {
     if (!ready_) {
@@ -125,6 +176,28 @@ Error MCP2518<FrameType>::write(const FrameType& frame) {
     return ERR_INTERNAL;
 }
 
+template <typename FrameType>
+Error MCP2518<FrameType>::writeMany(const FrameType* frames, size_t count, size_t* n) {
+    *n = 0;
+    if (!ready_) {
+        return ERR_READY;
+    }
+
+    // Fill the transmit FIFO until the controller runs out of space.
+    bool fd = mode_ == CANFD_CONST_RATE || mode_ == CANFD_DUAL_RATE;
+    for (; *n < count; ++*n) {
+        const FrameType& frame = frames[*n];
+        if (frame.data() == nullptr || (!fd && frame.size() > 8) || frame.size() > 64) {
+            return ERR_INVALID;
+        }
+        uint8_t size = fd ? CANFD::len2dlc(frame.size()) : frame.size();
+        if (mcp_.sendMsgBuf(frame.id(), frame.ext(), size, frame.data()) != CAN_OK) {
+            return ERR_INTERNAL;
+        }
+    }
+    return ERR_OK;
+}
+
 template <typename FrameType>
 void MCP2518<FrameType>::setFilter(uint8_t num, uint8_t ext, uint32_t filter, uint32_t mask) {
     mcp_.init_Filt_Mask(num, ext, filter, mask);
@@ -135,6 +208,89 @@ void MCP2518<FrameType>::clearFilter(uint8_t num) {
     mcp_.CANFDSPI_FilterDisable((CAN_FILTER)num);
 }
 
+template <typename FrameType>
+bool MCP2518<FrameType>::setFilters(FrameIDFilter* filter) {
+    AcceptanceFilter filters[32];
+    size_t len = 0;
+
+    AcceptancePlanner planner;
+    bool enabled = false;
+    if (filter != nullptr) {
+        planner.accept(*filter);
+        filter->compile();
+        enabled = planner.plan(filters, 32, &len);
+    }
+    disableFilters();
+    for (size_t i = 0; i < len; ++i) {
+        setFilter(i, filters[i].ext, filters[i].id, filters[i].mask);
+    }
+
+    // Keep the filter to drop frames the hardware accepts but the filter does
+    // not.
+    noInterrupts();
+    filter_ = enabled && planner.exact() ? nullptr : filter;
+    interrupts();
+    return enabled;
+}
+
+template <typename FrameType>
+bool MCP2518<FrameType>::enableInterrupt(uint8_t int_pin, uint8_t capacity) {
+    disableInterrupt();
+    rx_ = new FrameRing<FrameType>(capacity);
+    int_pin_ = int_pin;
+    pinMode(int_pin_, INPUT_PULLUP);
+    if (!internal::attachInterruptHandler(int_pin_, FALLING, handleInterrupt, this)) {
+        delete rx_;
+        rx_ = nullptr;
+        return false;
+    }
+    // Keep SPI transactions in loop() from being interrupted by the handler.
+    SPI.usingInterrupt(digitalPinToInterrupt(int_pin_));
+
+    // Frames received before the interrupt was attached hold INT low and
+    // would prevent the falling edge.
+    noInterrupts();
+    drain();
+    interrupts();
+    return true;
+}
+
+template <typename FrameType>
+void MCP2518<FrameType>::disableInterrupt() {
+    if (rx_ == nullptr) {
+        return;
+    }
+    internal::detachInterruptHandler(int_pin_);
+    delete rx_;
+    rx_ = nullptr;
+}
+
+template <typename FrameType>
+void MCP2518<FrameType>::drain() {
+    if (rx_ == nullptr || !ready_) {
+        return;
+    }
+    // Read until the controller is empty so that INT is released. Frames that
+    // do not fit in the ring are discarded.
+    FrameType overflow;
+    while (true) {
+        FrameType* slot = rx_->back();
+        if (receive(slot == nullptr ? &overflow : slot) != ERR_OK) {
+            return;
+        }
+        if (slot == nullptr) {
+            rx_->drop();
+        } else {
+            rx_->push();
+        }
+    }
+}
+
+template <typename FrameType>
+void MCP2518<FrameType>::handleInterrupt(void* arg) {
+    ((MCP2518<FrameType>*)arg)->drain();
+}
+
 template <typename FrameType>
 void MCP2518<FrameType>::disableFilters() {
     for (uint8_t i = 0; i < 32; ++i) {
@@ -0,0 +1,83 @@
+#ifndef _CANNY_PRIORITY_FRAME_QUEUE_H_
+#define _CANNY_PRIORITY_FRAME_QUEUE_H_
+
+#include <Arduino.h>
+
+namespace Canny {
+
+// A fixed size queue of frames ordered the same way the bus arbitrates. The
+// front of the queue is always the frame that would win arbitration: the
+// lowest ID, with a standard frame winning over an extended frame that shares
+// its 11-bit base ID. Frames with equal IDs are kept in FIFO order.
+//
+// Frames are stored in place and ordered by a binary heap of slot indexes so
+// that push() and pop() are O(log n) and no frame is ever moved. The queue has
+// the same slot interface as FrameQueue.
+template <typename FrameType>
+class PriorityFrameQueue {
+    public:
+        // Construct a queue that holds up to capacity frames.
+        PriorityFrameQueue(size_t capacity);
+        ~PriorityFrameQueue();
+
+        // Return true if the queue has no frames.
+        bool empty() const { return len_ == 0; }
+
+        // Return true if the queue has no free slots.
+        bool full() const { return len_ >= capacity_; }
+
+        // Return the number of frames in the queue.
+        size_t size() const { return len_; }
+
+        // Return the maximum number of frames the queue can hold.
+        size_t capacity() const { return capacity_; }
+
+        // Return a free slot or nullptr if the queue is full.
+        FrameType* back();
+
+        // Insert the slot returned by back() into the queue.
+        void push();
+
+        // Copy a frame into the queue. Return false if the queue is full.
+        bool push(const FrameType& frame);
+
+        // Replace the lowest priority frame with frame when the queue is full
+        // and frame would be sent before it. The replaced frame is copied to
+        // evicted. Return false if no frame was replaced.
+        bool displace(const FrameType& frame, FrameType* evicted);
+
+        // Return the highest priority frame or nullptr if the queue is empty.
+        FrameType* front();
+
+        // Remove the frame returned by front().
+        void pop();
+
+    private:
+        struct Entry {
+            uint32_t key;   // Arbitration order of the frame's ID.
+            uint32_t seq;   // Insertion order for frames with equal keys.
+            size_t slot;    // Index of the frame in frames_.
+        };
+
+        // Return the arbitration key of a frame. Lower keys win.
+        static uint32_t key(const FrameType& frame);
+
+        // Return true if entry a should be sent before entry b.
+        static bool before(const Entry& a, const Entry& b);
+
+        // Move entry up from position i until the heap is ordered.
+        void siftUp(size_t i, const Entry& entry);
+
+        FrameType* frames_;
+        Entry* heap_;
+        size_t* free_;
+        size_t capacity_;
+        size_t len_;
+        uint32_t seq_;
+};
+
+}  // namespace Canny
+
+#include "PriorityFrameQueue.tpp"
+
+#endif  // _CANNY_PRIORITY_FRAME_QUEUE_H_
@@ -0,0 +1,160 @@
+namespace Canny {
+
+template <typename FrameType>
+PriorityFrameQueue<FrameType>::PriorityFrameQueue(size_t capacity) :
+        frames_(nullptr), heap_(nullptr), free_(nullptr), capacity_(capacity),
+        len_(0), seq_(0) {
+    if (capacity_ > 0) {
+        frames_ = new FrameType[capacity_];
+        heap_ = new Entry[capacity_];
+        free_ = new size_t[capacity_];
+        for (size_t i = 0; i < capacity_; ++i) {
+            free_[i] = capacity_ - i - 1;
+        }
+    }
+}
+
+template <typename FrameType>
+PriorityFrameQueue<FrameType>::~PriorityFrameQueue() {
+    if (frames_ != nullptr) {
+        delete[] frames_;
+    }
+    if (heap_ != nullptr) {
+        delete[] heap_;
+    }
+    if (free_ != nullptr) {
+        delete[] free_;
+    }
+}
+
+template <typename FrameType>
+FrameType* PriorityFrameQueue<FrameType>::back() {
+    if (full()) {
+        return nullptr;
+    }
+    // free slots are stacked after the used ones
+    return frames_ + free_[capacity_ - len_ - 1];
+}
+
+template <typename FrameType>
+void PriorityFrameQueue<FrameType>::push() {
+    if (full()) {
+        return;
+    }
+    Entry entry;
+    entry.slot = free_[capacity_ - len_ - 1];
+    entry.key = key(frames_[entry.slot]);
+    entry.seq = seq_++;
+    siftUp(len_++, entry);
+}
+
+template <typename FrameType>
+bool PriorityFrameQueue<FrameType>::push(const FrameType& frame) {
+    FrameType* slot = back();
+    if (slot == nullptr) {
+        return false;
+    }
+    *slot = frame;
+    push();
+    return true;
+}
+
+template <typename FrameType>
+bool PriorityFrameQueue<FrameType>::displace(const FrameType& frame, FrameType* evicted) {
+    if (!full() || empty()) {
+        return false;
+    }
+
+    // The lowest priority entry is one of the leaves.
+    size_t worst = len_ / 2;
+    for (size_t i = worst + 1; i < len_; ++i) {
+        if (before(heap_[worst], heap_[i])) {
+            worst = i;
+        }
+    }
+    // Frames with equal keys stay in FIFO order so only a lower key wins.
+    Entry entry;
+    entry.key = key(frame);
+    if (entry.key >= heap_[worst].key) {
+        return false;
+    }
+    entry.slot = heap_[worst].slot;
+    entry.seq = seq_++;
+    *evicted = frames_[entry.slot];
+    frames_[entry.slot] = frame;
+    siftUp(worst, entry);
+    return true;
+}
+
+template <typename FrameType>
+FrameType* PriorityFrameQueue<FrameType>::front() {
+    if (empty()) {
+        return nullptr;
+    }
+    return frames_ + heap_[0].slot;
+}
+
+template <typename FrameType>
+void PriorityFrameQueue<FrameType>::pop() {
+    if (empty()) {
+        return;
+    }
+    --len_;
+    free_[capacity_ - len_ - 1] = heap_[0].slot;
+    if (len_ == 0) {
+        return;
+    }
+
+    // sift down
+    Entry entry = heap_[len_];
+    size_t i = 0;
+    while (true) {
+        size_t child = 2 * i + 1;
+        if (child >= len_) {
+            break;
+        }
+        if (child + 1 < len_ && before(heap_[child + 1], heap_[child])) {
+            ++child;
+        }
+        if (!before(heap_[child], entry)) {
+            break;
+        }
+        heap_[i] = heap_[child];
+        i = child;
+    }
+    heap_[i] = entry;
+}
+
+template <typename FrameType>
+uint32_t PriorityFrameQueue<FrameType>::key(const FrameType& frame) {
+    // Order by the 11-bit base ID, then the SRR/IDE bit which is dominant for
+    // standard frames, then the 18-bit ID extension.
+    if (frame.ext() == 1) {
+        uint32_t id = frame.id() & 0x1FFFFFFF;
+        return ((id >> 18) << 19) | (1UL << 18) | (id & 0x3FFFF);
+    }
+    return (frame.id() & 0x7FF) << 19;
+}
+
+template <typename FrameType>
+bool PriorityFrameQueue<FrameType>::before(const Entry& a, const Entry& b) {
+    if (a.key != b.key) {
+        return a.key < b.key;
+    }
+    return (int32_t)(a.seq - b.seq) < 0;
+}
+
+template <typename FrameType>
+void PriorityFrameQueue<FrameType>::siftUp(size_t i, const Entry& entry) {
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (!before(entry, heap_[parent])) {
+            break;
+        }
+        heap_[i] = heap_[parent];
+        i = parent;
+    }
+    heap_[i] = entry;
+}
+
+}  // namespace Canny
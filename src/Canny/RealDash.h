@@ -2,12 +2,15 @@
 #define _CANNY_REALDASH_H_
 
 #include <Arduino.h>
-#include <CRC32.h>
+#include "Checksum.h"
 #include "Connection.h"
 #include "Frame.h"
 
 namespace Canny {
 
+// Bytes added to the padded payload of each frame by 0x66 encoding.
+const uint8_t RealDashOverhead = 12;
+
 // Reads and writes frames to RealDash over serial. Supports reading RealDash
 // 0x44 and 0x66 type frames. All written frames are 0x66 for simplicity.
 template <typename FrameType>
@@ -19,38 +22,61 @@ class RealDash : public Connection<FrameType> {
 
         // Read a frame from the RealDash stream without blocking. Return
         // ERR_OK when a frame was read or ERR_FIFO when no frame is available.
-        // Return ERR_INTERNAL if the serial data is invalid.
+        // Invalid serial data is skipped and the stream is resynchronized at
+        // the next frame header.
         //
         // The ext flag is always set to 1. RealDash encodes all frame IDs as 4
         // bytes and does not provide an ext flag.
         Error read(FrameType* frame) override;
 
-        // Write a frame to the RealDash stream. Return ERR_OK on success.
+        // Write a frame to the RealDash stream. The frame is encoded in full
+        // and written with a single stream write. Return ERR_OK on success or
+        // ERR_INVALID if the frame cannot be encoded.
         virtual Error write(const FrameType& frame) override;
 
+        // Read all complete frames available on the stream, up to max.
+        Error readMany(FrameType* frames, size_t max, size_t* n) override;
+
+        // Write frames to the RealDash stream. Consecutive frames are packed
+        // into as few stream writes as possible. Return ERR_INVALID at the
+        // first frame that cannot be encoded.
+        Error writeMany(const FrameType* frames, size_t count, size_t* n) override;
+
     private:
+        // Size of the receive buffer. Must hold at least one 0x66 frame with
+        // 64 bytes of data.
+        static constexpr size_t buffer_size_ = 128;
+
+        // Maximum size of an encoded 0x66 frame.
+        static constexpr size_t frame_size_ = 76;
+
+        // Size of the buffer used to pack frames in writeMany().
+        static constexpr size_t write_size_ = 4 * frame_size_;
+
         Stream* stream_;
-        FrameType frame_;
-
-        // Read attributes.
-        bool frame_type_66_;        // Type of frame. False if 0x44, true if 0x66.
-        uint8_t frame44_checksum_;  // Frame 0x44 checksum. Calculated as bytes are read.
-        CRC32::Checksum frame66_checksum_;  // Frame 0x66 checksum. Calculated as bytes are read.
-        byte checksum_buffer_[4];   // Buffer to read in the checksum.
-        uint8_t read_size_;         // Tracks how many bytes have been read.
-
-        // Write attributes.
-        CRC32::Checksum write_checksum_;
-
-        void updateChecksum(byte b);
-        bool readHeader();
-        bool readId();
-        bool readData();
-        bool validateChecksum();
-        void reset();
-        void writeByte(const byte b);
-        void writeBytes(const byte* b, uint8_t len);
-        void writeBytes(uint32_t data);
+
+        // Read attributes. Bytes in [read_pos_, read_len_) have been read from
+        // the stream but not yet decoded.
+        byte read_buffer_[buffer_size_];
+        size_t read_pos_;
+        size_t read_len_;
+
+        // Move the available stream bytes into the receive buffer. Return
+        // true if any bytes were added.
+        bool fill();
+
+        // Decode the next valid frame in the receive buffer into frame.
+        // Return false if the buffer does not hold a complete frame.
+        bool decode(FrameType* frame);
+
+        // Return the offset of the first byte in buffer that could start a
+        // frame header or len if there is none.
+        static size_t scan(const byte* buffer, size_t len);
+
+        // Encode frame as a 0x66 frame into buffer which must hold at least
+        // frame_size_ bytes. Return the encoded size or 0 if the frame cannot
+        // be encoded.
+        static size_t encode(const FrameType& frame, byte* buffer);
 };
 
 }  // namespace Canny
@@ -1,170 +1,158 @@
 namespace Canny {
 
-static const uint32_t kReceiveTimeout = 5000;
+// Size of the frame header and of the header and ID together.
+static const size_t kRealDashHeaderSize = 4;
+static const size_t kRealDashPrefixSize = 8;
 
 template <typename FrameType>
-RealDash<FrameType>::RealDash(Stream* stream) : stream_(stream), frame_(0, 1, 0) {
-    reset();
-}
-
-template <typename FrameType>
-void RealDash<FrameType>::reset() {
-    memset(checksum_buffer_, 0, 4);
-    frame_type_66_ = false;
-    frame44_checksum_ = 0;
-    frame66_checksum_.reset();
-    frame_.resize(8);
-    read_size_ = 0;
-}
-
-template <typename FrameType>
-void RealDash<FrameType>::updateChecksum(byte b) {
-    if (frame_type_66_) {
-        frame66_checksum_.update(b);
-    } else {
-        frame44_checksum_ += b;
-    }
-}
+RealDash<FrameType>::RealDash(Stream* stream) :
+    stream_(stream), read_pos_(0), read_len_(0) {}
 
 template <typename FrameType>
 Error RealDash<FrameType>::read(FrameType* frame) {
-    if (stream_ && readHeader() && readId() && readData() && validateChecksum()) {
-        *frame = frame_;
-        reset();
+    if (!stream_) {
+        return ERR_FIFO;
+    }
+    if (decode(frame) || (fill() && decode(frame))) {
         return Error::ERR_OK;
     }
     return Error::ERR_FIFO;
 }
 
 template <typename FrameType>
-bool RealDash<FrameType>::readHeader() {
-    byte b;
-    while (read_size_ < 4 && stream_->available()) {
-        b = stream_->read();
-        read_size_++;
-        switch (read_size_) {
-            case 1:
-                if (b != 0x44 && b != 0x66) {
-                    //ERROR_MSG_VAL_FMT("realdash: unrecognized frame type ", b, HEX);
-                    reset();
-                    continue;
-                }
-                frame_type_66_ = (b == 0x66);
-                break;
-            case 2:
-                if (b != 0x33) {
-                    //ERROR_MSG_VAL_FMT("realdash: invalid header byte 2 ", b, HEX);
-                    reset();
-                    continue;
-                }
-                break;
-            case 3:
-                if (b != 0x22) {
-                    //ERROR_MSG_VAL_FMT("realdash: invalid header byte 3 ", b, HEX);
-                    reset();
-                    continue;
-                }
-                break;
-            case 4:
-                if ((!frame_type_66_ && b != 0x11) || (frame_type_66_ && (b < 0x11 || b > 0x1F))) {
-                    //ERROR_MSG_VAL_FMT("realdash: invalid header byte 4 ", b, HEX);
-                    reset();
-                    continue;
-                }
-                frame_.resize((b - 15) * 4);
-                break;
-            default:
-                break;
-        }
-        updateChecksum(b);
+Error RealDash<FrameType>::readMany(FrameType* frames, size_t max, size_t* n) {
+    *n = 0;
+    if (!stream_) {
+        return ERR_FIFO;
     }
-    return read_size_ >= 4;
+    while (*n < max && (decode(frames + *n) || (fill() && decode(frames + *n)))) {
+        ++*n;
+    }
+    return *n > 0 ? ERR_OK : ERR_FIFO;
 }
 
 template <typename FrameType>
-bool RealDash<FrameType>::readId() {
-    uint32_t b;
-    while (read_size_ < 8 && stream_->available()) {
-        b = stream_->read();
-        read_size_++;
-        updateChecksum(b);
-        switch (read_size_-4) {
-            case 1:
-                *frame_.mutable_id() = b;
-                break;
-            case 2:
-                *frame_.mutable_id() |= (b << 8);
-                break;
-            case 3:
-                *frame_.mutable_id() |= (b << 16);
-                break;
-            case 4:
-                *frame_.mutable_id() |= (b << 24);
-                break;
-        }
+bool RealDash<FrameType>::fill() {
+    if (read_pos_ > 0) {
+        memmove(read_buffer_, read_buffer_ + read_pos_, read_len_ - read_pos_);
+        read_len_ -= read_pos_;
+        read_pos_ = 0;
+    }
+    int available = stream_->available();
+    if (available <= 0 || read_len_ >= buffer_size_) {
+        return false;
     }
-    return read_size_ >= 8;
+    size_t n = buffer_size_ - read_len_;
+    if ((size_t)available < n) {
+        n = available;
+    }
+    n = stream_->readBytes(read_buffer_ + read_len_, n);
+    read_len_ += n;
+    return n > 0;
 }
 
 template <typename FrameType>
-bool RealDash<FrameType>::readData() {
-    while (read_size_ - 8 < frame_.size() && stream_->available()) {
-        frame_.data()[read_size_-8] = stream_->read();
-        updateChecksum(frame_.data()[read_size_-8]);
-        read_size_++;
+size_t RealDash<FrameType>::scan(const byte* buffer, size_t len) {
+    // A candidate may be cut off by the end of the buffer in which case only
+    // the bytes that are present are checked.
+    for (size_t i = 0; i < len; ++i) {
+        const byte type = buffer[i];
+        if (type != 0x44 && type != 0x66) {
+            continue;
+        }
+        if (i + 1 < len && buffer[i + 1] != 0x33) {
+            continue;
+        }
+        if (i + 2 < len && buffer[i + 2] != 0x22) {
+            continue;
+        }
+        if (i + 3 < len) {
+            const byte size = buffer[i + 3];
+            if ((type == 0x44 && size != 0x11) ||
+                    (type == 0x66 && (size < 0x11 || size > 0x1F))) {
+                continue;
+            }
+        }
+        return i;
     }
-    *frame_.mutable_size() = frame_.size();
-    return read_size_ - 8 >= frame_.size();
+    return len;
 }
 
 template <typename FrameType>
-bool RealDash<FrameType>::validateChecksum() {
-    if (frame_type_66_) {
-        while (read_size_ - 8 - frame_.size() < 4 && stream_->available()) {
-            checksum_buffer_[read_size_ - 8 - frame_.size()] = stream_->read();
-            read_size_++;
-        }
-        if (read_size_ - 8 - frame_.size() < 4) {
+bool RealDash<FrameType>::decode(FrameType* frame) {
+    while (true) {
+        read_pos_ += scan(read_buffer_ + read_pos_, read_len_ - read_pos_);
+        const byte* buffer = read_buffer_ + read_pos_;
+        const size_t len = read_len_ - read_pos_;
+        if (len < kRealDashHeaderSize) {
             return false;
         }
-        if (frame66_checksum_.value() != *((uint32_t*)checksum_buffer_)) {
-            //ERROR_MSG_VAL_FMT("realdash: frame 0x66 checksum error, wanted ", frame66_checksum_.value(), HEX);
-            reset();
+
+        const bool type66 = buffer[0] == 0x66;
+        const size_t size = (buffer[3] - 15) * 4;
+        const size_t span = kRealDashPrefixSize + size;
+        if (len < span + (type66 ? 4 : 1)) {
             return false;
         }
-    } else {
-        if (read_size_ - 8 - frame_.size() < 1) {
-            if (!stream_->available()) {
-                return false;
+
+        bool valid;
+        if (type66) {
+            const byte* expect = buffer + span;
+            valid = crc32(0, buffer, span) == ((uint32_t)expect[0] |
+                    ((uint32_t)expect[1] << 8) | ((uint32_t)expect[2] << 16) |
+                    ((uint32_t)expect[3] << 24));
+        } else {
+            uint8_t checksum = 0;
+            for (size_t i = 0; i < span; ++i) {
+                checksum += buffer[i];
             }
-            checksum_buffer_[0] = stream_->read();
-            read_size_++;
+            valid = checksum == buffer[span];
         }
-        if (frame44_checksum_ != checksum_buffer_[0]) {
-            //ERROR_MSG_VAL_FMT("realdash: frame 0x44 checksum error, wanted ", frame44_checksum_, HEX);
-            reset();
-            return false;
+
+        if (!valid) {
+            // Skip the false header and resynchronize on the bytes behind it.
+            ++read_pos_;
+            continue;
         }
-    }
-    return true;
-}
 
-template <typename FrameType>
-void RealDash<FrameType>::writeByte(const byte b) {
-    stream_->write(b);
-    write_checksum_.update(b);
+        *frame->mutable_id() = (uint32_t)buffer[4] | ((uint32_t)buffer[5] << 8) |
+            ((uint32_t)buffer[6] << 16) | ((uint32_t)buffer[7] << 24);
+        *frame->mutable_ext() = 1;
+        frame->resize(size);
+        memcpy(frame->data(), buffer + kRealDashPrefixSize, frame->size());
+        read_pos_ += span + (type66 ? 4 : 1);
+        return true;
+    }
 }
 
 template <typename FrameType>
-void RealDash<FrameType>::writeBytes(const byte* b, uint8_t len) {
-    for (int i = 0; i < len; i++) {
-        writeByte(b[i]);
+size_t RealDash<FrameType>::encode(const FrameType& frame, byte* buffer) {
+    const uint8_t size = frame.size();
+    if (size > 64 || size % 4 != 0) {
+        return 0;
     }
-}
 
-template <typename FrameType>
-void RealDash<FrameType>::writeBytes(uint32_t data) {
-    writeBytes((const byte*)&data, 4);
+    // Frames shorter than 8 bytes are padded to 8.
+    const uint8_t padded = size < 8 ? 8 : size;
+    const uint32_t id = frame.id();
+    buffer[0] = 0x66;
+    buffer[1] = 0x33;
+    buffer[2] = 0x22;
+    buffer[3] = padded / 4 + 15;
+    buffer[4] = id;
+    buffer[5] = id >> 8;
+    buffer[6] = id >> 16;
+    buffer[7] = id >> 24;
+    memcpy(buffer + kRealDashPrefixSize, frame.data(), size);
+    memset(buffer + kRealDashPrefixSize + size, 0, padded - size);
+
+    const size_t span = kRealDashPrefixSize + padded;
+    const uint32_t checksum = crc32(0, buffer, span);
+    buffer[span] = checksum;
+    buffer[span + 1] = checksum >> 8;
+    buffer[span + 2] = checksum >> 16;
+    buffer[span + 3] = checksum >> 24;
+    return span + 4;
 }
 
 template <typename FrameType>
@@ -172,25 +160,41 @@ Error RealDash<FrameType>::write(const FrameType& frame) {
     if (!stream_) {
         return ERR_FIFO;
     }
-    if (frame.size() > 64 || frame.size() % 4 != 0) {
+    byte buffer[frame_size_];
+    size_t len = encode(frame, buffer);
+    if (len == 0) {
         return ERR_INVALID;
     }
+    stream_->write(buffer, len);
+    return Error::ERR_OK;
+}
 
-    write_checksum_.reset();
-
-    byte encoded_size = (frame.size() < 8 ? 8 : frame.size()) / 4 + 15;
-    writeByte(0x66);
-    writeByte(0x33);
-    writeByte(0x22);
-    writeByte(encoded_size);
-    writeBytes(frame.id());
-    writeBytes(frame.data(), frame.size());
-    for (int i = 0; i < 8-frame.size(); i++) {
-        writeByte(0);
+template <typename FrameType>
+Error RealDash<FrameType>::writeMany(const FrameType* frames, size_t count, size_t* n) {
+    *n = 0;
+    if (!stream_) {
+        return ERR_FIFO;
     }
-    uint32_t checksum = write_checksum_.value();
-    stream_->write((const byte*)&checksum, 4);
-    return Error::ERR_OK;
+    byte buffer[write_size_];
+    size_t len = 0;
+    Error err = ERR_OK;
+    while (*n < count) {
+        if (len + frame_size_ > write_size_) {
+            stream_->write(buffer, len);
+            len = 0;
+        }
+        size_t encoded = encode(frames[*n], buffer + len);
+        if (encoded == 0) {
+            err = ERR_INVALID;
+            break;
+        }
+        len += encoded;
+        ++*n;
+    }
+    if (len > 0) {
+        stream_->write(buffer, len);
+    }
+    return err;
 }
 
 }  // namespace Canny
@@ -0,0 +1,61 @@
+#ifndef _CANNY_RING_H_
+#define _CANNY_RING_H_
+
+#include <Arduino.h>
+
+namespace Canny {
+
+// A fixed size single-producer/single-consumer ring of frames. The producer
+// may run in an interrupt handler while the consumer runs in loop() without
+// disabling interrupts. Each index is written by only one side and is a
+// single byte so that it is read and written atomically on every supported
+// architecture. This limits the capacity to 254 frames.
+//
+// The producer fills the slot returned by back() and then publishes it with
+// push(). The consumer reads the slot returned by front() and then releases it
+// with pop(). Frames are never moved once written.
+template <typename FrameType>
+class FrameRing {
+    public:
+        // Construct a ring that holds up to capacity frames.
+        FrameRing(uint8_t capacity);
+        ~FrameRing();
+
+        // Return the slot the producer should fill next or nullptr if the
+        // ring is full.
+        FrameType* back();
+
+        // Publish the slot returned by back().
+        void push();
+
+        // Record a frame that was discarded because the ring was full.
+        void drop() { ++dropped_; }
+
+        // Return the oldest frame in the ring or nullptr if the ring is empty.
+        FrameType* front();
+
+        // Release the frame returned by front().
+        void pop();
+
+        // Return the number of frames in the ring.
+        uint8_t size() const;
+
+        // Return the maximum number of frames the ring can hold.
+        uint8_t capacity() const { return size_ - 1; }
+
+        // Return the number of frames discarded because the ring was full.
+        uint32_t dropped() const { return dropped_; }
+
+    private:
+        FrameType* frames_;
+        uint8_t size_;
+        uint8_t head_;
+        uint8_t tail_;
+        volatile uint32_t dropped_;
+};
+
+}  // namespace Canny
+
+#include "Ring.tpp"
+
+#endif  // _CANNY_RING_H_
@@ -0,0 +1,53 @@
+namespace Canny {
+
+template <typename FrameType>
+FrameRing<FrameType>::FrameRing(uint8_t capacity) :
+        frames_(nullptr), size_(capacity > 254 ? 255 : capacity + 1),
+        head_(0), tail_(0), dropped_(0) {
+    frames_ = new FrameType[size_];
+}
+
+template <typename FrameType>
+FrameRing<FrameType>::~FrameRing() {
+    if (frames_ != nullptr) {
+        delete[] frames_;
+    }
+}
+
+template <typename FrameType>
+FrameType* FrameRing<FrameType>::back() {
+    uint8_t next = tail_ + 1 == size_ ? 0 : tail_ + 1;
+    if (next == __atomic_load_n(&head_, __ATOMIC_ACQUIRE)) {
+        return nullptr;
+    }
+    return frames_ + tail_;
+}
+
+template <typename FrameType>
+void FrameRing<FrameType>::push() {
+    uint8_t next = tail_ + 1 == size_ ? 0 : tail_ + 1;
+    __atomic_store_n(&tail_, next, __ATOMIC_RELEASE);
+}
+
+template <typename FrameType>
+FrameType* FrameRing<FrameType>::front() {
+    if (head_ == __atomic_load_n(&tail_, __ATOMIC_ACQUIRE)) {
+        return nullptr;
+    }
+    return frames_ + head_;
+}
+
+template <typename FrameType>
+void FrameRing<FrameType>::pop() {
+    uint8_t next = head_ + 1 == size_ ? 0 : head_ + 1;
+    __atomic_store_n(&head_, next, __ATOMIC_RELEASE);
+}
+
+template <typename FrameType>
+uint8_t FrameRing<FrameType>::size() const {
+    uint8_t head = __atomic_load_n(&head_, __ATOMIC_ACQUIRE);
+    uint8_t tail = __atomic_load_n(&tail_, __ATOMIC_ACQUIRE);
+    return tail >= head ? tail - head : size_ - head + tail;
+}
+
+}  // namespace Canny
@@ -0,0 +1,126 @@
+#ifndef _CANNY_ROUTER_H_
+#define _CANNY_ROUTER_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Error.h"
+#include "FrameQueue.h"
+
+namespace Canny {
+
+// Matches frames read from any port.
+const uint8_t AnyPort = 0xFF;
+
+// Matches both standard and extended frames.
+const uint8_t AnyExt = 0xFF;
+
+// Routes frames between a set of ports. Each frame read from a port is
+// matched against the route table in the order routes were added. The first
+// route whose source port, frame format, and ID/mask match the frame decides
+// where it goes.
+// Frames are never routed back to the port they were read from. Frames that
+// match no route are dropped.
+//
+// Frames are written to a destination port directly unless the port is busy.
+// Each port has its own output buffer for frames it cannot accept yet so that
+// a slow port does not stall the others. A frame that does not fit in a
+// destination's buffer is dropped for that destination only.
+//
+// Work is done in poll() which reads and writes a bounded number of frames
+// per port so that the time spent in each loop() is bounded.
+template <typename FrameType>
+class Router {
+    public:
+        // Construct a router with room for the given number of ports and
+        // routes. Each port buffers up to buffer_size frames for writing.
+        // There may be at most 32 ports.
+        Router(size_t ports, size_t routes, size_t buffer_size);
+        ~Router();
+
+        // Add a port. Ports are numbered in the order they are added starting
+        // at 0. Return false if there is no room for the port.
+        bool addPort(Connection<FrameType>* port);
+
+        // Add a route. Frames read from the source port whose ext flag
+        // matches ext and whose ID matches id under mask are written to each
+        // port in the destinations bitmask, where bit n selects port n. Use
+        // AnyPort to match frames from all ports and AnyExt to match both
+        // standard and extended frames. Routes are numbered in the order they
+        // are added starting at 0. Return false if there is no room for the
+        // route.
+        bool addRoute(uint8_t source, uint32_t id, uint32_t mask, uint32_t destinations,
+                uint8_t ext = AnyExt);
+
+        // Rewrite the IDs of frames forwarded by a route. The bits in mask
+        // are replaced by the corresponding bits in id. The result is
+        // truncated to 11 bits for standard frames and 29 bits for extended
+        // frames.
+        void rewrite(size_t route, uint32_t id, uint32_t mask);
+
+        // Read up to read_budget frames from each port and route them. Then
+        // write up to write_budget buffered frames to each port. Call this
+        // from loop().
+        void poll(size_t read_budget = 16, size_t write_budget = 16);
+
+        // Return the number of frames a route has written to its
+        // destinations. A frame sent to two ports counts twice. Buffered
+        // frames are counted once they are written.
+        uint32_t forwarded(size_t route) const;
+
+        // Return the number of frames a route dropped because a destination
+        // buffer was full or the destination failed to write.
+        uint32_t dropped(size_t route) const;
+
+        // Return the number of frames that matched no route.
+        uint32_t unrouted() const { return unrouted_; }
+
+        // Return the number of frames buffered for a port.
+        size_t pending(uint8_t port) const;
+
+    private:
+        // A buffered frame and the route that sent it.
+        struct Pending {
+            FrameType frame;
+            size_t route;
+        };
+
+        struct Port {
+            Connection<FrameType>* connection;
+            FrameQueue<Pending>* buffer;
+        };
+
+        struct Route {
+            uint32_t id;
+            uint32_t mask;
+            uint32_t rewrite_id;
+            uint32_t rewrite_mask;
+            uint32_t destinations;
+            uint32_t forwarded;
+            uint32_t dropped;
+            uint8_t source;
+            uint8_t ext;
+        };
+
+        // Route a frame read from the given port.
+        void route(uint8_t source, const FrameType& frame);
+
+        // Write buffered frames to a port.
+        void drain(Port* port, size_t budget);
+
+        Port* ports_;
+        size_t ports_size_;
+        size_t ports_len_;
+        size_t buffer_size_;
+
+        Route* routes_;
+        size_t routes_size_;
+        size_t routes_len_;
+
+        uint32_t unrouted_;
+};
+
+}  // namespace Canny
+
+#include "Router.tpp"
+
+#endif  // _CANNY_ROUTER_H_
@@ -0,0 +1,172 @@
+namespace Canny {
+
+template <typename FrameType>
+Router<FrameType>::Router(size_t ports, size_t routes, size_t buffer_size) :
+        ports_(nullptr), ports_size_(ports > 32 ? 32 : ports), ports_len_(0),
+        buffer_size_(buffer_size), routes_(nullptr), routes_size_(routes),
+        routes_len_(0), unrouted_(0) {
+    if (ports_size_ > 0) {
+        ports_ = new Port[ports_size_];
+    }
+    if (routes_size_ > 0) {
+        routes_ = new Route[routes_size_];
+    }
+}
+
+template <typename FrameType>
+Router<FrameType>::~Router() {
+    if (ports_ != nullptr) {
+        for (size_t i = 0; i < ports_len_; ++i) {
+            delete ports_[i].buffer;
+        }
+        delete[] ports_;
+    }
+    if (routes_ != nullptr) {
+        delete[] routes_;
+    }
+}
+
+template <typename FrameType>
+bool Router<FrameType>::addPort(Connection<FrameType>* port) {
+    if (ports_len_ >= ports_size_) {
+        return false;
+    }
+    ports_[ports_len_].connection = port;
+    ports_[ports_len_].buffer = new FrameQueue<Pending>(buffer_size_);
+    ++ports_len_;
+    return true;
+}
+
+template <typename FrameType>
+bool Router<FrameType>::addRoute(uint8_t source, uint32_t id, uint32_t mask, uint32_t destinations,
+        uint8_t ext) {
+    if (routes_len_ >= routes_size_) {
+        return false;
+    }
+    Route& route = routes_[routes_len_++];
+    route.id = id & mask;
+    route.mask = mask;
+    route.rewrite_id = 0;
+    route.rewrite_mask = 0;
+    route.destinations = destinations;
+    route.forwarded = 0;
+    route.dropped = 0;
+    route.source = source;
+    route.ext = ext;
+    return true;
+}
+
+template <typename FrameType>
+void Router<FrameType>::rewrite(size_t route, uint32_t id, uint32_t mask) {
+    if (route < routes_len_) {
+        routes_[route].rewrite_id = id & mask;
+        routes_[route].rewrite_mask = mask;
+    }
+}
+
+template <typename FrameType>
+void Router<FrameType>::poll(size_t read_budget, size_t write_budget) {
+    FrameType frame;
+    for (size_t i = 0; i < ports_len_; ++i) {
+        for (size_t n = 0; n < read_budget; ++n) {
+            if (ports_[i].connection->read(&frame) != ERR_OK) {
+                break;
+            }
+            route(i, frame);
+        }
+    }
+    for (size_t i = 0; i < ports_len_; ++i) {
+        drain(ports_ + i, write_budget);
+    }
+}
+
+template <typename FrameType>
+uint32_t Router<FrameType>::forwarded(size_t route) const {
+    return route < routes_len_ ? routes_[route].forwarded : 0;
+}
+
+template <typename FrameType>
+uint32_t Router<FrameType>::dropped(size_t route) const {
+    return route < routes_len_ ? routes_[route].dropped : 0;
+}
+
+template <typename FrameType>
+size_t Router<FrameType>::pending(uint8_t port) const {
+    return port < ports_len_ ? ports_[port].buffer->size() : 0;
+}
+
+template <typename FrameType>
+void Router<FrameType>::route(uint8_t source, const FrameType& frame) {
+    size_t index = 0;
+    for (; index < routes_len_; ++index) {
+        const Route& candidate = routes_[index];
+        if ((candidate.source == AnyPort || candidate.source == source) &&
+                (candidate.ext == AnyExt || candidate.ext == frame.ext()) &&
+                (frame.id() & candidate.mask) == candidate.id) {
+            break;
+        }
+    }
+    if (index >= routes_len_) {
+        ++unrouted_;
+        return;
+    }
+    Route* route = routes_ + index;
+
+    const FrameType* out = &frame;
+    FrameType rewritten;
+    if (route->rewrite_mask != 0) {
+        rewritten = frame;
+        uint32_t id = (frame.id() & ~route->rewrite_mask) | route->rewrite_id;
+        rewritten.id(id & (frame.ext() ? 0x1FFFFFFF : 0x7FF));
+        out = &rewritten;
+    }
+
+    uint32_t destinations = route->destinations & ~((uint32_t)1 << source);
+    for (size_t i = 0; i < ports_len_ && destinations != 0; ++i) {
+        if ((destinations & ((uint32_t)1 << i)) == 0) {
+            continue;
+        }
+        destinations &= ~((uint32_t)1 << i);
+        Port& port = ports_[i];
+
+        // write directly unless frames are already waiting for the port
+        if (port.buffer->empty()) {
+            Error err = port.connection->write(*out);
+            if (err == ERR_OK) {
+                ++route->forwarded;
+                continue;
+            } else if (err != ERR_FIFO) {
+                ++route->dropped;
+                continue;
+            }
+        }
+        Pending* pending = port.buffer->back();
+        if (pending == nullptr) {
+            ++route->dropped;
+            continue;
+        }
+        pending->frame = *out;
+        pending->route = index;
+        port.buffer->push();
+    }
+}
+
+template <typename FrameType>
+void Router<FrameType>::drain(Port* port, size_t budget) {
+    Pending* pending;
+    for (size_t n = 0; n < budget && (pending = port->buffer->front()) != nullptr; ++n) {
+        Error err = port->connection->write(pending->frame);
+        if (err == ERR_FIFO) {
+            // try again on the next poll
+            return;
+        } else if (err == ERR_OK) {
+            ++routes_[pending->route].forwarded;
+        } else {
+            // other errors are not recoverable, discard the frame
+            ++routes_[pending->route].dropped;
+        }
+        port->buffer->pop();
+    }
+}
+
+}  // namespace Canny
@@ -3,16 +3,21 @@
 
 #include <same51_can.h>
 #include "Controller.h"
+#include "Ring.h"
 
 namespace Canny {
 
 // CAN implementation for SAME51 boards with integrated CAN FD controller.
+//
+// TimestampedFrame frames are stamped with micros() when they are taken from
+// the controller. The SAME51_CAN library does not expose the RX timestamp of
+// the message RAM element.
 template <typename FrameType>
 class SAME51 : public Controller<FrameType> {
     public:
         // Construct a new CAN object.
-        SAME51() : same51_(), ready_(false) {}
-        ~SAME51() override = default;
+        SAME51() : same51_(), ready_(false), rx_(nullptr) {}
+        ~SAME51() override;
 
         bool begin(Bitrate bitrate) override;
         Mode mode() const override;
@@ -21,11 +26,36 @@ class SAME51 : public Controller<FrameType> {
         Error read(uint32_t* id, uint8_t* ext, uint8_t* data, uint8_t* size);
         Error write(const FrameType& frame) override;
         Error write(uint32_t id, uint8_t ext, uint8_t* data, uint8_t size);
+        Error readMany(FrameType* frames, size_t max, size_t* n) override;
+        Error writeMany(const FrameType* frames, size_t count, size_t* n) override;
+
+        // Receive frames into a ring of capacity frames. The ring is filled
+        // by drain() and read() returns frames from the ring. Call drain()
+        // from the CAN interrupt handler or a timer interrupt to keep the
+        // controller's receive FIFO from overflowing when loop() is slow.
+        // Call after begin().
+        void enableRing(uint8_t capacity = 32);
+
+        // Stop receiving frames into the ring. Frames remaining in the ring
+        // are discarded.
+        void disableRing();
+
+        // Move frames from the controller into the receive ring. This is safe
+        // to call from an interrupt handler.
+        void drain();
+
+        // Return the number of frames discarded because the receive ring was
+        // full.
+        uint32_t dropped() const { return rx_ == nullptr ? 0 : rx_->dropped(); }
     private:
+        // Read a frame directly from the controller.
+        Error receive(uint32_t* id, uint8_t* ext, uint8_t* data, uint8_t* size);
+
         SAME51_CAN same51_;
         bool ready_;
         Mode mode_;
         Bitrate bitrate_;
+        FrameRing<FrameType>* rx_;
 };
 
 }  // namespace Canny
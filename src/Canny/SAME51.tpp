@@ -70,6 +70,11 @@ uint32_t GetSAME51Bitrate(Bitrate bitrate) {
 
 }  // namespace
 
+template <typename FrameType>
+SAME51<FrameType>::~SAME51() {
+    disableRing();
+}
+
 template <typename FrameType>
 bool SAME51<FrameType>::begin(Bitrate bitrate) {
     bitrate_ = FixSAME51Bitrate(bitrate);
@@ -90,11 +95,73 @@ Bitrate SAME51<FrameType>::bitrate() const {
 
 template <typename FrameType>
 Error SAME51<FrameType>::read(FrameType* frame) {
-    return read(frame->mutable_id(), frame->mutable_ext(), frame->data(), frame->mutable_size());
+    if (rx_ == nullptr) {
+        stampFrame(frame);
+        return receive(frame->mutable_id(), frame->mutable_ext(), frame->data(), frame->mutable_size());
+    }
+    if (!ready_) {
+        return ERR_READY;
+    }
+    FrameType* next = rx_->front();
+    if (next == nullptr) {
+        return ERR_FIFO;
+    }
+    *frame = *next;
+    rx_->pop();
+    return ERR_OK;
 }
 
 template <typename FrameType>
 Error SAME51<FrameType>::read(uint32_t* id, uint8_t* ext, uint8_t* data, uint8_t* size) {
+    if (rx_ == nullptr) {
+        return receive(id, ext, data, size);
+    }
+    if (!ready_) {
+        return ERR_READY;
+    }
+    FrameType* next = rx_->front();
+    if (next == nullptr) {
+        return ERR_FIFO;
+    }
+    *id = next->id();
+    *ext = next->ext();
+    *size = next->size();
+    memcpy(data, next->data(), next->size());
+    rx_->pop();
+    return ERR_OK;
+}
+
+template <typename FrameType>
+Error SAME51<FrameType>::readMany(FrameType* frames, size_t max, size_t* n) {
+    *n = 0;
+    if (!ready_) {
+        return ERR_READY;
+    }
+
+    Error err = ERR_FIFO;
+    if (rx_ == nullptr) {
+        // Drain the controller's receive FIFO directly.
+        while (*n < max) {
+            FrameType* frame = frames + *n;
+            stampFrame(frame);
+            err = receive(frame->mutable_id(), frame->mutable_ext(), frame->data(), frame->mutable_size());
+            if (err != ERR_OK) {
+                break;
+            }
+            ++*n;
+        }
+    } else {
+        FrameType* next;
+        while (*n < max && (next = rx_->front()) != nullptr) {
+            frames[(*n)++] = *next;
+            rx_->pop();
+        }
+    }
+    return *n > 0 ? ERR_OK : err;
+}
+
+template <typename FrameType>
+Error SAME51<FrameType>::receive(uint32_t* id, uint8_t* ext, uint8_t* data, uint8_t* size) {
     if (!ready_) {
         return ERR_READY;
     }
@@ -137,4 +204,61 @@ Error SAME51<FrameType>::write(uint32_t id, uint8_t ext, uint8_t* data, uint8_t
     }
 }
 
+template <typename FrameType>
+Error SAME51<FrameType>::writeMany(const FrameType* frames, size_t count, size_t* n) {
+    Error err = ERR_OK;
+    *n = 0;
+    while (*n < count) {
+        const FrameType& frame = frames[*n];
+        if ((err = write(frame.id(), frame.ext(), frame.data(), frame.size())) != ERR_OK) {
+            break;
+        }
+        ++*n;
+    }
+    return err;
+}
+
+template <typename FrameType>
+void SAME51<FrameType>::enableRing(uint8_t capacity) {
+    disableRing();
+    FrameRing<FrameType>* rx = new FrameRing<FrameType>(capacity);
+    noInterrupts();
+    rx_ = rx;
+    interrupts();
+}
+
+template <typename FrameType>
+void SAME51<FrameType>::disableRing() {
+    if (rx_ == nullptr) {
+        return;
+    }
+    noInterrupts();
+    FrameRing<FrameType>* rx = rx_;
+    rx_ = nullptr;
+    interrupts();
+    delete rx;
+}
+
+template <typename FrameType>
+void SAME51<FrameType>::drain() {
+    if (rx_ == nullptr || !ready_) {
+        return;
+    }
+    // Frames that do not fit in the ring are discarded.
+    FrameType overflow;
+    while (true) {
+        FrameType* slot = rx_->back();
+        FrameType* frame = slot == nullptr ? &overflow : slot;
+        stampFrame(frame);
+        if (receive(frame->mutable_id(), frame->mutable_ext(), frame->data(), frame->mutable_size()) != ERR_OK) {
+            return;
+        }
+        if (slot == nullptr) {
+            rx_->drop();
+        } else {
+            rx_->push();
+        }
+    }
+}
+
 }  // namespace Canny
@@ -0,0 +1,132 @@
+#ifndef _CANNY_SLCAN_H_
+#define _CANNY_SLCAN_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Controller.h"
+#include "Frame.h"
+
+namespace Canny {
+
+// Reads and writes frames to a host using the SLCAN (Lawicel) serial protocol
+// as spoken by can-utils slcand, python-can and SavvyCAN. Every command and
+// frame is a line of ASCII terminated by a carriage return. The host drives
+// the channel:
+//
+//   Sn      Set the arbitration rate: S4=125K, S5=250K, S6=500K, S8=1M.
+//   Yn      Set the CAN FD data rate in Mbit/s (1, 2, 3, 4, 5 or 8) or Y0 for
+//           CAN 2.0 only. The rate must exist in Bitrate for the selected
+//           arbitration rate.
+//   O       Open the channel.
+//   L       Open the channel in listen only mode.
+//   C       Close the channel.
+//   Zn      Disable (Z0) or enable (Z1) timestamps on frames sent to the host.
+//   V, N, F Report the version, serial number and status flags.
+//
+// Frames are tiiildd.., Tiiiiiiiildd.. for CAN 2.0 and d/D (or b/B with bit
+// rate switching) for CAN FD where l is the DLC. Remote frames (r/R) are
+// rejected as Canny frames do not carry an RTR flag. Commands are answered
+// with a carriage return on success or a bell (0x07) on failure.
+template <typename FrameType>
+class SLCAN : public Connection<FrameType> {
+    public:
+        // Construct an SLCAN instance that communicates over the given stream.
+        // This is typically Serial or SerialUSB. If controller is not null it
+        // is started with begin() at the selected bitrate when the host opens
+        // the channel. The bitrate defaults to CAN20_500K.
+        SLCAN(Stream* stream, Controller<FrameType>* controller = nullptr);
+
+        // Process commands from the host without blocking. Return ERR_OK when
+        // the host sent a frame and it was read into frame or ERR_FIFO when no
+        // frame is available. Frames are only read while the channel is open
+        // and not in listen only mode.
+        Error read(FrameType* frame) override;
+
+        // Write a frame to the host. The line is encoded in full and written
+        // with a single stream write. Return ERR_OK on success, ERR_READY if
+        // the channel is not open or ERR_INVALID if the frame size is not a
+        // valid CAN FD length.
+        Error write(const FrameType& frame) override;
+
+        // Read all frames available from the host, up to max.
+        Error readMany(FrameType* frames, size_t max, size_t* n) override;
+
+        // Write frames to the host. Consecutive frames are packed into as few
+        // stream writes as possible. Return ERR_INVALID at the first frame
+        // that cannot be encoded.
+        Error writeMany(const FrameType* frames, size_t count, size_t* n) override;
+
+        // Return true if the host has opened the channel.
+        bool isOpen() const { return open_; }
+
+        // Return true if the channel was opened in listen only mode.
+        bool listenOnly() const { return listen_; }
+
+        // Return true if frames sent to the host carry a timestamp.
+        bool timestamps() const { return timestamps_; }
+
+        // Return the bitrate the channel was last opened with.
+        Bitrate bitrate() const { return bitrate_; }
+
+    private:
+        // Longest line: D, 8 ID digits, DLC, 128 data digits, 4 timestamp
+        // digits and the carriage return.
+        static constexpr size_t line_size_ = 143;
+
+        // Size of the receive buffer. Must hold at least one line.
+        static constexpr size_t buffer_size_ = 160;
+
+        // Size of the buffer used to pack lines in writeMany().
+        static constexpr size_t write_size_ = 2 * line_size_;
+
+        Stream* stream_;
+        Controller<FrameType>* controller_;
+        Bitrate bitrate_;
+        uint8_t arbitration_;
+        uint8_t data_rate_;
+        bool open_;
+        bool listen_;
+        bool timestamps_;
+
+        // Read attributes. Bytes in [read_pos_, read_len_) have been read from
+        // the stream but not yet parsed. Bytes in [read_pos_, scan_pos_) are
+        // known not to contain a carriage return. Bytes are discarded up to
+        // the next carriage return while overflow_ is set.
+        char read_buffer_[buffer_size_];
+        size_t read_pos_;
+        size_t read_len_;
+        size_t scan_pos_;
+        bool overflow_;
+
+        // Move the available stream bytes into the receive buffer. Return
+        // true if any bytes were added.
+        bool fill();
+
+        // Handle the lines in the receive buffer until one yields a frame.
+        // Return false if the buffer does not hold a frame.
+        bool decode(FrameType* frame);
+
+        // Handle a single line without its carriage return. Return true if
+        // the line held a frame which was read into frame.
+        bool handle(const char* line, size_t len, FrameType* frame);
+
+        // Parse a frame line into frame. Return false if the line is invalid.
+        bool parseFrame(const char* line, size_t len, FrameType* frame);
+
+        // Open the channel at the selected rates. Return false on failure.
+        bool openChannel(bool listen);
+
+        // Send a reply to the host.
+        void reply(const char* text);
+
+        // Encode frame as a line into buffer which must hold at least
+        // line_size_ bytes. Return the encoded size or 0 if the frame cannot
+        // be encoded.
+        size_t encode(const FrameType& frame, char* buffer) const;
+};
+
+}  // namespace Canny
+
+#include "SLCAN.tpp"
+
+#endif  // _CANNY_SLCAN_H_
@@ -0,0 +1,384 @@
+namespace Canny {
+
+// Upper case hex digits used to encode lines.
+static const char kSLCANHex[] = "0123456789ABCDEF";
+
+// Payload length of each CAN FD DLC.
+static const uint8_t kSLCANLength[16] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 12, 16, 20, 24, 32, 48, 64};
+
+// Return the value of a hex digit or 0xFF if c is not a hex digit.
+inline uint8_t slcanNibble(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    c |= 0x20;
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    return 0xFF;
+}
+
+// Parse len hex digits into value. Return false if a digit is invalid.
+inline bool slcanHex(const char* text, size_t len, uint32_t* value) {
+    *value = 0;
+    for (size_t i = 0; i < len; ++i) {
+        uint8_t nibble = slcanNibble(text[i]);
+        if (nibble > 0x0F) {
+            return false;
+        }
+        *value = (*value << 4) | nibble;
+    }
+    return true;
+}
+
+// Return the DLC for a payload size or 0xFF if size is not a CAN FD length.
+inline uint8_t slcanDLC(uint8_t size) {
+    if (size <= 8) {
+        return size;
+    }
+    for (uint8_t dlc = 9; dlc < 16; ++dlc) {
+        if (kSLCANLength[dlc] == size) {
+            return dlc;
+        }
+    }
+    return 0xFF;
+}
+
+// Resolve an arbitration rate index (0=125K, 1=250K, 2=500K, 3=1M) and a data
+// rate in Mbit/s into a Bitrate. A data rate of 0 selects CAN 2.0. Return
+// false if the combination is not supported.
+inline bool slcanBitrate(uint8_t arbitration, uint8_t data, Bitrate* bitrate) {
+    if (data == 0) {
+        static const Bitrate rates[] = {CAN20_125K, CAN20_250K, CAN20_500K, CAN20_1000K};
+        *bitrate = rates[arbitration];
+        return true;
+    }
+    switch ((arbitration << 4) | data) {
+        case 0x11: *bitrate = CANFD_250K_1M; return true;
+        case 0x12: *bitrate = CANFD_250K_2M; return true;
+        case 0x13: *bitrate = CANFD_250K_3M; return true;
+        case 0x14: *bitrate = CANFD_250K_4M; return true;
+        case 0x21: *bitrate = CANFD_500K_1M; return true;
+        case 0x22: *bitrate = CANFD_500K_2M; return true;
+        case 0x23: *bitrate = CANFD_500K_3M; return true;
+        case 0x24: *bitrate = CANFD_500K_4M; return true;
+        case 0x25: *bitrate = CANFD_500K_5M; return true;
+        case 0x28: *bitrate = CANFD_500K_8M; return true;
+        case 0x34: *bitrate = CANFD_1000K_4M; return true;
+        case 0x38: *bitrate = CANFD_1000K_8M; return true;
+        default: return false;
+    }
+}
+
+template <typename FrameType>
+SLCAN<FrameType>::SLCAN(Stream* stream, Controller<FrameType>* controller) :
+    stream_(stream), controller_(controller), bitrate_(CAN20_500K), arbitration_(2),
+    data_rate_(0), open_(false), listen_(false), timestamps_(false), read_pos_(0),
+    read_len_(0), scan_pos_(0), overflow_(false) {}
+
+template <typename FrameType>
+Error SLCAN<FrameType>::read(FrameType* frame) {
+    if (!stream_) {
+        return ERR_FIFO;
+    }
+    while (true) {
+        if (decode(frame)) {
+            return ERR_OK;
+        }
+        if (!fill()) {
+            return ERR_FIFO;
+        }
+    }
+}
+
+template <typename FrameType>
+Error SLCAN<FrameType>::readMany(FrameType* frames, size_t max, size_t* n) {
+    *n = 0;
+    while (*n < max && read(frames + *n) == ERR_OK) {
+        ++*n;
+    }
+    return *n > 0 ? ERR_OK : ERR_FIFO;
+}
+
+template <typename FrameType>
+bool SLCAN<FrameType>::fill() {
+    if (read_pos_ > 0) {
+        memmove(read_buffer_, read_buffer_ + read_pos_, read_len_ - read_pos_);
+        read_len_ -= read_pos_;
+        scan_pos_ -= read_pos_;
+        read_pos_ = 0;
+    }
+    if (read_len_ >= buffer_size_) {
+        // The line does not fit. Drop it and reject it at its end.
+        overflow_ = true;
+        read_len_ = 0;
+        scan_pos_ = 0;
+    }
+    int available = stream_->available();
+    if (available <= 0) {
+        return false;
+    }
+    size_t n = buffer_size_ - read_len_;
+    if ((size_t)available < n) {
+        n = available;
+    }
+    n = stream_->readBytes(read_buffer_ + read_len_, n);
+    read_len_ += n;
+    return n > 0;
+}
+
+template <typename FrameType>
+bool SLCAN<FrameType>::decode(FrameType* frame) {
+    while (true) {
+        const char* end = (const char*)memchr(read_buffer_ + scan_pos_, '\r',
+                read_len_ - scan_pos_);
+        if (end == nullptr) {
+            scan_pos_ = read_len_;
+            return false;
+        }
+
+        const char* line = read_buffer_ + read_pos_;
+        const size_t len = end - line;
+        read_pos_ += len + 1;
+        scan_pos_ = read_pos_;
+
+        if (overflow_) {
+            overflow_ = false;
+            reply("\a");
+            continue;
+        }
+        // Tolerate line feeds left behind by hosts that send CRLF.
+        if (len > 0 && line[0] == '\n') {
+            ++line;
+            if (handle(line, len - 1, frame)) {
+                return true;
+            }
+        } else if (handle(line, len, frame)) {
+            return true;
+        }
+    }
+}
+
+template <typename FrameType>
+bool SLCAN<FrameType>::handle(const char* line, size_t len, FrameType* frame) {
+    if (len == 0) {
+        return false;
+    }
+    switch (line[0]) {
+        case 't':
+        case 'T':
+        case 'd':
+        case 'D':
+        case 'b':
+        case 'B':
+            if (open_ && !listen_ && parseFrame(line, len, frame)) {
+                reply(line[0] == 't' || line[0] == 'd' || line[0] == 'b' ? "z\r" : "Z\r");
+                return true;
+            }
+            break;
+        case 'S':
+            if (!open_ && len == 2 && (line[1] == '4' || line[1] == '5' ||
+                        line[1] == '6' || line[1] == '8')) {
+                arbitration_ = line[1] == '8' ? 3 : line[1] - '4';
+                reply("\r");
+                return false;
+            }
+            break;
+        case 'Y':
+            if (!open_ && len == 2 && line[1] >= '0' && line[1] <= '8') {
+                data_rate_ = line[1] - '0';
+                reply("\r");
+                return false;
+            }
+            break;
+        case 'O':
+        case 'L':
+            if (len == 1 && openChannel(line[0] == 'L')) {
+                reply("\r");
+                return false;
+            }
+            break;
+        case 'C':
+            if (len == 1) {
+                open_ = false;
+                listen_ = false;
+                reply("\r");
+                return false;
+            }
+            break;
+        case 'Z':
+            if (len == 2 && (line[1] == '0' || line[1] == '1')) {
+                timestamps_ = line[1] == '1';
+                reply("\r");
+                return false;
+            }
+            break;
+        case 'V':
+            if (len == 1) {
+                reply("V1013\r");
+                return false;
+            }
+            break;
+        case 'N':
+            if (len == 1) {
+                reply("NCNY1\r");
+                return false;
+            }
+            break;
+        case 'F':
+            if (len == 1) {
+                reply(open_ ? "F00\r" : "\a");
+                return false;
+            }
+            break;
+    }
+    reply("\a");
+    return false;
+}
+
+template <typename FrameType>
+bool SLCAN<FrameType>::parseFrame(const char* line, size_t len, FrameType* frame) {
+    const char type = line[0];
+    const bool ext = type == 'T' || type == 'D' || type == 'B';
+    const bool fd = type == 'd' || type == 'D' || type == 'b' || type == 'B';
+    const size_t id_len = ext ? 8 : 3;
+    if (len < 2 + id_len) {
+        return false;
+    }
+
+    uint32_t id;
+    if (!slcanHex(line + 1, id_len, &id) || id > (ext ? 0x1FFFFFFFu : 0x7FFu)) {
+        return false;
+    }
+    const uint8_t dlc = slcanNibble(line[1 + id_len]);
+    if (dlc > (fd ? 15 : 8)) {
+        return false;
+    }
+    const uint8_t size = kSLCANLength[dlc];
+    const char* data = line + 2 + id_len;
+    if (size > frame->capacity() || len != 2 + id_len + 2 * (size_t)size) {
+        return false;
+    }
+
+    frame->resize(size);
+    uint8_t* out = frame->data();
+    for (uint8_t i = 0; i < size; ++i) {
+        const uint8_t high = slcanNibble(data[2 * i]);
+        const uint8_t low = slcanNibble(data[2 * i + 1]);
+        if ((high | low) > 0x0F) {
+            return false;
+        }
+        out[i] = (high << 4) | low;
+    }
+    *frame->mutable_id() = id;
+    *frame->mutable_ext() = ext ? 1 : 0;
+    stampFrame(frame);
+    return true;
+}
+
+template <typename FrameType>
+bool SLCAN<FrameType>::openChannel(bool listen) {
+    Bitrate bitrate;
+    if (open_ || !slcanBitrate(arbitration_, data_rate_, &bitrate)) {
+        return false;
+    }
+    if (controller_ && !controller_->begin(bitrate)) {
+        return false;
+    }
+    bitrate_ = bitrate;
+    open_ = true;
+    listen_ = listen;
+    return true;
+}
+
+template <typename FrameType>
+void SLCAN<FrameType>::reply(const char* text) {
+    stream_->write((const uint8_t*)text, strlen(text));
+}
+
+template <typename FrameType>
+size_t SLCAN<FrameType>::encode(const FrameType& frame, char* buffer) const {
+    const uint8_t size = frame.size();
+    const uint8_t dlc = slcanDLC(size);
+    if (dlc > 15) {
+        return 0;
+    }
+
+    char* p = buffer;
+    const uint32_t id = frame.id();
+    if (frame.ext()) {
+        *p++ = size > 8 ? 'D' : 'T';
+        for (int shift = 28; shift >= 0; shift -= 4) {
+            *p++ = kSLCANHex[(id >> shift) & 0x0F];
+        }
+    } else {
+        *p++ = size > 8 ? 'd' : 't';
+        *p++ = kSLCANHex[(id >> 8) & 0x07];
+        *p++ = kSLCANHex[(id >> 4) & 0x0F];
+        *p++ = kSLCANHex[id & 0x0F];
+    }
+    *p++ = kSLCANHex[dlc];
+
+    const uint8_t* data = frame.data();
+    for (uint8_t i = 0; i < size; ++i) {
+        *p++ = kSLCANHex[data[i] >> 4];
+        *p++ = kSLCANHex[data[i] & 0x0F];
+    }
+
+    if (timestamps_) {
+        // Timestamps are in milliseconds and wrap each minute.
+        uint32_t time = FrameTraits<FrameType>::timestamped ?
+            frameTimestamp(frame) / 1000 : millis();
+        time %= 60000;
+        *p++ = kSLCANHex[(time >> 12) & 0x0F];
+        *p++ = kSLCANHex[(time >> 8) & 0x0F];
+        *p++ = kSLCANHex[(time >> 4) & 0x0F];
+        *p++ = kSLCANHex[time & 0x0F];
+    }
+    *p++ = '\r';
+    return p - buffer;
+}
+
+template <typename FrameType>
+Error SLCAN<FrameType>::write(const FrameType& frame) {
+    if (!stream_ || !open_) {
+        return ERR_READY;
+    }
+    char buffer[line_size_];
+    size_t len = encode(frame, buffer);
+    if (len == 0) {
+        return ERR_INVALID;
+    }
+    stream_->write((const uint8_t*)buffer, len);
+    return ERR_OK;
+}
+
+template <typename FrameType>
+Error SLCAN<FrameType>::writeMany(const FrameType* frames, size_t count, size_t* n) {
+    *n = 0;
+    if (!stream_ || !open_) {
+        return ERR_READY;
+    }
+    char buffer[write_size_];
+    size_t len = 0;
+    Error err = ERR_OK;
+    while (*n < count) {
+        if (len + line_size_ > write_size_) {
+            stream_->write((const uint8_t*)buffer, len);
+            len = 0;
+        }
+        size_t encoded = encode(frames[*n], buffer + len);
+        if (encoded == 0) {
+            err = ERR_INVALID;
+            break;
+        }
+        len += encoded;
+        ++*n;
+    }
+    if (len > 0) {
+        stream_->write((const uint8_t*)buffer, len);
+    }
+    return err;
+}
+
+}  // namespace Canny
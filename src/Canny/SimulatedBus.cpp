@@ -0,0 +1,199 @@
+#include "SimulatedBus.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+namespace {
+
+// Increase of the transmit error counter for each failed transmission.
+const uint16_t kTransmitErrorStep = 8;
+
+// Transmit error counter value above which a node goes bus-off.
+const uint16_t kBusOffThreshold = 255;
+
+// Return the arbitration key of a frame. Lower keys win. Frames are ordered by
+// the 11-bit base ID, then the SRR/IDE bit which is dominant for standard
+// frames, then the 18-bit ID extension.
+uint32_t arbitrationKey(const CANFDFrame& frame) {
+    if (frame.ext() == 1) {
+        uint32_t id = frame.id() & 0x1FFFFFFF;
+        return ((id >> 18) << 19) | (1UL << 18) | (id & 0x3FFFF);
+    }
+    return (frame.id() & 0x7FF) << 19;
+}
+
+}  // namespace
+
+SimulatedBus::SimulatedBus(Bitrate bitrate, Mode mode) :
+    bitrate_(bitrate), mode_(mode), timing_(bitrate, mode, Stuffing::EXACT),
+    nodes_(nullptr), now_(0), end_(0), sender_(nullptr), corrupt_(false),
+    error_rate_(0), random_(1), frames_(0), errors_(0), busy_(0) {}
+
+SimulatedBus::~SimulatedBus() {
+    while (nodes_ != nullptr) {
+        SimulatedNode* node = nodes_;
+        nodes_ = node->next_;
+        node->bus_ = nullptr;
+        node->next_ = nullptr;
+    }
+}
+
+void SimulatedBus::advance(uint32_t duration) {
+    uint64_t target = now_ + duration;
+    while (sender_ != nullptr || arbitrate()) {
+        if (end_ > target) {
+            break;
+        }
+        now_ = end_;
+        complete();
+    }
+    now_ = target;
+}
+
+void SimulatedBus::run() {
+    while (sender_ != nullptr || arbitrate()) {
+        now_ = end_;
+        complete();
+    }
+}
+
+bool SimulatedBus::idle() {
+    if (sender_ != nullptr) {
+        return false;
+    }
+    for (SimulatedNode* node = nodes_; node != nullptr; node = node->next_) {
+        if (node->pending()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SimulatedBus::attach(SimulatedNode* node) {
+    node->next_ = nodes_;
+    nodes_ = node;
+}
+
+void SimulatedBus::detach(SimulatedNode* node) {
+    if (sender_ == node) {
+        sender_ = nullptr;
+    }
+    SimulatedNode** next = &nodes_;
+    while (*next != nullptr) {
+        if (*next == node) {
+            *next = node->next_;
+            node->next_ = nullptr;
+            return;
+        }
+        next = &(*next)->next_;
+    }
+}
+
+bool SimulatedBus::arbitrate() {
+    SimulatedNode* winner = nullptr;
+    uint32_t winner_key = 0;
+    for (SimulatedNode* node = nodes_; node != nullptr; node = node->next_) {
+        if (!node->pending()) {
+            continue;
+        }
+        uint32_t key = arbitrationKey(*node->tx_.front());
+        if (winner == nullptr || key < winner_key) {
+            winner = node;
+            winner_key = key;
+        }
+    }
+    if (winner == nullptr) {
+        return false;
+    }
+
+    uint32_t time = timing_.frameTime(*winner->tx_.front());
+    sender_ = winner;
+    end_ = now_ + time;
+    busy_ += time;
+    corrupt_ = chance(error_rate_);
+    return true;
+}
+
+void SimulatedBus::complete() {
+    SimulatedNode* sender = sender_;
+    sender_ = nullptr;
+
+    if (corrupt_) {
+        // The frame is retransmitted when the sender next wins arbitration.
+        ++errors_;
+        sender->tec_ += kTransmitErrorStep;
+        if (sender->tec_ > kBusOffThreshold) {
+            sender->bus_off_ = true;
+        }
+        return;
+    }
+
+    const CANFDFrame* frame = sender->tx_.front();
+    for (SimulatedNode* node = nodes_; node != nullptr; node = node->next_) {
+        if (node == sender || !node->started_ || node->bus_off_) {
+            continue;
+        }
+        if (chance(node->drop_rate_)) {
+            ++node->dropped_;
+            continue;
+        }
+        TimestampedFrame<CANFDFrame>* slot = node->rx_.back();
+        if (slot == nullptr) {
+            ++node->overruns_;
+            continue;
+        }
+        *slot = TimestampedFrame<CANFDFrame>(*frame, now_ / 1000);
+        node->rx_.push();
+        ++node->received_;
+    }
+
+    sender->tx_.pop();
+    ++sender->transmitted_;
+    if (sender->tec_ > 0) {
+        --sender->tec_;
+    }
+    ++frames_;
+}
+
+bool SimulatedBus::chance(uint16_t rate) {
+    if (rate == 0) {
+        return false;
+    }
+    // xorshift32
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 17;
+    random_ ^= random_ << 5;
+    return random_ % 1000 < rate;
+}
+
+SimulatedNode::SimulatedNode(SimulatedBus* bus, uint8_t tx_depth, uint8_t rx_depth) :
+    bus_(bus), next_(nullptr), tx_(tx_depth), rx_(rx_depth), started_(false),
+    bus_off_(false), tec_(0), drop_rate_(0), transmitted_(0), received_(0),
+    overruns_(0), dropped_(0) {
+    if (bus_ != nullptr) {
+        bus_->attach(this);
+    }
+}
+
+SimulatedNode::~SimulatedNode() {
+    if (bus_ != nullptr) {
+        bus_->detach(this);
+    }
+}
+
+void SimulatedNode::recover() {
+    bus_off_ = false;
+    tec_ = 0;
+}
+
+Error SimulatedNode::transmit(const CANFDFrame& frame) {
+    if (bus_ == nullptr || !started_ || bus_off_) {
+        return ERR_READY;
+    }
+    if (!tx_.push(frame)) {
+        return ERR_FIFO;
+    }
+    return ERR_OK;
+}
+
+}  // namespace Canny
@@ -0,0 +1,188 @@
+#ifndef _CANNY_SIMULATED_BUS_H_
+#define _CANNY_SIMULATED_BUS_H_
+
+#include <Arduino.h>
+#include "BusLoad.h"
+#include "Controller.h"
+#include "Error.h"
+#include "Frame.h"
+#include "FrameQueue.h"
+
+namespace Canny {
+
+class SimulatedNode;
+
+// A virtual CAN bus for testing without hardware. Nodes attached to the bus
+// queue frames in their transmit mailboxes. When the bus is idle the pending
+// frame with the lowest ID wins arbitration and occupies the bus for its wire
+// time before it is delivered to the receive mailbox of every other node.
+//
+// Time on the bus is virtual. It only moves when advance() or run() is called
+// so simulations run as fast as the host allows and are repeatable. Random
+// faults are drawn from a seeded generator and are also repeatable.
+class SimulatedBus {
+    public:
+        // Construct a bus running at the given bitrate and mode. Wire time is
+        // computed with exact bit stuffing.
+        SimulatedBus(Bitrate bitrate, Mode mode);
+        ~SimulatedBus();
+
+        // Return the bitrate of the bus.
+        Bitrate bitrate() const { return bitrate_; }
+
+        // Return the mode of the bus.
+        Mode mode() const { return mode_; }
+
+        // Return the virtual time in nanoseconds since the bus was created.
+        uint64_t now() const { return now_; }
+
+        // Advance virtual time by duration nanoseconds, transmitting every
+        // frame that completes in that time.
+        void advance(uint32_t duration);
+
+        // Advance virtual time until no node has a frame to transmit. Nodes
+        // that are bus-off are ignored.
+        void run();
+
+        // Return true if no frame is being transmitted or waiting to be.
+        bool idle();
+
+        // Corrupt transmissions with a probability of rate / 1000. A corrupted
+        // frame occupies the bus for its full wire time, is not delivered,
+        // and is retransmitted by its sender. Each failure raises the
+        // sender's transmit error counter and enough failures put it into
+        // bus-off.
+        void errorRate(uint16_t rate) { error_rate_ = rate; }
+
+        // Seed the fault generator.
+        void seed(uint32_t seed) { random_ = seed == 0 ? 1 : seed; }
+
+        // Return the number of frames transmitted successfully.
+        uint32_t frames() const { return frames_; }
+
+        // Return the number of corrupted transmissions.
+        uint32_t errors() const { return errors_; }
+
+        // Return the total time in nanoseconds the bus has spent transmitting.
+        uint64_t busy() const { return busy_; }
+
+    private:
+        friend class SimulatedNode;
+
+        void attach(SimulatedNode* node);
+        void detach(SimulatedNode* node);
+
+        // Select the next frame to transmit. Return false if nothing is
+        // pending.
+        bool arbitrate();
+
+        // Finish the frame being transmitted.
+        void complete();
+
+        // Return true with a probability of rate / 1000.
+        bool chance(uint16_t rate);
+
+        Bitrate bitrate_;
+        Mode mode_;
+        BusLoad timing_;
+        SimulatedNode* nodes_;
+
+        uint64_t now_;
+        uint64_t end_;
+        SimulatedNode* sender_;
+        bool corrupt_;
+
+        uint16_t error_rate_;
+        uint32_t random_;
+        uint32_t frames_;
+        uint32_t errors_;
+        uint64_t busy_;
+};
+
+// A node attached to a simulated bus. A node has a FIFO transmit mailbox and
+// a FIFO receive mailbox of fixed depth. Writes fail with ERR_FIFO when the
+// transmit mailbox is full and received frames are lost when the receive
+// mailbox is full, as on a real controller that is not serviced quickly
+// enough.
+//
+// This is the bus facing half of a SimulatedController.
+class SimulatedNode {
+    public:
+        // Construct a node attached to bus.
+        SimulatedNode(SimulatedBus* bus, uint8_t tx_depth, uint8_t rx_depth);
+        virtual ~SimulatedNode();
+
+        // Return the bus the node is attached to.
+        SimulatedBus* bus() const { return bus_; }
+
+        // Put the node into bus-off. A bus-off node does not transmit or
+        // receive frames. Frames in its transmit mailbox are kept.
+        void busOff() { bus_off_ = true; }
+
+        // Recover from bus-off and reset the transmit error counter.
+        void recover();
+
+        // Return true if the node is bus-off.
+        bool isBusOff() const { return bus_off_; }
+
+        // Return the transmit error counter.
+        uint16_t transmitErrors() const { return tec_; }
+
+        // Drop received frames with a probability of rate / 1000 before they
+        // reach the receive mailbox.
+        void dropRate(uint16_t rate) { drop_rate_ = rate; }
+
+        // Return the number of frames transmitted by the node.
+        uint32_t transmitted() const { return transmitted_; }
+
+        // Return the number of frames placed in the receive mailbox.
+        uint32_t received() const { return received_; }
+
+        // Return the number of frames lost because the receive mailbox was
+        // full.
+        uint32_t overruns() const { return overruns_; }
+
+        // Return the number of received frames dropped by fault injection.
+        uint32_t dropped() const { return dropped_; }
+
+    protected:
+        // Return true once the node is started.
+        bool started() const { return started_; }
+
+        // Start participating on the bus.
+        void start() { started_ = true; }
+
+        // Queue a frame for transmission.
+        Error transmit(const CANFDFrame& frame);
+
+        // Return the oldest received frame or nullptr if there is none. The
+        // frame is stamped with the virtual time in microseconds at which it
+        // finished transmitting.
+        TimestampedFrame<CANFDFrame>* receive() { return rx_.front(); }
+
+        // Release the frame returned by receive().
+        void release() { rx_.pop(); }
+
+    private:
+        friend class SimulatedBus;
+
+        // Return true if the node has a frame to transmit.
+        bool pending() const { return started_ && !bus_off_ && !tx_.empty(); }
+
+        SimulatedBus* bus_;
+        SimulatedNode* next_;
+        FrameQueue<CANFDFrame> tx_;
+        FrameQueue<TimestampedFrame<CANFDFrame>> rx_;
+        bool started_;
+        bool bus_off_;
+        uint16_t tec_;
+        uint16_t drop_rate_;
+        uint32_t transmitted_;
+        uint32_t received_;
+        uint32_t overruns_;
+        uint32_t dropped_;
+};
+
+}  // namespace Canny
+
+#endif  // _CANNY_SIMULATED_BUS_H_
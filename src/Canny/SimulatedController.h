@@ -0,0 +1,53 @@
+#ifndef _CANNY_SIMULATED_CONTROLLER_H_
+#define _CANNY_SIMULATED_CONTROLLER_H_
+
+#include <Arduino.h>
+#include "Controller.h"
+#include "Error.h"
+#include "SimulatedBus.h"
+
+namespace Canny {
+
+// A CAN controller attached to a SimulatedBus. Frames written to the
+// controller are queued in its transmit mailbox and sent when the bus is
+// advanced. Frames sent by other controllers are read from its receive
+// mailbox. TimestampedFrame frames are stamped with the virtual bus time in
+// microseconds at which they finished transmitting.
+//
+// The default mailbox depths match the MCP2515.
+template <typename FrameType>
+class SimulatedController : public Controller<FrameType>, public SimulatedNode {
+    public:
+        // Construct a controller attached to bus.
+        SimulatedController(SimulatedBus* bus, uint8_t tx_depth = 3, uint8_t rx_depth = 2) :
+            SimulatedNode(bus, tx_depth, rx_depth) {}
+
+        // Start the controller. Return false if bitrate does not match the
+        // bus or the controller is not attached to a bus.
+        bool begin(Bitrate bitrate) override;
+
+        // Return the mode of the bus.
+        Mode mode() const override;
+
+        // Return the bitrate of the bus.
+        Bitrate bitrate() const override;
+
+        // Read a frame from the receive mailbox.
+        //
+        // Return ERR_READY if the controller has not been started or
+        // ERR_FIFO if the mailbox is empty.
+        Error read(FrameType* frame) override;
+
+        // Queue a frame in the transmit mailbox.
+        //
+        // Return ERR_READY if the controller has not been started or is
+        // bus-off, ERR_INVALID if the frame is too large for the bus mode,
+        // or ERR_FIFO if the mailbox is full.
+        Error write(const FrameType& frame) override;
+};
+
+}  // namespace Canny
+
+#include "SimulatedController.tpp"
+
+#endif  // _CANNY_SIMULATED_CONTROLLER_H_
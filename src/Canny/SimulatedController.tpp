@@ -0,0 +1,50 @@
+namespace Canny {
+
+template <typename FrameType>
+bool SimulatedController<FrameType>::begin(Bitrate bitrate) {
+    if (bus() == nullptr || bitrate != bus()->bitrate()) {
+        return false;
+    }
+    start();
+    return true;
+}
+
+template <typename FrameType>
+Mode SimulatedController<FrameType>::mode() const {
+    return bus() == nullptr ? CAN20 : bus()->mode();
+}
+
+template <typename FrameType>
+Bitrate SimulatedController<FrameType>::bitrate() const {
+    return bus() == nullptr ? CAN20_125K : bus()->bitrate();
+}
+
+template <typename FrameType>
+Error SimulatedController<FrameType>::read(FrameType* frame) {
+    if (!started()) {
+        return ERR_READY;
+    }
+    TimestampedFrame<CANFDFrame>* next = receive();
+    if (next == nullptr) {
+        return ERR_FIFO;
+    }
+    frame->copyFrom(*next);
+    stampFrame(frame, next->timestamp());
+    release();
+    return ERR_OK;
+}
+
+template <typename FrameType>
+Error SimulatedController<FrameType>::write(const FrameType& frame) {
+    if (!started()) {
+        return ERR_READY;
+    }
+    if (frame.size() > (mode() == CAN20 ? 8 : 64)) {
+        return ERR_INVALID;
+    }
+    CANFDFrame copy;
+    copy.copyFrom(frame);
+    return transmit(copy);
+}
+
+}  // namespace Canny
@@ -0,0 +1,95 @@
+#include "Stats.h"
+
+#include <Arduino.h>
+
+namespace Canny {
+namespace {
+
+const char* const kErrorNames[5] = {
+    "ok",
+    "fifo",
+    "ready",
+    "invalid",
+    "internal",
+};
+
+size_t printCounter(Print& p, const char* name, uint32_t value) {
+    if (value == 0) {
+        return 0;
+    }
+    size_t n = 0;
+    n += p.print(name);
+    n += p.print('=');
+    n += p.print(value);
+    n += p.print(' ');
+    return n;
+}
+
+size_t printErrors(Print& p, const char* prefix, const uint32_t* errors) {
+    size_t n = 0;
+    for (uint8_t i = 1; i < 5; ++i) {
+        if (errors[i] != 0) {
+            n += p.print(prefix);
+            n += printCounter(p, kErrorNames[i], errors[i]);
+        }
+    }
+    return n;
+}
+
+size_t printHistogram(Print& p, const char* name, const uint32_t* buckets) {
+    uint8_t last = StatsBuckets;
+    for (uint8_t i = 0; i < StatsBuckets; ++i) {
+        if (buckets[i] != 0) {
+            last = i;
+        }
+    }
+    if (last == StatsBuckets) {
+        return 0;
+    }
+    size_t n = 0;
+    n += p.print(name);
+    n += p.print("=[");
+    for (uint8_t i = 0; i <= last; ++i) {
+        if (i > 0) {
+            n += p.print(',');
+        }
+        n += p.print(buckets[i]);
+    }
+    n += p.print("] ");
+    return n;
+}
+
+}  // namespace
+
+void ConnectionStats::clear() {
+    memset(this, 0, sizeof(ConnectionStats));
+}
+
+size_t ConnectionStats::printTo(Print& p) const {
+    size_t n = 0;
+    n += printCounter(p, "frames_in", frames_in);
+    n += printCounter(p, "frames_out", frames_out);
+    n += printCounter(p, "bytes_in", bytes_in);
+    n += printCounter(p, "bytes_out", bytes_out);
+    n += printErrors(p, "read_", read_errors);
+    n += printErrors(p, "write_", write_errors);
+    n += printCounter(p, "filtered_in", filtered_in);
+    n += printCounter(p, "filtered_out", filtered_out);
+    n += printCounter(p, "overflow", overflow);
+    n += printCounter(p, "read_high_water", read_high_water);
+    n += printCounter(p, "write_high_water", write_high_water);
+    n += printHistogram(p, "read_time", read_time);
+    n += printHistogram(p, "residency", residency);
+    return n;
+}
+
+uint8_t statsBucket(uint32_t duration) {
+    uint8_t bucket = 0;
+    while (duration != 0 && bucket < StatsBuckets - 1) {
+        duration >>= 1;
+        ++bucket;
+    }
+    return bucket;
+}
+
+}  // namespace Canny
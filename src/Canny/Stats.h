@@ -0,0 +1,237 @@
+#ifndef _CANNY_STATS_H_
+#define _CANNY_STATS_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Error.h"
+
+// Statistics are only recorded when CANNY_STATS is defined. Otherwise the
+// recording calls compile to nothing and snapshots are always zero. Define
+// CANNY_STATS in the build flags, or before including any Canny header in
+// every file that uses the library, so that all files agree.
+
+namespace Canny {
+
+// The number of buckets in a latency histogram. Bucket 0 counts durations of
+// 0us. Bucket n counts durations of [2^(n-1), 2^n) microseconds. The last
+// bucket also counts all longer durations.
+const uint8_t StatsBuckets = 16;
+
+// The most buffered frames whose residency is timed at once. Frames buffered
+// beyond this are counted but not timed.
+const size_t StatsResidencyFrames = 64;
+
+// A snapshot of the statistics recorded for a connection. Frames and bytes
+// are counted where they cross the connection: frames returned by read() are
+// in, frames accepted by the child are out. Errors are indexed by their Error
+// value; index 0 is unused.
+struct ConnectionStats {
+    uint32_t frames_in;
+    uint32_t frames_out;
+    uint32_t bytes_in;
+    uint32_t bytes_out;
+    uint32_t read_errors[5];
+    uint32_t write_errors[5];
+    uint32_t filtered_in;       // Frames dropped by the read filter.
+    uint32_t filtered_out;      // Frames dropped by the write filter.
+    uint32_t overflow;          // Frames dropped because a buffer was full.
+    uint16_t read_high_water;   // Most frames held in the read buffer.
+    uint16_t write_high_water;  // Most frames held in the write buffer.
+    uint32_t read_time[StatsBuckets];   // Duration of read() calls.
+    uint32_t residency[StatsBuckets];   // Time frames spent in a FIFO write buffer.
+
+    // Reset all statistics to zero.
+    void clear();
+
+    // Write a human readable representation of the statistics to a print
+    // object. Empty counters and histograms are omitted. Return the number
+    // of bytes written.
+    size_t printTo(Print& p) const;
+};
+
+// Return the histogram bucket for a duration in microseconds.
+uint8_t statsBucket(uint32_t duration);
+
+#ifdef CANNY_STATS
+
+// Records statistics for a connection.
+class StatsRecorder {
+    public:
+        StatsRecorder() : times_(nullptr), times_size_(0), times_head_(0), times_len_(0),
+                untimed_(0) {
+            stats_.clear();
+        }
+
+        ~StatsRecorder() {
+            if (times_ != nullptr) {
+                delete[] times_;
+            }
+        }
+
+        // Track the residency of up to size buffered frames. Frames buffered
+        // while the tracker is full are not timed.
+        void reserve(size_t size) {
+            if (times_ != nullptr) {
+                delete[] times_;
+            }
+            times_ = size > 0 ? new uint32_t[size] : nullptr;
+            times_size_ = size;
+            times_head_ = 0;
+            times_len_ = 0;
+            untimed_ = 0;
+        }
+
+        // Return the start time of an operation.
+        uint32_t start() const { return micros(); }
+
+        // Record a read that began at start.
+        void read(Error err, uint8_t size, uint32_t start) {
+            ++stats_.read_time[statsBucket(micros() - start)];
+            read(err, size);
+        }
+
+        // Record a read without timing it.
+        void read(Error err, uint8_t size) {
+            if (err == ERR_OK) {
+                ++stats_.frames_in;
+                stats_.bytes_in += size;
+            } else if (err < 5) {
+                ++stats_.read_errors[err];
+            }
+        }
+
+        // Record a write.
+        void write(Error err, uint8_t size) {
+            if (err == ERR_OK) {
+                ++stats_.frames_out;
+                stats_.bytes_out += size;
+            } else if (err < 5) {
+                ++stats_.write_errors[err];
+            }
+        }
+
+        // Record a frame dropped by the read filter.
+        void filteredIn() { ++stats_.filtered_in; }
+
+        // Record a frame dropped by the write filter.
+        void filteredOut() { ++stats_.filtered_out; }
+
+        // Record a frame dropped because a buffer was full.
+        void overflow() { ++stats_.overflow; }
+
+        // Record the number of frames in the read buffer.
+        void readDepth(size_t depth) {
+            if (depth > stats_.read_high_water) {
+                stats_.read_high_water = depth > 0xFFFF ? 0xFFFF : depth;
+            }
+        }
+
+        // Record the number of frames in the write buffer.
+        void writeDepth(size_t depth) {
+            if (depth > stats_.write_high_water) {
+                stats_.write_high_water = depth > 0xFFFF ? 0xFFFF : depth;
+            }
+        }
+
+        // Record a frame added to the write buffer.
+        void enqueued() {
+            // Once a frame goes untimed the frames behind it are untimed too
+            // so that the timed frames stay at the front of the buffer.
+            if (untimed_ == 0 && times_len_ < times_size_) {
+                size_t tail = times_head_ + times_len_;
+                times_[tail >= times_size_ ? tail - times_size_ : tail] = micros();
+                ++times_len_;
+            } else {
+                ++untimed_;
+            }
+        }
+
+        // Record a frame removed from the write buffer. Residency is measured
+        // in the order frames were added so only FIFO buffers should reserve
+        // room to time it.
+        void dequeued() {
+            if (times_len_ > 0) {
+                ++stats_.residency[statsBucket(micros() - times_[times_head_])];
+                if (++times_head_ >= times_size_) {
+                    times_head_ = 0;
+                }
+                --times_len_;
+            } else if (untimed_ > 0) {
+                --untimed_;
+            }
+        }
+
+        // Copy the recorded statistics.
+        void snapshot(ConnectionStats* stats) const { *stats = stats_; }
+
+        // Reset the recorded statistics.
+        void clear() { stats_.clear(); }
+
+    private:
+        ConnectionStats stats_;
+        uint32_t* times_;
+        size_t times_size_;
+        size_t times_head_;
+        size_t times_len_;
+        size_t untimed_;
+};
+
+#else
+
+// Statistics are disabled. Every call is a no-op.
+class StatsRecorder {
+    public:
+        void reserve(size_t) {}
+        uint32_t start() const { return 0; }
+        void read(Error, uint8_t, uint32_t) {}
+        void read(Error, uint8_t) {}
+        void write(Error, uint8_t) {}
+        void filteredIn() {}
+        void filteredOut() {}
+        void overflow() {}
+        void readDepth(size_t) {}
+        void writeDepth(size_t) {}
+        void enqueued() {}
+        void dequeued() {}
+        void snapshot(ConnectionStats* stats) const { stats->clear(); }
+        void clear() {}
+};
+
+#endif  // CANNY_STATS
+
+// Records statistics for the frames passing through a child connection.
+template <typename FrameType>
+class StatsConnection : public Connection<FrameType> {
+    public:
+        // Construct a connection that records statistics for child.
+        StatsConnection(Connection<FrameType>* child) : child_(child) {}
+
+        // Read a frame from the child and record the result and duration.
+        Error read(FrameType* frame) override {
+            uint32_t start = stats_.start();
+            Error err = child_->read(frame);
+            stats_.read(err, frame->size(), start);
+            return err;
+        }
+
+        // Write a frame to the child and record the result.
+        Error write(const FrameType& frame) override {
+            Error err = child_->write(frame);
+            stats_.write(err, frame.size());
+            return err;
+        }
+
+        // Copy the recorded statistics.
+        void stats(ConnectionStats* stats) const { stats_.snapshot(stats); }
+
+        // Reset the recorded statistics.
+        void clearStats() { stats_.clear(); }
+
+    private:
+        Connection<FrameType>* child_;
+        StatsRecorder stats_;
+};
+
+}  // namespace Canny
+
+#endif  // _CANNY_STATS_H_
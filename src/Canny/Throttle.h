@@ -0,0 +1,148 @@
+#ifndef _CANNY_THROTTLE_H_
+#define _CANNY_THROTTLE_H_
+
+#include <Arduino.h>
+#include "Connection.h"
+#include "Error.h"
+#include "FrameIndex.h"
+#include "RealDash.h"
+
+namespace Canny {
+
+// The last frame written for an ID.
+template <typename FrameType>
+struct ThrottleEntry {
+    // The last frame written with this ID. Holds the newest frame while the
+    // entry is pending.
+    FrameType frame;
+    // The value of micros() when the frame was sent to the child.
+    uint32_t sent;
+    // The state of the entry. See Throttle::State.
+    uint8_t state;
+};
+
+// Reduces the frames written to a slow child connection such as RealDash over
+// serial. A frame is only written when its payload differs from the last frame
+// written with its ID or when the refresh interval for that ID has passed.
+// Repeated frames inside the interval are dropped and reported as written.
+//
+// Output may be limited to a budget of bytes per second. Changed frames take
+// priority over refreshes: a refresh is only sent when no changed frames are
+// waiting and half of the burst allowance is left over. A changed frame that
+// does not fit in the budget is held, replaced by newer frames with the same
+// ID, and sent by a later write(), read() or flush() in the order the IDs
+// first changed.
+//
+// The throttle tracks a fixed number of IDs. Frames with new IDs are passed
+// through subject to the budget once the table is full.
+template <typename FrameType>
+class Throttle : public Connection<FrameType> {
+    public:
+        typedef ThrottleEntry<FrameType> Entry;
+
+        // Construct a throttle that writes to child and tracks up to capacity
+        // IDs. Unchanged frames are repeated every refresh microseconds. Each
+        // frame costs overhead bytes plus its payload padded to 8 bytes, as
+        // RealDash sends it, against a budget of budget bytes per second. A
+        // budget of 0 disables the limit.
+        Throttle(Connection<FrameType>* child, size_t capacity, uint32_t refresh,
+                uint32_t budget = 0, uint8_t overhead = RealDashOverhead);
+        ~Throttle();
+
+        // Send held frames and then read a frame from the child.
+        Error read(FrameType* frame) override;
+
+        // Write a frame to the child if it changed or is due for a refresh.
+        // Return ERR_OK if the frame was written, dropped as a repeat, or held
+        // until the budget allows. Return ERR_FIFO if the ID is not tracked
+        // and the frame does not fit in the budget. Otherwise return the
+        // result of the child write.
+        Error write(const FrameType& frame) override;
+
+        // Send held frames as the budget allows.
+        void flush();
+
+        // Set the refresh interval in microseconds.
+        void refresh(uint32_t refresh) { refresh_ = refresh; }
+
+        // Return the refresh interval in microseconds.
+        uint32_t refresh() const { return refresh_; }
+
+        // Return the budget in bytes per second. 0 means unlimited.
+        uint32_t budget() const { return budget_; }
+
+        // Return the entry for an ID or nullptr if the ID is not tracked.
+        const Entry* find(uint32_t id, uint8_t ext) const;
+
+        // Return the number of frames written to the child.
+        uint32_t sent() const { return sent_; }
+
+        // Return the number of frames dropped as repeats.
+        uint32_t suppressed() const { return suppressed_; }
+
+        // Return the number of frames held for the budget.
+        size_t pending() const { return pending_len_; }
+
+        // Return the number of IDs tracked.
+        size_t size() const { return len_; }
+
+        // Return the maximum number of IDs that can be tracked.
+        size_t capacity() const { return capacity_; }
+
+        // Forget all IDs and drop held frames.
+        void clear();
+
+    private:
+        enum State : uint8_t {
+            UNSENT,     // No frame has been sent for the ID.
+            SENT,       // The frame has been sent.
+            PENDING,    // The frame is held for the budget.
+        };
+
+        // Return the budget cost of a frame in bytes.
+        uint32_t cost(const FrameType& frame) const {
+            return overhead_ + (frame.size() < 8 ? 8 : frame.size());
+        }
+
+        // Take cost bytes from the budget. A refresh must leave the reserve in
+        // place. Return false if the budget does not allow it.
+        bool spend(uint32_t cost, bool refresh);
+
+        // Return cost bytes to the budget.
+        void refund(uint32_t cost);
+
+        // Write a frame to the child and update its entry.
+        Error send(Entry* entry, const FrameType& frame);
+
+        // Return the entry for a frame, adding one if there is room. Return
+        // nullptr if the table is full.
+        Entry* lookup(const FrameType& frame);
+
+        Connection<FrameType>* child_;
+        uint32_t refresh_;
+        uint32_t budget_;
+        uint8_t overhead_;
+
+        uint64_t credit_;       // Budget in bytes scaled by 1000000.
+        uint64_t burst_;        // Maximum credit.
+        uint32_t refill_time_;  // The value of micros() when credit was added.
+
+        Entry* entries_;
+        size_t capacity_;
+        size_t len_;
+
+        FrameIndex index_;  // Map of IDs to entries.
+
+        size_t* pending_;   // Ring of held entries.
+        size_t pending_head_;
+        size_t pending_len_;
+
+        uint32_t sent_;
+        uint32_t suppressed_;
+};
+
+}  // namespace Canny
+
+#include "Throttle.tpp"
+
+#endif  // _CANNY_THROTTLE_H_
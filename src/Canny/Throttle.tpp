@@ -0,0 +1,194 @@
+namespace Canny {
+namespace {
+
+// Budget credit per byte.
+const uint64_t kThrottleScale = 1000000;
+
+}  // namespace
+
+template <typename FrameType>
+Throttle<FrameType>::Throttle(Connection<FrameType>* child, size_t capacity, uint32_t refresh,
+        uint32_t budget, uint8_t overhead) :
+        child_(child), refresh_(refresh), budget_(budget), overhead_(overhead),
+        credit_(0), burst_(0), refill_time_(micros()),
+        entries_(nullptr), capacity_(capacity), len_(0),
+        index_(capacity), pending_(nullptr), pending_head_(0), pending_len_(0),
+        sent_(0), suppressed_(0) {
+    // allow bursts of 50ms but always at least two of the largest frames
+    uint32_t burst = budget_ / 20;
+    if (burst < 2 * (overhead_ + 64U)) {
+        burst = 2 * (overhead_ + 64U);
+    }
+    burst_ = burst * kThrottleScale;
+    credit_ = burst_;
+
+    if (capacity_ > 0) {
+        entries_ = new Entry[capacity_];
+        pending_ = new size_t[capacity_];
+    }
+    clear();
+}
+
+template <typename FrameType>
+Throttle<FrameType>::~Throttle() {
+    if (entries_ != nullptr) {
+        delete[] entries_;
+    }
+    if (pending_ != nullptr) {
+        delete[] pending_;
+    }
+}
+
+template <typename FrameType>
+Error Throttle<FrameType>::read(FrameType* frame) {
+    flush();
+    return child_->read(frame);
+}
+
+template <typename FrameType>
+Error Throttle<FrameType>::write(const FrameType& frame) {
+    flush();
+
+    Entry* entry = lookup(frame);
+    if (entry == nullptr) {
+        if (!spend(cost(frame), false)) {
+            return ERR_FIFO;
+        }
+        Error err = child_->write(frame);
+        if (err == ERR_OK) {
+            ++sent_;
+        } else {
+            refund(cost(frame));
+        }
+        return err;
+    }
+
+    if (entry->state == PENDING) {
+        entry->frame = frame;
+        return ERR_OK;
+    }
+
+    bool changed = entry->state == UNSENT || entry->frame.size() != frame.size() ||
+        memcmp(entry->frame.data(), frame.data(), frame.size()) != 0;
+    if (!changed) {
+        if (micros() - entry->sent < refresh_ ||
+                pending_len_ > 0 || !spend(cost(frame), true)) {
+            ++suppressed_;
+            return ERR_OK;
+        }
+        return send(entry, frame);
+    }
+
+    if (pending_len_ == 0 && spend(cost(frame), false)) {
+        Error err = send(entry, frame);
+        if (err != ERR_FIFO) {
+            return err;
+        }
+    }
+
+    // hold the frame until the budget or the child allows it
+    entry->frame = frame;
+    entry->state = PENDING;
+    size_t tail = pending_head_ + pending_len_;
+    pending_[tail >= capacity_ ? tail - capacity_ : tail] = entry - entries_;
+    ++pending_len_;
+    return ERR_OK;
+}
+
+template <typename FrameType>
+void Throttle<FrameType>::flush() {
+    while (pending_len_ > 0) {
+        Entry* entry = entries_ + pending_[pending_head_];
+        if (!spend(cost(entry->frame), false) || send(entry, entry->frame) == ERR_FIFO) {
+            return;
+        }
+        if (++pending_head_ >= capacity_) {
+            pending_head_ = 0;
+        }
+        --pending_len_;
+    }
+}
+
+template <typename FrameType>
+const ThrottleEntry<FrameType>* Throttle<FrameType>::find(uint32_t id, uint8_t ext) const {
+    size_t slot = index_.get(frameKey(id, ext));
+    return slot == FrameIndex::Empty ? nullptr : entries_ + slot;
+}
+
+template <typename FrameType>
+void Throttle<FrameType>::clear() {
+    index_.clear();
+    len_ = 0;
+    pending_head_ = 0;
+    pending_len_ = 0;
+}
+
+template <typename FrameType>
+bool Throttle<FrameType>::spend(uint32_t cost, bool refresh) {
+    if (budget_ == 0) {
+        return true;
+    }
+
+    uint32_t now = micros();
+    credit_ += (uint64_t)(now - refill_time_) * budget_;
+    refill_time_ = now;
+    if (credit_ > burst_) {
+        credit_ = burst_;
+    }
+
+    uint64_t need = cost * kThrottleScale;
+    if (credit_ < need || (refresh && credit_ - need < burst_ / 2)) {
+        return false;
+    }
+    credit_ -= need;
+    return true;
+}
+
+template <typename FrameType>
+void Throttle<FrameType>::refund(uint32_t cost) {
+    if (budget_ == 0) {
+        return;
+    }
+    credit_ += cost * kThrottleScale;
+    if (credit_ > burst_) {
+        credit_ = burst_;
+    }
+}
+
+template <typename FrameType>
+Error Throttle<FrameType>::send(Entry* entry, const FrameType& frame) {
+    Error err = child_->write(frame);
+    if (err == ERR_OK) {
+        entry->frame = frame;
+        entry->sent = micros();
+        entry->state = SENT;
+        ++sent_;
+        return ERR_OK;
+    }
+    refund(cost(frame));
+    if (err != ERR_FIFO) {
+        // the child rejected the frame so the next one counts as a change
+        entry->state = UNSENT;
+    }
+    return err;
+}
+
+template <typename FrameType>
+ThrottleEntry<FrameType>* Throttle<FrameType>::lookup(const FrameType& frame) {
+    uint32_t key = frameKey(frame.id(), frame.ext());
+    size_t slot = index_.get(key);
+    if (slot != FrameIndex::Empty) {
+        return entries_ + slot;
+    }
+    if (len_ >= capacity_) {
+        return nullptr;
+    }
+    index_.put(key, len_);
+    Entry* entry = entries_ + len_++;
+    entry->frame = frame;
+    entry->sent = 0;
+    entry->state = UNSENT;
+    return entry;
+}
+
+}  // namespace Canny
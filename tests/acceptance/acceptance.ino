@@ -0,0 +1,275 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny/Acceptance.h>
+#include <Canny/Filter.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+bool accepts(const AcceptanceFilter* filters, size_t len, uint32_t id, uint8_t ext) {
+    for (size_t i = 0; i < len; ++i) {
+        if (filters[i].ext == ext && (id & filters[i].mask) == filters[i].id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+test(AcceptancePlannerTest, Empty) {
+    AcceptanceFilter filters[4];
+    size_t len;
+
+    AcceptancePlanner planner;
+    assertFalse(planner.plan(filters, 4, &len));
+    assertEqual(len, (size_t)0);
+}
+
+test(AcceptancePlannerTest, AllowMode) {
+    AcceptanceFilter filters[4];
+    size_t len;
+
+    FrameIDFilter filter(FilterMode::ALLOW);
+    filter.drop(0x123);
+
+    AcceptancePlanner planner;
+    planner.accept(filter);
+    assertTrue(planner.all());
+    assertFalse(planner.exact());
+    assertFalse(planner.plan(filters, 4, &len));
+}
+
+test(AcceptancePlannerTest, ExactIDs) {
+    AcceptanceFilter filters[4];
+    size_t len;
+
+    FrameIDFilter filter(FilterMode::DROP);
+    filter.allow(0x123);
+    filter.allow(0x456);
+    filter.allow(0x18FEF100);
+
+    AcceptancePlanner planner;
+    planner.accept(filter);
+    assertTrue(planner.plan(filters, 4, &len));
+    assertEqual(len, (size_t)3);
+    assertTrue(planner.exact());
+    assertTrue(accepts(filters, len, 0x123, 0));
+    assertTrue(accepts(filters, len, 0x456, 0));
+    assertTrue(accepts(filters, len, 0x18FEF100, 1));
+    assertFalse(accepts(filters, len, 0x124, 0));
+    assertFalse(accepts(filters, len, 0x123, 1));
+    assertFalse(accepts(filters, len, 0x18FEF101, 1));
+}
+
+test(AcceptancePlannerTest, BitmapRuns) {
+    AcceptanceFilter filters[4];
+    size_t len;
+
+    FrameIDFilter filter(FilterMode::DROP);
+    for (uint32_t id = 0x100; id <= 0x1FF; ++id) {
+        filter.allow(id);
+    }
+
+    AcceptancePlanner planner;
+    planner.accept(filter);
+    assertTrue(planner.plan(filters, 4, &len));
+    assertEqual(len, (size_t)1);
+    assertEqual(filters[0].id, (uint32_t)0x100);
+    assertEqual(filters[0].mask, (uint32_t)0x700);
+}
+
+test(AcceptancePlannerTest, ManyRules) {
+    AcceptanceFilter filters[32];
+    size_t len;
+
+    FrameIDFilter filter(FilterMode::DROP);
+    for (uint32_t id = 0; id <= 0x7FF; id += 2) {
+        filter.allow(id);
+    }
+
+    AcceptancePlanner planner;
+    planner.accept(filter);
+    assertTrue(planner.plan(filters, 32, &len));
+    assertEqual(len, (size_t)32);
+    for (uint32_t id = 0; id <= 0x7FF; id += 2) {
+        assertTrue(accepts(filters, len, id, 0));
+        assertFalse(accepts(filters, len, id + 1, 0));
+    }
+}
+
+test(AcceptancePlannerTest, MergeNearest) {
+    AcceptanceFilter filters[2];
+    size_t len;
+
+    AcceptancePlanner planner;
+    planner.accept(0x100, 0x7FF, 0);
+    planner.accept(0x101, 0x7FF, 0);
+    planner.accept(0x700, 0x7FF, 0);
+    assertTrue(planner.plan(filters, 2, &len));
+    assertEqual(len, (size_t)2);
+
+    // 0x100 and 0x101 differ by one bit and are merged without accepting
+    // other IDs.
+    assertTrue(planner.exact());
+    assertTrue(accepts(filters, len, 0x100, 0));
+    assertTrue(accepts(filters, len, 0x101, 0));
+    assertTrue(accepts(filters, len, 0x700, 0));
+    assertFalse(accepts(filters, len, 0x102, 0));
+    assertFalse(accepts(filters, len, 0x701, 0));
+}
+
+test(AcceptancePlannerTest, MergeInexact) {
+    AcceptanceFilter filters[1];
+    size_t len;
+
+    AcceptancePlanner planner;
+    planner.accept(0x100, 0x7FF, 0);
+    planner.accept(0x103, 0x7FF, 0);
+    assertTrue(planner.plan(filters, 1, &len));
+    assertFalse(planner.exact());
+    assertTrue(accepts(filters, len, 0x100, 0));
+    assertTrue(accepts(filters, len, 0x103, 0));
+    assertTrue(accepts(filters, len, 0x101, 0));
+
+    planner.clear();
+    planner.accept(0x100, 0x7FF, 0);
+    assertTrue(planner.plan(filters, 1, &len));
+    assertTrue(planner.exact());
+}
+
+test(AcceptancePlannerTest, StandardAndExtendedNotMerged) {
+    AcceptanceFilter filters[1];
+    size_t len;
+
+    AcceptancePlanner planner;
+    planner.accept(0x100, 0x7FF, 0);
+    planner.accept(0x100, 0x1FFFFFFF, 1);
+    assertFalse(planner.plan(filters, 1, &len));
+}
+
+test(AcceptancePlannerTest, Range) {
+    AcceptanceFilter filters[8];
+    size_t len;
+
+    FrameIDFilter filter(FilterMode::DROP);
+    filter.allowRange(0x100, 0x13F);
+
+    AcceptancePlanner planner;
+    planner.accept(filter);
+    assertTrue(planner.plan(filters, 8, &len));
+    assertEqual(len, (size_t)1);
+    for (uint32_t id = 0x100; id <= 0x13F; ++id) {
+        assertTrue(accepts(filters, len, id, 0));
+    }
+    assertFalse(accepts(filters, len, 0x0FF, 0));
+    assertFalse(accepts(filters, len, 0x140, 0));
+}
+
+test(AcceptancePlannerTest, CoverAllRules) {
+    AcceptanceFilter filters[4];
+    size_t len;
+
+    FrameIDFilter filter(FilterMode::DROP);
+    for (uint32_t i = 0; i < 20; ++i) {
+        filter.allow(0x18FF0000 + i * 37);
+        filter.allow(0x200 + i * 3);
+    }
+    filter.allowJ1939(0xFEF1);
+
+    AcceptancePlanner planner;
+    planner.accept(filter);
+    assertTrue(planner.plan(filters, 4, &len));
+    assertLessOrEqual(len, (size_t)4);
+    for (uint32_t i = 0; i < 20; ++i) {
+        assertTrue(accepts(filters, len, 0x18FF0000 + i * 37, 1));
+        assertTrue(accepts(filters, len, 0x200 + i * 3, 0));
+    }
+    assertTrue(accepts(filters, len, 0x18FEF1AB, 1));
+}
+
+test(AcceptancePlannerTest, Groups) {
+    static const uint8_t groups[] = {2, 4};
+    AcceptanceFilter masks[2];
+    AcceptanceFilter filters[6];
+
+    AcceptancePlanner planner;
+    planner.accept(0x100, 0x7FF, 0);
+    planner.accept(0x200, 0x7FF, 0);
+    planner.accept(0x300, 0x7FF, 0);
+    planner.accept(0x18FEF100, 0x1FFFFFFF, 1);
+    planner.accept(0x18FEF200, 0x1FFFFFFF, 1);
+    assertTrue(planner.plan(groups, 2, masks, filters));
+    assertTrue(planner.exact());
+
+    // Each group shares a single frame format.
+    assertEqual(masks[0].ext, filters[0].ext);
+    assertEqual(masks[0].ext, filters[1].ext);
+    for (size_t i = 2; i < 6; ++i) {
+        assertEqual(masks[1].ext, filters[i].ext);
+    }
+    for (size_t i = 0; i < 6; ++i) {
+        assertEqual(filters[i].mask, masks[i < 2 ? 0 : 1].mask);
+    }
+
+    assertTrue(accepts(filters, 6, 0x100, 0));
+    assertTrue(accepts(filters, 6, 0x200, 0));
+    assertTrue(accepts(filters, 6, 0x300, 0));
+    assertTrue(accepts(filters, 6, 0x18FEF100, 1));
+    assertTrue(accepts(filters, 6, 0x18FEF200, 1));
+    assertFalse(accepts(filters, 6, 0x101, 0));
+    assertFalse(accepts(filters, 6, 0x18FEF101, 1));
+}
+
+test(AcceptancePlannerTest, GroupsSingleRule) {
+    static const uint8_t groups[] = {2, 4};
+    AcceptanceFilter masks[2];
+    AcceptanceFilter filters[6];
+
+    AcceptancePlanner planner;
+    planner.accept(0x123, 0x7FF, 0);
+    assertTrue(planner.plan(groups, 2, masks, filters));
+    for (size_t i = 0; i < 6; ++i) {
+        assertEqual(filters[i].id, (uint32_t)0x123);
+        assertEqual(filters[i].mask, (uint32_t)0x7FF);
+    }
+    assertEqual(masks[0].mask, (uint32_t)0x7FF);
+    assertEqual(masks[1].mask, (uint32_t)0x7FF);
+}
+
+test(AcceptancePlannerTest, GroupsMixedFormats) {
+    static const uint8_t groups[] = {2, 4};
+    AcceptanceFilter masks[2];
+    AcceptanceFilter filters[6];
+
+    // Three rules of each format do not fit in the groups without merging.
+    AcceptancePlanner planner;
+    planner.accept(0x100, 0x7FF, 0);
+    planner.accept(0x200, 0x7FF, 0);
+    planner.accept(0x400, 0x7FF, 0);
+    planner.accept(0x1000, 0x1FFFFFFF, 1);
+    planner.accept(0x2000, 0x1FFFFFFF, 1);
+    planner.accept(0x4000, 0x1FFFFFFF, 1);
+    assertTrue(planner.plan(groups, 2, masks, filters));
+    assertFalse(planner.exact());
+    assertTrue(accepts(filters, 6, 0x100, 0));
+    assertTrue(accepts(filters, 6, 0x200, 0));
+    assertTrue(accepts(filters, 6, 0x400, 0));
+    assertTrue(accepts(filters, 6, 0x1000, 1));
+    assertTrue(accepts(filters, 6, 0x2000, 1));
+    assertTrue(accepts(filters, 6, 0x4000, 1));
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
@@ -0,0 +1,438 @@
+// Benchmarks for the library's hot paths. Results are printed as CSV with one
+// row per benchmark:
+//
+//   benchmark,iterations,ns_per_op,frames_per_sec
+//
+// Each benchmark is run several times and the fastest run is reported to
+// reduce noise from the host. frames_per_sec is 0 for benchmarks that do not
+// move frames.
+
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/Buffer.h>
+#include <Canny/Filter.h>
+#include <Canny/J1939.h>
+#include <Canny/RealDash.h>
+
+namespace Canny {
+namespace {
+
+#if defined(EPOXY_DUINO)
+const uint32_t kIterations = 200000;
+#else
+const uint32_t kIterations = 2000;
+#endif
+
+// Number of times each benchmark is repeated.
+const uint8_t kRuns = 5;
+
+// Results are accumulated here so that the compiler cannot discard the work
+// being measured.
+volatile uint32_t sink;
+
+// Run op for iterations and print the fastest of kRuns runs. Each call to op
+// moves frames frames.
+template <typename Op>
+void bench(const char* name, uint32_t iterations, uint32_t frames, Op op) {
+    op(0);
+    uint32_t best = 0xFFFFFFFF;
+    for (uint8_t run = 0; run < kRuns; ++run) {
+        uint32_t start = micros();
+        for (uint32_t i = 0; i < iterations; ++i) {
+            op(i);
+        }
+        uint32_t elapsed = micros() - start;
+        if (elapsed < best) {
+            best = elapsed;
+        }
+    }
+
+    double ns = best * 1000.0 / iterations;
+    double fps = ns > 0 ? frames * 1000000000.0 / ns : 0;
+    SERIAL_PORT_MONITOR.print(name);
+    SERIAL_PORT_MONITOR.print(',');
+    SERIAL_PORT_MONITOR.print(iterations);
+    SERIAL_PORT_MONITOR.print(',');
+    SERIAL_PORT_MONITOR.print(ns, 2);
+    SERIAL_PORT_MONITOR.print(',');
+    SERIAL_PORT_MONITOR.println(fps, 0);
+}
+
+// A connection that always has a frame to read and always accepts writes.
+// Every other write fails with ERR_FIFO when busy is set.
+template <typename FrameType>
+class LoopConnection : public Connection<FrameType> {
+    public:
+        LoopConnection(const FrameType& frame, bool busy = false) :
+            frame_(frame), busy_(busy), toggle_(false) {}
+
+        Error read(FrameType* frame) override {
+            *frame = frame_;
+            return ERR_OK;
+        }
+
+        Error write(const FrameType& frame) override {
+            if (busy_ && (toggle_ = !toggle_)) {
+                return ERR_FIFO;
+            }
+            sink = frame.id();
+            return ERR_OK;
+        }
+
+    private:
+        FrameType frame_;
+        bool busy_;
+        bool toggle_;
+};
+
+// A stream that replays the bytes written to it forever. Writes past the end
+// of the buffer are discarded.
+class LoopStream : public Stream {
+    public:
+        LoopStream() : len_(0), pos_(0) {}
+
+        int available() override { return len_ == 0 ? 0 : sizeof(buffer_); }
+
+        int read() override {
+            if (len_ == 0) {
+                return -1;
+            }
+            int b = buffer_[pos_];
+            if (++pos_ >= len_) {
+                pos_ = 0;
+            }
+            return b;
+        }
+
+        int peek() override { return len_ == 0 ? -1 : buffer_[pos_]; }
+
+        size_t write(uint8_t b) override {
+            if (len_ < sizeof(buffer_)) {
+                buffer_[len_++] = b;
+            }
+            return 1;
+        }
+
+        size_t write(const uint8_t* buffer, size_t size) override {
+            size_t n = size < sizeof(buffer_) - len_ ? size : sizeof(buffer_) - len_;
+            memcpy(buffer_ + len_, buffer, n);
+            len_ += n;
+            return size;
+        }
+
+        using Print::write;
+
+        void clear() {
+            len_ = 0;
+            pos_ = 0;
+        }
+
+    private:
+        uint8_t buffer_[256];
+        size_t len_;
+        size_t pos_;
+};
+
+// A CRC-32 updated one byte at a time from a 256 entry table.
+class BytewiseCRC32 {
+    public:
+        BytewiseCRC32() : crc_(0xFFFFFFFF) {
+            if (table_[1] == 0) {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t crc = i;
+                    for (uint8_t bit = 0; bit < 8; ++bit) {
+                        crc = (crc >> 1) ^ (crc & 1 ? 0xEDB88320 : 0);
+                    }
+                    table_[i] = crc;
+                }
+            }
+        }
+
+        void reset() { crc_ = 0xFFFFFFFF; }
+
+        void update(uint8_t b) { crc_ = table_[(crc_ ^ b) & 0xFF] ^ (crc_ >> 8); }
+
+        uint32_t value() const { return ~crc_; }
+
+    private:
+        static uint32_t table_[256];
+        uint32_t crc_;
+};
+
+uint32_t BytewiseCRC32::table_[256];
+
+// The original RealDash encoder which writes and checksums one byte at a time.
+// Kept as a baseline for the RealDash encoder.
+class BytewiseRealDash {
+    public:
+        BytewiseRealDash(Stream* stream) : stream_(stream) {}
+
+        Error write(const CANFDFrame& frame) {
+            checksum_.reset();
+            writeByte(0x66);
+            writeByte(0x33);
+            writeByte(0x22);
+            writeByte((frame.size() < 8 ? 8 : frame.size()) / 4 + 15);
+            uint32_t id = frame.id();
+            writeBytes((const byte*)&id, 4);
+            writeBytes(frame.data(), frame.size());
+            for (int i = 0; i < 8 - frame.size(); i++) {
+                writeByte(0);
+            }
+            uint32_t checksum = checksum_.value();
+            stream_->write((const byte*)&checksum, 4);
+            return ERR_OK;
+        }
+
+    private:
+        void writeByte(byte b) {
+            stream_->write(b);
+            checksum_.update(b);
+        }
+
+        void writeBytes(const byte* b, uint8_t len) {
+            for (int i = 0; i < len; i++) {
+                writeByte(b[i]);
+            }
+        }
+
+        Stream* stream_;
+        BytewiseCRC32 checksum_;
+};
+
+const uint8_t kData[64] = {
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+    0x00, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77,
+    0x88, 0x99, 0xAA, 0xBB, 0xCC, 0xDD, 0xEE, 0xFF,
+};
+
+void benchFrame() {
+    bench("frame/can20/construct", kIterations, 1, [](uint32_t i) {
+        CAN20Frame frame(i, 0, 8);
+        sink = frame.data()[0];
+    });
+    bench("frame/canfd/construct", kIterations, 1, [](uint32_t i) {
+        CANFDFrame frame(i, 0, 64);
+        sink = frame.data()[0];
+    });
+
+    CAN20Frame can20(0x123, 0, 8);
+    CANFDFrame canfd(0x123, 0, 64);
+    bench("frame/can20/resize", kIterations, 1, [&](uint32_t i) {
+        can20.resize(i & 0x07);
+        sink = can20.size();
+    });
+    bench("frame/canfd/resize", kIterations, 1, [&](uint32_t i) {
+        canfd.resize(i & 0x3F);
+        sink = canfd.size();
+    });
+
+    CAN20Frame can20_src(0x123, 0, 8);
+    CANFDFrame canfd_src(0x123, 0, 64);
+    can20_src.data(kData, 8);
+    canfd_src.data(kData, 64);
+    bench("frame/can20/copy_from_can20", kIterations, 1, [&](uint32_t) {
+        can20.copyFrom(can20_src);
+        sink = can20.size();
+    });
+    bench("frame/canfd/copy_from_canfd", kIterations, 1, [&](uint32_t) {
+        canfd.copyFrom(canfd_src);
+        sink = canfd.size();
+    });
+    bench("frame/canfd/copy_from_can20", kIterations, 1, [&](uint32_t) {
+        canfd.copyFrom(can20_src);
+        sink = canfd.size();
+    });
+    bench("frame/can20/copy_from_canfd", kIterations, 1, [&](uint32_t) {
+        can20.copyFrom(canfd_src);
+        sink = can20.size();
+    });
+}
+
+// Benchmark a filter matching extended IDs. Half of the IDs matched are
+// allowed by the filter.
+void benchFilterIDs(const char* name, size_t count) {
+    FrameIDFilter filter(FilterMode::DROP);
+    for (size_t i = 0; i < count; ++i) {
+        filter.allow((uint32_t)(0x18FF0000 + i * 2));
+    }
+    filter.match((uint32_t)0x18FF0000);
+    bench(name, kIterations, 1, [&](uint32_t i) {
+        sink = filter.match((uint32_t)(0x18FF0000 + (i % (count * 2))));
+    });
+}
+
+void benchFilter() {
+    benchFilterIDs("filter/match/ext_ids_1", 1);
+    benchFilterIDs("filter/match/ext_ids_16", 16);
+    benchFilterIDs("filter/match/ext_ids_256", 256);
+
+    FrameIDFilter standard(FilterMode::DROP);
+    for (uint32_t i = 0; i < 0x800; i += 3) {
+        standard.allow(i);
+    }
+    standard.match((uint32_t)0);
+    bench("filter/match/std_ids_683", kIterations, 1, [&](uint32_t i) {
+        sink = standard.match(i & 0x7FF);
+    });
+
+    FrameIDFilter masks(FilterMode::DROP);
+    for (uint32_t i = 0; i < 16; ++i) {
+        masks.allowMask(0x18F00000 + (i << 12), 0x1FFFF000);
+    }
+    masks.match((uint32_t)0);
+    bench("filter/match/masks_16", kIterations, 1, [&](uint32_t i) {
+        sink = masks.match(0x18F00000 + ((i & 0x1F) << 12));
+    });
+
+    FrameIDFilter ranges(FilterMode::DROP);
+    for (uint32_t i = 0; i < 16; ++i) {
+        ranges.allowRange(0x1000 + i * 0x100, 0x1000 + i * 0x100 + 0x7F);
+    }
+    ranges.match((uint32_t)0);
+    bench("filter/match/ranges_16", kIterations, 1, [&](uint32_t i) {
+        sink = ranges.match(0x1000 + ((i * 0x41) & 0x1FFF));
+    });
+}
+
+void benchBuffer() {
+    CAN20Frame frame(0x123, 0, 8);
+    frame.data(kData, 8);
+
+    LoopConnection<CAN20Frame> read_child(frame);
+    BufferedConnection<CAN20Frame> read_can(&read_child, 16, 16);
+    bench("buffer/read", kIterations, 1, [&](uint32_t) {
+        CAN20Frame out;
+        read_can.read(&out);
+        sink = out.id();
+    });
+
+    CAN20Frame frames[16];
+    bench("buffer/read_many_16", kIterations / 16, 16, [&](uint32_t) {
+        size_t n;
+        read_can.readMany(frames, 16, &n);
+        sink = n;
+    });
+
+    LoopConnection<CAN20Frame> write_child(frame);
+    BufferedConnection<CAN20Frame> write_can(&write_child, 16, 16);
+    bench("buffer/write", kIterations, 1, [&](uint32_t) {
+        sink = write_can.write(frame);
+    });
+
+    // The child rejects every other write so frames pass through the write
+    // buffer.
+    LoopConnection<CAN20Frame> busy_child(frame, true);
+    BufferedConnection<CAN20Frame> busy_can(&busy_child, 16, 16);
+    bench("buffer/write_buffered", kIterations, 1, [&](uint32_t) {
+        sink = busy_can.write(frame);
+    });
+
+    for (size_t i = 0; i < 16; ++i) {
+        frames[i] = frame;
+    }
+    bench("buffer/write_many_16", kIterations / 16, 16, [&](uint32_t) {
+        size_t n;
+        write_can.writeMany(frames, 16, &n);
+        sink = n;
+    });
+}
+
+void benchRealDash() {
+    CANFDFrame frame8(0x5800, 1, 8);
+    frame8.data(kData, 8);
+    CANFDFrame frame64(0x5800, 1, 64);
+    frame64.data(kData, 64);
+
+    LoopStream stream;
+    RealDash<CANFDFrame> realdash(&stream);
+    bench("realdash/encode_44", kIterations, 1, [&](uint32_t) {
+        stream.clear();
+        sink = realdash.write(frame8);
+    });
+    bench("realdash/encode_66_64", kIterations, 1, [&](uint32_t) {
+        stream.clear();
+        sink = realdash.write(frame64);
+    });
+
+    BytewiseRealDash bytewise(&stream);
+    bench("realdash/encode_44_bytewise", kIterations, 1, [&](uint32_t) {
+        stream.clear();
+        sink = bytewise.write(frame8);
+    });
+    bench("realdash/encode_66_64_bytewise", kIterations, 1, [&](uint32_t) {
+        stream.clear();
+        sink = bytewise.write(frame64);
+    });
+
+    CANFDFrame frames[12];
+    for (size_t i = 0; i < 12; ++i) {
+        frames[i] = frame8;
+    }
+    bench("realdash/write_many_12", kIterations / 12, 12, [&](uint32_t) {
+        size_t n;
+        stream.clear();
+        realdash.writeMany(frames, 12, &n);
+        sink = n;
+    });
+
+    CANFDFrame out;
+    stream.clear();
+    realdash.write(frame8);
+    bench("realdash/decode_44", kIterations, 1, [&](uint32_t) {
+        sink = realdash.read(&out);
+    });
+
+    stream.clear();
+    realdash.write(frame64);
+    bench("realdash/decode_66_64", kIterations, 1, [&](uint32_t) {
+        sink = realdash.read(&out);
+    });
+}
+
+void benchJ1939() {
+    J1939Message message(0xFEF1, 0x20, 0x00, 6);
+    bench("j1939/get_fields", kIterations, 0, [&](uint32_t) {
+        sink = message.pgn() + message.priority() + message.source_address() +
+            message.dest_address();
+    });
+    bench("j1939/set_fields", kIterations, 0, [&](uint32_t i) {
+        message.pgn(i & 0x3FFFF);
+        message.source_address(i);
+        message.priority(i & 0x07);
+        sink = message.id();
+    });
+    bench("j1939/construct", kIterations, 1, [&](uint32_t i) {
+        J1939Message m(i & 0x3FFFF, 0x20, 0x30, 3);
+        sink = m.id();
+    });
+}
+
+}  // namespace
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+
+    SERIAL_PORT_MONITOR.println("benchmark,iterations,ns_per_op,frames_per_sec");
+    Canny::benchFrame();
+    Canny::benchFilter();
+    Canny::benchBuffer();
+    Canny::benchRealDash();
+    Canny::benchJ1939();
+}
+
+void loop() {
+#if defined(EPOXY_DUINO)
+    exit(0);
+#endif
+}
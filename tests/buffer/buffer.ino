@@ -222,6 +222,404 @@ test(BufferedConnectionTest, FilteredWrite) {
     assertTrue(fake.writeData()[1] == expect2);
 }
 
+test(BufferedConnectionTest, FilteredWriteDrains) {
+    FakeConnection fake(0, 0);
+    TestConnection can(&fake, 1, 1);
+
+    CAN20Frame expect(0x10, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    CAN20Frame discard(0x20, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+
+    assertEqual(can.write(expect), Error::ERR_OK);
+    assertEqual(fake.writeCount(), 0);
+
+    // a filtered frame still drains the buffer
+    fake.writeReset(2);
+    assertEqual(can.write(discard), Error::ERR_OK);
+    assertEqual(fake.writeCount(), 1);
+    assertTrue(fake.writeData()[0] == expect);
+}
+
+test(BufferedConnectionTest, IDFilterRead) {
+    FakeConnection fake(3, 0);
+    BufferedConnection<CAN20Frame> can(&fake, 3, 1);
+    FrameIDFilter filter(FilterMode::DROP);
+    filter.allowRange(0x10, 0x11);
+    can.setReadFilter(&filter);
+
+    CAN20Frame f1(0x10, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    CAN20Frame f2(0x12, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    CAN20Frame f3(0x11, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    fake.setReadBuffer({f1, f2, f3});
+
+    CAN20Frame actual;
+    assertEqual(can.read(&actual), Error::ERR_OK);
+    assertTrue(actual == f1);
+    assertEqual(can.read(&actual), Error::ERR_OK);
+    assertTrue(actual == f3);
+    assertEqual(can.read(&actual), Error::ERR_FIFO);
+}
+
+test(BufferedConnectionTest, IDFilterWrite) {
+    FakeConnection fake(0, 2);
+    BufferedConnection<CAN20Frame> can(&fake, 1, 1);
+    FrameIDFilter filter(FilterMode::ALLOW);
+    filter.drop(0x12);
+    can.setWriteFilter(&filter);
+
+    CAN20Frame f1(0x10, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    CAN20Frame f2(0x12, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    CAN20Frame f3(0x11, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+
+    assertEqual(can.write(f1), Error::ERR_OK);
+    assertEqual(can.write(f2), Error::ERR_OK);
+    assertEqual(can.write(f3), Error::ERR_OK);
+    assertEqual(fake.writeCount(), 2);
+    assertTrue(fake.writeData()[0] == f1);
+    assertTrue(fake.writeData()[1] == f3);
+}
+
+test(BufferedConnectionTest, ReadMany) {
+    FakeConnection fake(4, 0);
+    TestConnection can(&fake, 1, 1);
+
+    CAN20Frame f1(0x10, 0, {0x11, 0x22, 0x33, 0x44});
+    CAN20Frame f2(0x20, 0, {0x11, 0x22, 0x33, 0x44});
+    CAN20Frame f3(0x30, 0, {0x11, 0x22, 0x33, 0x44});
+    CAN20Frame f4(0x40, 0, {0x11, 0x22, 0x33, 0x44});
+    fake.setReadBuffer({f1, f2, f3, f4});
+
+    // f2 is filtered and f3 is buffered
+    CAN20Frame actual[4];
+    size_t n;
+    assertEqual(can.readMany(actual, 1, &n), Error::ERR_OK);
+    assertEqual(n, (size_t)1);
+    assertTrue(actual[0] == f1);
+
+    // f3 is buffered, f4 is read from the child
+    assertEqual(can.readMany(actual, 4, &n), Error::ERR_OK);
+    assertEqual(n, (size_t)2);
+    assertTrue(actual[0] == f3);
+    assertTrue(actual[1] == f4);
+    assertEqual(fake.readsRemaining(), 0);
+
+    assertEqual(can.readMany(actual, 4, &n), Error::ERR_FIFO);
+    assertEqual(n, (size_t)0);
+}
+
+test(BufferedConnectionTest, WriteMany) {
+    FakeConnection fake(0, 2);
+    TestConnection can(&fake, 1, 2);
+
+    CAN20Frame frames[] = {
+        CAN20Frame(0x10, 0, {0x11, 0x22, 0x33, 0x44}),
+        CAN20Frame(0x20, 0, {0x11, 0x22, 0x33, 0x44}),
+        CAN20Frame(0x30, 0, {0x11, 0x22, 0x33, 0x44}),
+        CAN20Frame(0x40, 0, {0x11, 0x22, 0x33, 0x44}),
+        CAN20Frame(0x50, 0, {0x11, 0x22, 0x33, 0x44}),
+    };
+
+    // f1 and f3 written, f2 filtered, f4 and f5 buffered
+    size_t n;
+    assertEqual(can.writeMany(frames, 5, &n), Error::ERR_OK);
+    assertEqual(n, (size_t)5);
+    assertEqual(fake.writeCount(), 2);
+    assertTrue(fake.writeData()[0] == frames[0]);
+    assertTrue(fake.writeData()[1] == frames[2]);
+
+    // buffer is full
+    assertEqual(can.writeMany(frames, 1, &n), Error::ERR_FIFO);
+    assertEqual(n, (size_t)0);
+
+    fake.writeReset(4);
+    assertEqual(can.writeMany(frames, 1, &n), Error::ERR_OK);
+    assertEqual(n, (size_t)1);
+    assertEqual(fake.writeCount(), 3);
+    assertTrue(fake.writeData()[0] == frames[3]);
+    assertTrue(fake.writeData()[1] == frames[4]);
+    assertTrue(fake.writeData()[2] == frames[0]);
+}
+
+// A child that accepts every frame of a batch but still reports an error.
+class ErrorAfterWriteConnection : public Connection<CAN20Frame> {
+    public:
+        Error read(CAN20Frame*) override { return ERR_FIFO; }
+
+        Error write(const CAN20Frame&) override { return ERR_OK; }
+
+        Error writeMany(const CAN20Frame*, size_t count, size_t* n) override {
+            *n = count;
+            return ERR_INTERNAL;
+        }
+};
+
+class ErrorCountConnection : public BufferedConnection<CAN20Frame> {
+    public:
+        ErrorCountConnection(Connection* child) :
+                BufferedConnection(child, 1, 2), errors(0) {}
+
+        void onWriteError(Error, const CAN20Frame&) const override { ++errors; }
+
+        mutable int errors;
+};
+
+test(BufferedConnectionTest, WriteManyErrorAfterWrite) {
+    ErrorAfterWriteConnection child;
+    ErrorCountConnection can(&child);
+
+    CAN20Frame frames[] = {
+        CAN20Frame(0x10, 0, {0x11, 0x22, 0x33, 0x44}),
+        CAN20Frame(0x20, 0, {0x11, 0x22, 0x33, 0x44}),
+    };
+
+    size_t n;
+    assertEqual(can.writeMany(frames, 2, &n), Error::ERR_OK);
+    assertEqual(n, (size_t)2);
+    assertEqual(can.errors, 0);
+}
+
+test(ConnectionTest, DefaultReadWriteMany) {
+    FakeConnection fake(2, 1);
+    Connection<CAN20Frame>* conn = &fake;
+
+    CAN20Frame f1(0x10, 0, {0x11, 0x22, 0x33, 0x44});
+    CAN20Frame f2(0x20, 0, {0x11, 0x22, 0x33, 0x44});
+    fake.setReadBuffer({f1, f2});
+
+    CAN20Frame actual[3];
+    size_t n;
+    assertEqual(conn->readMany(actual, 3, &n), Error::ERR_OK);
+    assertEqual(n, (size_t)2);
+    assertTrue(actual[0] == f1);
+    assertTrue(actual[1] == f2);
+    assertEqual(conn->readMany(actual, 3, &n), Error::ERR_FIFO);
+    assertEqual(n, (size_t)0);
+
+    assertEqual(conn->writeMany(actual, 2, &n), Error::ERR_FIFO);
+    assertEqual(n, (size_t)1);
+    assertTrue(fake.writeData()[0] == f1);
+}
+
+test(BufferedConnectionTest, Borrow) {
+    FakeConnection fake(3, 0);
+    TestConnection can(&fake, 2, 1);
+
+    CAN20Frame f1(0x10, 0, {0x11, 0x22, 0x33, 0x44});
+    CAN20Frame f2(0x20, 0, {0x11, 0x22, 0x33, 0x44});
+    CAN20Frame f3(0x30, 0, {0x11, 0x22, 0x33, 0x44});
+    fake.setReadBuffer({f1, f2, f3});
+
+    CAN20Frame* frame;
+    assertEqual(can.borrow(&frame), Error::ERR_OK);
+    assertTrue(*frame == f1);
+    assertEqual(can.borrow(&frame), Error::ERR_OK);
+    assertTrue(*frame == f1);
+    can.release();
+
+    // f2 is filtered
+    assertEqual(can.borrow(&frame), Error::ERR_OK);
+    assertTrue(*frame == f3);
+    can.release();
+
+    assertEqual(can.borrow(&frame), Error::ERR_FIFO);
+    assertEqual(frame, (CAN20Frame*)nullptr);
+}
+
+test(BufferedConnectionTest, ReserveCommit) {
+    FakeConnection fake(0, 0);
+    TestConnection can(&fake, 1, 1);
+
+    CAN20Frame expect(0x10, 0, {0x11, 0x22, 0x33, 0x44});
+
+    CAN20Frame* slot = can.reserve();
+    assertNotEqual(slot, (CAN20Frame*)nullptr);
+    slot->id(expect.id());
+    slot->data({0x11, 0x22, 0x33, 0x44});
+    assertEqual(can.commit(), Error::ERR_OK);
+    assertEqual(fake.writeCount(), 0);
+
+    // write buffer is full
+    assertEqual(can.reserve(), (CAN20Frame*)nullptr);
+    assertEqual(can.commit(), Error::ERR_FIFO);
+
+    fake.writeReset(2);
+    slot = can.reserve();
+    assertNotEqual(slot, (CAN20Frame*)nullptr);
+    assertEqual(fake.writeCount(), 1);
+    assertTrue(fake.writeData()[0] == expect);
+
+    // filtered frames are discarded
+    slot->id(0x20);
+    assertEqual(can.commit(), Error::ERR_OK);
+    assertEqual(fake.writeCount(), 1);
+}
+
+test(BufferedConnectionTest, CompactQueue) {
+    FakeConnection fake(3, 0);
+    BufferedConnection<CAN20Frame, CompactFrameQueue<CAN20Frame>> can(&fake, 64, 64);
+
+    CAN20Frame f1(0x10, 0, {0x11, 0x22});
+    CAN20Frame f2(0x11, 1, {0x11, 0x22, 0x33, 0x44});
+    CAN20Frame f3(0x12, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    fake.setReadBuffer({f1, f2, f3});
+
+    CAN20Frame actual;
+    assertEqual(can.read(&actual), Error::ERR_OK);
+    assertTrue(actual == f1);
+    assertEqual(fake.readsRemaining(), 0);
+    assertEqual(can.read(&actual), Error::ERR_OK);
+    assertTrue(actual == f2);
+    assertEqual(can.read(&actual), Error::ERR_OK);
+    assertTrue(actual == f3);
+    assertEqual(can.read(&actual), Error::ERR_FIFO);
+
+    // buffer writes until the child has room
+    assertEqual(can.write(f1), Error::ERR_OK);
+    assertEqual(can.write(f2), Error::ERR_OK);
+    fake.writeReset(3);
+    assertEqual(can.write(f3), Error::ERR_OK);
+    assertEqual(fake.writeCount(), 3);
+    assertTrue(fake.writeData()[0] == f1);
+    assertTrue(fake.writeData()[1] == f2);
+    assertTrue(fake.writeData()[2] == f3);
+}
+
+test(BufferedConnectionTest, PriorityWrite) {
+    FakeConnection fake(0, 0);
+    BufferedConnection<CAN20Frame, FrameQueue<CAN20Frame>, PriorityFrameQueue<CAN20Frame>> can(&fake, 1, 8);
+
+    CAN20Frame diag1(0x7DF, 0, {0x01});
+    CAN20Frame diag2(0x7DF, 0, {0x02});
+    CAN20Frame ext(0x00400000, 1, {0x03});
+    CAN20Frame critical(0x010, 0, {0x04});
+
+    assertEqual(can.write(diag1), Error::ERR_OK);
+    assertEqual(can.write(diag2), Error::ERR_OK);
+    assertEqual(can.write(ext), Error::ERR_OK);
+    assertEqual(can.write(critical), Error::ERR_OK);
+
+    // lowest ID first, equal IDs in FIFO order
+    fake.writeReset(2);
+    can.flush();
+    assertEqual(fake.writeCount(), 2);
+    assertTrue(fake.writeData()[0] == critical);
+    assertTrue(fake.writeData()[1] == ext);
+
+    fake.writeReset(2);
+    can.flush();
+    assertEqual(fake.writeCount(), 2);
+    assertTrue(fake.writeData()[0] == diag1);
+    assertTrue(fake.writeData()[1] == diag2);
+}
+
+class EvictConnection : public BufferedConnection<CAN20Frame, FrameQueue<CAN20Frame>,
+        PriorityFrameQueue<CAN20Frame>> {
+    public:
+        EvictConnection(Connection* child) : BufferedConnection(child, 1, 2), errors(0) {}
+
+        void onWriteError(Error err, const CAN20Frame& frame) const override {
+            ++errors;
+            last_error = err;
+            discarded = frame;
+        }
+
+        mutable int errors;
+        mutable Error last_error;
+        mutable CAN20Frame discarded;
+};
+
+test(BufferedConnectionTest, PriorityWriteEvicts) {
+    FakeConnection fake(0, 0);
+    EvictConnection can(&fake);
+
+    CAN20Frame low(0x300, 0, {0x01});
+    CAN20Frame mid(0x200, 0, {0x02});
+    CAN20Frame high(0x100, 0, {0x03});
+    CAN20Frame lowest(0x400, 0, {0x04});
+
+    assertEqual(can.write(low), Error::ERR_OK);
+    assertEqual(can.write(mid), Error::ERR_OK);
+
+    // the lowest priority buffered frame makes room for a higher one
+    assertEqual(can.write(high), Error::ERR_OK);
+    assertEqual(can.errors, 1);
+    assertEqual(can.last_error, Error::ERR_FIFO);
+    assertTrue(can.discarded == low);
+
+    // a lower priority frame is discarded itself
+    assertEqual(can.write(lowest), Error::ERR_FIFO);
+    assertEqual(can.errors, 2);
+    assertTrue(can.discarded == lowest);
+
+    fake.writeReset(4);
+    can.flush();
+    assertEqual(fake.writeCount(), 2);
+    assertTrue(fake.writeData()[0] == high);
+    assertTrue(fake.writeData()[1] == mid);
+}
+
+test(BufferedConnectionTest, CoalescingWrite) {
+    FakeConnection fake(0, 0);
+    BufferedConnection<CAN20Frame, FrameQueue<CAN20Frame>, CoalescingFrameQueue<CAN20Frame>> can(&fake, 1, 2);
+
+    CAN20Frame a1(0x100, 0, {0x01, 0x00});
+    CAN20Frame b1(0x200, 0, {0x01, 0x00});
+    CAN20Frame a2(0x100, 0, {0x02, 0x00});
+    CAN20Frame a3(0x100, 0, {0x03, 0x00});
+    CAN20Frame c1(0x300, 0, {0x01, 0x00});
+
+    assertEqual(can.write(a1), Error::ERR_OK);
+    assertEqual(can.write(b1), Error::ERR_OK);
+    assertEqual(can.write(a2), Error::ERR_OK);
+    assertEqual(can.write(a3), Error::ERR_OK);
+
+    // a third distinct ID does not fit
+    assertEqual(can.write(c1), Error::ERR_FIFO);
+
+    fake.writeReset(4);
+    can.flush();
+    assertEqual(fake.writeCount(), 2);
+    assertTrue(fake.writeData()[0] == a3);
+    assertTrue(fake.writeData()[1] == b1);
+}
+
+class TimestampConnection : public Connection<TimestampedFrame<CAN20Frame>> {
+    public:
+        TimestampConnection() : reads_(0) {}
+
+        Error read(TimestampedFrame<CAN20Frame>* frame) override {
+            if (reads_ >= 3) {
+                return ERR_FIFO;
+            }
+            *frame = TimestampedFrame<CAN20Frame>(CAN20Frame(0x100 + reads_, 0, {0x01, 0x02}),
+                    1000 * (reads_ + 1));
+            ++reads_;
+            return ERR_OK;
+        }
+
+        Error write(const TimestampedFrame<CAN20Frame>&) override {
+            return ERR_OK;
+        }
+
+    private:
+        uint32_t reads_;
+};
+
+test(BufferedConnectionTest, Timestamps) {
+    typedef TimestampedFrame<CAN20Frame> Frame;
+    TimestampConnection child1;
+    TimestampConnection child2;
+    BufferedConnection<Frame> can1(&child1, 4, 1);
+    BufferedConnection<Frame, CompactFrameQueue<Frame>> can2(&child2, 64, 64);
+
+    Frame frame;
+    for (uint32_t i = 0; i < 3; ++i) {
+        assertEqual(can1.read(&frame), Error::ERR_OK);
+        assertEqual(frame.timestamp(), 1000 * (i + 1));
+        assertEqual(can2.read(&frame), Error::ERR_OK);
+        assertEqual(frame.timestamp(), 1000 * (i + 1));
+    }
+}
+
 }  // namespace Canny
 
 // Test boilerplate.
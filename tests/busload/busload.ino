@@ -0,0 +1,136 @@
+#include <Arduino.h>
+#include <AUnit.h>
+#include <Canny.h>
+#include <Canny/BusLoad.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+class FakeConnection : public Connection<CAN20Frame> {
+    public:
+        FakeConnection() : reads_(0) {}
+
+        Error read(CAN20Frame* frame) override {
+            if (reads_ == 0) {
+                return ERR_FIFO;
+            }
+            --reads_;
+            *frame = CAN20Frame(0x123, 0, {0x11, 0x22, 0x33, 0x44});
+            return ERR_OK;
+        }
+
+        Error write(const CAN20Frame&) override {
+            return ERR_OK;
+        }
+
+        void setReads(size_t reads) { reads_ = reads; }
+
+    private:
+        size_t reads_;
+};
+
+test(BusLoadTest, ClassicWorstCase) {
+    uint8_t data[8] = {0};
+    BusLoad load(CAN20_500K, CAN20);
+    assertEqual(load.frameTime(0x123, 0, data, 8), (uint32_t)270000);
+    assertEqual(load.frameTime(0x18FEF100, 1, data, 8), (uint32_t)320000);
+    assertEqual(load.frameTime(0x123, 0, data, 0), (uint32_t)110000);
+}
+
+test(BusLoadTest, ClassicExact) {
+    uint8_t zeros[8] = {0};
+    uint8_t ones[8] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    uint8_t mixed[2] = {0xAA, 0x55};
+    BusLoad load(CAN20_500K, CAN20, Stuffing::EXACT);
+    assertEqual(load.frameTime(0x000, 0, zeros, 0), (uint32_t)106000);
+    assertEqual(load.frameTime(0x7FF, 0, ones, 8), (uint32_t)252000);
+    assertEqual(load.frameTime(0x555, 0, mixed, 2), (uint32_t)128000);
+    assertEqual(load.frameTime(0x18FEF100, 1, zeros, 8), (uint32_t)294000);
+}
+
+test(BusLoadTest, ClassicFrame) {
+    BusLoad load(CAN20_500K, CAN20, Stuffing::EXACT);
+    CAN20Frame frame(0x123, 0, {0x11, 0x22, 0x33, 0x44});
+    assertEqual(load.frameTime(frame), (uint32_t)160000);
+}
+
+test(BusLoadTest, FDExact) {
+    uint8_t data[64] = {0};
+    for (size_t i = 0; i < 12; ++i) {
+        data[i] = 0x11;
+    }
+    BusLoad load(CANFD_500K_2M, CANFD_DUAL_RATE, Stuffing::EXACT);
+    assertEqual(load.frameTime(0x123, 0, data, 12), (uint32_t)124000);
+
+    // Payloads are padded to the next FD length.
+    data[10] = 0;
+    data[11] = 0;
+    assertEqual(load.frameTime(0x123, 0, data, 10), load.frameTime(0x123, 0, data, 12));
+
+    memset(data, 0, sizeof(data));
+    assertEqual(load.frameTime(0x18FEF100, 1, data, 64), (uint32_t)427500);
+
+    BusLoad constant(CANFD_500K, CANFD_CONST_RATE, Stuffing::EXACT);
+    assertEqual(constant.frameTime(0x000, 0, data, 0), (uint32_t)130000);
+}
+
+test(BusLoadTest, FDWorstCase) {
+    uint8_t data[64] = {0};
+    BusLoad exact(CANFD_500K_2M, CANFD_DUAL_RATE, Stuffing::EXACT);
+    BusLoad worst(CANFD_500K_2M, CANFD_DUAL_RATE);
+    assertMoreOrEqual(worst.frameTime(0x18FEF100, 1, data, 64),
+            exact.frameTime(0x18FEF100, 1, data, 64));
+    assertMoreOrEqual(worst.frameTime(0x000, 0, data, 0), exact.frameTime(0x000, 0, data, 0));
+}
+
+test(BusLoadTest, ClassicModeDowngrade) {
+    uint8_t data[8] = {0};
+    BusLoad load(CANFD_500K_2M, CAN20);
+    assertEqual(load.frameTime(0x123, 0, data, 8), (uint32_t)270000);
+}
+
+test(BusLoadTest, Window) {
+    BusLoad load(CAN20_500K, CAN20, Stuffing::WORST_CASE, 80);
+    assertEqual(load.window(), (uint16_t)80);
+    assertEqual(load.load(), (uint8_t)0);
+
+    delay(20);
+    load.recordTime(10000000);
+    uint8_t percent = load.load();
+    assertMoreOrEqual(percent, (uint8_t)30);
+    assertLessOrEqual(percent, (uint8_t)50);
+
+    delay(100);
+    assertEqual(load.load(), (uint8_t)0);
+
+    load.recordTime(10000000);
+    load.clear();
+    assertEqual(load.load(), (uint8_t)0);
+}
+
+test(BusLoadTest, Connection) {
+    FakeConnection fake;
+    fake.setReads(4);
+
+    BusLoadConnection<CAN20Frame> can(&fake, CAN20_500K, CAN20, Stuffing::EXACT);
+    CAN20Frame frame;
+    while (can.read(&frame) == ERR_OK) {}
+    assertEqual(can.write(frame), ERR_OK);
+    assertMore(can.estimator()->loadPermille(), (uint16_t)0);
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
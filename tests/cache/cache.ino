@@ -0,0 +1,151 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/Cache.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+class FakeConnection : public Connection<CAN20Frame> {
+    public:
+        FakeConnection() : read_len_(0), read_pos_(0), write_count_(0) {}
+
+        Error read(CAN20Frame* frame) override {
+            if (read_pos_ >= read_len_) {
+                return ERR_FIFO;
+            }
+            *frame = read_buffer_[read_pos_++];
+            return ERR_OK;
+        }
+
+        Error write(const CAN20Frame&) override {
+            ++write_count_;
+            return ERR_OK;
+        }
+
+        void add(const CAN20Frame& frame) {
+            read_buffer_[read_len_++] = frame;
+        }
+
+        int writeCount() const { return write_count_; }
+
+    private:
+        CAN20Frame read_buffer_[32];
+        size_t read_len_;
+        size_t read_pos_;
+        int write_count_;
+};
+
+test(FrameCacheTest, ReadThrough) {
+    FakeConnection fake;
+    FrameCache<CAN20Frame> cache(&fake, 4);
+
+    CAN20Frame expect(0x123, 0, {0x01, 0x02});
+    fake.add(expect);
+
+    CAN20Frame actual;
+    assertEqual(cache.read(&actual), ERR_OK);
+    assertTrue(actual == expect);
+    assertEqual(cache.read(&actual), ERR_FIFO);
+
+    const CAN20Frame* latest = cache.latest(0x123, 0);
+    assertNotEqual(latest, (const CAN20Frame*)nullptr);
+    assertTrue(*latest == expect);
+    assertEqual(cache.latest(0x123, 1), (const CAN20Frame*)nullptr);
+    assertEqual(cache.latest(0x124, 0), (const CAN20Frame*)nullptr);
+
+    assertEqual(cache.write(expect), ERR_OK);
+    assertEqual(fake.writeCount(), 1);
+}
+
+test(FrameCacheTest, Latest) {
+    FakeConnection fake;
+    FrameCache<CAN20Frame> cache(&fake, 4);
+
+    fake.add(CAN20Frame(0x100, 0, {0x01, 0x00}));
+    fake.add(CAN20Frame(0x200, 0, {0x01, 0x00}));
+    fake.add(CAN20Frame(0x100, 0, {0x02, 0x00}));
+    fake.add(CAN20Frame(0x100, 0, {0x03, 0x00}));
+    assertEqual(cache.poll(), (size_t)4);
+    assertEqual(cache.size(), (size_t)2);
+
+    const FrameCacheEntry<CAN20Frame>* entry = cache.find(0x100, 0);
+    assertNotEqual(entry, (const FrameCacheEntry<CAN20Frame>*)nullptr);
+    assertEqual(entry->frame.data()[0], (uint8_t)0x03);
+    assertEqual(entry->updates, (uint32_t)3);
+    assertEqual(cache.find(0x200, 0)->updates, (uint32_t)1);
+}
+
+test(FrameCacheTest, Changed) {
+    FakeConnection fake;
+    FrameCache<CAN20Frame> cache(&fake, 4);
+
+    fake.add(CAN20Frame(0x100, 0, {0x01, 0x00}));
+    fake.add(CAN20Frame(0x200, 0, {0x01, 0x00}));
+    fake.add(CAN20Frame(0x100, 0, {0x02, 0x00}));
+    cache.poll();
+
+    const FrameCacheEntry<CAN20Frame>* entry = cache.nextChanged();
+    assertEqual(entry->frame.id(), (uint32_t)0x100);
+    assertEqual(entry->frame.data()[0], (uint8_t)0x02);
+    entry = cache.nextChanged();
+    assertEqual(entry->frame.id(), (uint32_t)0x200);
+    assertEqual(cache.nextChanged(), (const FrameCacheEntry<CAN20Frame>*)nullptr);
+
+    fake.add(CAN20Frame(0x200, 0, {0x02, 0x00}));
+    cache.poll();
+    entry = cache.nextChanged();
+    assertEqual(entry->frame.id(), (uint32_t)0x200);
+    assertEqual(cache.nextChanged(), (const FrameCacheEntry<CAN20Frame>*)nullptr);
+}
+
+test(FrameCacheTest, Full) {
+    FakeConnection fake;
+    FrameCache<CAN20Frame> cache(&fake, 2);
+
+    fake.add(CAN20Frame(0x100, 0, 1));
+    fake.add(CAN20Frame(0x200, 0, 1));
+    fake.add(CAN20Frame(0x300, 0, 1));
+    fake.add(CAN20Frame(0x100, 0, 2));
+    assertEqual(cache.poll(), (size_t)4);
+    assertEqual(cache.size(), (size_t)2);
+    assertEqual(cache.latest(0x300, 0), (const CAN20Frame*)nullptr);
+    assertEqual(cache.latest(0x100, 0)->size(), (uint8_t)2);
+
+    cache.clear();
+    assertEqual(cache.size(), (size_t)0);
+    assertEqual(cache.latest(0x100, 0), (const CAN20Frame*)nullptr);
+    assertEqual(cache.nextChanged(), (const FrameCacheEntry<CAN20Frame>*)nullptr);
+}
+
+test(FrameCacheTest, Stale) {
+    FakeConnection fake;
+    FrameCache<CAN20Frame> cache(&fake, 4, 20000);
+
+    assertTrue(cache.stale(0x100, 0));
+    fake.add(CAN20Frame(0x100, 0, 1));
+    cache.poll();
+    assertFalse(cache.stale(0x100, 0));
+    delay(30);
+    assertTrue(cache.stale(0x100, 0));
+    assertMoreOrEqual(cache.age(*cache.find(0x100, 0)), (uint32_t)20000);
+
+    cache.timeout(0);
+    assertFalse(cache.stale(0x100, 0));
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
@@ -0,0 +1,221 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/Capture.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+// A stream backed by a fixed buffer. Bytes written are appended and bytes read
+// are consumed from the front. At most limit bytes are available to read.
+class MemoryStream : public Stream {
+    public:
+        MemoryStream() : len_(0), pos_(0), limit_(sizeof(buffer_)) {}
+
+        int available() override {
+            size_t end = len_ < limit_ ? len_ : limit_;
+            return end > pos_ ? end - pos_ : 0;
+        }
+
+        int read() override { return available() > 0 ? buffer_[pos_++] : -1; }
+
+        int peek() override { return available() > 0 ? buffer_[pos_] : -1; }
+
+        size_t write(uint8_t b) override {
+            if (len_ >= sizeof(buffer_)) {
+                return 0;
+            }
+            buffer_[len_++] = b;
+            return 1;
+        }
+
+        using Print::write;
+
+        void limit(size_t limit) { limit_ = limit; }
+        size_t size() const { return len_; }
+        const uint8_t* data() const { return buffer_; }
+        const char* str() {
+            buffer_[len_ < sizeof(buffer_) ? len_ : sizeof(buffer_) - 1] = 0;
+            return (const char*)buffer_;
+        }
+
+    private:
+        uint8_t buffer_[512];
+        size_t len_;
+        size_t pos_;
+        size_t limit_;
+};
+
+template <typename FrameType>
+class FakeConnection : public Connection<FrameType> {
+    public:
+        FakeConnection() : len_(0), pos_(0) {}
+
+        Error read(FrameType* frame) override {
+            if (pos_ >= len_) {
+                return ERR_FIFO;
+            }
+            *frame = frames_[pos_++];
+            return ERR_OK;
+        }
+
+        Error write(const FrameType&) override { return ERR_OK; }
+
+        void add(const FrameType& frame) { frames_[len_++] = frame; }
+
+    private:
+        FrameType frames_[8];
+        size_t len_;
+        size_t pos_;
+};
+
+test(CaptureTest, Encode) {
+    uint8_t data[8] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88};
+    uint8_t buffer[CaptureMaxRecord];
+    uint8_t expect[] = {
+        0xE8, 0x07,
+        0x8D, 0x09,
+        0x08,
+        0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+    };
+    size_t len = captureEncode(buffer, 1000, 0x123, 0, CaptureWrite, data, 8);
+    assertEqual(len, sizeof(expect));
+    assertEqual(memcmp(buffer, expect, len), 0);
+
+    assertEqual(captureHeader(buffer), (size_t)4);
+    assertEqual(buffer[0], 'C');
+    assertEqual(buffer[3], 0x01);
+}
+
+test(CaptureTest, RoundTrip) {
+    typedef TimestampedFrame<CAN20Frame> Frame;
+    FakeConnection<Frame> child;
+    child.add(Frame(CAN20Frame(0x123, 0, {0x11, 0x22, 0x33, 0x44}), 1000));
+    child.add(Frame(CAN20Frame(0x18FEF100, 1, {0x01, 0x02}), 1500));
+    Frame written(CAN20Frame(0x456, 0, 0), 301500);
+
+    MemoryStream stream;
+    CaptureWriter<Frame> writer(&child, &stream);
+    Frame frame;
+    assertEqual(writer.read(&frame), ERR_OK);
+    assertEqual(writer.read(&frame), ERR_OK);
+    assertEqual(writer.read(&frame), ERR_FIFO);
+    assertEqual(writer.write(written), ERR_OK);
+    assertEqual(writer.frames(), (uint32_t)3);
+    assertEqual(writer.overflows(), (uint32_t)0);
+
+    Replayer<Frame> replayer(&stream, false);
+    assertEqual(replayer.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x123, 0, {0x11, 0x22, 0x33, 0x44}));
+    assertEqual(frame.timestamp(), 0u);
+    assertEqual(replayer.direction(), CaptureRead);
+
+    assertEqual(replayer.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x18FEF100, 1, {0x01, 0x02}));
+    assertEqual(frame.timestamp(), 500u);
+
+    assertEqual(replayer.read(&frame), ERR_OK);
+    assertEqual(frame.id(), 0x456u);
+    assertEqual(frame.size(), 0);
+    assertEqual(frame.timestamp(), 300500u);
+    assertEqual(replayer.direction(), CaptureWrite);
+
+    assertEqual(replayer.read(&frame), ERR_FIFO);
+}
+
+test(CaptureTest, Partial) {
+    FakeConnection<CANFDFrame> child;
+    CANFDFrame expect(0x18FEF100, 1, 64);
+    memset(expect.data(), 0xA5, 64);
+    child.add(expect);
+
+    MemoryStream stream;
+    CaptureWriter<CANFDFrame> writer(&child, &stream);
+    CANFDFrame frame;
+    assertEqual(writer.read(&frame), ERR_OK);
+
+    // bytes arrive one at a time
+    Replayer<CANFDFrame> replayer(&stream, false);
+    for (size_t i = 1; i < stream.size(); ++i) {
+        stream.limit(i);
+        assertEqual(replayer.read(&frame), ERR_FIFO);
+    }
+    stream.limit(stream.size());
+    assertEqual(replayer.read(&frame), ERR_OK);
+    assertTrue(frame == expect);
+}
+
+test(CaptureTest, Realtime) {
+    uint8_t data[2] = {0x01, 0x02};
+    uint8_t buffer[4 + 2 * CaptureMaxRecord];
+    size_t len = captureHeader(buffer);
+    len += captureEncode(buffer + len, 0, 0x100, 0, CaptureRead, data, 2);
+    len += captureEncode(buffer + len, 20000, 0x101, 0, CaptureRead, data, 2);
+
+    MemoryStream stream;
+    stream.write(buffer, len);
+
+    Replayer<CAN20Frame> replayer(&stream);
+    CAN20Frame frame;
+    assertEqual(replayer.read(&frame), ERR_OK);
+    assertEqual(frame.id(), 0x100u);
+    assertEqual(replayer.read(&frame), ERR_FIFO);
+    delay(25);
+    assertEqual(replayer.read(&frame), ERR_OK);
+    assertEqual(frame.id(), 0x101u);
+}
+
+test(CaptureTest, Invalid) {
+    MemoryStream stream;
+    stream.print("candump");
+
+    Replayer<CAN20Frame> replayer(&stream, false);
+    CAN20Frame frame;
+    assertEqual(replayer.read(&frame), ERR_INVALID);
+}
+
+test(CaptureTest, Overflow) {
+    FakeConnection<CAN20Frame> child;
+    MemoryStream stream;
+    CaptureWriter<CAN20Frame> writer(&child, &stream);
+    CAN20Frame frame(0x123, 0, 8);
+    for (size_t i = 0; i < 50; ++i) {
+        assertEqual(writer.write(frame), ERR_OK);
+    }
+    assertEqual(writer.frames(), (uint32_t)50);
+    assertMore(writer.overflows(), (uint32_t)0);
+}
+
+test(CaptureTest, Candump) {
+    uint8_t data[12] = {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88, 0x99, 0xAA, 0xBB, 0xCC};
+    uint8_t buffer[4 + 3 * CaptureMaxRecord];
+    size_t len = captureHeader(buffer);
+    len += captureEncode(buffer + len, 0, 0x123, 0, CaptureRead, data, 8);
+    len += captureEncode(buffer + len, 500, 0x18FEF100, 1, CaptureWrite, data, 2);
+    len += captureEncode(buffer + len, 2000000, 0x7FF, 0, CaptureRead, data, 12);
+
+    MemoryStream in;
+    in.write(buffer, len);
+    MemoryStream out;
+    assertEqual(captureToCandump(&in, &out, "vcan0"), (size_t)3);
+    assertEqual(out.str(),
+        "(0.000000) vcan0 123#1122334455667788\n"
+        "(0.000500) vcan0 18FEF100#1122\n"
+        "(2.000500) vcan0 7FF##0112233445566778899AABBCC\n");
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
@@ -148,6 +148,125 @@ test(FrameIDFilterTest, ModeFromDropToAllow) {
     assertTrue(filter.match(0x00005432));
 }
 
+test(FrameIDFilterTest, StandardAndExtended) {
+    FrameIDFilter filter(FilterMode::DROP);
+    filter.allow(0x000);
+    filter.allow(0x7FF);
+    filter.allow(0x800);
+    filter.allow(0x1FFFFFFF);
+
+    assertTrue(filter.match(0x000));
+    assertFalse(filter.match(0x001));
+    assertTrue(filter.match(0x7FF));
+    assertTrue(filter.match(0x800));
+    assertFalse(filter.match(0x801));
+    assertTrue(filter.match(0x1FFFFFFF));
+    assertFalse(filter.match(0x1FFFFFFE));
+
+    filter.drop(0x7FF);
+    filter.drop(0x800);
+    assertTrue(filter.match(0x000));
+    assertFalse(filter.match(0x7FF));
+    assertFalse(filter.match(0x800));
+    assertTrue(filter.match(0x1FFFFFFF));
+}
+
+test(FrameIDFilterTest, ManyIDs) {
+    FrameIDFilter filter(FilterMode::ALLOW);
+    for (uint32_t i = 0; i < 300; ++i) {
+        filter.drop((i * 7919) % 0x800);
+        filter.drop(0x18FF0000 + ((i * 7919) % 0x10000));
+    }
+    for (uint32_t i = 0; i < 300; ++i) {
+        assertFalse(filter.match((i * 7919) % 0x800));
+        assertFalse(filter.match(0x18FF0000 + ((i * 7919) % 0x10000)));
+    }
+    assertTrue(filter.match(0x18FEFFFF));
+    for (uint32_t i = 0; i < 300; i += 2) {
+        filter.allow(0x18FF0000 + ((i * 7919) % 0x10000));
+    }
+    for (uint32_t i = 0; i < 300; ++i) {
+        assertEqual(filter.match(0x18FF0000 + ((i * 7919) % 0x10000)), i % 2 == 0);
+    }
+}
+
+test(FrameIDFilterTest, MaskRules) {
+    FrameIDFilter filter(FilterMode::DROP);
+    filter.allowMask(0x100, 0x7F0);
+    filter.allowMask(0x18FECA00, 0x1FFFFF00);
+
+    assertTrue(filter.match(0x100));
+    assertTrue(filter.match(0x10F));
+    assertFalse(filter.match(0x110));
+    assertTrue(filter.match(0x18FECA00));
+    assertTrue(filter.match(0x18FECA31));
+    assertFalse(filter.match(0x18FECB31));
+
+    filter.dropMask(0x100, 0x7F0);
+    assertFalse(filter.match(0x100));
+    assertTrue(filter.match(0x18FECA31));
+}
+
+test(FrameIDFilterTest, RangeRules) {
+    FrameIDFilter filter(FilterMode::ALLOW);
+    filter.dropRange(0x100, 0x1FF);
+    filter.dropRange(0x180, 0x2FF);
+    filter.dropRange(0x500, 0x5FF);
+
+    assertTrue(filter.match(0x0FF));
+    assertFalse(filter.match(0x100));
+    assertFalse(filter.match(0x2FF));
+    assertTrue(filter.match(0x300));
+    assertTrue(filter.match(0x4FF));
+    assertFalse(filter.match(0x500));
+    assertFalse(filter.match(0x5FF));
+    assertTrue(filter.match(0x600));
+
+    filter.allowRange(0x180, 0x2FF);
+    assertFalse(filter.match(0x1FF));
+    assertTrue(filter.match(0x200));
+}
+
+test(FrameIDFilterTest, J1939Rules) {
+    FrameIDFilter filter(FilterMode::DROP);
+    // PDU2 from any source
+    filter.allowJ1939(0xFECA);
+    // PDU1 from a single source with any destination
+    filter.allowJ1939(0xEF00, 0x31);
+    // PDU2 at priority 3 only
+    filter.allowJ1939(0xF004, AnySourceAddress, 3);
+
+    assertTrue(filter.match(0x18FECA00));
+    assertTrue(filter.match(0x1CFECA31));
+    assertFalse(filter.match(0x18FECB31));
+    assertTrue(filter.match(0x18EF4231));
+    assertTrue(filter.match(0x18EF0031));
+    assertFalse(filter.match(0x18EF4232));
+    assertTrue(filter.match(0x0CF00400));
+    assertFalse(filter.match(0x18F00400));
+
+    filter.dropJ1939(0xFECA);
+    assertFalse(filter.match(0x18FECA00));
+}
+
+test(FrameIDFilterTest, RulesWithIDs) {
+    FrameIDFilter filter(FilterMode::ALLOW);
+    filter.drop(0x123);
+    filter.dropRange(0x200, 0x20F);
+    filter.dropMask(0x18FF0000, 0x1FFF0000);
+
+    assertFalse(filter.match(0x123));
+    assertFalse(filter.match(0x205));
+    assertFalse(filter.match(0x18FF1234));
+    assertTrue(filter.match(0x124));
+    assertTrue(filter.match(0x18FE1234));
+
+    filter.clear();
+    assertTrue(filter.match(0x123));
+    assertTrue(filter.match(0x205));
+    assertTrue(filter.match(0x18FF1234));
+}
+
 }
 
 // Test boilerplate.
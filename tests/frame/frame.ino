@@ -272,6 +272,36 @@ test(MutableTest, MutableData) {
     assertEqual(memcmp(f.data(), expect_data, 4), 0);
 }
 
+test(TimestampTest, Construct) {
+    TimestampedFrame<CAN20Frame> f1(0x123, 0, {0x1A, 0x2B});
+    assertEqual(f1.id(), 0x123u);
+    assertEqual(f1.size(), 2);
+    assertEqual(f1.timestamp(), 0u);
+
+    TimestampedFrame<CAN20Frame> f2(CAN20Frame(0x123, 0, {0x1A, 0x2B}), 1000);
+    assertEqual(f2.timestamp(), 1000u);
+    assertTrue(f1 == f2);
+
+    TimestampedFrame<CAN20Frame> f3 = f2;
+    assertEqual(f3.timestamp(), 1000u);
+}
+
+test(TimestampTest, Stamp) {
+    TimestampedFrame<CANFDFrame> stamped;
+    stampFrame(&stamped, 1234);
+    assertEqual(stamped.timestamp(), 1234u);
+    assertEqual(frameTimestamp(stamped), 1234u);
+    stampFrame(&stamped);
+    assertNotEqual(stamped.timestamp(), 1234u);
+
+    CANFDFrame plain(0x01, 0, 8);
+    stampFrame(&plain, 1234);
+    assertEqual(frameTimestamp(plain), 0u);
+    assertTrue(FrameTraits<TimestampedFrame<CANFDFrame>>::timestamped);
+    assertFalse(FrameTraits<CANFDFrame>::timestamped);
+    assertEqual(sizeof(CANFDFrame), sizeof(Frame<64, 0x00>));
+}
+
 }  // namespace Canny
 
 // Test boilerplate.
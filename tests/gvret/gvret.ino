@@ -0,0 +1,262 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/GVRET.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+// A stream that plays the host side of a serial link. Bytes sent by the host
+// are read from input. Bytes written by the device are collected in output.
+class HostStream : public Stream {
+    public:
+        HostStream() : in_len_(0), in_pos_(0), out_len_(0), writes_(0) {}
+
+        int available() override { return in_len_ - in_pos_; }
+
+        int read() override { return available() > 0 ? input_[in_pos_++] : -1; }
+
+        int peek() override { return available() > 0 ? input_[in_pos_] : -1; }
+
+        size_t write(uint8_t b) override { return write(&b, 1); }
+
+        size_t write(const uint8_t* buffer, size_t size) override {
+            if (out_len_ + size >= sizeof(output_)) {
+                size = sizeof(output_) - out_len_ - 1;
+            }
+            memcpy(output_ + out_len_, buffer, size);
+            out_len_ += size;
+            ++writes_;
+            return size;
+        }
+
+        // Queue bytes sent by the host.
+        template <size_t N>
+        void send(const uint8_t (&bytes)[N]) {
+            memcpy(input_ + in_len_, bytes, N);
+            in_len_ += N;
+        }
+
+        // Return true if the device wrote exactly the expected bytes. The
+        // written bytes are cleared.
+        template <size_t N>
+        bool received(const uint8_t (&expect)[N]) {
+            bool equal = out_len_ == N && memcmp(output_, expect, N) == 0;
+            out_len_ = 0;
+            return equal;
+        }
+
+        // Return and clear the bytes written by the device.
+        const uint8_t* received(size_t* len) {
+            *len = out_len_;
+            out_len_ = 0;
+            return output_;
+        }
+
+        int writes() const { return writes_; }
+
+    private:
+        uint8_t input_[1024];
+        size_t in_len_;
+        size_t in_pos_;
+        uint8_t output_[1024];
+        size_t out_len_;
+        int writes_;
+};
+
+template <typename FrameType>
+class FakeController : public Controller<FrameType> {
+    public:
+        FakeController() : begins_(0), bitrate_(CAN20_125K) {}
+
+        bool begin(Bitrate bitrate) override {
+            ++begins_;
+            bitrate_ = bitrate;
+            return true;
+        }
+        Mode mode() const override { return CAN20; }
+        Bitrate bitrate() const override { return bitrate_; }
+        Error read(FrameType*) override { return ERR_FIFO; }
+        Error write(const FrameType&) override { return ERR_OK; }
+
+        int begins() const { return begins_; }
+
+    private:
+        int begins_;
+        Bitrate bitrate_;
+};
+
+test(GVRETTest, Commands) {
+    HostStream stream;
+    GVRET gvret(&stream, 2);
+    gvret.configure(1, CAN20_250K);
+
+    stream.send((uint8_t[]){0xE7, 0xE7, 0xF1, 0x0C, 0xF1, 0x06, 0xF1, 0x07, 0xF1, 0x09});
+    gvret.poll();
+    assertTrue(gvret.binary());
+    assertTrue(stream.received((uint8_t[]){
+        0xF1, 0x0C, 0x02,
+        0xF1, 0x06, 0x01, 0x20, 0xA1, 0x07, 0x00, 0x01, 0x90, 0xD0, 0x03, 0x00,
+        0xF1, 0x07, 0x6A, 0x01, 0x20, 0x00, 0x00, 0x00,
+        0xF1, 0x09, 0xDE, 0xAD,
+    }));
+
+    // unknown commands and stray bytes are skipped
+    stream.send((uint8_t[]){0x55, 0xF1, 0x7F, 0xF1, 0x08, 0x01, 0xF1, 0x0C});
+    gvret.poll();
+    assertTrue(stream.received((uint8_t[]){0xF1, 0x0C, 0x02}));
+
+    size_t len;
+    stream.send((uint8_t[]){0xF1, 0x01});
+    gvret.poll();
+    const uint8_t* sync = stream.received(&len);
+    assertEqual(len, (size_t)6);
+    assertEqual(sync[1], 0x01);
+}
+
+test(GVRETTest, SetupBus) {
+    HostStream stream;
+    GVRET gvret(&stream, 2);
+    FakeController<CANFDFrame> controller0;
+    FakeController<CAN20Frame> controller1;
+    GVRETBus<CANFDFrame> bus0(&gvret, 0, &controller0);
+    GVRETBus<CAN20Frame> bus1(&gvret, 1, &controller1);
+    gvret.configure(0, CANFD_500K_2M);
+    CANFDFrame fd;
+    CAN20Frame frame;
+
+    // bus 0 keeps its data rate at 500K, bus 1 is enabled at 1M in listen
+    // only mode
+    stream.send((uint8_t[]){0xF1, 0x05, 0x20, 0xA1, 0x07, 0x00, 0x40, 0x42, 0x0F, 0xE0});
+    assertEqual(bus0.read(&fd), ERR_FIFO);
+    assertEqual(bus1.read(&frame), ERR_FIFO);
+    assertEqual(controller0.begins(), 0);
+    assertEqual(controller1.begins(), 1);
+    assertEqual(controller1.bitrate(), CAN20_1000K);
+    assertTrue(gvret.listenOnly(1));
+
+    // bus 0 moves to 250K and bus 1 is disabled
+    stream.send((uint8_t[]){0xF1, 0x05, 0x90, 0xD0, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00});
+    assertEqual(bus0.read(&fd), ERR_FIFO);
+    assertEqual(bus1.read(&frame), ERR_FIFO);
+    assertEqual(controller0.begins(), 1);
+    assertEqual(controller0.bitrate(), CAN20_250K);
+    assertFalse(gvret.enabled(1));
+    assertEqual(controller1.begins(), 1);
+}
+
+test(GVRETTest, Read) {
+    HostStream stream;
+    GVRET gvret(&stream, 2);
+    GVRETBus<CANFDFrame> bus0(&gvret, 0);
+    GVRETBus<CAN20Frame> bus1(&gvret, 1);
+    CANFDFrame fd;
+    CAN20Frame frame;
+
+    stream.send((uint8_t[]){
+        0xE7, 0xE7,
+        // extended frame on bus 1
+        0xF1, 0x00, 0x00, 0xF1, 0xFE, 0x98, 0x01, 0x02, 0xAA, 0xBB, 0x00,
+        // standard frame on bus 0
+        0xF1, 0x00, 0x23, 0x01, 0x00, 0x00, 0x00, 0x01, 0xCC, 0x00,
+        // FD frame on bus 0
+        0xF1, 0x14, 0x23, 0x01, 0x00, 0x00, 0x00, 0x0C,
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x00,
+        // FD frame on bus 1 is too large
+        0xF1, 0x14, 0x23, 0x01, 0x00, 0x00, 0x01, 0x0C,
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x00,
+        // standard frame on bus 1
+        0xF1, 0x00, 0x45, 0x04, 0x00, 0x00, 0x01, 0x00, 0x00,
+    });
+
+    // frames are taken in order
+    assertEqual(bus0.read(&fd), ERR_FIFO);
+    assertEqual(bus1.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x18FEF100, 1, {0xAA, 0xBB}));
+    assertEqual(bus1.read(&frame), ERR_FIFO);
+    assertEqual(bus0.read(&fd), ERR_OK);
+    assertTrue(fd == CANFDFrame(0x123, 0, (uint8_t[]){0xCC}));
+    assertEqual(bus0.read(&fd), ERR_OK);
+    assertEqual(fd.size(), 12);
+    assertEqual(fd.data()[11], 0x0B);
+    assertEqual(bus1.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x445, 0, 0));
+    assertEqual(bus1.read(&frame), ERR_FIFO);
+    assertEqual(gvret.dropped(), (uint32_t)0);
+}
+
+test(GVRETTest, Write) {
+    typedef TimestampedFrame<CANFDFrame> Frame;
+    HostStream stream;
+    GVRET gvret(&stream, 2);
+    GVRETBus<Frame> bus0(&gvret, 0);
+    GVRETBus<Frame> bus1(&gvret, 1);
+
+    Frame frame(CANFDFrame(0x18FEF100, 1, {0xAA, 0xBB}), 0x01020304);
+    assertEqual(bus1.write(frame), ERR_READY);
+
+    stream.send((uint8_t[]){0xE7, 0xE7});
+    gvret.poll();
+    assertEqual(bus1.write(frame), ERR_OK);
+    assertEqual(bus0.write(Frame(CANFDFrame(0x123, 0, 12), 5)), ERR_OK);
+    assertEqual(stream.writes(), 0);
+    gvret.flush();
+    assertEqual(stream.writes(), 1);
+    assertTrue(stream.received((uint8_t[]){
+        0xF1, 0x00, 0x04, 0x03, 0x02, 0x01, 0x00, 0xF1, 0xFE, 0x98, 0x12, 0xAA, 0xBB, 0x00,
+        0xF1, 0x14, 0x05, 0x00, 0x00, 0x00, 0x23, 0x01, 0x00, 0x00, 0x0C, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    }));
+}
+
+test(GVRETTest, WriteBatch) {
+    HostStream stream;
+    GVRET gvret(&stream, 1);
+    GVRETBus<CAN20Frame> bus(&gvret, 0);
+
+    stream.send((uint8_t[]){0xE7, 0xE7});
+    gvret.poll();
+    for (int i = 0; i < 20; ++i) {
+        CAN20Frame frame(0x100 + i, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+        assertEqual(bus.write(frame), ERR_OK);
+    }
+    gvret.poll();
+
+    // 20 byte records are packed into the output buffer
+    size_t len;
+    stream.received(&len);
+    assertEqual(len, (size_t)(20 * 20));
+    assertEqual(stream.writes(), 2);
+}
+
+test(GVRETTest, Echo) {
+    HostStream stream;
+    GVRET gvret(&stream, 1);
+    GVRETBus<CAN20Frame> bus(&gvret, 0);
+    CAN20Frame frame;
+
+    stream.send((uint8_t[]){0xE7, 0xE7, 0xF1, 0x0B, 0x23, 0x01, 0x00, 0x00, 0x00, 0x01, 0xCC, 0x00});
+    assertEqual(bus.read(&frame), ERR_FIFO);
+    gvret.flush();
+    size_t len;
+    const uint8_t* echo = stream.received(&len);
+    assertEqual(len, (size_t)13);
+    assertEqual(echo[10], 0x01);
+    assertEqual(echo[11], 0xCC);
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
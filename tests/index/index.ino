@@ -0,0 +1,70 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny/FrameIndex.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+test(FrameIndexTest, Key) {
+    assertEqual(frameKey(0x123, 0), (uint32_t)0x123);
+    assertEqual(frameKey(0x123, 1), (uint32_t)0x80000123);
+    assertNotEqual(frameKey(0x18FEF100, 0), frameKey(0x18FEF100, 1));
+}
+
+test(FrameIndexTest, PutGet) {
+    FrameIndex index(4);
+    assertEqual(index.get(frameKey(0x100, 0)), FrameIndex::Empty);
+
+    index.put(frameKey(0x100, 0), 0);
+    index.put(frameKey(0x100, 1), 1);
+    index.put(frameKey(0x200, 0), 2);
+    assertEqual(index.get(frameKey(0x100, 0)), (size_t)0);
+    assertEqual(index.get(frameKey(0x100, 1)), (size_t)1);
+    assertEqual(index.get(frameKey(0x200, 0)), (size_t)2);
+    assertEqual(index.get(frameKey(0x300, 0)), FrameIndex::Empty);
+
+    index.put(frameKey(0x200, 0), 3);
+    assertEqual(index.get(frameKey(0x200, 0)), (size_t)3);
+}
+
+test(FrameIndexTest, Remove) {
+    // Fill the index so that probe sequences overlap.
+    FrameIndex index(16);
+    for (uint32_t id = 0; id < 16; ++id) {
+        index.put(frameKey(id * 64, 0), id);
+    }
+
+    for (uint32_t id = 0; id < 16; id += 2) {
+        index.remove(frameKey(id * 64, 0));
+    }
+    index.remove(frameKey(0x7FF, 0));
+    for (uint32_t id = 0; id < 16; ++id) {
+        size_t expect = id % 2 == 0 ? FrameIndex::Empty : id;
+        assertEqual(index.get(frameKey(id * 64, 0)), expect);
+    }
+}
+
+test(FrameIndexTest, Clear) {
+    FrameIndex index(2);
+    index.put(frameKey(0x100, 0), 0);
+    index.put(frameKey(0x101, 0), 1);
+    index.clear();
+    assertEqual(index.get(frameKey(0x100, 0)), FrameIndex::Empty);
+    assertEqual(index.get(frameKey(0x101, 0)), FrameIndex::Empty);
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
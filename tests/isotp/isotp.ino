@@ -0,0 +1,489 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/ISOTP.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+// One end of a point to point bus. Frames written to an end are read from its
+// peer.
+template <typename FrameType>
+class FakeBus : public Connection<FrameType> {
+    public:
+        FakeBus() : peer_(nullptr), head_(0), len_(0), writes_(0) {}
+
+        void connect(FakeBus* peer) {
+            peer_ = peer;
+            peer->peer_ = this;
+        }
+
+        Error read(FrameType* frame) override {
+            if (len_ == 0) {
+                return ERR_FIFO;
+            }
+            *frame = frames_[head_];
+            head_ = (head_ + 1) % kSize;
+            --len_;
+            return ERR_OK;
+        }
+
+        Error write(const FrameType& frame) override {
+            if (peer_->len_ >= kSize) {
+                return ERR_FIFO;
+            }
+            peer_->frames_[(peer_->head_ + peer_->len_) % kSize] = frame;
+            ++peer_->len_;
+            ++writes_;
+            return ERR_OK;
+        }
+
+        // Queue a frame to be read from this end.
+        void push(const FrameType& frame) {
+            frames_[(head_ + len_) % kSize] = frame;
+            ++len_;
+        }
+
+        // Return the next frame to be read without removing it.
+        const FrameType& peek() const { return frames_[head_]; }
+
+        size_t pending() const { return len_; }
+        int writes() const { return writes_; }
+
+    private:
+        static const size_t kSize = 128;
+
+        FakeBus* peer_;
+        FrameType frames_[kSize];
+        size_t head_;
+        size_t len_;
+        int writes_;
+};
+
+template <typename FrameType>
+class TestISOTP : public ISOTP<FrameType> {
+    public:
+        TestISOTP(Connection<FrameType>* child, uint32_t max_size = ISOTPShortMaxSize) :
+            ISOTP<FrameType>(child, 4, 4, max_size), aborts_(0), reason_(0) {}
+
+        void onAbort(const ISOTPMessage&, ISOTPAbortReason reason) const override {
+            ++aborts_;
+            reason_ = reason;
+        }
+
+        int aborts() const { return aborts_; }
+        uint8_t reason() const { return reason_; }
+
+    private:
+        mutable int aborts_;
+        mutable uint8_t reason_;
+};
+
+// Service both ends until neither has frames left to read.
+template <typename FrameType>
+void pump(ISOTP<FrameType>* a, FakeBus<FrameType>* bus_a, ISOTP<FrameType>* b,
+        FakeBus<FrameType>* bus_b) {
+    FrameType frame;
+    for (int i = 0; i < 1000 && (bus_a->pending() > 0 || bus_b->pending() > 0 ||
+                a->sending() || b->sending()); ++i) {
+        a->read(&frame);
+        b->read(&frame);
+    }
+}
+
+void fill(uint8_t* data, uint32_t size) {
+    for (uint32_t i = 0; i < size; ++i) {
+        data[i] = i * 7 + (i >> 8);
+    }
+}
+
+bool check(const ISOTPMessage* message, uint32_t size) {
+    if (message->size() != size) {
+        return false;
+    }
+    for (uint32_t i = 0; i < size; ++i) {
+        if (message->data()[i] != (uint8_t)(i * 7 + (i >> 8))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+test(ISOTPTest, ReadPassThrough) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CAN20Frame> isotp(&bus_a);
+    isotp.addChannel(0x7E0, 0x7E8);
+    CAN20Frame frame;
+
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x02, 0x01, 0x0C}));
+    bus_a.push(CAN20Frame(0x7E8, 1, {0x02, 0x01, 0x0C}));
+    bus_a.push(CAN20Frame(0x123, 0, {0x11, 0x22}));
+    assertEqual(isotp.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x7E8, 1, {0x02, 0x01, 0x0C}));
+    assertEqual(isotp.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x123, 0, {0x11, 0x22}));
+    assertEqual(isotp.read(&frame), ERR_FIFO);
+
+    ISOTPMessage* message;
+    assertEqual(isotp.receive(&message), ERR_OK);
+    assertEqual(message->channel(), 0);
+    assertEqual(message->size(), (uint32_t)2);
+    assertEqual(message->data()[1], 0x0C);
+    isotp.release(message);
+    assertEqual(isotp.receive(&message), ERR_FIFO);
+}
+
+test(ISOTPTest, ReceiveCompletionOrder) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CAN20Frame> isotp(&bus_a);
+    isotp.addChannel(0x7E0, 0x7E8);
+    isotp.addChannel(0x7E1, 0x7E9);
+    CAN20Frame frame;
+
+    // channel 0 starts first but completes after channel 1
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x10, 0x0A, 0x00, 0x01, 0x02, 0x03, 0x04, 0x05}));
+    bus_a.push(CAN20Frame(0x7E9, 0, {0x02, 0x01, 0x0C}));
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x21, 0x06, 0x07, 0x08, 0x09}));
+    assertEqual(isotp.read(&frame), ERR_FIFO);
+
+    ISOTPMessage* first;
+    ISOTPMessage* second;
+    assertEqual(isotp.receive(&first), ERR_OK);
+    assertEqual(first->channel(), 1);
+    assertEqual(isotp.receive(&second), ERR_OK);
+    assertEqual(second->channel(), 0);
+    assertEqual(second->size(), (uint32_t)10);
+    isotp.release(first);
+    isotp.release(second);
+    assertEqual(isotp.receive(&first), ERR_FIFO);
+}
+
+test(ISOTPTest, SendSingleFrame) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CAN20Frame> isotp(&bus_a);
+    isotp.addChannel(0x7E0, 0x7E8);
+
+    uint8_t data[] = {0x22, 0xF1, 0x90};
+    assertEqual(isotp.send(0, data, sizeof(data)), ERR_OK);
+    assertEqual(bus_b.pending(), (size_t)1);
+    assertTrue(bus_b.peek() == CAN20Frame(0x7E0, 0, {0x03, 0x22, 0xF1, 0x90, 0xCC, 0xCC, 0xCC, 0xCC}));
+
+    assertEqual(isotp.send(1, data, sizeof(data)), ERR_INVALID);
+    assertEqual(isotp.send(0, data, 0), ERR_INVALID);
+}
+
+test(ISOTPTest, SendSingleFrameWhileSending) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CAN20Frame> a(&bus_a);
+    ISOTP<CAN20Frame> b(&bus_b);
+    a.addChannel(0x7E0, 0x7E8);
+    a.addChannel(0x7E1, 0x7E9);
+    b.addChannel(0x7E8, 0x7E0);
+
+    uint8_t data[30];
+    fill(data, sizeof(data));
+    uint8_t short_data[] = {0x3E, 0x00};
+    assertEqual(a.send(0, data, sizeof(data)), ERR_OK);
+
+    // a single frame may not interrupt a segmented message on the channel
+    assertEqual(a.send(0, short_data, sizeof(short_data)), ERR_FIFO);
+    assertEqual(bus_b.pending(), (size_t)1);
+    assertEqual(a.send(1, short_data, sizeof(short_data)), ERR_OK);
+    assertEqual(bus_b.pending(), (size_t)2);
+
+    pump(&a, &bus_a, &b, &bus_b);
+    ISOTPMessage* message;
+    assertEqual(b.receive(&message), ERR_OK);
+    assertTrue(check(message, sizeof(data)));
+    assertEqual(a.send(0, short_data, sizeof(short_data)), ERR_OK);
+}
+
+test(ISOTPTest, SendMultiFrame) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CAN20Frame> a(&bus_a);
+    ISOTP<CAN20Frame> b(&bus_b);
+    a.addChannel(0x7E0, 0x7E8);
+    b.addChannel(0x7E8, 0x7E0);
+
+    uint8_t data[300];
+    fill(data, sizeof(data));
+    assertEqual(a.send(0, data, sizeof(data)), ERR_OK);
+    assertTrue(bus_b.peek() == CAN20Frame(0x7E0, 0, {0x11, 0x2C, 0x00, 0x07, 0x0E, 0x15, 0x1C, 0x23}));
+    assertEqual(a.send(0, data, sizeof(data)), ERR_FIFO);
+
+    pump(&a, &bus_a, &b, &bus_b);
+    assertFalse(a.sending());
+    ISOTPMessage* message;
+    assertEqual(b.receive(&message), ERR_OK);
+    assertTrue(check(message, sizeof(data)));
+    b.release(message);
+
+    // one first frame and 42 consecutive frames for one flow control
+    assertEqual(bus_a.writes(), 43);
+    assertEqual(bus_b.writes(), 1);
+}
+
+test(ISOTPTest, BlockSize) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CAN20Frame> a(&bus_a);
+    ISOTP<CAN20Frame> b(&bus_b);
+    a.addChannel(0x7E0, 0x7E8);
+    b.addChannel(0x7E8, 0x7E0);
+    b.flowControl(2, 0);
+
+    uint8_t data[50];
+    fill(data, sizeof(data));
+    assertEqual(a.send(0, data, sizeof(data)), ERR_OK);
+    pump(&a, &bus_a, &b, &bus_b);
+
+    ISOTPMessage* message;
+    assertEqual(b.receive(&message), ERR_OK);
+    assertTrue(check(message, sizeof(data)));
+
+    // seven consecutive frames in blocks of two
+    assertEqual(bus_a.writes(), 8);
+    assertEqual(bus_b.writes(), 4);
+}
+
+test(ISOTPTest, STmin) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CAN20Frame> a(&bus_a);
+    a.addChannel(0x7E0, 0x7E8);
+    CAN20Frame frame;
+
+    uint8_t data[30];
+    fill(data, sizeof(data));
+    assertEqual(a.send(0, data, sizeof(data)), ERR_OK);
+    assertEqual(bus_a.writes(), 1);
+
+    // the first consecutive frame follows the flow control immediately
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x30, 0x00, 0x14}));
+    assertEqual(a.read(&frame), ERR_FIFO);
+    assertEqual(bus_a.writes(), 2);
+    a.flush();
+    assertEqual(bus_a.writes(), 2);
+
+    delay(21);
+    a.flush();
+    assertEqual(bus_a.writes(), 3);
+    delay(21);
+    a.flush();
+    delay(21);
+    a.flush();
+    assertEqual(bus_a.writes(), 5);
+    assertFalse(a.sending());
+}
+
+test(ISOTPTest, FlowControlWaitAndOverflow) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    TestISOTP<CAN20Frame> a(&bus_a);
+    a.addChannel(0x7E0, 0x7E8);
+    CAN20Frame frame;
+
+    uint8_t data[30];
+    fill(data, sizeof(data));
+    assertEqual(a.send(0, data, sizeof(data)), ERR_OK);
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x31, 0x00, 0x00}));
+    assertEqual(a.read(&frame), ERR_FIFO);
+    assertTrue(a.sending());
+    assertEqual(bus_a.writes(), 1);
+
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x32, 0x00, 0x00}));
+    assertEqual(a.read(&frame), ERR_FIFO);
+    assertFalse(a.sending());
+    assertEqual(a.aborts(), 1);
+    assertEqual(a.reason(), ISOTP_ABORT_OVERFLOW);
+}
+
+test(ISOTPTest, ReceiveTooLarge) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    TestISOTP<CAN20Frame> a(&bus_a);
+    ISOTP<CAN20Frame> b(&bus_b, 4, 4, 64);
+    a.addChannel(0x7E0, 0x7E8);
+    b.addChannel(0x7E8, 0x7E0);
+
+    uint8_t data[100];
+    fill(data, sizeof(data));
+    assertEqual(a.send(0, data, sizeof(data)), ERR_OK);
+    pump(&a, &bus_a, &b, &bus_b);
+    assertEqual(a.aborts(), 1);
+    assertEqual(a.reason(), ISOTP_ABORT_OVERFLOW);
+    ISOTPMessage* message;
+    assertEqual(b.receive(&message), ERR_FIFO);
+}
+
+test(ISOTPTest, ReceiveSequenceError) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    TestISOTP<CAN20Frame> isotp(&bus_a);
+    isotp.addChannel(0x7E0, 0x7E8);
+    CAN20Frame frame;
+
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x10, 0x14, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06}));
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x21, 0x07, 0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D}));
+    bus_a.push(CAN20Frame(0x7E8, 0, {0x23, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14}));
+    assertEqual(isotp.read(&frame), ERR_FIFO);
+    assertTrue(bus_b.peek() == CAN20Frame(0x7E0, 0, {0x30, 0x00, 0x00, 0xCC, 0xCC, 0xCC, 0xCC, 0xCC}));
+    assertEqual(isotp.aborts(), 1);
+    assertEqual(isotp.reason(), ISOTP_ABORT_SEQUENCE);
+}
+
+test(ISOTPTest, Timeout) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    TestISOTP<CAN20Frame> isotp(&bus_a);
+    isotp.addChannel(0x7E0, 0x7E8);
+
+    uint8_t data[30];
+    fill(data, sizeof(data));
+    assertEqual(isotp.send(0, data, sizeof(data)), ERR_OK);
+    isotp.flush();
+    assertTrue(isotp.sending());
+    delay(1001);
+    isotp.flush();
+    assertFalse(isotp.sending());
+    assertEqual(isotp.reason(), ISOTP_ABORT_TIMEOUT);
+}
+
+test(ISOTPTest, WriteTimeout) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    TestISOTP<CAN20Frame> isotp(&bus_a);
+    isotp.addChannel(0x7E0, 0x7E8);
+
+    // Fill the peer so that every write fails.
+    for (int i = 0; i < 128; ++i) {
+        bus_b.push(CAN20Frame(0x100, 0, (uint8_t[]){0x01}));
+    }
+
+    uint8_t data[30];
+    fill(data, sizeof(data));
+    assertEqual(isotp.send(0, data, sizeof(data)), ERR_OK);
+    isotp.flush();
+    assertTrue(isotp.sending());
+    assertEqual(bus_a.writes(), 0);
+    delay(1001);
+    isotp.flush();
+    assertFalse(isotp.sending());
+    assertEqual(isotp.aborts(), 1);
+    assertEqual(isotp.reason(), ISOTP_ABORT_TIMEOUT);
+}
+
+test(ISOTPTest, ConcurrentChannels) {
+    FakeBus<CAN20Frame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CAN20Frame> a(&bus_a);
+    ISOTP<CAN20Frame> b(&bus_b);
+    a.addChannel(0x7E0, 0x7E8);
+    a.addChannel(0x7E1, 0x7E9);
+    b.addChannel(0x7E8, 0x7E0);
+    b.addChannel(0x7E9, 0x7E1);
+
+    uint8_t data[200];
+    fill(data, sizeof(data));
+    assertEqual(a.send(0, data, 200), ERR_OK);
+    assertEqual(a.send(1, data, 150), ERR_OK);
+    assertEqual(b.send(0, data, 100), ERR_OK);
+    pump(&a, &bus_a, &b, &bus_b);
+
+    ISOTPMessage* first;
+    ISOTPMessage* second;
+    assertEqual(b.receive(&first), ERR_OK);
+    assertEqual(b.receive(&second), ERR_OK);
+    if (first->channel() == 1) {
+        ISOTPMessage* swap = first;
+        first = second;
+        second = swap;
+    }
+    assertEqual(first->channel(), 0);
+    assertTrue(check(first, 200));
+    assertEqual(second->channel(), 1);
+    assertTrue(check(second, 150));
+
+    ISOTPMessage* reply;
+    assertEqual(a.receive(&reply), ERR_OK);
+    assertTrue(check(reply, 100));
+}
+
+test(ISOTPTest, CANFD) {
+    FakeBus<CANFDFrame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CANFDFrame> a(&bus_a, 4, 4, 5000);
+    ISOTP<CANFDFrame> b(&bus_b, 4, 4, 5000);
+    a.addChannel(0x18DA10F1, 0x18DAF110, 1);
+    b.addChannel(0x18DAF110, 0x18DA10F1, 1);
+    CANFDFrame frame;
+
+    // single frames up to 62 bytes use the escaped length and are padded
+    uint8_t data[5000];
+    fill(data, sizeof(data));
+    assertEqual(a.send(0, data, 20), ERR_OK);
+    assertEqual(bus_b.peek().size(), 24);
+    assertEqual(bus_b.peek().data()[0], 0x00);
+    assertEqual(bus_b.peek().data()[1], 20);
+    assertEqual(bus_b.peek().data()[22], 0xCC);
+    assertEqual(b.read(&frame), ERR_FIFO);
+    ISOTPMessage* message;
+    assertEqual(b.receive(&message), ERR_OK);
+    assertTrue(check(message, 20));
+    b.release(message);
+
+    // messages over 4095 bytes use the escape sequence
+    assertEqual(a.send(0, data, sizeof(data)), ERR_OK);
+    const CANFDFrame& first = bus_b.peek();
+    assertEqual(first.size(), 64);
+    assertEqual(first.data()[0], 0x10);
+    assertEqual(first.data()[1], 0x00);
+    assertEqual(first.data()[4], 0x13);
+    assertEqual(first.data()[5], 0x88);
+    pump(&a, &bus_a, &b, &bus_b);
+    assertEqual(b.receive(&message), ERR_OK);
+    assertTrue(check(message, sizeof(data)));
+
+    // (5000 - 58) / 63 consecutive frames
+    assertEqual(bus_a.writes(), 2 + 79);
+}
+
+test(ISOTPTest, FrameSize) {
+    FakeBus<CANFDFrame> bus_a, bus_b;
+    bus_a.connect(&bus_b);
+    ISOTP<CANFDFrame> a(&bus_a);
+    ISOTP<CANFDFrame> b(&bus_b);
+    a.addChannel(0x7E0, 0x7E8);
+    b.addChannel(0x7E8, 0x7E0);
+    a.frameSize(30);
+
+    uint8_t data[100];
+    fill(data, sizeof(data));
+    assertEqual(a.send(0, data, sizeof(data)), ERR_OK);
+    assertEqual(bus_b.peek().size(), 24);
+    pump(&a, &bus_a, &b, &bus_b);
+    ISOTPMessage* message;
+    assertEqual(b.receive(&message), ERR_OK);
+    assertTrue(check(message, sizeof(data)));
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
@@ -0,0 +1,208 @@
+#include <Arduino.h>
+#include <AUnit.h>
+#include <Canny.h>
+#include <Canny/J1939Node.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+class FakeConnection : public Connection<J1939Message> {
+    public:
+        FakeConnection() : read_len_(0), read_pos_(0), write_len_(0) {}
+
+        Error read(J1939Message* message) override {
+            if (read_pos_ >= read_len_) {
+                return ERR_FIFO;
+            }
+            *message = read_buffer_[read_pos_++];
+            return ERR_OK;
+        }
+
+        Error write(const J1939Message& message) override {
+            if (write_len_ >= 16) {
+                return ERR_FIFO;
+            }
+            write_buffer_[write_len_++] = message;
+            return ERR_OK;
+        }
+
+        void push(const J1939Message& message) {
+            read_buffer_[read_len_++] = message;
+        }
+
+        void pushClaim(uint8_t sa, uint64_t name) {
+            J1939Message message(0xEE00, sa, 0xFF, 6);
+            message.name(name);
+            push(message);
+        }
+
+        J1939Message* writeData() { return write_buffer_; }
+
+        size_t writeCount() { return write_len_; }
+
+        void writeReset() { write_len_ = 0; }
+
+    private:
+        J1939Message read_buffer_[16];
+        size_t read_len_;
+        size_t read_pos_;
+        J1939Message write_buffer_[16];
+        size_t write_len_;
+};
+
+// Drain the node's read queue.
+void drain(J1939Node* node) {
+    J1939Message message;
+    while (node->read(&message) == ERR_OK) {}
+}
+
+const uint64_t kName = 0x06876A340082FAC0;
+const uint64_t kArbitraryName = 0x06876A340082FAC1;
+
+test(J1939NodeTest, Claim) {
+    FakeConnection fake;
+    J1939Node node(&fake, kName, 0x20);
+    assertEqual(node.address(), NullAddress);
+    assertFalse(node.claimed());
+
+    node.begin();
+    assertEqual(node.address(), 0x20);
+    assertFalse(node.claimed());
+    assertEqual(fake.writeCount(), (size_t)1);
+    J1939Message* claim = fake.writeData();
+    assertEqual(claim->pgn(), (uint32_t)0xEE00);
+    assertEqual(claim->source_address(), 0x20);
+    assertEqual(claim->dest_address(), 0xFF);
+    assertTrue(claim->name() == kName);
+
+    J1939Message message(0xFEF1, 0x00);
+    assertEqual(node.write(message), ERR_READY);
+
+    delay(260);
+    drain(&node);
+    assertTrue(node.claimed());
+    assertEqual(node.write(message), ERR_OK);
+    assertEqual(fake.writeData()[1].source_address(), 0x20);
+}
+
+test(J1939NodeTest, PassThrough) {
+    FakeConnection fake;
+    J1939Node node(&fake, kName, 0x20);
+    node.begin();
+
+    J1939Message expect(0xFEF1, 0x10);
+    expect.data({0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    fake.push(expect);
+
+    J1939Message actual;
+    assertEqual(node.read(&actual), ERR_OK);
+    assertTrue(actual == expect);
+    assertEqual(node.read(&actual), ERR_FIFO);
+}
+
+test(J1939NodeTest, DefendAddress) {
+    FakeConnection fake;
+    J1939Node node(&fake, kName, 0x20);
+    node.begin();
+    fake.writeReset();
+
+    fake.pushClaim(0x20, kName + 0x100);
+    drain(&node);
+    assertEqual(node.address(), 0x20);
+    assertEqual(fake.writeCount(), (size_t)1);
+    assertEqual(fake.writeData()[0].source_address(), 0x20);
+    assertTrue(fake.writeData()[0].name() == kName);
+
+    // The losing device does not hold the address.
+    assertEqual(node.devices(), (size_t)0);
+    assertTrue(node.device_name(0x20) == 0);
+}
+
+test(J1939NodeTest, LoseAddress) {
+    FakeConnection fake;
+    J1939Node node(&fake, kName, 0x20);
+    node.begin();
+    fake.writeReset();
+
+    fake.pushClaim(0x20, kName - 0x100);
+    drain(&node);
+    assertEqual(node.address(), NullAddress);
+    assertFalse(node.claimed());
+    assertEqual(fake.writeCount(), (size_t)1);
+    assertEqual(fake.writeData()[0].source_address(), NullAddress);
+    assertTrue(node.device_name(0x20) == kName - 0x100);
+
+    delay(260);
+    drain(&node);
+    assertFalse(node.claimed());
+}
+
+test(J1939NodeTest, ArbitraryAddress) {
+    FakeConnection fake;
+    J1939Node node(&fake, kArbitraryName, 0x80);
+    node.begin();
+    fake.writeReset();
+
+    fake.pushClaim(0x81, kName + 0x200);
+    fake.pushClaim(0x80, kName - 0x100);
+    drain(&node);
+    assertEqual(node.address(), 0x82);
+    assertEqual(fake.writeCount(), (size_t)1);
+    assertEqual(fake.writeData()[0].source_address(), 0x82);
+
+    delay(260);
+    drain(&node);
+    assertTrue(node.claimed());
+}
+
+test(J1939NodeTest, RequestAddressClaimed) {
+    FakeConnection fake;
+    J1939Node node(&fake, kName, 0x20);
+    node.begin();
+    fake.writeReset();
+
+    J1939Message request(0xEA00, 0x10, 0xFF, 6);
+    request.data({0x00, 0xEE, 0x00});
+    fake.push(request);
+    drain(&node);
+    assertEqual(fake.writeCount(), (size_t)1);
+    assertEqual(fake.writeData()[0].pgn(), (uint32_t)0xEE00);
+    assertEqual(fake.writeData()[0].source_address(), 0x20);
+}
+
+test(J1939NodeTest, DeviceTable) {
+    FakeConnection fake;
+    J1939Node node(&fake, kName, 0x20);
+
+    fake.pushClaim(0x30, 0x1111);
+    fake.pushClaim(0x31, 0x2222);
+    fake.pushClaim(0x32, 0x1111);
+    drain(&node);
+    assertEqual(node.devices(), (size_t)2);
+    assertEqual(node.device_address(0x1111), 0x32);
+    assertEqual(node.device_address(0x2222), 0x31);
+    assertTrue(node.device_name(0x30) == 0);
+    assertTrue(node.device_name(0x31) == 0x2222);
+
+    fake.pushClaim(NullAddress, 0x2222);
+    drain(&node);
+    assertEqual(node.devices(), (size_t)1);
+    assertEqual(node.device_address(0x2222), NullAddress);
+}
+
+}  // namespace Canny
+
+// Test boilerplate.
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
@@ -0,0 +1,311 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/CoalescingFrameQueue.h>
+#include <Canny/CompactFrameQueue.h>
+#include <Canny/FrameQueue.h>
+#include <Canny/PriorityFrameQueue.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+test(FrameQueueTest, Empty) {
+    FrameQueue<CAN20Frame> queue(2);
+    assertTrue(queue.empty());
+    assertFalse(queue.full());
+    assertEqual(queue.capacity(), (size_t)2);
+    assertEqual(queue.front(), (CAN20Frame*)nullptr);
+}
+
+test(FrameQueueTest, InPlace) {
+    FrameQueue<CAN20Frame> queue(2);
+
+    CAN20Frame* slot = queue.back();
+    assertNotEqual(slot, (CAN20Frame*)nullptr);
+    slot->id(0x123);
+    queue.push();
+    assertEqual(queue.size(), (size_t)1);
+
+    // the published slot is the front of the queue
+    assertEqual(queue.front(), slot);
+    assertEqual(queue.front()->id(), (uint32_t)0x123);
+    queue.pop();
+    assertTrue(queue.empty());
+}
+
+test(FrameQueueTest, Wrap) {
+    FrameQueue<CAN20Frame> queue(3);
+    for (uint32_t i = 0; i < 10; ++i) {
+        assertTrue(queue.push(CAN20Frame(i, 0, 0)));
+        assertTrue(queue.push(CAN20Frame(i + 100, 0, 0)));
+        assertEqual(queue.front()->id(), i);
+        queue.pop();
+        assertEqual(queue.front()->id(), i + 100);
+        queue.pop();
+    }
+    assertTrue(queue.empty());
+}
+
+test(FrameQueueTest, Full) {
+    FrameQueue<CAN20Frame> queue(2);
+    assertTrue(queue.push(CAN20Frame(0x01, 0, 0)));
+    assertTrue(queue.push(CAN20Frame(0x02, 0, 0)));
+    assertTrue(queue.full());
+    assertEqual(queue.back(), (CAN20Frame*)nullptr);
+    assertFalse(queue.push(CAN20Frame(0x03, 0, 0)));
+    assertEqual(queue.front()->id(), (uint32_t)0x01);
+}
+
+test(CompactFrameQueueTest, Packed) {
+    CompactFrameQueue<CANFDFrame> queue(256);
+    assertEqual(queue.capacity(), (size_t)256);
+
+    CANFDFrame f1(0x123, 0, {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08});
+    CANFDFrame f2(0x18FEF100, 1, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88,
+            0x99, 0xAA, 0xBB, 0xCC});
+    assertTrue(queue.push(f1));
+    assertTrue(queue.push(f2));
+    assertEqual(queue.size(), (size_t)2);
+    assertEqual(queue.used(), (size_t)(2 * CompactFrameQueue<CANFDFrame>::HeaderSize + 8 + 12));
+
+    assertTrue(*queue.front() == f1);
+    queue.pop();
+    assertTrue(*queue.front() == f2);
+    assertEqual(queue.front()->ext(), (uint8_t)1);
+    queue.pop();
+    assertTrue(queue.empty());
+    assertEqual(queue.used(), (size_t)0);
+}
+
+test(CompactFrameQueueTest, Staging) {
+    CompactFrameQueue<CANFDFrame> queue(256);
+
+    CANFDFrame* slot = queue.back();
+    assertNotEqual(slot, (CANFDFrame*)nullptr);
+    slot->id(0x456);
+    slot->data({0x01, 0x02, 0x03});
+    queue.push();
+    assertEqual(queue.size(), (size_t)1);
+    assertEqual(queue.front()->id(), (uint32_t)0x456);
+    assertEqual(queue.front()->size(), (uint8_t)3);
+    assertEqual(queue.front()->data()[2], (uint8_t)0x03);
+}
+
+test(CompactFrameQueueTest, Full) {
+    // room for one maximum size frame plus one small frame
+    CompactFrameQueue<CANFDFrame> queue(82);
+    CANFDFrame big(0x01, 0, 64);
+    CANFDFrame small(0x02, 0, {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08});
+
+    assertNotEqual(queue.back(), (CANFDFrame*)nullptr);
+    assertTrue(queue.push(big));
+    assertTrue(queue.full());
+    assertEqual(queue.back(), (CANFDFrame*)nullptr);
+    assertTrue(queue.push(small));
+    assertFalse(queue.push(small));
+    assertEqual(queue.size(), (size_t)2);
+}
+
+test(CompactFrameQueueTest, Wrap) {
+    CompactFrameQueue<CANFDFrame> queue(100);
+    for (uint32_t i = 0; i < 50; ++i) {
+        CANFDFrame frame(i, 0, (uint8_t)(i % 13));
+        for (uint8_t j = 0; j < frame.size(); ++j) {
+            frame.data()[j] = i + j;
+        }
+        assertTrue(queue.push(frame));
+        assertTrue(queue.push(frame));
+        assertTrue(*queue.front() == frame);
+        queue.pop();
+        assertTrue(*queue.front() == frame);
+        queue.pop();
+    }
+    assertTrue(queue.empty());
+}
+
+test(CompactFrameQueueTest, Timestamp) {
+    CompactFrameQueue<TimestampedFrame<CAN20Frame>> queue(64);
+    assertEqual(queue.HeaderSize, (size_t)9);
+    TimestampedFrame<CAN20Frame> f1(CAN20Frame(0x10, 0, {0x11, 0x22}), 0x12345678);
+    TimestampedFrame<CAN20Frame> f2(CAN20Frame(0x11, 1, {0x33, 0x44}), 0x9ABCDEF0);
+    assertTrue(queue.push(f1));
+    assertTrue(queue.push(f2));
+    assertEqual(queue.used(), (size_t)22);
+
+    assertTrue(*queue.front() == f1);
+    assertEqual(queue.front()->timestamp(), 0x12345678u);
+    queue.pop();
+    assertTrue(*queue.front() == f2);
+    assertEqual(queue.front()->timestamp(), 0x9ABCDEF0u);
+    queue.pop();
+    assertTrue(queue.empty());
+}
+
+test(PriorityFrameQueueTest, Order) {
+    PriorityFrameQueue<CAN20Frame> queue(8);
+    assertTrue(queue.push(CAN20Frame(0x300, 0, 1)));
+    assertTrue(queue.push(CAN20Frame(0x100, 0, 1)));
+    assertTrue(queue.push(CAN20Frame(0x200, 0, 1)));
+    assertTrue(queue.push(CAN20Frame(0x100, 0, 2)));
+    assertTrue(queue.push(CAN20Frame(0x00000000, 1, 1)));
+
+    // standard 0x000 is not queued, so extended 0x0 wins with base ID 0
+    assertEqual(queue.front()->id(), (uint32_t)0x00000000);
+    assertEqual(queue.front()->ext(), (uint8_t)1);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x100);
+    assertEqual(queue.front()->size(), (uint8_t)1);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x100);
+    assertEqual(queue.front()->size(), (uint8_t)2);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x200);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x300);
+    queue.pop();
+    assertTrue(queue.empty());
+}
+
+test(PriorityFrameQueueTest, StandardBeforeExtended) {
+    PriorityFrameQueue<CAN20Frame> queue(4);
+
+    // extended 0x04000000 shares the base ID 0x100 with standard 0x100
+    assertTrue(queue.push(CAN20Frame(0x04000000, 1, 0)));
+    assertTrue(queue.push(CAN20Frame(0x100, 0, 0)));
+    assertTrue(queue.push(CAN20Frame(0x0FF, 0, 0)));
+    assertEqual(queue.front()->id(), (uint32_t)0x0FF);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x100);
+    assertEqual(queue.front()->ext(), (uint8_t)0);
+    queue.pop();
+    assertEqual(queue.front()->ext(), (uint8_t)1);
+}
+
+test(PriorityFrameQueueTest, FullAndReuse) {
+    PriorityFrameQueue<CAN20Frame> queue(3);
+    for (uint32_t round = 0; round < 10; ++round) {
+        for (uint32_t i = 0; i < 3; ++i) {
+            CAN20Frame* slot = queue.back();
+            assertNotEqual(slot, (CAN20Frame*)nullptr);
+            slot->id(0x300 - i * 0x100);
+            queue.push();
+        }
+        assertTrue(queue.full());
+        assertFalse(queue.push(CAN20Frame(0x001, 0, 0)));
+        for (uint32_t i = 0; i < 3; ++i) {
+            assertEqual(queue.front()->id(), (uint32_t)(0x100 + i * 0x100));
+            queue.pop();
+        }
+        assertTrue(queue.empty());
+    }
+}
+
+test(PriorityFrameQueueTest, Displace) {
+    PriorityFrameQueue<CAN20Frame> queue(3);
+    CAN20Frame evicted;
+    assertTrue(queue.push(CAN20Frame(0x200, 0, 1)));
+    assertTrue(queue.push(CAN20Frame(0x100, 0, 1)));
+    assertFalse(queue.displace(CAN20Frame(0x001, 0, 1), &evicted));
+    assertTrue(queue.push(CAN20Frame(0x300, 0, 1)));
+
+    // equal and lower priority frames do not displace
+    assertFalse(queue.displace(CAN20Frame(0x300, 0, 2), &evicted));
+    assertFalse(queue.displace(CAN20Frame(0x400, 0, 1), &evicted));
+
+    assertTrue(queue.displace(CAN20Frame(0x050, 0, 1), &evicted));
+    assertEqual(evicted.id(), (uint32_t)0x300);
+    assertTrue(queue.displace(CAN20Frame(0x150, 0, 1), &evicted));
+    assertEqual(evicted.id(), (uint32_t)0x200);
+    assertTrue(queue.full());
+
+    assertEqual(queue.front()->id(), (uint32_t)0x050);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x100);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x150);
+    queue.pop();
+    assertTrue(queue.empty());
+}
+
+test(CoalescingFrameQueueTest, Coalesce) {
+    CoalescingFrameQueue<CAN20Frame> queue(4);
+    assertTrue(queue.push(CAN20Frame(0x100, 0, {0x01, 0x00})));
+    assertTrue(queue.push(CAN20Frame(0x200, 0, {0x01, 0x00})));
+    assertTrue(queue.push(CAN20Frame(0x100, 0, {0x02, 0x00})));
+    assertTrue(queue.push(CAN20Frame(0x100, 1, {0x03, 0x00})));
+    assertEqual(queue.size(), (size_t)3);
+
+    // order of first pending, latest data
+    assertEqual(queue.front()->id(), (uint32_t)0x100);
+    assertEqual(queue.front()->ext(), (uint8_t)0);
+    assertEqual(queue.front()->data()[0], (uint8_t)0x02);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x200);
+    queue.pop();
+    assertEqual(queue.front()->id(), (uint32_t)0x100);
+    assertEqual(queue.front()->ext(), (uint8_t)1);
+    queue.pop();
+    assertTrue(queue.empty());
+}
+
+test(CoalescingFrameQueueTest, FullAcceptsPendingIDs) {
+    CoalescingFrameQueue<CAN20Frame> queue(2);
+    assertTrue(queue.push(CAN20Frame(0x100, 0, {0x01, 0x00})));
+    assertTrue(queue.push(CAN20Frame(0x200, 0, {0x01, 0x00})));
+    assertTrue(queue.full());
+    assertEqual(queue.back(), (CAN20Frame*)nullptr);
+    assertFalse(queue.push(CAN20Frame(0x300, 0, {0x01, 0x00})));
+    assertTrue(queue.push(CAN20Frame(0x200, 0, {0x02, 0x00})));
+    assertEqual(queue.size(), (size_t)2);
+}
+
+test(CoalescingFrameQueueTest, Slots) {
+    CoalescingFrameQueue<CAN20Frame> queue(2);
+    CAN20Frame* slot = queue.back();
+    slot->id(0x123);
+    slot->data({0x01, 0x00});
+    queue.push();
+
+    slot = queue.back();
+    slot->id(0x123);
+    slot->data({0x02, 0x00});
+    queue.push();
+    assertEqual(queue.size(), (size_t)1);
+    assertEqual(queue.front()->data()[0], (uint8_t)0x02);
+}
+
+test(CoalescingFrameQueueTest, Churn) {
+    // Exercise index removal with many colliding IDs.
+    CoalescingFrameQueue<CAN20Frame> queue(16);
+    for (uint32_t round = 0; round < 50; ++round) {
+        for (uint32_t i = 0; i < 16; ++i) {
+            assertTrue(queue.push(CAN20Frame((i * 64 + round) & 0x7FF, 0, {(uint8_t)round, 0x00})));
+        }
+        for (uint32_t i = 0; i < 16; ++i) {
+            assertTrue(queue.push(CAN20Frame((i * 64 + round) & 0x7FF, 0, {(uint8_t)(round + 1), 0x00})));
+        }
+        assertEqual(queue.size(), (size_t)16);
+        for (uint32_t i = 0; i < 16; ++i) {
+            assertEqual(queue.front()->id(), (i * 64 + round) & 0x7FF);
+            assertEqual(queue.front()->data()[0], (uint8_t)(round + 1));
+            queue.pop();
+        }
+        assertTrue(queue.empty());
+    }
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
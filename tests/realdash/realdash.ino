@@ -207,6 +207,93 @@ test(RealDashTest, ReadPostGarbage) {
     assertEqual(err, Error::ERR_FIFO);
 }
 
+test(RealDashTest, ReadResync) {
+    CANFDFrame actual;
+    CANFDFrame expect(0x5800, 1, (uint8_t[]){0xf4, 0x08, 0x0e, 0xef, 0x39, 0x2c, 0x1b, 0x4c});
+    byte buffer[] = {
+        // truncated frame
+        0x66, 0x33, 0x22, 0x11,
+        0x00, 0x58,
+        // complete frame
+        0x66, 0x33, 0x22, 0x11,
+        0x00, 0x58, 0x00, 0x00,
+        0xf4, 0x08, 0x0e, 0xef,
+        0x39, 0x2c, 0x1b, 0x4c,
+        0xf2, 0x30, 0x3f, 0x6e,
+    };
+
+    FakeReadStream stream;
+    stream.set(buffer, sizeof(buffer)/sizeof(buffer[0]));
+
+    RealDash<CANFDFrame> realdash(&stream);
+    Error err = realdash.read(&actual);
+    assertEqual(err, Error::ERR_OK);
+    assertFramesEqual(actual, expect);
+}
+
+test(RealDashTest, ReadBadChecksum) {
+    Error err;
+    CANFDFrame actual;
+    CANFDFrame expect(0x5800, 1, (uint8_t[]){0xf4, 0x08, 0x0e, 0xef, 0x39, 0x2c, 0x1b, 0x4c});
+    byte buffer[] = {
+        // 0x44 frame with a bad checksum
+        0x44, 0x33, 0x22, 0x11,
+        0x00, 0x58, 0x00, 0x00,
+        0xf4, 0x08, 0x0e, 0xef,
+        0x39, 0x2c, 0x1b, 0x4c,
+        0xc8,
+        // 0x66 frame
+        0x66, 0x33, 0x22, 0x11,
+        0x00, 0x58, 0x00, 0x00,
+        0xf4, 0x08, 0x0e, 0xef,
+        0x39, 0x2c, 0x1b, 0x4c,
+        0xf2, 0x30, 0x3f, 0x6e,
+    };
+
+    FakeReadStream stream;
+    stream.set(buffer, sizeof(buffer)/sizeof(buffer[0]));
+
+    RealDash<CANFDFrame> realdash(&stream);
+    err = realdash.read(&actual);
+    assertEqual(err, Error::ERR_OK);
+    assertFramesEqual(actual, expect);
+
+    err = realdash.read(&actual);
+    assertEqual(err, Error::ERR_FIFO);
+}
+
+test(RealDashTest, ReadManyLong) {
+    CANFDFrame expect[3] = {
+        CANFDFrame(0x5200, 1, 64),
+        CANFDFrame(0x5201, 1, 64),
+        CANFDFrame(0x5202, 1, 64),
+    };
+    for (size_t i = 0; i < 3; ++i) {
+        for (size_t j = 0; j < 64; ++j) {
+            expect[i].data()[j] = i * 64 + j;
+        }
+    }
+
+    // Three long frames do not fit in the receive buffer at once.
+    byte buffer[3 * 76];
+    FakeWriteStream out;
+    out.set(buffer, sizeof(buffer));
+    RealDash<CANFDFrame> writer(&out);
+    size_t n;
+    assertEqual(writer.writeMany(expect, 3, &n), Error::ERR_OK);
+    assertEqual(out.pos(), sizeof(buffer));
+
+    FakeReadStream in;
+    in.set(buffer, sizeof(buffer));
+    RealDash<CANFDFrame> reader(&in);
+    CANFDFrame actual[4];
+    assertEqual(reader.readMany(actual, 4, &n), Error::ERR_OK);
+    assertEqual(n, (size_t)3);
+    for (size_t i = 0; i < 3; ++i) {
+        assertFramesEqual(actual[i], expect[i]);
+    }
+}
+
 test(RealDashTest, Write) {
     CANFDFrame frame(0x5800, 8, (uint8_t[]){0xf4, 0x08, 0x0e, 0xef, 0x39, 0x2c, 0x1b, 0x4c});
     byte expect[] = {
@@ -229,6 +316,65 @@ test(RealDashTest, Write) {
     assertEqual(memcmp(actual, expect, size), 0);
 }
 
+// Counts the calls made to write a block of bytes.
+class CountingStream : public FakeWriteStream {
+    public:
+        CountingStream() : writes_(0) {}
+
+        size_t write(const uint8_t* buffer, size_t size) override {
+            ++writes_;
+            return FakeWriteStream::write(buffer, size);
+        }
+
+        using FakeWriteStream::write;
+
+        size_t writes() const { return writes_; }
+
+    private:
+        size_t writes_;
+};
+
+test(RealDashTest, WriteMany) {
+    CANFDFrame frames[3] = {
+        CANFDFrame(0x5800, 1, (uint8_t[]){0xf4, 0x08, 0x0e, 0xef, 0x39, 0x2c, 0x1b, 0x4c}),
+        CANFDFrame(0x5800, 1, (uint8_t[]){0xf4, 0x08, 0x0e, 0xef, 0x39, 0x2c, 0x1b, 0x4c}),
+        CANFDFrame(0x5801, 1, 3),
+    };
+    byte expect[] = {
+        0x66, 0x33, 0x22, 0x11,
+        0x00, 0x58, 0x00, 0x00,
+        0xf4, 0x08, 0x0e, 0xef,
+        0x39, 0x2c, 0x1b, 0x4c,
+        0xf2, 0x30, 0x3f, 0x6e,
+    };
+    byte actual[60];
+    memset(actual, 0, sizeof(actual));
+
+    CountingStream stream;
+    stream.set(actual, sizeof(actual));
+
+    // The third frame is invalid and only the first two are packed into a
+    // single write.
+    size_t n;
+    RealDash<CANFDFrame> realdash(&stream);
+    assertEqual(realdash.writeMany(frames, 3, &n), Error::ERR_INVALID);
+    assertEqual(n, (size_t)2);
+    assertEqual(stream.writes(), (size_t)1);
+    assertEqual(stream.pos(), (size_t)40);
+    assertEqual(memcmp(actual, expect, sizeof(expect)), 0);
+    assertEqual(memcmp(actual + 20, expect, sizeof(expect)), 0);
+}
+
+test(ChecksumTest, CRC32) {
+    const uint8_t data[] = {'1', '2', '3', '4', '5', '6', '7', '8', '9'};
+    assertEqual(crc32(0, data, 0), (uint32_t)0);
+    assertEqual(crc32(0, data, sizeof(data)), (uint32_t)0xCBF43926);
+    for (size_t i = 0; i <= sizeof(data); ++i) {
+        uint32_t crc = crc32(0, data, i);
+        assertEqual(crc32(crc, data + i, sizeof(data) - i), (uint32_t)0xCBF43926);
+    }
+}
+
 }  // namespace Canny
 
 // Test boilerplate.
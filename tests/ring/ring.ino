@@ -0,0 +1,95 @@
+#include <Arduino.h>
+#include <AUnit.h>
+#include <Canny.h>
+#include <Canny/Ring.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+test(FrameRingTest, Empty) {
+    FrameRing<CAN20Frame> ring(4);
+    assertEqual(ring.capacity(), (uint8_t)4);
+    assertEqual(ring.size(), (uint8_t)0);
+    assertEqual(ring.front(), (CAN20Frame*)nullptr);
+}
+
+test(FrameRingTest, PushPop) {
+    FrameRing<CAN20Frame> ring(4);
+    CAN20Frame expect(0x123, 0, {0x01, 0x02});
+
+    CAN20Frame* slot = ring.back();
+    assertNotEqual(slot, (CAN20Frame*)nullptr);
+    *slot = expect;
+    assertEqual(ring.size(), (uint8_t)0);
+    ring.push();
+    assertEqual(ring.size(), (uint8_t)1);
+
+    CAN20Frame* actual = ring.front();
+    assertNotEqual(actual, (CAN20Frame*)nullptr);
+    assertTrue(*actual == expect);
+    ring.pop();
+    assertEqual(ring.size(), (uint8_t)0);
+    assertEqual(ring.front(), (CAN20Frame*)nullptr);
+}
+
+test(FrameRingTest, Full) {
+    FrameRing<CAN20Frame> ring(3);
+    for (uint32_t i = 0; i < 3; ++i) {
+        CAN20Frame* slot = ring.back();
+        assertNotEqual(slot, (CAN20Frame*)nullptr);
+        slot->id(i);
+        ring.push();
+    }
+    assertEqual(ring.size(), (uint8_t)3);
+    assertEqual(ring.back(), (CAN20Frame*)nullptr);
+    ring.drop();
+    assertEqual(ring.dropped(), (uint32_t)1);
+
+    ring.pop();
+    assertNotEqual(ring.back(), (CAN20Frame*)nullptr);
+}
+
+test(FrameRingTest, Wrap) {
+    FrameRing<CAN20Frame> ring(3);
+    for (uint32_t i = 0; i < 20; ++i) {
+        CAN20Frame* slot = ring.back();
+        assertNotEqual(slot, (CAN20Frame*)nullptr);
+        slot->id(i);
+        ring.push();
+        if (i % 2 == 1) {
+            assertEqual(ring.size(), (uint8_t)2);
+            assertEqual(ring.front()->id(), i - 1);
+            ring.pop();
+            assertEqual(ring.front()->id(), i);
+            ring.pop();
+        }
+    }
+    assertEqual(ring.size(), (uint8_t)0);
+}
+
+test(FrameRingTest, MaxCapacity) {
+    FrameRing<CAN20Frame> ring(255);
+    assertEqual(ring.capacity(), (uint8_t)254);
+    for (uint8_t i = 0; i < 254; ++i) {
+        assertNotEqual(ring.back(), (CAN20Frame*)nullptr);
+        ring.push();
+    }
+    assertEqual(ring.size(), (uint8_t)254);
+    assertEqual(ring.back(), (CAN20Frame*)nullptr);
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
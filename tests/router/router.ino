@@ -0,0 +1,269 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/Router.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+class FakeConnection : public Connection<CAN20Frame> {
+    public:
+        FakeConnection(size_t write_size = 16) :
+                read_len_(0), read_pos_(0), write_size_(write_size), write_len_(0),
+                write_err_(ERR_FIFO) {}
+
+        Error read(CAN20Frame* frame) override {
+            if (read_pos_ >= read_len_) {
+                return ERR_FIFO;
+            }
+            *frame = read_buffer_[read_pos_++];
+            return ERR_OK;
+        }
+
+        Error write(const CAN20Frame& frame) override {
+            if (write_len_ >= write_size_) {
+                return write_err_;
+            }
+            write_buffer_[write_len_++] = frame;
+            return ERR_OK;
+        }
+
+        void add(const CAN20Frame& frame) {
+            read_buffer_[read_len_++] = frame;
+        }
+
+        size_t readsRemaining() const { return read_len_ - read_pos_; }
+
+        const CAN20Frame* writeData() const { return write_buffer_; }
+
+        size_t writeCount() const { return write_len_; }
+
+        void setWriteError(Error err) { write_err_ = err; }
+
+        void writeReset(size_t size) {
+            write_size_ = size;
+            write_len_ = 0;
+        }
+
+    private:
+        CAN20Frame read_buffer_[16];
+        size_t read_len_;
+        size_t read_pos_;
+        CAN20Frame write_buffer_[16];
+        size_t write_size_;
+        size_t write_len_;
+        Error write_err_;
+};
+
+test(RouterTest, Forward) {
+    FakeConnection a, b, c;
+    Router<CAN20Frame> router(3, 4, 4);
+    assertTrue(router.addPort(&a));
+    assertTrue(router.addPort(&b));
+    assertTrue(router.addPort(&c));
+
+    // 0x100-0x1FF from a go to b and c, everything else from a goes to b
+    assertTrue(router.addRoute(0, 0x100, 0x700, 0x06));
+    assertTrue(router.addRoute(0, 0x000, 0x000, 0x02));
+
+    CAN20Frame f1(0x123, 0, {0x01, 0x02});
+    CAN20Frame f2(0x456, 0, {0x03, 0x04});
+    a.add(f1);
+    a.add(f2);
+    router.poll();
+
+    assertEqual(b.writeCount(), (size_t)2);
+    assertTrue(b.writeData()[0] == f1);
+    assertTrue(b.writeData()[1] == f2);
+    assertEqual(c.writeCount(), (size_t)1);
+    assertTrue(c.writeData()[0] == f1);
+    assertEqual(a.writeCount(), (size_t)0);
+    assertEqual(router.forwarded(0), (uint32_t)2);
+    assertEqual(router.forwarded(1), (uint32_t)1);
+}
+
+test(RouterTest, NoRouteBackToSource) {
+    FakeConnection a, b;
+    Router<CAN20Frame> router(2, 1, 4);
+    router.addPort(&a);
+    router.addPort(&b);
+    router.addRoute(AnyPort, 0, 0, 0x03);
+
+    CAN20Frame f1(0x100, 0, 1);
+    CAN20Frame f2(0x200, 0, 1);
+    a.add(f1);
+    b.add(f2);
+    router.poll();
+
+    assertEqual(a.writeCount(), (size_t)1);
+    assertTrue(a.writeData()[0] == f2);
+    assertEqual(b.writeCount(), (size_t)1);
+    assertTrue(b.writeData()[0] == f1);
+}
+
+test(RouterTest, Unrouted) {
+    FakeConnection a, b;
+    Router<CAN20Frame> router(2, 1, 4);
+    router.addPort(&a);
+    router.addPort(&b);
+    router.addRoute(1, 0, 0, 0x01);
+
+    a.add(CAN20Frame(0x100, 0, 1));
+    router.poll();
+    assertEqual(b.writeCount(), (size_t)0);
+    assertEqual(router.unrouted(), (uint32_t)1);
+}
+
+test(RouterTest, Rewrite) {
+    FakeConnection a, b;
+    Router<CAN20Frame> router(2, 1, 4);
+    router.addPort(&a);
+    router.addPort(&b);
+    router.addRoute(0, 0x100, 0x700, 0x02);
+    router.rewrite(0, 0x500, 0x700);
+
+    a.add(CAN20Frame(0x123, 0, 1));
+    router.poll();
+    assertEqual(b.writeCount(), (size_t)1);
+    assertEqual(b.writeData()[0].id(), (uint32_t)0x523);
+}
+
+test(RouterTest, RewriteTruncates) {
+    FakeConnection a, b;
+    Router<CAN20Frame> router(2, 1, 4);
+    router.addPort(&a);
+    router.addPort(&b);
+    router.addRoute(0, 0, 0, 0x02);
+    router.rewrite(0, 0x1F000000, 0x1F000000);
+
+    // The rewritten bits do not fit a standard ID.
+    a.add(CAN20Frame(0x123, 0, 1));
+    a.add(CAN20Frame(0x123, 1, 1));
+    router.poll();
+    assertEqual(b.writeCount(), (size_t)2);
+    assertEqual(b.writeData()[0].id(), (uint32_t)0x123);
+    assertEqual(b.writeData()[1].id(), (uint32_t)0x1F000123);
+}
+
+test(RouterTest, MatchExt) {
+    FakeConnection a, b, c;
+    Router<CAN20Frame> router(3, 2, 4);
+    router.addPort(&a);
+    router.addPort(&b);
+    router.addPort(&c);
+    router.addRoute(0, 0x123, 0x1FFFFFFF, 0x02, 1);
+    router.addRoute(0, 0x123, 0x1FFFFFFF, 0x04, 0);
+
+    a.add(CAN20Frame(0x123, 0, 1));
+    a.add(CAN20Frame(0x123, 1, 1));
+    router.poll();
+    assertEqual(b.writeCount(), (size_t)1);
+    assertEqual(b.writeData()[0].ext(), (uint8_t)1);
+    assertEqual(c.writeCount(), (size_t)1);
+    assertEqual(c.writeData()[0].ext(), (uint8_t)0);
+}
+
+test(RouterTest, SlowPort) {
+    FakeConnection a, b(0), c;
+    Router<CAN20Frame> router(3, 1, 2);
+    router.addPort(&a);
+    router.addPort(&b);
+    router.addPort(&c);
+    router.addRoute(0, 0, 0, 0x06);
+
+    for (uint32_t i = 0; i < 4; ++i) {
+        a.add(CAN20Frame(i, 0, 1));
+    }
+    router.poll();
+
+    // c keeps up while b is full and drops
+    assertEqual(c.writeCount(), (size_t)4);
+    assertEqual(b.writeCount(), (size_t)0);
+    assertEqual(router.pending(1), (size_t)2);
+    assertEqual(router.forwarded(0), (uint32_t)4);
+    assertEqual(router.dropped(0), (uint32_t)2);
+
+    b.writeReset(4);
+    router.poll();
+    assertEqual(b.writeCount(), (size_t)2);
+    assertEqual(b.writeData()[0].id(), (uint32_t)0);
+    assertEqual(b.writeData()[1].id(), (uint32_t)1);
+    assertEqual(router.pending(1), (size_t)0);
+    assertEqual(router.forwarded(0), (uint32_t)6);
+}
+
+test(RouterTest, DrainError) {
+    FakeConnection a, b(0);
+    Router<CAN20Frame> router(2, 2, 4);
+    router.addPort(&a);
+    router.addPort(&b);
+    router.addRoute(0, 0x100, 0x700, 0x02);
+    router.addRoute(0, 0x200, 0x700, 0x02);
+
+    a.add(CAN20Frame(0x100, 0, 1));
+    a.add(CAN20Frame(0x200, 0, 1));
+    a.add(CAN20Frame(0x201, 0, 1));
+    router.poll();
+    assertEqual(router.pending(1), (size_t)3);
+    assertEqual(router.forwarded(0), (uint32_t)0);
+    assertEqual(router.forwarded(1), (uint32_t)0);
+
+    // buffered frames that fail to write are dropped by their own route
+    b.setWriteError(ERR_INTERNAL);
+    router.poll();
+    assertEqual(router.pending(1), (size_t)0);
+    assertEqual(router.dropped(0), (uint32_t)1);
+    assertEqual(router.dropped(1), (uint32_t)2);
+    assertEqual(router.forwarded(0), (uint32_t)0);
+    assertEqual(router.forwarded(1), (uint32_t)0);
+}
+
+test(RouterTest, Budget) {
+    FakeConnection a, b(0);
+    Router<CAN20Frame> router(2, 1, 8);
+    router.addPort(&a);
+    router.addPort(&b);
+    router.addRoute(0, 0, 0, 0x02);
+
+    for (uint32_t i = 0; i < 6; ++i) {
+        a.add(CAN20Frame(i, 0, 1));
+    }
+    router.poll(4, 2);
+    assertEqual(a.readsRemaining(), (size_t)2);
+    assertEqual(router.pending(1), (size_t)4);
+
+    b.writeReset(8);
+    router.poll(0, 2);
+    assertEqual(a.readsRemaining(), (size_t)2);
+    assertEqual(b.writeCount(), (size_t)2);
+    assertEqual(router.pending(1), (size_t)2);
+
+    router.poll(4, 8);
+    assertEqual(a.readsRemaining(), (size_t)0);
+    assertEqual(b.writeCount(), (size_t)6);
+}
+
+test(RouterTest, Limits) {
+    FakeConnection a;
+    Router<CAN20Frame> router(1, 1, 1);
+    assertTrue(router.addPort(&a));
+    assertFalse(router.addPort(&a));
+    assertTrue(router.addRoute(0, 0, 0, 0));
+    assertFalse(router.addRoute(0, 0, 0, 0));
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
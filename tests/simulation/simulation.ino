@@ -0,0 +1,226 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/BusLoad.h>
+#include <Canny/SimulatedBus.h>
+#include <Canny/SimulatedController.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+test(SimulatedBusTest, Begin) {
+    SimulatedBus bus(CAN20_500K, CAN20);
+    SimulatedController<CAN20Frame> can(&bus);
+    CAN20Frame frame;
+    assertEqual(can.read(&frame), ERR_READY);
+    assertEqual(can.write(frame), ERR_READY);
+    assertFalse(can.begin(CAN20_250K));
+    assertTrue(can.begin(CAN20_500K));
+    assertEqual(can.mode(), CAN20);
+    assertEqual(can.bitrate(), CAN20_500K);
+    assertEqual(can.read(&frame), ERR_FIFO);
+}
+
+test(SimulatedBusTest, Deliver) {
+    SimulatedBus bus(CAN20_500K, CAN20);
+    SimulatedController<CAN20Frame> a(&bus);
+    SimulatedController<TimestampedFrame<CAN20Frame>> b(&bus);
+    assertTrue(a.begin(CAN20_500K));
+    assertTrue(b.begin(CAN20_500K));
+
+    CAN20Frame expect(0x123, 0, {0x11, 0x22, 0x33, 0x44});
+    uint32_t time = BusLoad(CAN20_500K, CAN20, Stuffing::EXACT).frameTime(expect);
+    assertEqual(a.write(expect), ERR_OK);
+    assertFalse(bus.idle());
+
+    // nothing arrives until the frame has been on the wire for its full time
+    TimestampedFrame<CAN20Frame> actual;
+    bus.advance(time - 1);
+    assertEqual(b.read(&actual), ERR_FIFO);
+    bus.advance(1);
+    assertEqual(b.read(&actual), ERR_OK);
+    assertTrue(actual == expect);
+    assertEqual(actual.timestamp(), time / 1000);
+    assertEqual(bus.now(), (uint64_t)time);
+    assertTrue(bus.idle());
+
+    // the sender does not receive its own frame
+    CAN20Frame frame;
+    assertEqual(a.read(&frame), ERR_FIFO);
+    assertEqual(a.transmitted(), (uint32_t)1);
+    assertEqual(b.received(), (uint32_t)1);
+    assertEqual(bus.busy(), (uint64_t)time);
+}
+
+test(SimulatedBusTest, Arbitration) {
+    SimulatedBus bus(CAN20_500K, CAN20);
+    SimulatedController<CAN20Frame> a(&bus);
+    SimulatedController<CAN20Frame> b(&bus);
+    SimulatedController<CAN20Frame> c(&bus);
+    SimulatedController<CAN20Frame> observer(&bus, 3, 8);
+    assertTrue(a.begin(CAN20_500K));
+    assertTrue(b.begin(CAN20_500K));
+    assertTrue(c.begin(CAN20_500K));
+    assertTrue(observer.begin(CAN20_500K));
+
+    assertEqual(a.write(CAN20Frame(0x08000000, 1, {0x01, 0x02})), ERR_OK);
+    assertEqual(a.write(CAN20Frame(0x0050, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(b.write(CAN20Frame(0x0100, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(c.write(CAN20Frame(0x0200, 0, {0x01, 0x02})), ERR_OK);
+    bus.run();
+
+    // a's second frame waits behind its first
+    uint32_t expect_id[] = {0x100, 0x200, 0x08000000, 0x050};
+    uint8_t expect_ext[] = {0, 0, 1, 0};
+    CAN20Frame frame;
+    for (size_t i = 0; i < 4; ++i) {
+        assertEqual(observer.read(&frame), ERR_OK);
+        assertEqual(frame.id(), expect_id[i]);
+        assertEqual(frame.ext(), expect_ext[i]);
+    }
+    assertEqual(observer.read(&frame), ERR_FIFO);
+}
+
+test(SimulatedBusTest, Mailboxes) {
+    SimulatedBus bus(CAN20_500K, CAN20);
+    SimulatedController<CAN20Frame> a(&bus, 3, 2);
+    SimulatedController<CAN20Frame> b(&bus, 3, 2);
+    assertTrue(a.begin(CAN20_500K));
+    assertTrue(b.begin(CAN20_500K));
+
+    CAN20Frame frame(0x123, 0, {0x01, 0x02});
+    assertEqual(a.write(frame), ERR_OK);
+    assertEqual(a.write(frame), ERR_OK);
+    assertEqual(a.write(frame), ERR_OK);
+    assertEqual(a.write(frame), ERR_FIFO);
+
+    bus.run();
+    assertEqual(b.received(), (uint32_t)2);
+    assertEqual(b.overruns(), (uint32_t)1);
+    assertEqual(a.write(frame), ERR_OK);
+}
+
+test(SimulatedBusTest, Invalid) {
+    SimulatedBus bus(CANFD_500K_2M, CAN20);
+    SimulatedController<CANFDFrame> can(&bus);
+    assertTrue(can.begin(CANFD_500K_2M));
+    assertEqual(can.write(CANFDFrame(0x123, 0, 12)), ERR_INVALID);
+    assertEqual(can.write(CANFDFrame(0x123, 0, 8)), ERR_OK);
+}
+
+test(SimulatedBusTest, CANFD) {
+    SimulatedBus bus(CANFD_500K_2M, CANFD_DUAL_RATE);
+    SimulatedController<CANFDFrame> a(&bus);
+    SimulatedController<CANFDFrame> b(&bus);
+    assertTrue(a.begin(CANFD_500K_2M));
+    assertTrue(b.begin(CANFD_500K_2M));
+
+    CANFDFrame expect(0x18FEF100, 1, 64);
+    memset(expect.data(), 0x5A, 64);
+    assertEqual(a.write(expect), ERR_OK);
+    bus.run();
+
+    CANFDFrame actual;
+    assertEqual(b.read(&actual), ERR_OK);
+    assertTrue(actual == expect);
+    assertEqual(bus.now(), (uint64_t)BusLoad(CANFD_500K_2M, CANFD_DUAL_RATE, Stuffing::EXACT).frameTime(expect));
+}
+
+test(SimulatedBusTest, BusOff) {
+    SimulatedBus bus(CAN20_500K, CAN20);
+    SimulatedController<CAN20Frame> a(&bus);
+    SimulatedController<CAN20Frame> b(&bus);
+    assertTrue(a.begin(CAN20_500K));
+    assertTrue(b.begin(CAN20_500K));
+
+    CAN20Frame frame(0x123, 0, {0x01, 0x02});
+    assertEqual(a.write(frame), ERR_OK);
+    b.busOff();
+    assertTrue(b.isBusOff());
+    assertEqual(b.write(frame), ERR_READY);
+    bus.run();
+    assertEqual(b.received(), (uint32_t)0);
+
+    b.recover();
+    assertEqual(a.write(frame), ERR_OK);
+    bus.run();
+    assertEqual(b.received(), (uint32_t)1);
+}
+
+test(SimulatedBusTest, Errors) {
+    SimulatedBus bus(CAN20_500K, CAN20);
+    SimulatedController<CAN20Frame> a(&bus);
+    SimulatedController<CAN20Frame> b(&bus);
+    assertTrue(a.begin(CAN20_500K));
+    assertTrue(b.begin(CAN20_500K));
+
+    // every transmission fails until the sender goes bus-off
+    bus.errorRate(1000);
+    assertEqual(a.write(CAN20Frame(0x123, 0, {0x01, 0x02})), ERR_OK);
+    bus.run();
+    assertTrue(a.isBusOff());
+    assertEqual(bus.errors(), (uint32_t)32);
+    assertEqual(bus.frames(), (uint32_t)0);
+    assertEqual(b.received(), (uint32_t)0);
+
+    // the frame is still pending and is sent after recovery
+    bus.errorRate(0);
+    a.recover();
+    bus.run();
+    assertEqual(b.received(), (uint32_t)1);
+}
+
+test(SimulatedBusTest, Drop) {
+    SimulatedBus bus(CAN20_500K, CAN20);
+    SimulatedController<CAN20Frame> a(&bus);
+    SimulatedController<CAN20Frame> b(&bus);
+    assertTrue(a.begin(CAN20_500K));
+    assertTrue(b.begin(CAN20_500K));
+
+    b.dropRate(1000);
+    assertEqual(a.write(CAN20Frame(0x123, 0, {0x01, 0x02})), ERR_OK);
+    bus.run();
+    assertEqual(a.transmitted(), (uint32_t)1);
+    assertEqual(b.dropped(), (uint32_t)1);
+    assertEqual(b.received(), (uint32_t)0);
+}
+
+test(SimulatedBusTest, Saturation) {
+    SimulatedBus bus(CAN20_125K, CAN20);
+    SimulatedController<CAN20Frame> a(&bus);
+    SimulatedController<CAN20Frame> b(&bus, 3, 64);
+    assertTrue(a.begin(CAN20_125K));
+    assertTrue(b.begin(CAN20_125K));
+
+    // write faster than the bus can carry frames
+    CAN20Frame frame(0x123, 0, 8);
+    uint32_t rejected = 0;
+    for (size_t i = 0; i < 100; ++i) {
+        if (a.write(frame) == ERR_FIFO) {
+            ++rejected;
+        }
+        bus.advance(500000);
+    }
+    assertMore(rejected, (uint32_t)0);
+
+    // every accepted frame is eventually delivered
+    bus.run();
+    assertEqual(b.received() + rejected, (uint32_t)100);
+    assertEqual(a.transmitted(), b.received());
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
@@ -0,0 +1,317 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/SLCAN.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+// A stream that plays the host side of a serial link. Bytes sent by the host
+// are read from input. Bytes written by the device are collected in output.
+class HostStream : public Stream {
+    public:
+        HostStream() : in_len_(0), in_pos_(0), out_len_(0), writes_(0) {}
+
+        int available() override { return in_len_ - in_pos_; }
+
+        int read() override { return available() > 0 ? input_[in_pos_++] : -1; }
+
+        int peek() override { return available() > 0 ? input_[in_pos_] : -1; }
+
+        size_t write(uint8_t b) override { return write(&b, 1); }
+
+        size_t write(const uint8_t* buffer, size_t size) override {
+            if (out_len_ + size >= sizeof(output_)) {
+                size = sizeof(output_) - out_len_ - 1;
+            }
+            memcpy(output_ + out_len_, buffer, size);
+            out_len_ += size;
+            ++writes_;
+            return size;
+        }
+
+        // Queue text sent by the host.
+        void send(const char* text) {
+            size_t len = strlen(text);
+            memcpy(input_ + in_len_, text, len);
+            in_len_ += len;
+        }
+
+        // Return and clear the text written by the device.
+        const char* received() {
+            output_[out_len_] = 0;
+            out_len_ = 0;
+            return output_;
+        }
+
+        int writes() const { return writes_; }
+
+    private:
+        char input_[1024];
+        size_t in_len_;
+        size_t in_pos_;
+        char output_[1024];
+        size_t out_len_;
+        int writes_;
+};
+
+class FakeController : public Controller<CANFDFrame> {
+    public:
+        FakeController() : begun_(false), bitrate_(CAN20_125K) {}
+
+        bool begin(Bitrate bitrate) override {
+            begun_ = true;
+            bitrate_ = bitrate;
+            return true;
+        }
+        Mode mode() const override { return CANFD_DUAL_RATE; }
+        Bitrate bitrate() const override { return bitrate_; }
+        Error read(CANFDFrame*) override { return ERR_FIFO; }
+        Error write(const CANFDFrame&) override { return ERR_OK; }
+
+        bool begun() const { return begun_; }
+
+    private:
+        bool begun_;
+        Bitrate bitrate_;
+};
+
+test(SLCANTest, Open) {
+    HostStream stream;
+    FakeController controller;
+    SLCAN<CANFDFrame> slcan(&stream, &controller);
+    CANFDFrame frame;
+
+    stream.send("\r\rC\rS4\rO\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "\r\r\r");
+    assertTrue(slcan.isOpen());
+    assertFalse(slcan.listenOnly());
+    assertTrue(controller.begun());
+    assertEqual(controller.bitrate(), CAN20_125K);
+    assertEqual(slcan.bitrate(), CAN20_125K);
+
+    // rates may not change while open and a second open fails
+    stream.send("S6\rO\rC\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "\a\a\r");
+    assertFalse(slcan.isOpen());
+}
+
+test(SLCANTest, DataBitrate) {
+    HostStream stream;
+    FakeController controller;
+    SLCAN<CANFDFrame> slcan(&stream, &controller);
+    CANFDFrame frame;
+
+    stream.send("S8\rY8\rL\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "\r\r\r");
+    assertEqual(controller.bitrate(), CANFD_1000K_8M);
+    assertTrue(slcan.listenOnly());
+
+    // 125K has no data rates in Mbit/s
+    stream.send("C\rS4\rY2\rO\rS7\rY9\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "\r\r\r\a\a\a");
+    assertFalse(slcan.isOpen());
+}
+
+test(SLCANTest, Info) {
+    HostStream stream;
+    SLCAN<CAN20Frame> slcan(&stream);
+    CAN20Frame frame;
+
+    stream.send("V\rN\rF\rO\rF\rX\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "V1013\rNCNY1\r\a\rF00\r\a");
+}
+
+test(SLCANTest, ReadStandard) {
+    HostStream stream;
+    SLCAN<CAN20Frame> slcan(&stream);
+    CAN20Frame frame;
+
+    stream.send("O\rt1238112233445566aAbB\rt7FF0\r");
+    assertEqual(slcan.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x123, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0xAA, 0xBB}));
+    assertEqual(slcan.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x7FF, 0, 0));
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "\rz\rz\r");
+}
+
+test(SLCANTest, ReadExtended) {
+    HostStream stream;
+    SLCAN<CANFDFrame> slcan(&stream);
+    CANFDFrame frame;
+
+    stream.send("O\rT18FEF1002AB01\r");
+    assertEqual(slcan.read(&frame), ERR_OK);
+    assertTrue(frame == CANFDFrame(0x18FEF100, 1, {0xAB, 0x01}));
+    assertEqual(stream.received(), "\rZ\r");
+
+    stream.send("D1FFFFFFF9000102030405060708090A0B\r");
+    assertEqual(slcan.read(&frame), ERR_OK);
+    assertTrue(frame == CANFDFrame(0x1FFFFFFF, 1, {
+        0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0x0B}));
+
+    stream.send("b001F");
+    for (int i = 0; i < 64; ++i) {
+        stream.send("A5");
+    }
+    stream.send("\r");
+    assertEqual(slcan.read(&frame), ERR_OK);
+    assertEqual(frame.id(), 0x001u);
+    assertEqual(frame.ext(), 0);
+    assertEqual(frame.size(), 64);
+    assertEqual(frame.data()[63], 0xA5);
+}
+
+test(SLCANTest, ReadInvalid) {
+    HostStream stream;
+    SLCAN<CAN20Frame> slcan(&stream);
+    CAN20Frame frame;
+
+    // frames are rejected while closed
+    stream.send("t1230\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "\a");
+
+    // remote frames, bad IDs, bad digits, wrong lengths and FD frames that
+    // don't fit a CAN 2.0 frame
+    stream.send("O\rr1230\rR123456780\rt8000\rT200000000\rt1231G\rt123211\r"
+            "t1239\rd1239000102030405060708090A0B\rt1\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "\r\a\a\a\a\a\a\a\a\a");
+
+    // listen only mode doesn't read frames
+    stream.send("C\rL\rt1230\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertEqual(stream.received(), "\r\r\a");
+}
+
+test(SLCANTest, ReadPartial) {
+    HostStream stream;
+    SLCAN<CAN20Frame> slcan(&stream);
+    CAN20Frame frame;
+
+    stream.send("O\rt1232A");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    stream.send("BC");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    stream.send("D\r\nt123101\r\n");
+    assertEqual(slcan.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x123, 0, {0xAB, 0xCD}));
+    assertEqual(slcan.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x123, 0, (uint8_t[]){0x01}));
+}
+
+test(SLCANTest, ReadOverflow) {
+    HostStream stream;
+    SLCAN<CAN20Frame> slcan(&stream);
+    CAN20Frame frame;
+
+    stream.send("O\r");
+    for (int i = 0; i < 40; ++i) {
+        stream.send("0123456789");
+    }
+    stream.send("\rt1230\r");
+    assertEqual(slcan.read(&frame), ERR_OK);
+    assertTrue(frame == CAN20Frame(0x123, 0, 0));
+    assertEqual(stream.received(), "\r\az\r");
+}
+
+test(SLCANTest, ReadMany) {
+    HostStream stream;
+    SLCAN<CAN20Frame> slcan(&stream);
+    CAN20Frame frames[4];
+    size_t n;
+
+    stream.send("O\rt1000\rt201111\rt302122\r");
+    assertEqual(slcan.readMany(frames, 4, &n), ERR_OK);
+    assertEqual(n, (size_t)3);
+    assertTrue(frames[2] == CAN20Frame(0x302, 0, (uint8_t[]){0x22}));
+    assertEqual(slcan.readMany(frames, 4, &n), ERR_FIFO);
+    assertEqual(n, (size_t)0);
+}
+
+test(SLCANTest, Write) {
+    HostStream stream;
+    SLCAN<CANFDFrame> slcan(&stream);
+    CANFDFrame frame;
+
+    assertEqual(slcan.write(CANFDFrame(0x123, 0, (uint8_t[]){0x01})), ERR_READY);
+    stream.send("O\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    stream.received();
+
+    assertEqual(slcan.write(CANFDFrame(0x123, 0, {0x01, 0xAB})), ERR_OK);
+    assertEqual(stream.received(), "t123201AB\r");
+    assertEqual(slcan.write(CANFDFrame(0x18FEF100, 1, 0)), ERR_OK);
+    assertEqual(stream.received(), "T18FEF1000\r");
+    assertEqual(slcan.write(CANFDFrame(0x7FF, 0, {
+        0xF0, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA, 0xFB,
+        0xFC, 0xFD, 0xFE, 0xFF})), ERR_OK);
+    assertEqual(stream.received(), "d7FFAF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF\r");
+    assertEqual(slcan.write(CANFDFrame(0x1ABCDEF, 1, 12)), ERR_OK);
+    assertEqual(stream.received(), "D01ABCDEF9000000000000000000000000\r");
+    assertEqual(slcan.write(CANFDFrame(0x123, 0, 10)), ERR_INVALID);
+}
+
+test(SLCANTest, WriteTimestamp) {
+    typedef TimestampedFrame<CAN20Frame> Frame;
+    HostStream stream;
+    SLCAN<Frame> slcan(&stream);
+    Frame frame;
+
+    stream.send("Z1\rO\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    assertTrue(slcan.timestamps());
+    stream.received();
+
+    // timestamps are milliseconds and wrap at one minute
+    assertEqual(slcan.write(Frame(CAN20Frame(0x123, 0, (uint8_t[]){0x01}), 61234567)), ERR_OK);
+    assertEqual(stream.received(), "t12310104D2\r");
+}
+
+test(SLCANTest, WriteMany) {
+    HostStream stream;
+    SLCAN<CAN20Frame> slcan(&stream);
+    CAN20Frame frame;
+    CAN20Frame frames[12];
+    size_t n;
+
+    stream.send("O\r");
+    assertEqual(slcan.read(&frame), ERR_FIFO);
+    stream.received();
+
+    for (int i = 0; i < 12; ++i) {
+        frames[i] = CAN20Frame(0x100 + i, 0, {0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    }
+    int writes = stream.writes();
+    assertEqual(slcan.writeMany(frames, 12, &n), ERR_OK);
+    assertEqual(n, (size_t)12);
+    assertEqual(stream.writes() - writes, 2);
+    assertEqual(strlen(stream.received()), (size_t)(12 * 22));
+
+    frames[1].resize(0);
+    assertEqual(slcan.writeMany(frames, 2, &n), ERR_OK);
+    assertEqual(stream.received(), "t10081122334455667788\rt1010\r");
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
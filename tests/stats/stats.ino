@@ -0,0 +1,296 @@
+#define CANNY_STATS
+
+#include <Arduino.h>
+#include <AUnit.h>
+#include <Canny.h>
+#include <Canny/Buffer.h>
+#include <Canny/Stats.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+class FakeConnection : public Connection<CAN20Frame> {
+    public:
+        FakeConnection() : read_len_(0), read_pos_(0), read_err_(ERR_FIFO),
+                write_len_(0), write_size_(0), write_err_(ERR_FIFO) {}
+
+        Error read(CAN20Frame* frame) override {
+            if (read_pos_ >= read_len_) {
+                return read_err_;
+            }
+            *frame = read_buffer_[read_pos_++];
+            return ERR_OK;
+        }
+
+        Error write(const CAN20Frame& frame) override {
+            if (write_len_ >= write_size_) {
+                return write_err_;
+            }
+            write_buffer_[write_len_++] = frame;
+            return ERR_OK;
+        }
+
+        void addRead(const CAN20Frame& frame) {
+            read_buffer_[read_len_++] = frame;
+        }
+
+        void setReadError(Error err) { read_err_ = err; }
+        void setWriteSize(size_t size) { write_size_ = size; }
+        void setWriteError(Error err) { write_err_ = err; }
+        size_t writeLen() const { return write_len_; }
+
+    private:
+        CAN20Frame read_buffer_[8];
+        size_t read_len_;
+        size_t read_pos_;
+        Error read_err_;
+        CAN20Frame write_buffer_[8];
+        size_t write_len_;
+        size_t write_size_;
+        Error write_err_;
+};
+
+class StringPrint : public Print {
+    public:
+        StringPrint() : len_(0) { buffer_[0] = 0; }
+
+        size_t write(uint8_t c) override {
+            if (len_ + 1 >= sizeof(buffer_)) {
+                return 0;
+            }
+            buffer_[len_++] = c;
+            buffer_[len_] = 0;
+            return 1;
+        }
+
+        const char* str() const { return buffer_; }
+
+    private:
+        char buffer_[256];
+        size_t len_;
+};
+
+uint32_t sum(const uint32_t* buckets) {
+    uint32_t total = 0;
+    for (uint8_t i = 0; i < StatsBuckets; ++i) {
+        total += buckets[i];
+    }
+    return total;
+}
+
+test(StatsTest, Bucket) {
+    assertEqual(statsBucket(0), (uint8_t)0);
+    assertEqual(statsBucket(1), (uint8_t)1);
+    assertEqual(statsBucket(2), (uint8_t)2);
+    assertEqual(statsBucket(3), (uint8_t)2);
+    assertEqual(statsBucket(4), (uint8_t)3);
+    assertEqual(statsBucket(1000), (uint8_t)10);
+    assertEqual(statsBucket(0xFFFFFFFF), (uint8_t)(StatsBuckets - 1));
+}
+
+test(StatsConnectionTest, Counts) {
+    FakeConnection fake;
+    fake.addRead(CAN20Frame(0x100, 0, {0x01, 0x02}));
+    fake.addRead(CAN20Frame(0x101, 0, {0x01, 0x02, 0x03}));
+    fake.setWriteSize(1);
+
+    StatsConnection<CAN20Frame> can(&fake);
+    CAN20Frame frame;
+    assertEqual(can.read(&frame), ERR_OK);
+    assertEqual(can.read(&frame), ERR_OK);
+    assertEqual(can.read(&frame), ERR_FIFO);
+    assertEqual(can.write(CAN20Frame(0x200, 0, {0x01, 0x02, 0x03, 0x04})), ERR_OK);
+    assertEqual(can.write(CAN20Frame(0x201, 0, {0x01, 0x02})), ERR_FIFO);
+
+    ConnectionStats stats;
+    can.stats(&stats);
+    assertEqual(stats.frames_in, (uint32_t)2);
+    assertEqual(stats.bytes_in, (uint32_t)5);
+    assertEqual(stats.read_errors[ERR_FIFO], (uint32_t)1);
+    assertEqual(stats.frames_out, (uint32_t)1);
+    assertEqual(stats.bytes_out, (uint32_t)4);
+    assertEqual(stats.write_errors[ERR_FIFO], (uint32_t)1);
+    assertEqual(sum(stats.read_time), (uint32_t)3);
+
+    can.clearStats();
+    can.stats(&stats);
+    assertEqual(stats.frames_in, (uint32_t)0);
+    assertEqual(sum(stats.read_time), (uint32_t)0);
+}
+
+test(StatsConnectionTest, Errors) {
+    FakeConnection fake;
+    fake.setReadError(ERR_INTERNAL);
+    fake.setWriteError(ERR_INVALID);
+
+    StatsConnection<CAN20Frame> can(&fake);
+    CAN20Frame frame;
+    assertEqual(can.read(&frame), ERR_INTERNAL);
+    assertEqual(can.write(CAN20Frame(0x200, 0, {0x01, 0x02})), ERR_INVALID);
+
+    ConnectionStats stats;
+    can.stats(&stats);
+    assertEqual(stats.read_errors[ERR_INTERNAL], (uint32_t)1);
+    assertEqual(stats.write_errors[ERR_INVALID], (uint32_t)1);
+    assertEqual(stats.frames_in, (uint32_t)0);
+    assertEqual(stats.frames_out, (uint32_t)0);
+}
+
+test(BufferedStatsTest, Filters) {
+    FakeConnection fake;
+    fake.addRead(CAN20Frame(0x100, 0, {0x01, 0x02}));
+    fake.addRead(CAN20Frame(0x101, 0, {0x01, 0x02}));
+    fake.addRead(CAN20Frame(0x102, 0, {0x01, 0x02}));
+    fake.setWriteSize(4);
+
+    FrameIDFilter read_filter(FilterMode::ALLOW);
+    read_filter.drop(0x101);
+    FrameIDFilter write_filter(FilterMode::ALLOW);
+    write_filter.drop(0x201);
+
+    BufferedConnection<CAN20Frame> can(&fake, 4, 4);
+    can.setReadFilter(&read_filter);
+    can.setWriteFilter(&write_filter);
+
+    CAN20Frame frame;
+    assertEqual(can.read(&frame), ERR_OK);
+    assertEqual(can.read(&frame), ERR_OK);
+    assertEqual(can.read(&frame), ERR_FIFO);
+    assertEqual(can.write(CAN20Frame(0x200, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(can.write(CAN20Frame(0x201, 0, {0x01, 0x02})), ERR_OK);
+
+    ConnectionStats stats;
+    can.stats(&stats);
+    assertEqual(stats.frames_in, (uint32_t)2);
+    assertEqual(stats.filtered_in, (uint32_t)1);
+    assertEqual(stats.read_errors[ERR_FIFO], (uint32_t)1);
+    assertEqual(stats.read_high_water, (uint16_t)1);
+    assertEqual(stats.frames_out, (uint32_t)1);
+    assertEqual(stats.filtered_out, (uint32_t)1);
+    assertEqual(fake.writeLen(), (size_t)1);
+}
+
+test(BufferedStatsTest, ReadError) {
+    FakeConnection fake;
+    fake.setReadError(ERR_INTERNAL);
+    BufferedConnection<CAN20Frame> can(&fake, 1, 1);
+
+    CAN20Frame frame;
+    assertEqual(can.read(&frame), ERR_FIFO);
+
+    ConnectionStats stats;
+    can.stats(&stats);
+    assertEqual(stats.read_errors[ERR_INTERNAL], (uint32_t)1);
+    assertEqual(stats.read_errors[ERR_FIFO], (uint32_t)0);
+    assertEqual(sum(stats.read_time), (uint32_t)1);
+}
+
+test(BufferedStatsTest, Overflow) {
+    FakeConnection fake;
+    BufferedConnection<CAN20Frame> can(&fake, 1, 2);
+
+    assertEqual(can.write(CAN20Frame(0x200, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(can.write(CAN20Frame(0x201, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(can.write(CAN20Frame(0x202, 0, {0x01, 0x02})), ERR_FIFO);
+
+    ConnectionStats stats;
+    can.stats(&stats);
+    assertEqual(stats.overflow, (uint32_t)1);
+    assertEqual(stats.write_high_water, (uint16_t)2);
+    assertEqual(stats.write_errors[ERR_FIFO], (uint32_t)3);
+    assertEqual(stats.frames_out, (uint32_t)0);
+    assertEqual(sum(stats.residency), (uint32_t)0);
+}
+
+test(BufferedStatsTest, Residency) {
+    FakeConnection fake;
+    BufferedConnection<CAN20Frame> can(&fake, 1, 2);
+
+    assertEqual(can.write(CAN20Frame(0x200, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(can.write(CAN20Frame(0x201, 0, {0x01, 0x02})), ERR_OK);
+    delay(2);
+    fake.setWriteSize(4);
+    assertEqual(can.write(CAN20Frame(0x202, 0, {0x01, 0x02})), ERR_OK);
+
+    ConnectionStats stats;
+    can.stats(&stats);
+    assertEqual(stats.frames_out, (uint32_t)3);
+    assertEqual(sum(stats.residency), (uint32_t)2);
+    for (uint8_t i = 0; i < statsBucket(2000); ++i) {
+        assertEqual(stats.residency[i], (uint32_t)0);
+    }
+}
+
+test(BufferedStatsTest, ResidencyPriorityQueue) {
+    FakeConnection fake;
+    BufferedConnection<CAN20Frame, FrameQueue<CAN20Frame>, PriorityFrameQueue<CAN20Frame>> can(
+            &fake, 1, 2);
+
+    // frames leave a priority queue out of order so residency is not timed
+    assertEqual(can.write(CAN20Frame(0x201, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(can.write(CAN20Frame(0x200, 0, {0x01, 0x02})), ERR_OK);
+    fake.setWriteSize(4);
+    can.flush();
+
+    ConnectionStats stats;
+    can.stats(&stats);
+    assertEqual(stats.frames_out, (uint32_t)2);
+    assertEqual(stats.write_high_water, (uint16_t)2);
+    assertEqual(sum(stats.residency), (uint32_t)0);
+}
+
+test(StatsRecorderTest, Untimed) {
+    StatsRecorder recorder;
+    recorder.reserve(2);
+    recorder.enqueued();
+    recorder.enqueued();
+    recorder.enqueued();
+    recorder.dequeued();
+    recorder.enqueued();
+    for (int i = 0; i < 3; ++i) {
+        recorder.dequeued();
+    }
+    recorder.enqueued();
+    recorder.dequeued();
+
+    ConnectionStats stats;
+    recorder.snapshot(&stats);
+    assertEqual(sum(stats.residency), (uint32_t)3);
+}
+
+test(BufferedStatsTest, Print) {
+    FakeConnection fake;
+    fake.addRead(CAN20Frame(0x100, 0, {0x01, 0x02}));
+
+    StatsConnection<CAN20Frame> can(&fake);
+    CAN20Frame frame;
+    assertEqual(can.read(&frame), ERR_OK);
+    assertEqual(can.read(&frame), ERR_FIFO);
+
+    ConnectionStats stats;
+    can.stats(&stats);
+    StringPrint p;
+    stats.printTo(p);
+    assertTrue(strstr(p.str(), "frames_in=1 ") != nullptr);
+    assertTrue(strstr(p.str(), "bytes_in=2 ") != nullptr);
+    assertTrue(strstr(p.str(), "read_fifo=1 ") != nullptr);
+    assertTrue(strstr(p.str(), "read_time=[") != nullptr);
+    assertTrue(strstr(p.str(), "frames_out") == nullptr);
+    assertTrue(strstr(p.str(), "residency") == nullptr);
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
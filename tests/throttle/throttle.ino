@@ -0,0 +1,192 @@
+#include <AUnit.h>
+#include <Arduino.h>
+#include <Canny.h>
+#include <Canny/Throttle.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+class FakeConnection : public Connection<CAN20Frame> {
+    public:
+        FakeConnection() : write_count_(0), full_(false) {}
+
+        Error read(CAN20Frame*) override { return ERR_FIFO; }
+
+        Error write(const CAN20Frame& frame) override {
+            if (full_) {
+                return ERR_FIFO;
+            }
+            last_ = frame;
+            ++write_count_;
+            return ERR_OK;
+        }
+
+        void full(bool full) { full_ = full; }
+        int writeCount() const { return write_count_; }
+        const CAN20Frame& last() const { return last_; }
+
+    private:
+        CAN20Frame last_;
+        int write_count_;
+        bool full_;
+};
+
+test(ThrottleTest, SuppressRepeats) {
+    FakeConnection fake;
+    Throttle<CAN20Frame> throttle(&fake, 4, 1000000);
+
+    CAN20Frame frame(0x123, 0, {0x01, 0x02});
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(fake.writeCount(), 1);
+    assertEqual(throttle.sent(), (uint32_t)1);
+    assertEqual(throttle.suppressed(), (uint32_t)2);
+
+    // the same payload on another ID is sent
+    assertEqual(throttle.write(CAN20Frame(0x124, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(fake.writeCount(), 2);
+    assertEqual(throttle.size(), (size_t)2);
+}
+
+test(ThrottleTest, SendChanges) {
+    FakeConnection fake;
+    Throttle<CAN20Frame> throttle(&fake, 4, 1000000);
+
+    assertEqual(throttle.write(CAN20Frame(0x123, 0, {0x01, 0x02})), ERR_OK);
+    assertEqual(throttle.write(CAN20Frame(0x123, 0, {0x01, 0x03})), ERR_OK);
+    assertEqual(throttle.write(CAN20Frame(0x123, 0, {0x01, 0x03, 0x00})), ERR_OK);
+    assertEqual(fake.writeCount(), 3);
+    assertEqual(throttle.suppressed(), (uint32_t)0);
+
+    const ThrottleEntry<CAN20Frame>* entry = throttle.find(0x123, 0);
+    assertNotEqual(entry, (const ThrottleEntry<CAN20Frame>*)nullptr);
+    assertTrue(entry->frame == CAN20Frame(0x123, 0, {0x01, 0x03, 0x00}));
+    assertEqual(throttle.find(0x123, 1), (const ThrottleEntry<CAN20Frame>*)nullptr);
+}
+
+test(ThrottleTest, Refresh) {
+    FakeConnection fake;
+    Throttle<CAN20Frame> throttle(&fake, 4, 10000);
+
+    CAN20Frame frame(0x123, 0, {0x01, 0x02});
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(fake.writeCount(), 1);
+
+    delay(11);
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(fake.writeCount(), 2);
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(fake.writeCount(), 2);
+}
+
+test(ThrottleTest, Budget) {
+    FakeConnection fake;
+    // 8 byte frames cost 20 bytes against a 152 byte burst.
+    Throttle<CAN20Frame> throttle(&fake, 16, 1000000, 1000);
+
+    CAN20Frame frame(0x100, 0, 8);
+    for (uint8_t i = 0; i < 10; ++i) {
+        frame.id(0x100 + i);
+        assertEqual(throttle.write(frame), ERR_OK);
+    }
+    assertEqual(fake.writeCount(), 7);
+    assertEqual(throttle.pending(), (size_t)3);
+
+    // newer frames replace held ones
+    frame.id(0x108);
+    frame.data()[0] = 0xFF;
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(throttle.pending(), (size_t)3);
+
+    // held frames go out in order as credit returns
+    delay(21);
+    throttle.flush();
+    assertEqual(fake.writeCount(), 8);
+    assertEqual(fake.last().id(), 0x107u);
+    delay(41);
+    throttle.flush();
+    assertEqual(fake.writeCount(), 10);
+    assertEqual(fake.last().id(), 0x109u);
+    assertTrue(throttle.find(0x108, 0)->frame == frame);
+    assertEqual(throttle.pending(), (size_t)0);
+}
+
+test(ThrottleTest, BudgetPadding) {
+    FakeConnection fake;
+    // payloads are padded to 8 bytes so 2 byte frames also cost 20 bytes
+    Throttle<CAN20Frame> throttle(&fake, 16, 1000000, 1000);
+
+    CAN20Frame frame(0x100, 0, 2);
+    for (uint8_t i = 0; i < 10; ++i) {
+        frame.id(0x100 + i);
+        assertEqual(throttle.write(frame), ERR_OK);
+    }
+    assertEqual(fake.writeCount(), 7);
+    assertEqual(throttle.pending(), (size_t)3);
+}
+
+test(ThrottleTest, ChangesBeforeRefreshes) {
+    FakeConnection fake;
+    Throttle<CAN20Frame> throttle(&fake, 4, 0, 1000);
+
+    // refreshes stop once they would cut into the reserve for changes
+    CAN20Frame frame(0x123, 0, 8);
+    for (uint8_t i = 0; i < 4; ++i) {
+        assertEqual(throttle.write(frame), ERR_OK);
+    }
+    assertEqual(fake.writeCount(), 3);
+    assertEqual(throttle.suppressed(), (uint32_t)1);
+
+    assertEqual(throttle.write(CAN20Frame(0x124, 0, 8)), ERR_OK);
+    assertEqual(fake.writeCount(), 4);
+    assertEqual(throttle.pending(), (size_t)0);
+}
+
+test(ThrottleTest, Full) {
+    FakeConnection fake;
+    Throttle<CAN20Frame> throttle(&fake, 1, 1000000);
+
+    CAN20Frame frame(0x123, 0, {0x01, 0x02});
+    assertEqual(throttle.write(frame), ERR_OK);
+    frame.id(0x124);
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(fake.writeCount(), 3);
+    assertEqual(throttle.size(), (size_t)1);
+}
+
+test(ThrottleTest, ChildFull) {
+    FakeConnection fake;
+    Throttle<CAN20Frame> throttle(&fake, 4, 1000000);
+
+    fake.full(true);
+    CAN20Frame frame(0x123, 0, {0x01, 0x02});
+    assertEqual(throttle.write(frame), ERR_OK);
+    assertEqual(throttle.pending(), (size_t)1);
+    assertEqual(fake.writeCount(), 0);
+
+    fake.full(false);
+    CAN20Frame read;
+    assertEqual(throttle.read(&read), ERR_FIFO);
+    assertEqual(throttle.pending(), (size_t)0);
+    assertEqual(fake.writeCount(), 1);
+    assertTrue(fake.last() == frame);
+}
+
+}  // namespace Canny
+
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}
@@ -0,0 +1,305 @@
+#include <Arduino.h>
+#include <AUnit.h>
+#include <Canny.h>
+#include <Canny/J1939Transport.h>
+
+using namespace aunit;
+
+namespace Canny {
+
+class FakeConnection : public Connection<J1939Message> {
+    public:
+        FakeConnection() : read_len_(0), read_pos_(0), write_len_(0) {}
+
+        Error read(J1939Message* message) override {
+            if (read_pos_ >= read_len_) {
+                return ERR_FIFO;
+            }
+            *message = read_buffer_[read_pos_++];
+            return ERR_OK;
+        }
+
+        Error write(const J1939Message& message) override {
+            if (write_len_ >= 32) {
+                return ERR_FIFO;
+            }
+            write_buffer_[write_len_++] = message;
+            return ERR_OK;
+        }
+
+        void push(const J1939Message& message) {
+            read_buffer_[read_len_++] = message;
+        }
+
+        void push(uint32_t pgn, uint8_t sa, uint8_t da, const uint8_t (&data)[8]) {
+            J1939Message message(pgn, sa, da);
+            message.data(data);
+            push(message);
+        }
+
+        J1939Message* writeData() { return write_buffer_; }
+
+        size_t writeCount() { return write_len_; }
+
+        void writeReset() { write_len_ = 0; }
+
+    private:
+        J1939Message read_buffer_[64];
+        size_t read_len_;
+        size_t read_pos_;
+        J1939Message write_buffer_[32];
+        size_t write_len_;
+};
+
+// A 20 byte payload split across three packets.
+const uint8_t kPayload[] = {
+    0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A,
+    0x0B, 0x0C, 0x0D, 0x0E, 0x0F, 0x10, 0x11, 0x12, 0x13, 0x14,
+};
+
+void pushData(FakeConnection* fake, uint8_t sa, uint8_t da, uint8_t seq) {
+    uint8_t data[8];
+    memset(data, 0xFF, 8);
+    data[0] = seq;
+    for (size_t i = 0; i < 7 && (seq-1)*7+i < sizeof(kPayload); ++i) {
+        data[i+1] = kPayload[(seq-1)*7+i];
+    }
+    fake->push(0xEB00, sa, da, data);
+}
+
+test(J1939TransportTest, ReadPassThrough) {
+    FakeConnection fake;
+    J1939Transport transport(&fake);
+
+    J1939Message expect(0xFEF1, 0x10);
+    expect.data({0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77, 0x88});
+    fake.push(expect);
+
+    J1939Message actual;
+    assertEqual(transport.read(&actual), ERR_OK);
+    assertTrue(actual == expect);
+    assertEqual(transport.read(&actual), ERR_FIFO);
+}
+
+test(J1939TransportTest, ReceiveBAM) {
+    FakeConnection fake;
+    J1939Transport transport(&fake);
+
+    fake.push(0xEC00, 0x10, 0xFF, {0x20, 0x14, 0x00, 0x03, 0xFF, 0xCA, 0xFE, 0x00});
+    pushData(&fake, 0x10, 0xFF, 1);
+    pushData(&fake, 0x10, 0xFF, 2);
+    pushData(&fake, 0x10, 0xFF, 3);
+
+    J1939Message frame;
+    J1939TransportMessage* message;
+    assertEqual(transport.read(&frame), ERR_FIFO);
+    assertEqual(transport.receive(&message), ERR_OK);
+    assertEqual(message->pgn(), (uint32_t)0xFECA);
+    assertEqual(message->source_address(), 0x10);
+    assertTrue(message->broadcast());
+    assertEqual(message->size(), (uint16_t)sizeof(kPayload));
+    assertEqual(memcmp(message->data(), kPayload, sizeof(kPayload)), 0);
+    assertEqual(fake.writeCount(), (size_t)0);
+
+    transport.release(message);
+    assertEqual(transport.receive(&message), ERR_FIFO);
+}
+
+test(J1939TransportTest, ReceiveConcurrentBAM) {
+    FakeConnection fake;
+    J1939Transport transport(&fake, 2);
+
+    fake.push(0xEC00, 0x10, 0xFF, {0x20, 0x14, 0x00, 0x03, 0xFF, 0xCA, 0xFE, 0x00});
+    fake.push(0xEC00, 0x11, 0xFF, {0x20, 0x14, 0x00, 0x03, 0xFF, 0xDA, 0xFE, 0x00});
+    pushData(&fake, 0x10, 0xFF, 1);
+    pushData(&fake, 0x11, 0xFF, 1);
+    pushData(&fake, 0x11, 0xFF, 2);
+    pushData(&fake, 0x10, 0xFF, 2);
+    pushData(&fake, 0x10, 0xFF, 3);
+    pushData(&fake, 0x11, 0xFF, 3);
+
+    J1939Message frame;
+    J1939TransportMessage* message1;
+    J1939TransportMessage* message2;
+    assertEqual(transport.read(&frame), ERR_FIFO);
+    assertEqual(transport.receive(&message1), ERR_OK);
+    assertEqual(transport.receive(&message2), ERR_OK);
+    assertEqual(message1->source_address(), 0x10);
+    assertEqual(message1->pgn(), (uint32_t)0xFECA);
+    assertEqual(memcmp(message1->data(), kPayload, sizeof(kPayload)), 0);
+    assertEqual(message2->source_address(), 0x11);
+    assertEqual(message2->pgn(), (uint32_t)0xFEDA);
+    assertEqual(memcmp(message2->data(), kPayload, sizeof(kPayload)), 0);
+}
+
+test(J1939TransportTest, ReceiveBAMOutOfSequence) {
+    FakeConnection fake;
+    J1939Transport transport(&fake);
+
+    fake.push(0xEC00, 0x10, 0xFF, {0x20, 0x14, 0x00, 0x03, 0xFF, 0xCA, 0xFE, 0x00});
+    pushData(&fake, 0x10, 0xFF, 1);
+    pushData(&fake, 0x10, 0xFF, 3);
+    pushData(&fake, 0x10, 0xFF, 2);
+
+    J1939Message frame;
+    J1939TransportMessage* message;
+    assertEqual(transport.read(&frame), ERR_FIFO);
+    assertEqual(transport.receive(&message), ERR_FIFO);
+}
+
+test(J1939TransportTest, ReceiveRTS) {
+    FakeConnection fake;
+    J1939Transport transport(&fake);
+    transport.address(0x20);
+
+    fake.push(0xEC00, 0x10, 0x20, {0x10, 0x14, 0x00, 0x03, 0x02, 0xCA, 0xFE, 0x00});
+    pushData(&fake, 0x10, 0x20, 1);
+    pushData(&fake, 0x10, 0x20, 2);
+    pushData(&fake, 0x10, 0x20, 3);
+
+    J1939Message frame;
+    J1939TransportMessage* message;
+    assertEqual(transport.read(&frame), ERR_FIFO);
+
+    // CTS for two packets, CTS for the last packet, then EOMA
+    assertEqual(fake.writeCount(), (size_t)3);
+    J1939Message* writes = fake.writeData();
+    assertEqual(writes[0].pgn(), (uint32_t)0xEC00);
+    assertEqual(writes[0].source_address(), 0x20);
+    assertEqual(writes[0].dest_address(), 0x10);
+    assertEqual(writes[0].data()[0], 17);
+    assertEqual(writes[0].data()[1], 2);
+    assertEqual(writes[0].data()[2], 1);
+    assertEqual(writes[1].data()[0], 17);
+    assertEqual(writes[1].data()[1], 1);
+    assertEqual(writes[1].data()[2], 3);
+    assertEqual(writes[2].data()[0], 19);
+    assertEqual(writes[2].data()[1], 0x14);
+    assertEqual(writes[2].data()[3], 3);
+
+    assertEqual(transport.receive(&message), ERR_OK);
+    assertEqual(message->pgn(), (uint32_t)0xFECA);
+    assertEqual(message->dest_address(), 0x20);
+    assertFalse(message->broadcast());
+    assertEqual(message->size(), (uint16_t)sizeof(kPayload));
+    assertEqual(memcmp(message->data(), kPayload, sizeof(kPayload)), 0);
+    transport.release(message);
+}
+
+test(J1939TransportTest, ReceiveRTSOtherAddress) {
+    FakeConnection fake;
+    J1939Transport transport(&fake);
+    transport.address(0x20);
+
+    fake.push(0xEC00, 0x10, 0x21, {0x10, 0x14, 0x00, 0x03, 0xFF, 0xCA, 0xFE, 0x00});
+
+    J1939Message frame;
+    assertEqual(transport.read(&frame), ERR_FIFO);
+    assertEqual(fake.writeCount(), (size_t)0);
+}
+
+test(J1939TransportTest, ReceiveRTSPoolExhausted) {
+    FakeConnection fake;
+    J1939Transport transport(&fake, 1);
+    transport.address(0x20);
+
+    fake.push(0xEC00, 0x10, 0x20, {0x10, 0x14, 0x00, 0x03, 0xFF, 0xCA, 0xFE, 0x00});
+    fake.push(0xEC00, 0x11, 0x20, {0x10, 0x14, 0x00, 0x03, 0xFF, 0xCA, 0xFE, 0x00});
+
+    J1939Message frame;
+    assertEqual(transport.read(&frame), ERR_FIFO);
+    assertEqual(fake.writeCount(), (size_t)2);
+    J1939Message* writes = fake.writeData();
+    assertEqual(writes[0].data()[0], 17);
+    assertEqual(writes[1].dest_address(), 0x11);
+    assertEqual(writes[1].data()[0], 255);
+    assertEqual(writes[1].data()[1], J1939_ABORT_BUSY);
+}
+
+test(J1939TransportTest, SendSingleFrame) {
+    FakeConnection fake;
+    J1939Transport transport(&fake);
+    transport.address(0x20);
+
+    assertEqual(transport.send(0xFECA, 0xFF, kPayload, 8), ERR_OK);
+    assertEqual(fake.writeCount(), (size_t)1);
+    assertEqual(fake.writeData()[0].pgn(), (uint32_t)0xFECA);
+    assertEqual(fake.writeData()[0].size(), 8);
+    assertFalse(transport.sending());
+}
+
+test(J1939TransportTest, SendBAM) {
+    FakeConnection fake;
+    J1939Transport transport(&fake);
+    transport.address(0x20);
+
+    assertEqual(transport.send(0xFECA, 0xFF, kPayload, sizeof(kPayload)), ERR_OK);
+    assertTrue(transport.sending());
+    assertEqual(fake.writeCount(), (size_t)1);
+    J1939Message* writes = fake.writeData();
+    assertEqual(writes[0].pgn(), (uint32_t)0xEC00);
+    assertEqual(writes[0].dest_address(), 0xFF);
+    assertEqual(writes[0].data()[0], 32);
+    assertEqual(writes[0].data()[1], 0x14);
+    assertEqual(writes[0].data()[3], 3);
+    assertEqual(writes[0].data()[5], 0xCA);
+    assertEqual(writes[0].data()[6], 0xFE);
+}
+
+test(J1939TransportTest, SendRTS) {
+    FakeConnection fake;
+    J1939Transport transport(&fake);
+    transport.address(0x20);
+
+    assertEqual(transport.send(0xFECA, 0x10, kPayload, sizeof(kPayload)), ERR_OK);
+    assertEqual(fake.writeCount(), (size_t)1);
+    assertEqual(fake.writeData()[0].data()[0], 16);
+    assertEqual(fake.writeData()[0].dest_address(), 0x10);
+    fake.writeReset();
+
+    J1939Message frame;
+    fake.push(0xEC00, 0x10, 0x20, {0x11, 0x03, 0x01, 0xFF, 0xFF, 0xCA, 0xFE, 0x00});
+    assertEqual(transport.read(&frame), ERR_FIFO);
+    assertEqual(fake.writeCount(), (size_t)3);
+    J1939Message* writes = fake.writeData();
+    for (uint8_t i = 0; i < 3; ++i) {
+        assertEqual(writes[i].pgn(), (uint32_t)0xEB00);
+        assertEqual(writes[i].dest_address(), 0x10);
+        assertEqual(writes[i].data()[0], i + 1);
+    }
+    assertEqual(memcmp(writes[0].data() + 1, kPayload, 7), 0);
+    assertEqual(memcmp(writes[2].data() + 1, kPayload + 14, 6), 0);
+    assertEqual(writes[2].data()[7], 0xFF);
+    assertTrue(transport.sending());
+
+    fake.push(0xEC00, 0x10, 0x20, {0x13, 0x14, 0x00, 0x03, 0xFF, 0xCA, 0xFE, 0x00});
+    assertEqual(transport.read(&frame), ERR_FIFO);
+    assertFalse(transport.sending());
+}
+
+test(J1939TransportTest, SendInvalid) {
+    FakeConnection fake;
+    J1939Transport transport(&fake, 1, 16);
+
+    assertEqual(transport.send(0xFECA, 0x10, kPayload, 16), ERR_INVALID);
+    transport.address(0x20);
+    assertEqual(transport.send(0xFECA, 0x10, kPayload, sizeof(kPayload)), ERR_INVALID);
+    assertEqual(transport.send(0xFECA, 0x10, kPayload, 16), ERR_OK);
+    assertEqual(transport.send(0xFECA, 0x11, kPayload, 16), ERR_FIFO);
+}
+
+}  // namespace Canny
+
+// Test boilerplate.
+void setup() {
+#ifdef ARDUINO
+    delay(1000);
+#endif
+    SERIAL_PORT_MONITOR.begin(115200);
+    while(!SERIAL_PORT_MONITOR);
+}
+
+void loop() {
+    TestRunner::run();
+    delay(1);
+}